@@ -349,6 +349,26 @@ private:
         std::unique_ptr<SampleRef> sample,
         SampleWrittenCb writtenCb = {}) const;
 
+    // Matched samples are written in batches, sorted by their offset on disk to read them in a single sweep
+    static constexpr DWORDLONG kMaxPendingSampleBytes = 1024 * 1024 * 1024;  // 1GB
+    // Offlimits samples have no data but still hold their match until written
+    static constexpr size_t kMaxPendingSamples = 10000;
+
+    struct PendingSample
+    {
+        std::unique_ptr<SampleRef> Sample;
+        const SampleSpec* Spec;
+        ULONGLONG DiskOffset;
+        size_t Order;
+    };
+
+    std::vector<PendingSample> m_pendingSamples;
+    DWORDLONG m_pendingSampleBytes = 0LL;
+    HRESULT m_hrPendingSamples = S_OK;
+
+    void AddPendingSample(std::unique_ptr<SampleRef> sample, const SampleSpec& sampleSpec);
+    HRESULT WritePendingSamples();
+
     void UpdateSamplesLimits(SampleSpec& sampleSpec, const SampleRef& sample);
 
     void FinalizeHashes(const Main::SampleRef& sample) const;
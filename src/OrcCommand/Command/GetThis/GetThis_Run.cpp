@@ -31,6 +31,7 @@
 #include "ArchiveExtract.h"
 
 #include "SnapshotVolumeReader.h"
+#include "NTFSStream.h"
 
 #include "SystemDetails.h"
 #include "Utils/WinApi.h"
@@ -505,6 +506,26 @@ HRESULT RegFlushKeys()
     return S_OK;
 }
 
+// Offset on disk of the first data of the sample, samples without data on disk (resident, sparse, not NTFS) come first
+ULONGLONG GetSampleDiskOffset(const FileFind::Match::AttributeMatch& attribute)
+{
+    const auto ntfsStream = std::dynamic_pointer_cast<NTFSStream>(attribute.RawStream);
+    if (ntfsStream == nullptr)
+    {
+        return 0LL;
+    }
+
+    for (const auto& segment : ntfsStream->DataSegments())
+    {
+        if (!segment.bUnallocated && segment.bValidData && segment.ullSize > 0)
+        {
+            return segment.ullDiskBasedOffset;
+        }
+    }
+
+    return 0LL;
+}
+
 class VolumeReaderInfo : public Orc::VolumeReaderVisitor
 {
 public:
@@ -1072,8 +1093,6 @@ void Main::OnSampleWritten(const SampleRef& sample, const SampleSpec& sampleSpec
 
 void Main::OnMatchingSample(const std::shared_ptr<FileFind::Match>& aMatch, bool bStop)
 {
-    HRESULT hr = E_FAIL;
-
     _ASSERT(aMatch != nullptr);
 
     if (aMatch->MatchingAttributes.empty())
@@ -1117,16 +1136,76 @@ void Main::OnMatchingSample(const std::shared_ptr<FileFind::Match>& aMatch, bool
         SampleNames.insert(sample->SampleName);
         m_sampleIds.insert(SampleId(*sample));
 
-        hr = WriteSample(*m_compressor, std::move(sample), [this, &sampleSpec](const SampleRef& sample, HRESULT hr) {
-            OnSampleWritten(sample, sampleSpec, hr);
-        });
+        AddPendingSample(std::move(sample), sampleSpec);
+    }
 
+    if (m_pendingSampleBytes >= kMaxPendingSampleBytes || m_pendingSamples.size() >= kMaxPendingSamples)
+    {
+        HRESULT hr = WritePendingSamples();
         if (FAILED(hr))
+        {
+            Log::Error(L"Failed to write pending samples [{}]", SystemError(hr));
+            m_hrPendingSamples = hr;
+        }
+    }
+}
+
+void Main::AddPendingSample(std::unique_ptr<SampleRef> sample, const SampleSpec& sampleSpec)
+{
+    const auto& attribute = sample->Matches.front()->MatchingAttributes[sample->AttributeIndex];
+    const auto diskOffset = ::GetSampleDiskOffset(attribute);
+
+    if (!sample->IsOfflimits())
+    {
+        m_pendingSampleBytes += sample->SampleSize;
+    }
+
+    const auto order = m_pendingSamples.size();
+    m_pendingSamples.push_back({std::move(sample), &sampleSpec, diskOffset, order});
+}
+
+HRESULT Main::WritePendingSamples()
+{
+    HRESULT hr = S_OK;
+
+    // Ties keep the matching order so the archive and the csv are the same from one run to the next
+    std::sort(
+        std::begin(m_pendingSamples),
+        std::end(m_pendingSamples),
+        [](const PendingSample& lhs, const PendingSample& rhs) {
+            if (lhs.Sample->VolumeSerial != rhs.Sample->VolumeSerial)
+                return lhs.Sample->VolumeSerial < rhs.Sample->VolumeSerial;
+
+            const auto cmpresult = memcmp(&lhs.Sample->SnapshotID, &rhs.Sample->SnapshotID, sizeof(GUID));
+            if (cmpresult != 0)
+                return cmpresult < 0;
+
+            if (lhs.DiskOffset != rhs.DiskOffset)
+                return lhs.DiskOffset < rhs.DiskOffset;
+
+            return lhs.Order < rhs.Order;
+        });
+
+    Log::Debug(L"Writing {} sample(s) ({} bytes) in disk order", m_pendingSamples.size(), m_pendingSampleBytes);
+
+    for (auto& pending : m_pendingSamples)
+    {
+        const auto& sampleSpec = *pending.Spec;
+        const auto writtenCb = [this, &sampleSpec](const SampleRef& sample, HRESULT hr) {
+            OnSampleWritten(sample, sampleSpec, hr);
+        };
+
+        HRESULT hrWrite = WriteSample(*m_compressor, std::move(pending.Sample), writtenCb);
+        if (FAILED(hrWrite))
         {
             Log::Warn(L"Failed to add sample");
-            continue;
+            hr = hrWrite;
         }
     }
+
+    m_pendingSamples.clear();
+    m_pendingSampleBytes = 0LL;
+    return hr;
 }
 
 HRESULT Main::FindMatchingSamples()
@@ -1149,6 +1228,18 @@ HRESULT Main::FindMatchingSamples()
         Log::Error(L"Failed while parsing locations");
     }
 
+    hr = WritePendingSamples();
+    if (SUCCEEDED(hr))
+    {
+        // failures of the writes made while matching
+        hr = m_hrPendingSamples;
+    }
+
+    if (FAILED(hr))
+    {
+        Log::Error(L"Failed to write matching samples [{}]", SystemError(hr));
+    }
+
     return S_OK;
 }
 
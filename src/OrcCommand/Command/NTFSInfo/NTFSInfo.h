@@ -17,6 +17,7 @@
 #include "VolumeReader.h"
 #include "MFTWalker.h"
 #include "NtfsFileInfo.h"
+#include "SecurityDescriptorCache.h"
 #include "Authenticode.h"
 
 #pragma managed(push, off)
@@ -108,6 +109,7 @@ private:
     MultipleOutput<LocationOutput> m_SecDescrOutput;
 
     MFTWalker::FullNameBuilder m_FullNameBuilder;
+    std::unique_ptr<SecurityDescriptorCache> m_SecDescrCache;
     DWORD dwTotalFileTreated;
     DWORD m_dwProgress;
 
@@ -206,6 +206,7 @@ void Main::FileAndDataInformation(
             pFileName,
             pDataAttr,
             m_codeVerifier);
+        fi.SetSecurityDescriptorCache(m_SecDescrCache.get());
 
         HRESULT hr = fi.WriteFileInformation(NtfsFileInfo::g_NtfsColumnNames, output, config.Filters);
         ++dwTotalFileTreated;
@@ -237,6 +238,7 @@ void Main::DirectoryInformation(
             pFileName,
             nullptr,
             m_codeVerifier);
+        fi.SetSecurityDescriptorCache(m_SecDescrCache.get());
 
         HRESULT hr = fi.WriteFileInformation(NtfsFileInfo::g_NtfsColumnNames, output, config.Filters);
         ++dwTotalFileTreated;
@@ -753,12 +755,21 @@ HRESULT Main::RunThroughMFT()
             };
         }
 
-        if (secdescrIterator->second != nullptr)
+        // Security IDs are specific to the volume
+        m_SecDescrCache = std::make_unique<SecurityDescriptorCache>();
+
+        const bool bOwnerColumns = fileinfoIterator->second != nullptr
+            && HasAnyFlag(config.ColumnIntentions, Intentions::FILEINFO_OWNER | Intentions::FILEINFO_OWNERSID);
+
+        if (secdescrIterator->second != nullptr || bOwnerColumns)
         {
             callBacks.SecDescCallback = [this, secdescrIterator](
                                             const std::shared_ptr<VolumeReader>& volreader,
                                             const PSECURITY_DESCRIPTOR_ENTRY pEntry) {
-                SecurityDescriptorInformation(*secdescrIterator->second, volreader, pEntry);
+                m_SecDescrCache->Add(*pEntry);
+
+                if (secdescrIterator->second != nullptr)
+                    SecurityDescriptorInformation(*secdescrIterator->second, volreader, pEntry);
             };
         }
 
@@ -793,6 +804,12 @@ HRESULT Main::RunThroughMFT()
                 m_console.Print("Done");
                 walker.Statistics(L"");
             }
+
+            Log::Debug(
+                L"Security descriptors of '{}': {} ids, {} distinct",
+                loc->GetLocation(),
+                m_SecDescrCache->Count(),
+                m_SecDescrCache->DescriptorCount());
         }
     }
 
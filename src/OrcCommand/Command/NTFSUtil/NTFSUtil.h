@@ -59,6 +59,10 @@ public:
         // Record
         ULONGLONG ullRecord;
 
+        // Find, from a MFT snapshot when one is available
+        std::wstring strFind;
+        std::wstring strSnapshot;
+
         // USN
         bool bConfigure;
         DWORDLONG dwlMaxSize;
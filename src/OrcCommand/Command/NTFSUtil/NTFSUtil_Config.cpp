@@ -53,10 +53,13 @@ HRESULT Main::GetConfigurationFromArgcArgv(int argc, LPCWSTR argv[])
                 {
                     config.cmd = Main::MFT;
                 }
-                else if (BooleanOption(argv[i] + 1, L"Find", bBool))
+                else if (ParameterOption(argv[i] + 1, L"Find", config.strFind))
                 {
                     config.cmd = Main::Find;
                 }
+                else if (ParameterOption(argv[i] + 1, L"Snapshot", config.strSnapshot))
+                {
+                }
                 else if (ParameterOption(argv[i] + 1, L"Record", config.ullRecord))
                 {
                     config.cmd = Main::Record;
@@ -123,6 +126,12 @@ HRESULT Main::CheckConfiguration()
         return E_INVALIDARG;
     }
 
+    if (config.cmd == Main::Find && config.strVolume.empty())
+    {
+        Log::Error("No volume set to find records in");
+        return E_INVALIDARG;
+    }
+
     if (config.bConfigure)
     {
         if (config.strVolume.empty() && config.cmd == Main::USN)
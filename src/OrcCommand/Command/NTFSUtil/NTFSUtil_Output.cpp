@@ -37,7 +37,8 @@ void Main::PrintUsage()
         "NTFS Swiss Army knife with a collection of useful features to investigate NTFS.");
 
     auto subcommandsNode = usageNode.AddNode("SUBCOMMAND");
-    subcommandsNode.Add("Available commands: /usn, /vsn, /enumlocs, /loc, /record, /hexdump, /mft, /bitlocker");
+    subcommandsNode.Add(
+        "Available commands: /usn, /vsn, /enumlocs, /loc, /record, /find, /hexdump, /mft, /bitlocker");
     subcommandsNode.AddEOL();
 
     {
@@ -95,6 +96,22 @@ void Main::PrintUsage()
         Usage::PrintParameters(usageNode, "RECORD PARAMETERS", kRecordParameters);
     }
 
+    {
+        auto findNode = usageNode.AddNode("FIND SUBCOMMAND");
+        findNode.Add("Find the MFT records with a given name and display their path, size and data runs");
+        findNode.AddEOL();
+        findNode.Add("Usage: /find=<Name> [/snapshot=<File>] <Location>");
+        findNode.AddEOL();
+
+        constexpr std::array kFindParameters = {
+            Parameter {"<Name>", "File name to look for (case insensitive)"},
+            Parameter {
+                "/snapshot=<File>",
+                "MFT snapshot to query instead of walking the MFT, it is (re)built when it does not match the MFT"},
+            Parameter {"<Location>", "Location (ex: 'D:'). See below for more details."}};
+        Usage::PrintParameters(usageNode, "FIND PARAMETERS", kFindParameters);
+    }
+
     {
         auto hexdumpNode = usageNode.AddNode("HEXDUMP SUBCOMMAND");
         hexdumpNode.Add("Dump data from the disk. Record offset and size can be easily found with '/record' command");
@@ -25,6 +25,7 @@
 #include "MFTWalker.h"
 #include "MFTOnline.h"
 #include "MFTOffline.h"
+#include "MFTSnapshot.h"
 #include "OfflineMFTReader.h"
 
 #include "Utils/TypeTraits.h"
@@ -430,6 +431,106 @@ HRESULT Main::CommandRecord(ULONGLONG ullRecord)
 // Find record
 HRESULT Main::FindRecord(const std::wstring& strTerm)
 {
+    auto root = m_console.OutputTree();
+
+    LocationSet locs;
+
+    std::vector<std::shared_ptr<Location>> addedLocs;
+    HRESULT hr = locs.AddLocations(config.strVolume.c_str(), addedLocs);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    if (addedLocs.empty() || addedLocs[0]->GetReader() == nullptr)
+    {
+        Log::Error(L"Unable to instantiate Volume reader for location: '{}'", config.strVolume);
+        return E_FAIL;
+    }
+
+    auto loc = addedLocs[0];
+
+    hr = loc->GetReader()->LoadDiskProperties();
+    if (FAILED(hr))
+    {
+        Log::Error(L"Unable to load disk properties for location: '{}' [{}]", loc->GetLocation(), SystemError(hr));
+        return hr;
+    }
+
+    if (!loc->IsNTFS())
+    {
+        Log::Error(L"Find command is only available on a NTFS volume: '{}'", config.strVolume);
+        return E_INVALIDARG;
+    }
+
+    MFTWalker walk;
+    hr = walk.Initialize(loc, false);
+    if (FAILED(hr))
+    {
+        Log::Error(L"Failed during MFT walk initialisation on volume: '{}'", config.strVolume);
+        return hr;
+    }
+
+    // The MFT is only walked when there is no snapshot of its current state
+    const auto key = walk.GetSnapshotKey();
+
+    MFTSnapshot snapshot;
+    if (config.strSnapshot.empty() || FAILED(hr = snapshot.Open(config.strSnapshot, key)))
+    {
+        MFTSnapshotWriter writer;
+
+        MFTWalker::Callbacks callbacks;
+        callbacks.ElementCallback = [&writer](const std::shared_ptr<VolumeReader>& volReader, MFTRecord* pRecord) {
+            writer.Add(volReader, pRecord);
+        };
+
+        if (FAILED(hr = walk.Walk(callbacks)))
+        {
+            Log::Error("Failed during MFT walk on volume [{}]", SystemError(hr));
+            return hr;
+        }
+
+        if (!config.strSnapshot.empty())
+        {
+            if (FAILED(hr = writer.Write(config.strSnapshot, key)))
+                return hr;
+            hr = snapshot.Open(config.strSnapshot, key);
+        }
+        else
+        {
+            std::vector<BYTE> image;
+            if (SUCCEEDED(hr = writer.Serialize(key, image)))
+                hr = snapshot.Open(std::move(image), key);
+        }
+
+        if (FAILED(hr))
+        {
+            Log::Error(L"Failed to open MFT snapshot of volume: '{}' [{}]", config.strVolume, SystemError(hr));
+            return hr;
+        }
+    }
+    else
+    {
+        Log::Info(L"Using MFT snapshot: '{}' ({} records)", config.strSnapshot, snapshot.GetRecordCount());
+    }
+
+    const auto found = snapshot.FindByName(strTerm);
+    for (const auto index : found)
+    {
+        const auto record = snapshot.GetRecord(index);
+
+        auto recordNode = root.AddNode(L"{:#018x}: {}", record.FRN, snapshot.GetFullName(index));
+        PrintValue(recordNode, "Size", record.Size);
+        PrintValue(recordNode, "Attributes", fmt::format("{:#x}", record.Attributes));
+
+        for (const auto& run : snapshot.GetDataRuns(index))
+        {
+            recordNode.Add("Run at offset {:#x} ({} bytes)", run.DiskOffset, run.Length);
+        }
+    }
+
+    root.Add(L"Found {} record(s) named '{}'", found.size(), strTerm);
+    root.AddEmptyLine();
     return S_OK;
 }
 
@@ -863,6 +964,8 @@ HRESULT Main::Run()
             return CommandMFT();
         case Main::USN:
             return CommandUSN();
+        case Main::Find:
+            return FindRecord(config.strFind);
         case Main::Record: {
             return CommandRecord(config.ullRecord);
         }
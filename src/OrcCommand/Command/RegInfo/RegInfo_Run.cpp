@@ -11,6 +11,8 @@
 #include <string>
 #include <sstream>
 
+#include <ppl.h>
+
 #include "OrcLib.h"
 
 #include "RegInfo.h"
@@ -38,6 +40,24 @@ using namespace Orc::Command::RegInfo;
 // end the table with a null character
 constexpr WCHAR kOutputBadChars[] = {'\n', '"', '\0'};
 
+namespace {
+
+// Orders matches by search term so the output does not depend on the layout of the matches map
+std::vector<std::pair<std::shared_ptr<RegFind::SearchTerm>, std::shared_ptr<RegFind::Match>>>
+SortedMatches(const RegFind::MatchesMap& matches)
+{
+    std::vector<std::pair<std::shared_ptr<RegFind::SearchTerm>, std::shared_ptr<RegFind::Match>>> sorted(
+        std::cbegin(matches), std::cend(matches));
+
+    std::stable_sort(std::begin(sorted), std::end(sorted), [](const auto& left, const auto& right) {
+        return left.first->GetDescription() < right.first->GetDescription();
+    });
+
+    return sorted;
+}
+
+}  // namespace
+
 Main::RegInfoDescription Main::_InfoDescription[] = {
     {REGINFO_COMPUTERNAME, L"ComputerName", L"Name of computer"},
 
@@ -477,9 +497,36 @@ HRESULT Main::Run()
             }
         }
 
+        // Hives are searched concurrently, results are written in the stream list order. Hives found on a volume share
+        // its reader and are searched one at a time.
+        const auto& hives = query->StreamList;
+        query->QuerySpec.Compile();
+
+        std::vector<RegFind::MatchesMap> matches(hives.size());
+        std::vector<HRESULT> results(hives.size(), E_FAIL);
+
+        const auto search = [&query, &hives, &matches, &results](size_t i) {
+            if (hives[i].Stream)
+                results[i] = query->QuerySpec.ParallelFind(hives[i].Stream, hives[i].LogStreams, matches[i]);
+        };
+
+        std::vector<size_t> fileHives;
+        std::vector<size_t> volumeHives;
+        for (size_t i = 0; i < hives.size(); i++)
+        {
+            if (std::dynamic_pointer_cast<FileStream>(hives[i].Stream) != nullptr)
+                fileHives.push_back(i);
+            else
+                volumeHives.push_back(i);
+        }
+
+        concurrency::parallel_for_each(std::cbegin(fileHives), std::cend(fileHives), search);
+        std::for_each(std::cbegin(volumeHives), std::cend(volumeHives), search);
+
         auto root = m_console.OutputTree();
-        for (const auto& hive : query->StreamList)
+        for (size_t i = 0; i < hives.size(); i++)
         {
+            const auto& hive = hives[i];
             auto node = root.AddNode("Parsing hive '{}'", hive.FileName);
 
             if (HasFlag(config.Output.Type, OutputSpec::Kind::Directory))
@@ -502,7 +549,7 @@ HRESULT Main::Run()
                 continue;
             }
 
-            hr = query->QuerySpec.Find(hive.Stream, nullptr, nullptr);
+            hr = results[i];
             if (FAILED(hr))
             {
                 Log::Error(L"Failed to search into hive '{}' [{}]", hive.FileName, SystemError(hr));
@@ -510,7 +557,7 @@ HRESULT Main::Run()
             }
 
             auto& output = *pRegInfoWriter;
-            for (const auto& [searchTerm, result] : query->QuerySpec.Matches())
+            for (const auto& [searchTerm, result] : SortedMatches(matches[i]))
             {
                 for (const auto& key : result->MatchingKeys)
                 {
@@ -537,8 +584,6 @@ HRESULT Main::Run()
                 }
             }
         }
-
-        query->QuerySpec.ClearMatches();
     }
 
     return hr;
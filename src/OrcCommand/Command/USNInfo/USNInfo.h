@@ -39,6 +39,9 @@ public:
 
         bool bCompactForm = false;
         bool bAddShadows = false;
+
+        // Files (sector dumps, extracted unallocated space...) carved for USN records with the names of each volume
+        std::vector<std::wstring> carveFiles;
     };
 
 private:
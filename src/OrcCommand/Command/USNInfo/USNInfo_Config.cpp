@@ -92,6 +92,8 @@ HRESULT Main::GetConfigurationFromArgcArgv(int argc, LPCWSTR argv[])
                     ;
                 else if (BooleanOption(argv[i] + 1, L"Shadows", config.bAddShadows))
                     ;
+                else if (ParameterListOption(argv[i] + 1, L"Carve", config.carveFiles))
+                    ;
                 else if (EncodingOption(argv[i] + 1, config.output.OutputEncoding))
                     ;
                 else if (AltitudeOption(argv[i] + 1, L"Altitude", config.locs.GetAltitude()))
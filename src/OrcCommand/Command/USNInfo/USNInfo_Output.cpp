@@ -42,10 +42,15 @@ void Main::PrintUsage()
 
     Usage::PrintLocationParameters(usageNode);
 
-    constexpr std::array kSpecificParameters = {Usage::Parameter {
-        "/Compact",
-        "Non human readable output. When using this option, the full-path column is not filled in and the reason is in "
-        "hexadecimal form in the output CSV file."}};
+    constexpr std::array kSpecificParameters = {
+        Usage::Parameter {
+            "/Compact",
+            "Non human readable output. When using this option, the full-path column is not filled in and the reason "
+            "is in hexadecimal form in the output CSV file."},
+        Usage::Parameter {
+            "/Carve=<File>,...",
+            "Carve USN records (versions 2 and 3) from these files (sector dumps, unallocated space or slack extracted "
+            "from the volume) and add them to the output. Names are resolved with the directories of the volume."}};
 
     Usage::PrintParameters(usageNode, "PARAMETERS", kSpecificParameters);
 
@@ -63,6 +68,7 @@ void Main::PrintParameters()
 
     PrintValues(node, "Parsed locations", config.locs.GetParsedLocations());
     PrintValue(node, "Compact", config.bCompactForm);
+    PrintValues(node, L"Carved file(s)", config.carveFiles);
 
     m_console.PrintNewLine();
 }
@@ -186,6 +186,7 @@ HRESULT Main::Run()
         config.output, [this](const MultipleOutput<LocationOutput>::OutputPair& dir) -> HRESULT {
             m_console.Print(L"Parsing volume '{}'", dir.first.m_pLoc->GetLocation());
             USNJournalWalkerOffline walker;
+            walker.SetParallel(true);
 
             HRESULT hr = walker.Initialize(dir.first.m_pLoc);
             if (FAILED(hr))
@@ -230,6 +231,23 @@ HRESULT Main::Run()
                 return S_OK;
             }
 
+            for (const auto& carveFile : config.carveFiles)
+            {
+                FileStream stream;
+                if (FAILED(hr = stream.ReadFrom(carveFile.c_str())))
+                {
+                    Log::Error(L"Failed to open '{}' for USN carving [{}]", carveFile, SystemError(hr));
+                    continue;
+                }
+
+                m_console.Print(L"Carving USN records from '{}'", carveFile);
+                if (FAILED(hr = walker.CarveJournal(stream, {}, callbacks)))
+                {
+                    Log::Error(L"Failed to carve USN records from '{}' [{}]", carveFile, SystemError(hr));
+                    continue;
+                }
+            }
+
             Log::Info(L"Done");
             return S_OK;
         });
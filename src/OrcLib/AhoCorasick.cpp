@@ -0,0 +1,108 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "AhoCorasick.h"
+
+#include <deque>
+
+using namespace Orc;
+
+namespace {
+
+constexpr DWORD kNoState = MAXDWORD;
+
+}  // namespace
+
+void AhoCorasick::Add(const BYTE* pPattern, size_t cbPattern, DWORD dwId)
+{
+    if (pPattern == nullptr || cbPattern == 0)
+        return;
+
+    m_Patterns.emplace_back(std::vector<BYTE>(pPattern, pPattern + cbPattern), dwId);
+}
+
+void AhoCorasick::Build()
+{
+    // Byte classes: 0 for bytes absent from the patterns
+    m_Classes.fill(0);
+    m_dwClassCount = 1L;
+    for (const auto& [pattern, id] : m_Patterns)
+    {
+        for (auto b : pattern)
+        {
+            if (m_Classes[b] == 0)
+                m_Classes[b] = static_cast<WORD>(m_dwClassCount++);
+        }
+    }
+
+    // Trie
+    m_Transitions.assign(m_dwClassCount, kNoState);
+    std::vector<std::vector<DWORD>> outputs(1);
+
+    for (const auto& [pattern, id] : m_Patterns)
+    {
+        DWORD dwState = 0L;
+        for (auto b : pattern)
+        {
+            auto& next = m_Transitions[dwState * m_dwClassCount + m_Classes[b]];
+            if (next == kNoState)
+            {
+                next = static_cast<DWORD>(outputs.size());
+                outputs.emplace_back();
+                m_Transitions.resize(m_Transitions.size() + m_dwClassCount, kNoState);
+            }
+            dwState = m_Transitions[dwState * m_dwClassCount + m_Classes[b]];
+        }
+        outputs[dwState].push_back(id);
+    }
+
+    // Failure links are folded into the transitions, breadth first so the failure state row is always complete
+    std::vector<DWORD> failures(outputs.size(), 0L);
+    std::deque<DWORD> queue;
+
+    for (DWORD c = 0; c < m_dwClassCount; c++)
+    {
+        auto& next = m_Transitions[c];
+        if (next == kNoState)
+            next = 0L;
+        else
+            queue.push_back(next);
+    }
+
+    while (!queue.empty())
+    {
+        const auto dwState = queue.front();
+        queue.pop_front();
+
+        for (DWORD c = 0; c < m_dwClassCount; c++)
+        {
+            const auto dwFailureNext = m_Transitions[failures[dwState] * m_dwClassCount + c];
+            auto& next = m_Transitions[dwState * m_dwClassCount + c];
+            if (next == kNoState)
+            {
+                next = dwFailureNext;
+                continue;
+            }
+
+            failures[next] = dwFailureNext;
+            const auto& inherited = outputs[dwFailureNext];
+            outputs[next].insert(std::end(outputs[next]), std::cbegin(inherited), std::cend(inherited));
+            queue.push_back(next);
+        }
+    }
+
+    m_OutputIndex.resize(outputs.size() + 1);
+    m_Outputs.clear();
+    for (size_t i = 0; i < outputs.size(); i++)
+    {
+        m_OutputIndex[i] = static_cast<DWORD>(m_Outputs.size());
+        m_Outputs.insert(std::end(m_Outputs), std::cbegin(outputs[i]), std::cend(outputs[i]));
+    }
+    m_OutputIndex[outputs.size()] = static_cast<DWORD>(m_Outputs.size());
+}
@@ -0,0 +1,68 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include <array>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Searches a set of byte patterns in a single pass over the data.
+// Patterns are added then Build() computes a deterministic automaton whose alphabet is reduced to the classes of bytes
+// found in the patterns (all other bytes share one class), which keeps the transition table small.
+class ORCLIB_API AhoCorasick
+{
+public:
+    // Empty patterns are ignored
+    void Add(const BYTE* pPattern, size_t cbPattern, DWORD dwId);
+
+    void Build();
+
+    bool Empty() const { return m_Patterns.empty(); }
+
+    // Calls 'onMatch(dwId, ullEndOffset)' for each occurrence of a pattern ending at 'ullEndOffset' (inclusive), the
+    // search stops when 'onMatch' returns false
+    template <typename OnMatch>
+    void Search(const BYTE* pData, size_t cbData, OnMatch onMatch) const
+    {
+        if (m_Transitions.empty())
+            return;
+
+        DWORD dwState = 0L;
+        for (size_t i = 0; i < cbData; i++)
+        {
+            dwState = m_Transitions[dwState * m_dwClassCount + m_Classes[pData[i]]];
+            for (auto j = m_OutputIndex[dwState]; j < m_OutputIndex[dwState + 1]; j++)
+            {
+                if (!onMatch(m_Outputs[j], i))
+                    return;
+            }
+        }
+    }
+
+private:
+    std::vector<std::pair<std::vector<BYTE>, DWORD>> m_Patterns;
+
+    std::array<WORD, 256> m_Classes {};
+    DWORD m_dwClassCount = 0L;
+
+    // Transition of 'state' for 'class' is at 'state * m_dwClassCount + class'
+    std::vector<DWORD> m_Transitions;
+
+    // Ids of the patterns ending in 'state' are in m_Outputs[m_OutputIndex[state], m_OutputIndex[state + 1])
+    std::vector<DWORD> m_OutputIndex;
+    std::vector<DWORD> m_Outputs;
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -17,6 +17,14 @@
 #include "FileStream.h"
 #include "PipeStream.h"
 
+#ifdef ORC_BUILD_ZSTD
+#    include "ZstdStream.h"
+#endif  // ORC_BUILD_ZSTD
+
+#ifdef ORC_BUILD_LZ4
+#    include "Lz4Stream.h"
+#endif  // ORC_BUILD_LZ4
+
 #include "InByteStreamWrapper.h"
 #include "IStreamWrapper.h"
 #include "ISequentialStreamWrapper.h"
@@ -171,6 +179,52 @@ std::shared_ptr<ByteStream> Orc::ByteStream::GetStream(const OutputSpec& output)
     }
 }
 
+std::shared_ptr<ByteStream> ByteStream::GetCompressingStream(
+    const std::shared_ptr<ByteStream>& output,
+    OutputSpecTypes::StreamCompression compression)
+{
+    HRESULT hr = E_FAIL;
+
+    switch (compression)
+    {
+        case OutputSpecTypes::StreamCompression::None:
+            return output;
+        case OutputSpecTypes::StreamCompression::Zstd: {
+#ifdef ORC_BUILD_ZSTD
+            auto retval = std::make_shared<ZstdStream>();
+
+            // Let zstd spread frame compression over the available cores, table writers should not wait on it
+            const auto dwWorkers = std::max(1U, Concurrency::GetProcessorCount() / 2);
+            if (FAILED(hr = retval->OpenToCompress(output, ZstdStream::kDefaultCompressionLevel, dwWorkers)))
+            {
+                Log::Error("Failed to open zstd compressing stream [{}]", SystemError(hr));
+                return nullptr;
+            }
+            return retval;
+#else
+            Log::Error("Zstd stream compression is not available");
+            return nullptr;
+#endif  // ORC_BUILD_ZSTD
+        }
+        case OutputSpecTypes::StreamCompression::Lz4: {
+#ifdef ORC_BUILD_LZ4
+            auto retval = std::make_shared<Lz4Stream>();
+            if (FAILED(hr = retval->OpenToCompress(output)))
+            {
+                Log::Error("Failed to open lz4 compressing stream [{}]", SystemError(hr));
+                return nullptr;
+            }
+            return retval;
+#else
+            Log::Error("Lz4 stream compression is not available");
+            return nullptr;
+#endif  // ORC_BUILD_LZ4
+        }
+        default:
+            return nullptr;
+    }
+}
+
 std::shared_ptr<ByteStream> ByteStream::GetHashStream(const std::shared_ptr<ByteStream>& aStream)
 {
     std::shared_ptr<CryptoHashStream> hs = std::dynamic_pointer_cast<CryptoHashStream>(aStream);
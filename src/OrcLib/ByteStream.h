@@ -10,6 +10,7 @@
 #include "OrcLib.h"
 
 #include "ByteStreamVisitor.h"
+#include "OutputSpecTypes.h"
 
 #include <memory>
 
@@ -74,6 +75,8 @@ public:
     STDMETHOD(Close)() PURE;
 
     static std::shared_ptr<ByteStream> GetStream(const OutputSpec& output);
+    static std::shared_ptr<ByteStream>
+    GetCompressingStream(const std::shared_ptr<ByteStream>& output, OutputSpecTypes::StreamCompression compression);
     static std::shared_ptr<ByteStream> GetHashStream(const std::shared_ptr<ByteStream>& aStream);
 
     static HRESULT Get_IInStream(const std::shared_ptr<ByteStream>& aStream, ::IInStream** pInStream);
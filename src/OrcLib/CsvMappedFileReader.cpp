@@ -0,0 +1,571 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#include "stdafx.h"
+
+#include "CsvMappedFileReader.h"
+
+#include "ParameterCheck.h"
+#include "WideAnsi.h"
+
+#include <bitset>
+#include <charconv>
+
+#include <emmintrin.h>
+
+using namespace std;
+
+using namespace Orc;
+
+using namespace Orc::TableOutput::CSV;
+
+namespace {
+
+constexpr size_t kBlockSize = 64;
+
+inline DWORD FirstSetBit(ULONG64 mask)
+{
+    unsigned long index = 0L;
+#ifdef _M_X64
+    _BitScanForward64(&index, mask);
+#else
+    if (!_BitScanForward(&index, static_cast<ULONG>(mask)))
+    {
+        _BitScanForward(&index, static_cast<ULONG>(mask >> 32));
+        index += 32;
+    }
+#endif
+    return index;
+}
+
+// Mask of the bits up to (and including) 'index'
+inline ULONG64 MaskUpTo(DWORD index)
+{
+    return index == 63 ? ~0ULL : (2ULL << index) - 1;
+}
+
+// Bit i of the result is the xor of the bits 0 to i: with the quotes mask, bits are set from an opening quote up to
+// (excluding) the closing one. Escaped quotes ("") toggle the state twice and leave it unchanged.
+inline ULONG64 PrefixXor(ULONG64 mask)
+{
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+}
+
+class StructuralScanner
+{
+public:
+    StructuralScanner(CHAR cSeparator, CHAR cQuote)
+        : m_separator(_mm_set1_epi8(cSeparator))
+        , m_quote(_mm_set1_epi8(cQuote))
+        , m_newLine(_mm_set1_epi8('\n'))
+    {
+    }
+
+    // Compute the masks of the separators and line feeds of a block which are not within quotes
+    void Scan(const CHAR* pBlock, ULONG64& separators, ULONG64& newLines)
+    {
+        __m128i bytes[4];
+        for (int i = 0; i < 4; i++)
+            bytes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlock + 16 * i));
+
+        const auto inQuotes = PrefixXor(Match(bytes, m_quote)) ^ m_ullInQuotes;
+
+        // Carry the quoted state over to the next block (all ones when the last byte is within quotes)
+        m_ullInQuotes = static_cast<ULONG64>(static_cast<LONG64>(inQuotes) >> 63);
+
+        separators = Match(bytes, m_separator) & ~inQuotes;
+        newLines = Match(bytes, m_newLine) & ~inQuotes;
+    }
+
+    // Copy the last (partial) block of the data to avoid reading past the end of the mapping
+    const CHAR* GetBlock(const CHAR* pData, ULONGLONG ullPos, ULONGLONG ullSize)
+    {
+        if (ullSize - ullPos >= kBlockSize)
+            return pData + ullPos;
+
+        ZeroMemory(m_tail, kBlockSize);
+        CopyMemory(m_tail, pData + ullPos, static_cast<size_t>(ullSize - ullPos));
+        return m_tail;
+    }
+
+private:
+    static ULONG64 Match(const __m128i bytes[4], const __m128i pattern)
+    {
+        ULONG64 mask = 0LL;
+        for (int i = 0; i < 4; i++)
+        {
+            const auto match = static_cast<ULONG>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes[i], pattern)));
+            mask |= static_cast<ULONG64>(match) << (16 * i);
+        }
+        return mask;
+    }
+
+    const __m128i m_separator;
+    const __m128i m_quote;
+    const __m128i m_newLine;
+    ULONG64 m_ullInQuotes = 0LL;
+    CHAR m_tail[kBlockSize];
+};
+
+}  // namespace
+
+std::string_view MappedFileReader::Unquote(std::string_view field, CHAR cQuote, std::string& unescaped)
+{
+    if (field.size() < 2 || field.front() != cQuote || field.back() != cQuote)
+        return field;
+
+    field = field.substr(1, field.size() - 2);
+
+    const auto escaped = field.find(cQuote);
+    if (escaped == std::string_view::npos)
+        return field;
+
+    // Escaped quotes are doubled
+    unescaped.assign(field.data(), escaped);
+    for (auto i = escaped; i < field.size(); i++)
+    {
+        unescaped.push_back(field[i]);
+        if (field[i] == cQuote && i + 1 < field.size() && field[i + 1] == cQuote)
+            i++;
+    }
+    return unescaped;
+}
+
+HRESULT MappedFileReader::Record::GetUnquoted(size_t dwIndex, std::string_view& value, std::string& unescaped) const
+{
+    if (dwIndex >= m_Fields.size())
+        return E_INVALIDARG;
+
+    value = Unquote(m_Fields[dwIndex], m_cQuote, unescaped);
+    return S_OK;
+}
+
+HRESULT MappedFileReader::Record::GetString(size_t dwIndex, std::wstring& value) const
+{
+    HRESULT hr = E_FAIL;
+
+    std::string_view field;
+    std::string unescaped;
+    if (FAILED(hr = GetUnquoted(dwIndex, field, unescaped)))
+        return hr;
+
+    return AnsiToWide(field, value);
+}
+
+HRESULT MappedFileReader::Record::GetInteger(size_t dwIndex, DWORD& value) const
+{
+    LARGE_INTEGER li;
+    if (auto hr = GetLargeInteger(dwIndex, li); FAILED(hr))
+        return hr;
+
+    if (li.QuadPart < 0 || li.QuadPart > MAXDWORD)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE);
+
+    value = li.LowPart;
+    return S_OK;
+}
+
+HRESULT MappedFileReader::Record::GetLargeInteger(size_t dwIndex, LARGE_INTEGER& value) const
+{
+    HRESULT hr = E_FAIL;
+
+    std::string_view field;
+    std::string unescaped;
+    if (FAILED(hr = GetUnquoted(dwIndex, field, unescaped)))
+        return hr;
+
+    if (field.empty())
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE);
+
+    const auto pEnd = field.data() + field.size();
+
+    std::from_chars_result result;
+    if (field.size() > 2 && field[0] == '0' && (field[1] == 'x' || field[1] == 'X'))
+    {
+        ULONGLONG ullValue = 0LL;
+        result = std::from_chars(field.data() + 2, pEnd, ullValue, 16);
+        value.QuadPart = static_cast<LONGLONG>(ullValue);
+    }
+    else
+    {
+        result = std::from_chars(field.data(), pEnd, value.QuadPart, 10);
+    }
+
+    if (result.ec != std::errc() || result.ptr != pEnd)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE);
+
+    return S_OK;
+}
+
+HRESULT MappedFileReader::Record::GetDateTime(size_t dwIndex, FILETIME& value, const WCHAR* szDateFormat) const
+{
+    HRESULT hr = E_FAIL;
+
+    std::wstring field;
+    if (FAILED(hr = GetString(dwIndex, field)))
+        return hr;
+
+    if (field.empty())
+    {
+        ZeroMemory(&value, sizeof(value));
+        return S_OK;
+    }
+
+    return GetDateFromString(szDateFormat, field.c_str(), value);
+}
+
+HRESULT MappedFileReader::Record::GetBoolean(size_t dwIndex, bool& value, LPCWSTR szBool) const
+{
+    HRESULT hr = E_FAIL;
+
+    std::string_view field;
+    std::string unescaped;
+    if (FAILED(hr = GetUnquoted(dwIndex, field, unescaped)))
+        return hr;
+
+    if (field.size() != 1 || szBool == nullptr || wcslen(szBool) < 2)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE);
+
+    const auto wChar = static_cast<WCHAR>(static_cast<BYTE>(field[0]));
+    if (wChar == szBool[0])
+        value = true;
+    else if (wChar == szBool[1])
+        value = false;
+    else
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE);
+
+    return S_OK;
+}
+
+HRESULT MappedFileReader::Record::GetGUID(size_t dwIndex, GUID& value) const
+{
+    HRESULT hr = E_FAIL;
+
+    std::wstring field;
+    if (FAILED(hr = GetString(dwIndex, field)))
+        return hr;
+
+    return CLSIDFromString(field.c_str(), &value);
+}
+
+HRESULT MappedFileReader::OpenFile(
+    const WCHAR* szFileName,
+    bool bfirstRowIsColumnNames,
+    CHAR cSeparator,
+    CHAR cQuote)
+{
+    HRESULT hr = E_FAIL;
+
+    Close();
+
+    m_strFileName = szFileName;
+    m_cSeparator = cSeparator;
+    m_cQuote = cQuote;
+
+    m_hFile = CreateFileW(
+        szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to open CSV file '{}' [{}]", szFileName, SystemError(hr));
+        return hr;
+    }
+
+    LARGE_INTEGER liFileSize;
+    if (!GetFileSizeEx(m_hFile, &liFileSize))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to get size of CSV file '{}' [{}]", szFileName, SystemError(hr));
+        return hr;
+    }
+    m_ullFileSize = liFileSize.QuadPart;
+
+    if (m_ullFileSize == 0LL)
+        return S_OK;  // Empty files cannot be mapped, there is nothing to parse anyway
+
+    m_hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0L, 0L, NULL);
+    if (m_hMapping == NULL)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to create mapping of CSV file '{}' [{}]", szFileName, SystemError(hr));
+        return hr;
+    }
+
+    m_pMapped = static_cast<const CHAR*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0L, 0L, 0L));
+    if (m_pMapped == nullptr)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to map CSV file '{}' [{}]", szFileName, SystemError(hr));
+        return hr;
+    }
+
+    if (m_ullFileSize >= 2 && (BYTE)m_pMapped[0] == 0xFF && (BYTE)m_pMapped[1] == 0xFE)
+    {
+        Log::Error(L"UTF16 CSV file '{}' cannot be memory mapped, only UTF8 is supported", szFileName);
+        return HRESULT_FROM_WIN32(ERROR_UNSUPPORTED_TYPE);
+    }
+
+    if (m_ullFileSize >= 3 && (BYTE)m_pMapped[0] == 0xEF && (BYTE)m_pMapped[1] == 0xBB
+        && (BYTE)m_pMapped[2] == 0xBF)
+    {
+        Log::Debug(L"UTF8 BOM detected");
+        m_ullDataOffset = 3LL;
+    }
+
+    if (bfirstRowIsColumnNames)
+    {
+        if (FAILED(hr = ParseHeaders()))
+            return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT MappedFileReader::ParseHeaders()
+{
+    HRESULT hr = E_FAIL;
+
+    Chunk all;
+    all.ullOffset = m_ullDataOffset;
+    all.ullSize = m_ullFileSize - m_ullDataOffset;
+    all.ullFirstLine = m_ullDataFirstLine;
+
+    ULONGLONG ullHeadersEnd = m_ullFileSize;
+
+    hr = Parse(all, [this, &ullHeadersEnd](const Record& record) -> HRESULT {
+        m_Headers.resize(record.GetColumnCount());
+        for (size_t i = 0; i < record.GetColumnCount(); i++)
+        {
+            if (auto hr = record.GetString(i, m_Headers[i]); FAILED(hr))
+                return hr;
+        }
+
+        // Records start after the line feed following the last header
+        const auto lastField = record.GetRaw(record.GetColumnCount() - 1);
+        ullHeadersEnd = (lastField.data() + lastField.size()) - m_pMapped;
+        if (ullHeadersEnd < m_ullFileSize && m_pMapped[ullHeadersEnd] == '\r')
+            ullHeadersEnd++;
+        if (ullHeadersEnd < m_ullFileSize && m_pMapped[ullHeadersEnd] == '\n')
+            ullHeadersEnd++;
+        return S_FALSE;
+    });
+
+    if (FAILED(hr))
+    {
+        Log::Error(L"Failed to parse headers of CSV file '{}' [{}]", m_strFileName, SystemError(hr));
+        return hr;
+    }
+
+    m_ullDataOffset = ullHeadersEnd;
+    m_ullDataFirstLine++;
+    return S_OK;
+}
+
+std::vector<MappedFileReader::Chunk> MappedFileReader::Split(DWORD dwChunkCount) const
+{
+    std::vector<Chunk> chunks;
+
+    if (m_pMapped == nullptr || m_ullDataOffset >= m_ullFileSize)
+        return chunks;
+
+    if (dwChunkCount == 0L)
+        dwChunkCount = Concurrency::GetProcessorCount();
+
+    const auto ullChunkSize = std::max(kMinChunkSize, (m_ullFileSize - m_ullDataOffset) / dwChunkCount);
+
+    Chunk current;
+    current.ullOffset = m_ullDataOffset;
+    current.ullFirstLine = m_ullDataFirstLine;
+
+    auto ullLine = m_ullDataFirstLine;
+    auto ullTarget = current.ullOffset + ullChunkSize;
+
+    // Chunks must end on line feeds outside of quotes: the whole file is scanned to keep track of the quoted state
+    StructuralScanner scanner(m_cSeparator, m_cQuote);
+    for (ULONGLONG ullPos = m_ullDataOffset; ullPos < m_ullFileSize; ullPos += kBlockSize)
+    {
+        ULONG64 separators = 0LL, newLines = 0LL;
+        scanner.Scan(scanner.GetBlock(m_pMapped, ullPos, m_ullFileSize), separators, newLines);
+
+        if (ullTarget < ullPos + kBlockSize && ullTarget < m_ullFileSize)
+        {
+            auto candidates = newLines;
+            if (ullTarget > ullPos)
+                candidates &= ~0ULL << (ullTarget - ullPos);
+
+            if (candidates != 0LL)
+            {
+                const auto index = FirstSetBit(candidates);
+                const auto ullBoundary = ullPos + index + 1;
+
+                ullLine += std::bitset<64>(newLines & MaskUpTo(index)).count();
+                newLines &= ~MaskUpTo(index);
+
+                current.ullSize = ullBoundary - current.ullOffset;
+                chunks.push_back(current);
+
+                current.ullOffset = ullBoundary;
+                current.ullFirstLine = ullLine;
+                ullTarget = ullBoundary + ullChunkSize;
+            }
+        }
+
+        ullLine += std::bitset<64>(newLines).count();
+    }
+
+    if (current.ullOffset < m_ullFileSize)
+    {
+        current.ullSize = m_ullFileSize - current.ullOffset;
+        chunks.push_back(current);
+    }
+
+    return chunks;
+}
+
+HRESULT MappedFileReader::Parse(const Chunk& chunk, const RecordCallback& onRecord) const
+{
+    HRESULT hr = E_FAIL;
+
+    if (m_pMapped == nullptr)
+        return S_OK;
+
+    if (chunk.ullOffset + chunk.ullSize > m_ullFileSize)
+        return E_INVALIDARG;
+
+    const auto pData = m_pMapped + chunk.ullOffset;
+    const auto ullSize = chunk.ullSize;
+
+    Record record;
+    record.m_cQuote = m_cQuote;
+    record.ullLineNumber = chunk.ullFirstLine;
+
+    ULONGLONG ullFieldStart = 0LL;
+
+    const auto addField = [&](ULONGLONG ullFieldEnd) {
+        record.m_Fields.emplace_back(pData + ullFieldStart, static_cast<size_t>(ullFieldEnd - ullFieldStart));
+        ullFieldStart = ullFieldEnd + 1;
+    };
+
+    const auto endRecord = [&]() -> HRESULT {
+        auto& last = record.m_Fields.back();
+        if (!last.empty() && last.back() == '\r')
+            last.remove_suffix(1);
+
+        HRESULT hr = S_OK;
+
+        // Empty lines are skipped
+        if (record.m_Fields.size() > 1 || !last.empty())
+            hr = onRecord(record);
+
+        record.m_Fields.clear();
+        record.ullLineNumber++;
+        return hr;
+    };
+
+    StructuralScanner scanner(m_cSeparator, m_cQuote);
+    for (ULONGLONG ullPos = 0LL; ullPos < ullSize; ullPos += kBlockSize)
+    {
+        ULONG64 separators = 0LL, newLines = 0LL;
+        scanner.Scan(scanner.GetBlock(pData, ullPos, ullSize), separators, newLines);
+
+        auto structurals = separators | newLines;
+        while (structurals != 0LL)
+        {
+            const auto index = FirstSetBit(structurals);
+            const auto bit = 1ULL << index;
+            structurals &= structurals - 1;
+
+            addField(ullPos + index);
+
+            if (newLines & bit)
+            {
+                if (FAILED(hr = endRecord()) || hr == S_FALSE)
+                    return FAILED(hr) ? hr : S_OK;
+            }
+        }
+    }
+
+    // Last line without line feed
+    if (ullFieldStart < ullSize || !record.m_Fields.empty())
+    {
+        addField(ullSize);
+        if (FAILED(hr = endRecord()))
+            return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT MappedFileReader::Parse(const RecordCallback& onRecord) const
+{
+    Chunk all;
+    all.ullOffset = m_ullDataOffset;
+    all.ullSize = m_ullFileSize > m_ullDataOffset ? m_ullFileSize - m_ullDataOffset : 0LL;
+    all.ullFirstLine = m_ullDataFirstLine;
+
+    return Parse(all, onRecord);
+}
+
+HRESULT MappedFileReader::ParallelParse(const ChunkRecordCallback& onRecord, DWORD dwChunkCount) const
+{
+    const auto chunks = Split(dwChunkCount);
+
+    std::vector<HRESULT> results(chunks.size(), S_OK);
+
+    Concurrency::parallel_for(size_t(0), chunks.size(), [&](size_t i) {
+        const auto& chunk = chunks[i];
+        results[i] = Parse(chunk, [&onRecord, &chunk](const Record& record) { return onRecord(chunk, record); });
+    });
+
+    for (const auto hr : results)
+    {
+        if (FAILED(hr))
+        {
+            Log::Error(L"Failed to parse CSV file '{}' [{}]", m_strFileName, SystemError(hr));
+            return hr;
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT MappedFileReader::Close()
+{
+    if (m_pMapped != nullptr)
+    {
+        UnmapViewOfFile(m_pMapped);
+        m_pMapped = nullptr;
+    }
+    if (m_hMapping != NULL)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+
+    m_ullFileSize = 0LL;
+    m_ullDataOffset = 0LL;
+    m_ullDataFirstLine = 1LL;
+    m_Headers.clear();
+    return S_OK;
+}
+
+MappedFileReader::~MappedFileReader()
+{
+    Close();
+}
@@ -0,0 +1,120 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#pragma once
+
+#include <functional>
+#include <string_view>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+namespace TableOutput::CSV {
+
+// Reads an UTF-8 CSV file through a read only mapping of the file.
+// Separators, quotes and line feeds are located 64 bytes at a time using SSE2 bitmasks (quoted regions being the prefix
+// xor of the quotes mask). Fields are kept as views on the mapped bytes and only converted when requested.
+class ORCLIB_API MappedFileReader
+{
+public:
+    // Fields point to the mapped file: they remain valid until the reader is closed
+    class Record
+    {
+    public:
+        ULONGLONG ullLineNumber = 0LL;
+
+        size_t GetColumnCount() const { return m_Fields.size(); }
+
+        // Bytes of the field as stored in the file (including enclosing quotes)
+        std::string_view GetRaw(size_t dwIndex) const { return m_Fields[dwIndex]; }
+
+        HRESULT GetString(size_t dwIndex, std::wstring& value) const;
+        HRESULT GetInteger(size_t dwIndex, DWORD& value) const;
+        HRESULT GetLargeInteger(size_t dwIndex, LARGE_INTEGER& value) const;
+        HRESULT GetDateTime(
+            size_t dwIndex,
+            FILETIME& value,
+            const WCHAR* szDateFormat = L"yyyy-MM-dd hh:mm:ss.000") const;
+        HRESULT GetBoolean(size_t dwIndex, bool& value, LPCWSTR szBool = L"YN") const;
+        HRESULT GetGUID(size_t dwIndex, GUID& value) const;
+
+    private:
+        friend class MappedFileReader;
+
+        HRESULT GetUnquoted(size_t dwIndex, std::string_view& value, std::string& unescaped) const;
+
+        std::vector<std::string_view> m_Fields;
+        CHAR m_cQuote = '\"';
+    };
+
+    // Range of the mapped file starting and ending on a line boundary, which can be parsed independently
+    struct Chunk
+    {
+        ULONGLONG ullOffset = 0LL;
+        ULONGLONG ullSize = 0LL;
+        ULONGLONG ullFirstLine = 0LL;
+    };
+
+    // Returning S_FALSE stops the parsing, a failure is propagated to the caller
+    using RecordCallback = std::function<HRESULT(const Record& record)>;
+    using ChunkRecordCallback = std::function<HRESULT(const Chunk& chunk, const Record& record)>;
+
+    MappedFileReader() = default;
+    MappedFileReader(const MappedFileReader&) = delete;
+
+    HRESULT OpenFile(
+        const WCHAR* szFileName,
+        bool bfirstRowIsColumnNames = true,
+        CHAR cSeparator = ',',
+        CHAR cQuote = '\"');
+
+    HRESULT Close();
+
+    const std::wstring& GetFileName() const { return m_strFileName; };
+    const std::vector<std::wstring>& GetHeaders() const { return m_Headers; };
+    CHAR GetQuote() const { return m_cQuote; };
+
+    // Strip the enclosing quotes of a raw field, 'unescaped' is only used when the field contains escaped quotes
+    static std::string_view Unquote(std::string_view field, CHAR cQuote, std::string& unescaped);
+
+    // Split the records in about 'dwChunkCount' chunks (one per processor when 0) of at least kMinChunkSize bytes
+    static constexpr ULONGLONG kMinChunkSize = 4 * 1024 * 1024;
+    std::vector<Chunk> Split(DWORD dwChunkCount = 0L) const;
+
+    HRESULT Parse(const Chunk& chunk, const RecordCallback& onRecord) const;
+    HRESULT Parse(const RecordCallback& onRecord) const;
+
+    // Chunks are parsed concurrently: 'onRecord' is called from several threads, records of a chunk being in order
+    HRESULT ParallelParse(const ChunkRecordCallback& onRecord, DWORD dwChunkCount = 0L) const;
+
+    ~MappedFileReader();
+
+private:
+    HRESULT ParseHeaders();
+
+    std::wstring m_strFileName;
+    CHAR m_cSeparator = ',';
+    CHAR m_cQuote = '\"';
+
+    HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    HANDLE m_hMapping = NULL;
+    const CHAR* m_pMapped = nullptr;
+    ULONGLONG m_ullFileSize = 0LL;
+
+    // Records start after the BOM and the headers
+    ULONGLONG m_ullDataOffset = 0LL;
+    ULONGLONG m_ullDataFirstLine = 1LL;
+
+    std::vector<std::wstring> m_Headers;
+};
+
+}  // namespace TableOutput::CSV
+}  // namespace Orc
+
+#pragma managed(pop)
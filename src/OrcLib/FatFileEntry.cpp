@@ -10,6 +10,7 @@
 #include "FatFileEntry.h"
 #include "FSUtils.h"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace Orc;
@@ -53,9 +54,6 @@ const std::wstring FatFileEntry::GetFullName() const
     return fullName;
 }
 
-/*
- * we could be more smart here and merge contiguous segments
- */
 void FatFileEntry::FillSegmentDetailsMap(ULONGLONG rootDirectoryOffset, ULONG ulClusterSize)
 {
     if (m_ClusterChain.empty())
@@ -64,36 +62,22 @@ void FatFileEntry::FillSegmentDetailsMap(ULONGLONG rootDirectoryOffset, ULONG ul
     m_SegmentDetailsMap.clear();
     ULONG ulTotalSize = 0;
 
-    std::for_each(
-        std::begin(m_ClusterChain),
-        std::end(m_ClusterChain),
-        [this, &ulTotalSize, rootDirectoryOffset, ulClusterSize](const FatTableEntry& entry) {
-            ULONG clusterNumber = 0;
-
-            if (m_ulSize > ulTotalSize && (entry.IsUsed() && (clusterNumber = entry.GetValue()) >= 2))
-            {
-                SegmentDetails segmentDetails;
-                ULONGLONG startOffset =
-                    rootDirectoryOffset + ((ULONGLONG)(clusterNumber - 2) * (ULONGLONG)ulClusterSize);
-                ULONGLONG endOffset = 0;
-
-                segmentDetails.mStartOffset = startOffset;
-
-                if (m_ulSize > ulTotalSize + ulClusterSize)
-                {
-                    segmentDetails.mEndOffset = startOffset + ulClusterSize;
-                    segmentDetails.mSize = ulClusterSize;
-                }
-                else
-                {
-                    segmentDetails.mSize = m_ulSize - ulTotalSize;
-                    segmentDetails.mEndOffset = startOffset + (segmentDetails.mSize);
-                }
-
-                m_SegmentDetailsMap.insert(std::pair<ULONGLONG, SegmentDetails>(ulTotalSize, segmentDetails));
-                ulTotalSize += segmentDetails.mSize;
-            }
-        });
+    // one segment per run of contiguous clusters
+    for (const auto& run : m_ClusterChain)
+    {
+        if (m_ulSize <= ulTotalSize)
+            break;
+
+        SegmentDetails segmentDetails;
+        segmentDetails.mStartOffset =
+            rootDirectoryOffset + ((ULONGLONG)(run.FirstCluster - 2) * (ULONGLONG)ulClusterSize);
+        segmentDetails.mSize =
+            static_cast<DWORD>(std::min<ULONGLONG>((ULONGLONG)run.Count * ulClusterSize, m_ulSize - ulTotalSize));
+        segmentDetails.mEndOffset = segmentDetails.mStartOffset + segmentDetails.mSize;
+
+        m_SegmentDetailsMap.insert(std::pair<ULONGLONG, SegmentDetails>(ulTotalSize, segmentDetails));
+        ulTotalSize += segmentDetails.mSize;
+    }
 }
 
 std::wostream& Orc::operator<<(std::wostream& os, const FatFileEntry& fatFatFileEntry)
@@ -0,0 +1,89 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Yann SALAUN
+//
+#include "stdafx.h"
+
+#include "FatTable.h"
+
+#include <numeric>
+
+using namespace Orc;
+
+void FatTable::AddChunk(const std::shared_ptr<CBinaryBuffer>& chunk)
+{
+    if (chunk == nullptr)
+        return;
+
+    m_Table.insert(std::end(m_Table), chunk->GetData(), chunk->GetData() + chunk->GetCount());
+}
+
+HRESULT FatTable::GetEntry(ULONG entryNumber, FatTableEntry& entry) const
+{
+    const ULONGLONG index = (static_cast<ULONGLONG>(entryNumber) * GetEntrySizeInBits()) / 8;
+    const size_t cbEntry = IsFat32Table() ? sizeof(ULONG) : sizeof(USHORT);
+
+    if (index + cbEntry > m_Table.size())
+        return E_FAIL;
+
+    const BYTE* pEntry = m_Table.data() + index;
+
+    if (IsFat12Table())
+    {
+        const USHORT value = *reinterpret_cast<const USHORT*>(pEntry);
+        if (entryNumber % 2 == 0)
+            entry = FatTableEntry(value & 0x0FFF, GetEntrySizeInBits());
+        else
+            entry = FatTableEntry((value & 0xFFF0) >> 4, GetEntrySizeInBits());
+    }
+    else if (IsFat16Table())
+    {
+        entry = FatTableEntry(*reinterpret_cast<const USHORT*>(pEntry), GetEntrySizeInBits());
+    }
+    else
+    {
+        entry = FatTableEntry(*reinterpret_cast<const ULONG*>(pEntry), GetEntrySizeInBits());
+    }
+
+    return S_OK;
+}
+
+HRESULT FatTable::FillClusterChain(ULONG firstClusterNumber, ClusterChain& clusterChain) const
+{
+    clusterChain.clear();
+
+    const ULONG ulEntryCount = GetEntryCount();
+    ULONG ulClusterCount = 0;
+    FatTableEntry entry(firstClusterNumber, GetEntrySizeInBits());
+
+    // clusters 0 and 1 are reserved
+    while (entry.IsUsed() && entry.GetValue() >= 2)
+    {
+        const ULONG ulCluster = entry.GetValue();
+
+        if (!clusterChain.empty() && clusterChain.back().FirstCluster + clusterChain.back().Count == ulCluster)
+            clusterChain.back().Count++;
+        else
+            clusterChain.push_back({ulCluster, 1});
+
+        // a chain cannot be longer than the table: it loops
+        if (++ulClusterCount > ulEntryCount)
+            return HRESULT_FROM_WIN32(ERROR_FILE_CORRUPT);
+
+        if (FAILED(GetEntry(ulCluster, entry)))
+            return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+ULONGLONG FatTable::GetClusterCount(const ClusterChain& clusterChain)
+{
+    return std::accumulate(
+        std::cbegin(clusterChain), std::cend(clusterChain), 0ULL, [](ULONGLONG count, const ClusterRun& run) {
+            return count + run.Count;
+        });
+}
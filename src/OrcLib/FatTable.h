@@ -12,7 +12,8 @@
 #include "FatTableEntry.h"
 #include "BinaryBuffer.h"
 
-#include <algorithm>
+#include <memory>
+#include <vector>
 
 #pragma managed(push, off)
 
@@ -28,8 +29,14 @@ public:
         FAT32
     };
 
-    using ClusterChain = std::vector<FatTableEntry>;
-    using FatTableChunks = std::vector<std::shared_ptr<CBinaryBuffer>>;
+    // Contiguous clusters of a chain
+    struct ClusterRun
+    {
+        ULONG FirstCluster;
+        ULONG Count;
+    };
+
+    using ClusterChain = std::vector<ClusterRun>;
 
     FatTable(FatTableType type)
         : m_FatTableType(type)
@@ -52,84 +59,20 @@ public:
             return 32;
     }
 
-    void AddChunk(const std::shared_ptr<CBinaryBuffer>& chunk) { mFatTableChunks.push_back(chunk); }
-
-    const FatTableChunks& GetFatTableChunks() { return mFatTableChunks; }
-
-    HRESULT FillClusterChain(ULONG firstClusterNumber, ClusterChain& clusterChain) const
-    {
-        clusterChain.clear();
-        FatTableEntry entry(firstClusterNumber, GetEntrySizeInBits());
+    // The table is read in chunks, they are appended to a single buffer so entries are directly indexed
+    void AddChunk(const std::shared_ptr<CBinaryBuffer>& chunk);
 
-        do
-        {
-            clusterChain.push_back(entry);
+    ULONG GetEntryCount() const { return static_cast<ULONG>((m_Table.size() * 8) / GetEntrySizeInBits()); }
 
-            if (FAILED(GetEntry(entry.GetValue(), entry)))
-                return E_FAIL;
+    // Clusters of the chain starting at 'firstClusterNumber', contiguous clusters are merged in runs
+    HRESULT FillClusterChain(ULONG firstClusterNumber, ClusterChain& clusterChain) const;
 
-        } while (entry.IsUsed());
+    HRESULT GetEntry(ULONG entryNumber, FatTableEntry& entry) const;
 
-        return S_OK;
-    }
-
-    HRESULT GetEntry(ULONG entryNumber, FatTableEntry& entry) const
-    {
-        ULONGLONG ulCurrentOffset = 0;
-        ULONGLONG ulTargetOffset = (static_cast<ULONGLONG>(entryNumber) * GetEntrySizeInBits()) / 8;
-
-        auto chunkIter = std::find_if(
-            mFatTableChunks.begin(),
-            mFatTableChunks.end(),
-            [this, &ulCurrentOffset, ulTargetOffset, &entry](const std::shared_ptr<CBinaryBuffer>& chunk) -> bool {
-                ULONGLONG ulChunkEndOffset = ulCurrentOffset + chunk->GetCount();
-
-                if (ulTargetOffset >= ulCurrentOffset && ulTargetOffset < ulChunkEndOffset)
-                {
-                    return true;
-                }
-
-                ulCurrentOffset += chunk->GetCount();
-                return false;
-            });
-
-        if (chunkIter != mFatTableChunks.end())
-        {
-            ULONGLONG index = ulTargetOffset - ulCurrentOffset;
-            const std::shared_ptr<CBinaryBuffer>& buffer(*chunkIter);
-
-            if (index >= buffer->GetCount())
-                return E_FAIL;
-
-            if (IsFat12Table())
-            {
-                if (entryNumber % 2 == 0)
-                    entry = FatTableEntry(
-                        *(reinterpret_cast<unsigned short*>(buffer->GetData() + index)) & 0x0FFF, GetEntrySizeInBits());
-                else
-                    entry = FatTableEntry(
-                        (*(reinterpret_cast<unsigned short*>(buffer->GetData() + index)) & 0xFFF0) >> 4,
-                        GetEntrySizeInBits());
-            }
-            else if (IsFat16Table())
-            {
-                entry = FatTableEntry(
-                    *(reinterpret_cast<unsigned short*>(buffer->GetData() + index)), GetEntrySizeInBits());
-            }
-            else
-                entry =
-                    FatTableEntry(*(reinterpret_cast<unsigned long*>(buffer->GetData() + index)), GetEntrySizeInBits());
-
-            return S_OK;
-        }
-        else
-        {
-            return E_FAIL;
-        }
-    }
+    static ULONGLONG GetClusterCount(const ClusterChain& clusterChain);
 
 private:
-    FatTableChunks mFatTableChunks;
+    std::vector<BYTE> m_Table;
     FatTableType m_FatTableType;
 };
 
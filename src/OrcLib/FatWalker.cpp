@@ -15,6 +15,8 @@
 #include <sstream>
 #include <algorithm>
 
+#include <ppl.h>
+
 using namespace Orc;
 
 FatWalker::FatWalker()
@@ -43,6 +45,7 @@ HRESULT FatWalker::Init(const std::shared_ptr<Location>& loc, bool bResurrectRec
     const CBinaryBuffer& vbr(reader->GetBootSector());
     ULONG ulSectorSize = reader->GetBytesPerSector();
     ULONG ulClusterSize = reader->GetBytesPerCluster();
+    m_ulClusterSize = ulClusterSize;
     FSVBR::FSType fsType = reader->GetFSType();
 
     int nbReservedSectors = 0;
@@ -161,7 +164,7 @@ HRESULT FatWalker::Init(const std::shared_ptr<Location>& loc, bool bResurrectRec
         fatTable.FillClusterChain(rootDirectoryCluster, clusterChain);
 
         // read root directory - it starts at cluster 2. there is actually no cluster 0 and no cluster 1
-        if (S_OK != (hr = ReadClusterChain(clusterChain, m_RootDirectoryBuffer)))
+        if (FAILED(hr = ReadClusterChain(clusterChain, m_RootDirectoryBuffer)))
         {
             Log::Error(
                 L"Failed to read root directory from location {} [{}]", m_Location->GetLocation(), SystemError(hr));
@@ -175,62 +178,135 @@ HRESULT FatWalker::Init(const std::shared_ptr<Location>& loc, bool bResurrectRec
 
     // parse root directory
     FatFileEntryList subFolders;
-    ParseFolder(fatTable, m_RootDirectoryBuffer, m_RootFolder, subFolders);
+    std::vector<FatFileEntry> rootEntries;
+    ParseFolder(fatTable, m_RootDirectoryBuffer, m_RootFolder, rootEntries);
+    AddFolderEntries(rootEntries, subFolders);
 
+    // folders are parsed breadth first, one batch at a time: all the active folders found so far, then the deleted
+    // ones (their clusters may have been reused by active folders). Deleted folders are parsed one by one, so active
+    // folders found under one of them are still parsed before the next deleted folder
     while (!subFolders.empty())
     {
-        // we put the deleted folder entries at the end of the structure
-        // we need to parse active folders first
-        std::partition(subFolders.begin(), subFolders.end(), [](const FatFileEntry* subfolder) {
-            return subfolder != nullptr && !subfolder->IsDeleted();
-        });
+        FatFileEntryList batch;
+        for (auto it = std::begin(subFolders); it != std::end(subFolders);)
+        {
+            if (*it != nullptr && !(*it)->IsDeleted())
+                batch.splice(std::end(batch), subFolders, it++);
+            else
+                ++it;
+        }
 
-        // get current subfolder
-        const FatFileEntry* subfolder(subFolders.front());
-        subFolders.pop_front();
+        if (batch.empty())
+            batch.splice(std::end(batch), subFolders, std::begin(subFolders));
 
-        if (nullptr == subfolder || !subfolder->IsFolder())
-            continue;
+        ParseFolders(fatTable, batch, parsedClusterSet, subFolders);
+    }
 
-        // get the subfolder cluster chain and check if we have already parsed at least one its clusters
-        bool alreadyParsed = false;
-        const FatTable::ClusterChain& clusterChain(subfolder->GetClusterChain());
-        std::for_each(
-            std::begin(clusterChain),
-            std::end(clusterChain),
-            [&parsedClusterSet, &alreadyParsed](const FatTableEntry& entry) {
-                if (entry.IsUsed())
+    return S_OK;
+}
+
+void FatWalker::ParseFolders(
+    const FatTable& fatTable,
+    const FatFileEntryList& folders,
+    ParsedClusterSet& parsedClusterSet,
+    FatFileEntryList& subFolders)
+{
+    struct FolderToParse
+    {
+        const FatFileEntry* m_Folder;
+        CBinaryBuffer m_Buffer;
+        std::vector<FatFileEntry> m_Entries;
+        bool m_bRead = false;
+    };
+
+    auto it = std::cbegin(folders);
+    while (it != std::cend(folders))
+    {
+        // folders are read and parsed in groups of bounded size
+        std::vector<FolderToParse> group;
+        ULONGLONG ullGroupSize = 0;
+        for (; it != std::cend(folders) && ullGroupSize < kMaxFolderGroupSize; ++it)
+        {
+            const FatFileEntry* subfolder(*it);
+            if (nullptr == subfolder || !subfolder->IsFolder())
+                continue;
+
+            // check if we have already parsed at least one of the clusters of the subfolder
+            const FatTable::ClusterChain& clusterChain(subfolder->GetClusterChain());
+            bool alreadyParsed = false;
+            for (const auto& run : clusterChain)
+            {
+                for (ULONG i = 0; i < run.Count && !alreadyParsed; i++)
                 {
-                    if (parsedClusterSet.find(entry.GetValue()) != parsedClusterSet.end())
+                    if (parsedClusterSet.find(run.FirstCluster + i) != parsedClusterSet.end())
                         alreadyParsed = true;
                 }
-            });
+            }
 
-        if (alreadyParsed)
-            continue;
+            if (alreadyParsed || clusterChain.empty())
+                continue;
+
+            // update parsed cluster set
+            for (const auto& run : clusterChain)
+            {
+                for (ULONG i = 0; i < run.Count; i++)
+                    parsedClusterSet.insert(run.FirstCluster + i);
+            }
+
+            group.push_back({subfolder});
+            ullGroupSize += FatTable::GetClusterCount(clusterChain) * m_ulClusterSize;
+        }
+
+        // read subfolder entries in disk order
+        std::vector<FolderToParse*> byOffset;
+        byOffset.reserve(group.size());
+        for (auto& folder : group)
+            byOffset.push_back(&folder);
 
-        // read subfolder entries
-        CBinaryBuffer buffer;
-        if (S_OK != (hr = ReadClusterChain(clusterChain, buffer)))
+        std::sort(std::begin(byOffset), std::end(byOffset), [](const FolderToParse* left, const FolderToParse* right) {
+            return left->m_Folder->GetClusterChain().front().FirstCluster
+                < right->m_Folder->GetClusterChain().front().FirstCluster;
+        });
+
+        for (auto folder : byOffset)
         {
-            Log::Error(L"Failed to read subfolder {} [{}]", subfolder->m_Name, SystemError(hr));
-            continue;
+            HRESULT hr = ReadClusterChain(folder->m_Folder->GetClusterChain(), folder->m_Buffer);
+            if (FAILED(hr))
+            {
+                Log::Error(L"Failed to read subfolder {} [{}]", folder->m_Folder->m_Name, SystemError(hr));
+                continue;
+            }
+
+            folder->m_bRead = true;
         }
 
-        // update parsed cluster set
-        std::for_each(
-            std::begin(clusterChain), std::end(clusterChain), [&parsedClusterSet](const FatTableEntry& entry) {
-                if (entry.IsUsed())
-                {
-                    parsedClusterSet.insert(entry.GetValue());
-                }
-            });
+        // parse subfolders concurrently
+        concurrency::parallel_for(size_t(0), group.size(), [this, &fatTable, &group](size_t i) {
+            auto& folder = group[i];
+            if (folder.m_bRead)
+                ParseFolder(fatTable, folder.m_Buffer, folder.m_Folder, folder.m_Entries);
+        });
 
-        // parse subfolder
-        ParseFolder(fatTable, buffer, subfolder, subFolders);
+        // entries are added in the order of the folders
+        for (auto& folder : group)
+            AddFolderEntries(folder.m_Entries, subFolders);
     }
+}
 
-    return S_OK;
+void FatWalker::AddFolderEntries(std::vector<FatFileEntry>& entries, FatFileEntryList& subFolders)
+{
+    for (auto& fileEntry : entries)
+    {
+        PrintFileEntry(fileEntry);
+        FatFileSystem::iterator it = m_FatFS.insert(std::make_shared<FatFileEntry>(std::move(fileEntry))).first;
+
+        if ((*it)->IsFolder())
+        {
+            subFolders.push_back(it->get());
+        }
+    }
+
+    entries.clear();
 }
 
 HRESULT FatWalker::Process(const Callbacks& callbacks)
@@ -334,65 +410,68 @@ HRESULT FatWalker::ReadClusterChain(const FatTable::ClusterChain& clusterChain,
     ULONGLONG offset = 0;
 
     size_t buffer_size = 0;
-    if (!msl::utilities::SafeMultiply(clusterChain.size(), ulClusterSize, buffer_size))
+    if (!msl::utilities::SafeMultiply(FatTable::GetClusterCount(clusterChain), ulClusterSize, buffer_size))
         return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
 
     buffer.SetCount(buffer_size);
     buffer.ZeroMe();
 
-    hr = S_OK;
+    // one read per run of contiguous clusters, a run that cannot be read is left zeroed and the next ones are read
+    ULONGLONG ullRunsRead = 0;
+    HRESULT hrRun = S_OK;
+    for (const auto& run : clusterChain)
+    {
+        const ULONGLONG ullRunSize = (ULONGLONG)run.Count * (ULONGLONG)ulClusterSize;
+        const ULONGLONG seekOffset =
+            m_ullRootDirectoryOffset + ((ULONGLONG)(run.FirstCluster - 2) * (ULONGLONG)ulClusterSize);
+        const ULONGLONG runOffset = offset;
+        offset += ullRunSize;
 
-    std::for_each(
-        std::begin(clusterChain),
-        std::end(clusterChain),
-        [this, &hr, ulClusterSize, &offset, &reader, &buffer](const FatTableEntry& entry) {
-            ULONG clusterNumber = 0;
+        if (S_OK != (hr = reader->Seek(seekOffset)))
+        {
+            Log::Error(
+                L"Failed to seek to cluster number {} from location {} [{}]",
+                run.FirstCluster,
+                m_Location->GetLocation(),
+                SystemError(hr));
+            hrRun = hr;
+            continue;
+        }
 
-            if (entry.IsUsed() && (clusterNumber = entry.GetValue()) >= 2)
-            {
-                CBinaryBuffer localBuffer;
-                localBuffer.SetCount(ulClusterSize);
-                ULONGLONG ullBytesRead;
-                ULONGLONG seekOffset =
-                    m_ullRootDirectoryOffset + ((ULONGLONG)(clusterNumber - 2) * (ULONGLONG)ulClusterSize);
+        CBinaryBuffer localBuffer;
+        localBuffer.SetCount(static_cast<size_t>(ullRunSize));
+        ULONGLONG ullBytesRead = 0;
+        if (FAILED(hr = reader->Read(localBuffer, ullRunSize, ullBytesRead)) || ullBytesRead != ullRunSize)
+        {
+            if (SUCCEEDED(hr))
+                hr = HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
 
-                if (S_OK != (hr = reader->Seek(seekOffset)))
-                {
-                    Log::Error(
-                        L"Failed to seek to cluster number {} from location {} [{}]",
-                        clusterNumber,
-                        m_Location->GetLocation(),
-                        SystemError(hr));
-                }
-                else
-                {
-                    if (S_OK
-                        == (hr = reader->Read(localBuffer, ulClusterSize, ullBytesRead)
-                                && ulClusterSize == ullBytesRead))
-                    {
-                        memcpy(buffer.GetData() + offset, localBuffer.GetData(), ulClusterSize);
-                        offset += ulClusterSize;
-                    }
-                    else
-                    {
-                        Log::Error(
-                            L"Failed to read cluster number {} from location {} [{}]",
-                            clusterNumber,
-                            m_Location->GetLocation(),
-                            SystemError(hr));
-                    }
-                }
-            }
-        });
+            Log::Error(
+                L"Failed to read {} cluster(s) from cluster number {} from location {} [{}]",
+                run.Count,
+                run.FirstCluster,
+                m_Location->GetLocation(),
+                SystemError(hr));
+            hrRun = hr;
+            continue;
+        }
+
+        memcpy(buffer.GetData() + runOffset, localBuffer.GetData(), static_cast<size_t>(ullRunSize));
+        ullRunsRead++;
+    }
 
-    return hr;
+    // a chain read in part is still parsed
+    if (FAILED(hrRun))
+        return ullRunsRead > 0 ? S_FALSE : hrRun;
+
+    return S_OK;
 }
 
 HRESULT FatWalker::ParseFolder(
     const FatTable& fatTable,
     CBinaryBuffer& folder,
     const FatFileEntry* parentFolder,
-    FatFileEntryList& subFolders)
+    std::vector<FatFileEntry>& entries) const
 {
     HRESULT hr = E_FAIL;
     LongFilenamesByChecksums longFilenamesByChecksums;
@@ -481,14 +560,7 @@ HRESULT FatWalker::ParseFolder(
             }
 
             fileEntry.m_ParentFolder = parentFolder;
-
-            PrintFileEntry(fileEntry);
-            FatFileSystem::iterator it = m_FatFS.insert(std::make_shared<FatFileEntry>(fileEntry)).first;
-
-            if (fileEntry.IsFolder())
-            {
-                subFolders.push_back(it->get());
-            }
+            entries.push_back(std::move(fileEntry));
         }
     }
 
@@ -503,7 +575,7 @@ HRESULT FatWalker::ParseFileEntry(
     const LongFilenamesByChecksums& longFilenameByChecksums,
     bool bIsDeleted,
     bool& bLFN,
-    bool& bIsSpecial)
+    bool& bIsSpecial) const
 {
     bIsSpecial = false;
 
@@ -637,8 +709,7 @@ HRESULT FatWalker::ParseFileEntry(
             fileEntry.m_ulSize = fatFile83->FileSize;
 
             // now we can update the map of segments for this file entry
-            // I assume here that the reader object is not null
-            fileEntry.FillSegmentDetailsMap(m_ullRootDirectoryOffset, m_Location->GetReader()->GetBytesPerCluster());
+            fileEntry.FillSegmentDetailsMap(m_ullRootDirectoryOffset, m_ulClusterSize);
 
             // times
             DosDateTimeToFileTime(fatFile83->CreationDate, fatFile83->CreationTime, &fileEntry.m_CreationTime);
@@ -18,6 +18,7 @@
 #include <set>
 #include <map>
 #include <memory>
+#include <vector>
 
 #pragma managed(push, off)
 
@@ -67,11 +68,18 @@ private:
     HRESULT ReadRootDirectory(CBinaryBuffer& buffer, DWORD size);
     HRESULT ReadClusterChain(const FatTable::ClusterChain& clusterChain, CBinaryBuffer& buffer);
 
+    // Reads the folders (in disk order) and parses them concurrently, their subfolders are appended to 'subFolders'
+    void ParseFolders(
+        const FatTable& fatTable,
+        const FatFileEntryList& folders,
+        ParsedClusterSet& parsedClusterSet,
+        FatFileEntryList& subFolders);
     HRESULT ParseFolder(
         const FatTable& fatTable,
         CBinaryBuffer& folder,
         const FatFileEntry* parentFolder,
-        FatFileEntryList& subFolders);
+        std::vector<FatFileEntry>& entries) const;
+    void AddFolderEntries(std::vector<FatFileEntry>& entries, FatFileEntryList& subFolders);
     HRESULT ParseFileEntry(
         const FatTable& fatTable,
         GenFatFile* genFatFile,
@@ -80,7 +88,7 @@ private:
         const LongFilenamesByChecksums& longFileNameByChecksums,
         bool bIsDeleted,
         bool& bLFN,
-        bool& bIsSpecial);
+        bool& bIsSpecial) const;
 
     HRESULT BruteForceDeletedEntryFirstChar(
         const FatFile83&,
@@ -92,8 +100,11 @@ private:
     std::shared_ptr<Location> m_Location;
     CBinaryBuffer m_RootDirectoryBuffer;
     ULONGLONG m_ullRootDirectoryOffset;
+    ULONG m_ulClusterSize = 0;
     bool m_bResurrectRecords;
 
+    static constexpr ULONGLONG kMaxFolderGroupSize = 0x4000000;
+
     FatFileSystem m_FatFS;
     const FatFileEntry* m_RootFolder = nullptr;
 
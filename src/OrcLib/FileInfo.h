@@ -109,9 +109,9 @@ protected:
     virtual HRESULT WriteLastModificationDate(ITableOutput& output) = 0;
     virtual HRESULT WriteLastAccessDate(ITableOutput& output) = 0;
 
-    HRESULT WriteOwnerId(ITableOutput& output);
-    HRESULT WriteOwnerSid(ITableOutput& output);
-    HRESULT WriteOwner(ITableOutput& output);
+    virtual HRESULT WriteOwnerId(ITableOutput& output);
+    virtual HRESULT WriteOwnerSid(ITableOutput& output);
+    virtual HRESULT WriteOwner(ITableOutput& output);
 
     HRESULT WritePlatform(ITableOutput& output);
     HRESULT WriteTimeStamp(ITableOutput& output);
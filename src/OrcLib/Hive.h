@@ -11,6 +11,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #pragma managed(push, off)
 
@@ -29,11 +30,14 @@ public:
         std::swap(Stream, anOther.Stream);
         std::swap(FileName, anOther.FileName);
         std::swap(Match, anOther.Match);
+        std::swap(LogStreams, anOther.LogStreams);
     }
 
     std::shared_ptr<ByteStream> Stream;
     std::wstring FileName;
     std::shared_ptr<FileFind::Match> Match;
+    // Transaction logs ('.LOG1', '.LOG2') found next to the hive file
+    std::vector<std::shared_ptr<ByteStream>> LogStreams;
 };
 }  // namespace Orc
 
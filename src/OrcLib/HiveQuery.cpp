@@ -68,6 +68,22 @@ HRESULT HiveQuery::BuildStreamList()
         hive.Stream = fileStream;
         hive.FileName = fileName;
 
+        // Transaction logs are replayed over the hive when it is loaded
+        for (const auto& extension : {L".LOG1", L".LOG2"})
+        {
+            const auto logName = fileName + extension;
+            if (GetFileAttributesW(logName.c_str()) == INVALID_FILE_ATTRIBUTES)
+                continue;
+
+            auto logStream = std::make_shared<FileStream>();
+            if (FAILED(hr = logStream->ReadFrom(logName.c_str())))
+            {
+                Log::Warn(L"Failed to open transaction log: {} [{}]", logName, SystemError(hr));
+                continue;
+            }
+            hive.LogStreams.push_back(std::move(logStream));
+        }
+
         auto it = m_FileNameMap.find(fileName);
         if (it != m_FileNameMap.end())
         {
@@ -28,6 +28,10 @@ public:
 
     virtual ULONG GetMFTRecordCount() const PURE;
     virtual MFTUtils::SafeMFTSegmentNumber GetUSNRoot() const PURE;
+
+    // Size of $MFT's data and LSN of its own record: they identify the state of the MFT of a volume
+    virtual ULONGLONG GetMftSize() const PURE;
+    virtual ULONGLONG GetMftLsn() const PURE;
 };  // IMFT
 
 }  // namespace Orc
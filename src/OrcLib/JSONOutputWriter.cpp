@@ -18,10 +18,61 @@
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/stream.h"
 
+#include <emmintrin.h>
+
 using namespace std;
 using namespace std::string_view_literals;
 using namespace Orc;
 
+namespace {
+
+template <typename _Ch>
+using TargetEncoding = std::conditional_t<std::is_same_v<_Ch, char>, rapidjson::UTF8<>, rapidjson::UTF16<>>;
+
+// Beyond this count of distinct key pointers, names are most likely built on the fly and caching is pointless
+constexpr size_t kMaxCachedKeys = 4096;
+
+// Index of the first character that rapidjson would have to escape or transcode (control characters, quote,
+// backslash and non ASCII characters), or 'length' if the whole string can be copied as is
+size_t FindFirstCharToEscape(const WCHAR* str, size_t length)
+{
+    size_t i = 0;
+
+    const __m128i lowest = _mm_set1_epi16(0x20);
+    const __m128i range = _mm_set1_epi16(0x80 - 0x20 - 1);
+    const __m128i quote = _mm_set1_epi16(L'"');
+    const __m128i backslash = _mm_set1_epi16(L'\\');
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= length; i += 8)
+    {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+
+        // Once shifted down by 0x20, characters outside of [0x20, 0x80) are above 'range' (unsigned)
+        const __m128i inRange = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_sub_epi16(chars, lowest), range), zero);
+        const __m128i special = _mm_or_si128(_mm_cmpeq_epi16(chars, quote), _mm_cmpeq_epi16(chars, backslash));
+
+        const auto mask = _mm_movemask_epi8(_mm_andnot_si128(special, inRange));
+        if (mask != 0xFFFF)
+        {
+            unsigned long index = 0;
+            _BitScanForward(&index, ~mask & 0xFFFF);
+            return i + index / sizeof(WCHAR);
+        }
+    }
+
+    for (; i < length; ++i)
+    {
+        const auto c = str[i];
+        if (c < 0x20 || c >= 0x80 || c == L'"' || c == L'\\')
+            return i;
+    }
+
+    return length;
+}
+
+}  // namespace
+
 namespace Orc::StructuredOutput::JSON {
 
 template <class _RapidWriter, typename _Ch>
@@ -30,7 +81,12 @@ Writer<_RapidWriter, _Ch>::Writer(std::shared_ptr<ByteStream> stream, std::uniqu
     , m_Stream(std::move(stream))
     , rapidWriter(m_Stream)
 {
-    rapidWriter.StartObject();
+    if (auto options = dynamic_cast<Options*>(m_Options.get()); options != nullptr)
+        m_bJsonLines = options->bJsonLines;
+
+    // JSON Lines have no root object, each top level element is written as a document on its own line
+    if (!m_bJsonLines)
+        rapidWriter.StartObject();
 }
 
 std::shared_ptr<StructuredOutput::IWriter>
@@ -41,6 +97,9 @@ GetWriter(std::shared_ptr<ByteStream> stream, std::unique_ptr<Options>&& options
             rapidjson::PrettyWriter<Stream<rapidjson::UTF8<>::Ch>, rapidjson::UTF16<>, rapidjson::UTF8<>>,
             rapidjson::UTF8<>::Ch>>(stream, std::move(options));
 
+    if (options->bJsonLines)
+        options->bPrettyPrint = false;
+
     if (options->bPrettyPrint && options->Encoding == OutputSpec::Encoding::UTF8)
         return std::make_shared<Writer<
             rapidjson::PrettyWriter<Stream<rapidjson::UTF8<>::Ch>, rapidjson::UTF16<>, rapidjson::UTF8<>>,
@@ -63,19 +122,96 @@ GetWriter(std::shared_ptr<ByteStream> stream, std::unique_ptr<Options>&& options
         rapidjson::UTF8<>::Ch>>(stream, std::move(options));
 }
 
+template <class _RapidWriter, typename _Ch>
+void Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::BeginValue()
+{
+    // With JSON Lines, a complete top level document ends its line before the next one starts
+    if (m_bJsonLines && rapidWriter.IsComplete())
+    {
+        m_Stream.Put(_Ch('\n'));
+        rapidWriter.Reset(m_Stream);
+    }
+}
+
+template <class _RapidWriter, typename _Ch>
+void Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteKey(LPCWSTR szName)
+{
+    auto it = m_Keys.find(szName);
+    if (it == std::end(m_Keys) || it->second.first != szName)
+    {
+        if (m_Keys.size() >= kMaxCachedKeys)
+            m_Keys.clear();
+
+        rapidjson::GenericStringBuffer<TargetEncoding<_Ch>> escaped;
+        rapidjson::Writer<decltype(escaped), rapidjson::UTF16<>, TargetEncoding<_Ch>> keyWriter(escaped);
+        keyWriter.String(szName);
+
+        it = m_Keys
+                 .insert_or_assign(
+                     szName,
+                     std::make_pair(
+                         std::wstring(szName), std::basic_string<_Ch>(escaped.GetString(), escaped.GetLength())))
+                 .first;
+    }
+
+    // rapidjson writes the separator (and indentation), the quoted key is then copied as is
+    rapidWriter.RawValue(L"", 0, rapidjson::kStringType);
+    m_Stream.Write(it->second.second.data(), it->second.second.size());
+}
+
+template <class _RapidWriter, typename _Ch>
+void Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteString(const std::wstring_view str)
+{
+    BeginValue();
+
+    if (FindFirstCharToEscape(str.data(), str.size()) < str.size())
+    {
+        rapidWriter.String(str.data(), static_cast<rapidjson::SizeType>(str.size()));
+        return;
+    }
+
+    // Plain ASCII: no escaping needed, the characters are copied (and narrowed when writing UTF8)
+    rapidWriter.RawValue(L"", 0, rapidjson::kStringType);
+    m_Stream.Put(_Ch('"'));
+    m_Stream.Write(str.data(), str.size());
+    m_Stream.Put(_Ch('"'));
+}
+
+template <class _RapidWriter, typename _Ch>
+template <typename _Fn>
+HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamedValue(LPCWSTR szName, _Fn&& writeValue)
+{
+    // With JSON Lines, a named value outside of any element is wrapped in its own object
+    const bool bWrap = m_bJsonLines && m_dwDepth == 0;
+    if (bWrap)
+    {
+        BeginValue();
+        rapidWriter.StartObject();
+    }
+
+    WriteKey(szName);
+    auto hr = writeValue();
+
+    if (bWrap)
+        rapidWriter.EndObject();
+    return hr;
+}
+
 template <class _RapidWriter, typename _Ch>
 template <typename... Args>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamed_(LPCWSTR szName, Args&&... args)
 {
-    rapidWriter.Key(szName);
-    return Write(std::forward<Args>(args)...);
+    return WriteNamedValue(szName, [&]() { return Write(std::forward<Args>(args)...); });
 }
 
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Close()
 {
-    rapidWriter.EndObject();
-    m_Stream.Flush();
+    if (!m_bJsonLines)
+        rapidWriter.EndObject();
+    else if (rapidWriter.IsComplete())
+        m_Stream.Put(_Ch('\n'));
+
     m_Stream.Close();
     return S_OK;
 }
@@ -83,15 +219,22 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Close()
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::BeginElement(LPCWSTR szElement)
 {
-    if (szElement)
-        rapidWriter.Key(szElement);
+    // With JSON Lines, top level elements are anonymous documents
+    if (m_bJsonLines && m_dwDepth == 0)
+        BeginValue();
+    else if (szElement)
+        WriteKey(szElement);
+
     rapidWriter.StartObject();
+    m_dwDepth++;
     return S_OK;
 }
 
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::EndElement(LPCWSTR szElement)
 {
+    if (m_dwDepth > 0)
+        m_dwDepth--;
     rapidWriter.EndObject();
     return S_OK;
 }
@@ -99,15 +242,25 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::EndElement(LPCWS
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::BeginCollection(LPCWSTR szCollection)
 {
+    // With JSON Lines, top level collections are transparent: each of their items is written on its own line
+    if (m_bJsonLines && m_dwDepth == 0)
+        return S_OK;
+
     if (szCollection)
-        rapidWriter.Key(szCollection);
+        WriteKey(szCollection);
     rapidWriter.StartArray();
+    m_dwDepth++;
     return S_OK;
 }
 
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::EndCollection(LPCWSTR szCollection)
 {
+    if (m_bJsonLines && m_dwDepth == 0)
+        return S_OK;
+
+    if (m_dwDepth > 0)
+        m_dwDepth--;
     rapidWriter.EndArray();
     return S_OK;
 }
@@ -122,7 +275,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteFormated_(
 
     std::wstring_view result_string = buffer.empty() ? L""sv : std::wstring_view(buffer.get(), buffer.size());
 
-    rapidWriter.String(result_string.data(), result_string.size());
+    WriteString(result_string);
     return S_OK;
 }
 
@@ -139,7 +292,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteFormated_(
     if (FAILED(hr))
         return hr;
 
-    rapidWriter.String(wstr.data(), wstr.size());
+    WriteString(wstr);
     return S_OK;
 }
 
@@ -149,9 +302,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamedFormat
     const std::wstring_view& szFormat,
     fmt::wformat_args args)
 {
-    rapidWriter.Key(szName);
-    WriteFormated_(szFormat, args);
-    return S_OK;
+    return WriteNamedValue(szName, [&]() { return WriteFormated_(szFormat, args); });
 }
 
 template <class _RapidWriter, typename _Ch>
@@ -160,15 +311,13 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamedFormat
     const std::string_view& szFormat,
     fmt::format_args args)
 {
-    rapidWriter.Key(szName);
-    WriteFormated_(szFormat, args);
-    return S_OK;
+    return WriteNamedValue(szName, [&]() { return WriteFormated_(szFormat, args); });
 }
 
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(LPCWSTR szValue)
 {
-    rapidWriter.String(szValue);
+    WriteString(szValue);
     return S_OK;
 }
 
@@ -181,7 +330,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamed(LPCWS
 template <class _RapidWriter, typename _Ch>
 HRESULT Writer<_RapidWriter, _Ch>::Write(const std::wstring_view str)
 {
-    rapidWriter.String(str.data(), str.length());
+    WriteString(str);
     return S_OK;
 }
 
@@ -194,7 +343,7 @@ HRESULT Writer<_RapidWriter, _Ch>::WriteNamed(LPCWSTR szName, const std::wstring
 template <class _RapidWriter, typename _Ch>
 HRESULT Writer<_RapidWriter, _Ch>::Write(const std::wstring& str)
 {
-    rapidWriter.String(str.data(), str.length());
+    WriteString(str);
     return S_OK;
 }
 
@@ -210,7 +359,7 @@ HRESULT Writer<_RapidWriter, _Ch>::Write(const std::string_view str)
     if (auto [hr, wstr] = Orc::AnsiToWide(str); FAILED(hr))
         return hr;
     else
-        rapidWriter.String(wstr.data(), wstr.length());
+        WriteString(wstr);
     return S_OK;
 }
 
@@ -230,10 +379,13 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(uint32_t d
     {
         StructuredOutput::Writer::_Buffer buffer;
         WriteBuffer(buffer, dwValue, bInHex);
-        rapidWriter.String(buffer.get());
+        WriteString(buffer.get());
     }
     else
+    {
+        BeginValue();
         rapidWriter.Uint(dwValue);
+    }
 
     return S_OK;
 }
@@ -245,10 +397,13 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(int32_t ui
     {
         StructuredOutput::Writer::_Buffer buffer;
         WriteBuffer(buffer, uiValue, bInHex);
-        rapidWriter.String(buffer.get());
+        WriteString(buffer.get());
     }
     else
+    {
+        BeginValue();
         rapidWriter.Int(uiValue);
+    }
 
     return S_OK;
 }
@@ -273,10 +428,13 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(uint64_t u
     {
         StructuredOutput::Writer::_Buffer buffer;
         WriteBuffer(buffer, ullValue, bInHex);
-        rapidWriter.String(buffer.get());
+        WriteString(buffer.get());
     }
     else
+    {
+        BeginValue();
         rapidWriter.Uint64(ullValue);
+    }
 
     return S_OK;
 }
@@ -288,10 +446,13 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(int64_t ll
     {
         StructuredOutput::Writer::_Buffer buffer;
         WriteBuffer(buffer, llValue, bInHex);
-        rapidWriter.String(buffer.get());
+        WriteString(buffer.get());
     }
     else
+    {
+        BeginValue();
         rapidWriter.Int64(llValue);
+    }
 
     return S_OK;
 }
@@ -316,10 +477,13 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(LARGE_INTE
     {
         StructuredOutput::Writer::_Buffer buffer;
         WriteBuffer(buffer, ullValue, bInHex);
-        rapidWriter.String(buffer.get());
+        WriteString(buffer.get());
     }
     else
+    {
+        BeginValue();
         rapidWriter.Int64(ullValue.QuadPart);
+    }
     return S_OK;
 }
 
@@ -335,7 +499,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteAttributes(
 {
     StructuredOutput::Writer::_Buffer buffer;
     WriteAttributesBuffer(buffer, dwFileAttributes);
-    rapidWriter.String(buffer.get());
+    WriteString(buffer.get());
     return S_OK;
 }
 
@@ -343,8 +507,7 @@ template <class _RapidWriter, typename _Ch>
 HRESULT
 Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamedAttributes(LPCWSTR szName, DWORD dwFileAttributes)
 {
-    rapidWriter.Key(szName);
-    return WriteAttributes(dwFileAttributes);
+    return WriteNamedValue(szName, [&]() { return WriteAttributes(dwFileAttributes); });
 }
 
 template <class _RapidWriter, typename _Ch>
@@ -352,15 +515,14 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteFileTime(UL
 {
     StructuredOutput::Writer::_Buffer buffer;
     WriteFileTimeBuffer(buffer, fileTime);
-    rapidWriter.String(buffer.get());
+    WriteString(buffer.get());
     return S_OK;
 }
 
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamedFileTime(LPCWSTR szName, ULONGLONG fileTime)
 {
-    rapidWriter.Key(szName);
-    return WriteFileTime(fileTime);
+    return WriteNamedValue(szName, [&]() { return WriteFileTime(fileTime); });
 }
 
 template <class _RapidWriter, typename _Ch>
@@ -368,7 +530,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(FILETIME f
 {
     StructuredOutput::Writer::_Buffer buffer;
     WriteBuffer(buffer, fileTime);
-    rapidWriter.String(buffer.get());
+    WriteString(buffer.get());
     return S_OK;
 }
 
@@ -383,7 +545,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(const WCHA
 {
     StructuredOutput::Writer::_Buffer buffer;
     WriteBuffer(buffer, szArray, dwCharCount);
-    rapidWriter.String(buffer.get());
+    WriteString(buffer.get());
     return S_OK;
 }
 
@@ -401,13 +563,13 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(const BYTE
 {
     if (dwLen == 0)
     {
-        rapidWriter.String(L"");
+        WriteString(L""sv);
         return S_OK;
     }
 
     StructuredOutput::Writer::_Buffer buffer;
     WriteBuffer(buffer, pBytes, dwLen, b0xPrefix);
-    rapidWriter.String(buffer.get());
+    WriteString(buffer.get());
     return S_OK;
 }
 
@@ -439,6 +601,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::WriteNamed(
 template <class _RapidWriter, typename _Ch>
 HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(bool bBoolean)
 {
+    BeginValue();
     rapidWriter.Bool(bBoolean);
     return S_OK;
 }
@@ -468,7 +631,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(DWORD dwEn
     if (szValue == NULL)
         szValue = L"IllegalEnumValue";
 
-    rapidWriter.String(szValue);
+    WriteString(szValue);
     return S_OK;
 }
 
@@ -489,7 +652,7 @@ HRESULT Orc::StructuredOutput::JSON::Writer<_RapidWriter, _Ch>::Write(
 {
     StructuredOutput::Writer::_Buffer buffer;
     WriteBuffer(buffer, dwFlags, FlagValues, cSeparator);
-    rapidWriter.String(buffer.get());
+    WriteString(buffer.get());
     return S_OK;
 }
 
@@ -26,51 +26,73 @@ class Stream
 public:
     using Ch = _Ch;
 
+    // Characters are accumulated and written to the underlying stream by chunks of this count
+    static constexpr size_t kChunkSize = 32 * 1024;
+
     Stream(std::shared_ptr<ByteStream> a_stream)
         : m_stream(std::move(a_stream))
     {
+        m_buffer.reserve(kChunkSize);
     }
     Stream(Stream&& rhs) noexcept = default;
 
     //! Write a character.
     void Put(_Ch c)
     {
-        if (m_buffer.full())
+        if (m_buffer.size() == kChunkSize)
+            WriteBuffer();
+        m_buffer.push_back(c);
+    }
+
+    //! Write a run of characters (already escaped and encoded)
+    template <typename _SrcCh>
+    void Write(const _SrcCh* str, size_t count)
+    {
+        while (count > 0)
         {
-            Flush();
-            if (!m_buffer.empty())
-                throw Orc::Exception(Severity::Continue, E_OUTOFMEMORY, L"Failed to flush JSON's stream buffer"sv);
+            if (m_buffer.size() == kChunkSize)
+                WriteBuffer();
+
+            const auto toCopy = std::min(count, kChunkSize - m_buffer.size());
+            std::transform(
+                str, str + toCopy, std::back_inserter(m_buffer), [](_SrcCh c) { return static_cast<_Ch>(c); });
+            str += toCopy;
+            count -= toCopy;
         }
-        m_buffer.push_back(c);
     }
 
     //! Flush the buffer.
-    void Flush()
+    //! rapidjson flushes each time a document is complete: data is only written once a chunk is full or on Close
+    void Flush() {}
+
+    void Close()
+    {
+        WriteBuffer();
+        m_stream->Close();
+    }
+
+    ~Stream() { Close(); }
+
+private:
+    void WriteBuffer()
     {
         if (m_buffer.empty())
             return;
 
+        const auto cbBuffer = sizeof(_Ch) * m_buffer.size();
+
         auto BytesWritten = 0ULL;
-        if (auto hr = m_stream->Write(m_buffer.get(), m_buffer.elt_size() * m_buffer.size(), &BytesWritten); FAILED(hr))
+        if (auto hr = m_stream->Write(m_buffer.data(), cbBuffer, &BytesWritten); FAILED(hr))
             throw Orc::Exception(Severity::Continue, hr, L"Failed to write JSON's buffer to stream"sv);
-        if (BytesWritten != m_buffer.elt_size() * m_buffer.size())
+        if (BytesWritten != cbBuffer)
             throw Orc::Exception(
                 Severity::Continue, E_NOT_VALID_STATE, L"Failed to write JSON's entire buffer to stream"sv);
 
         m_buffer.clear();
     }
 
-    void Close()
-    {
-        Flush();
-        m_stream->Close();
-    }
-
-    ~Stream() { Close(); }
-
-private:
     std::shared_ptr<ByteStream> m_stream;
-    Buffer<_Ch, 1024> m_buffer;
+    std::vector<_Ch> m_buffer;
 };
 
 template <class _RapidWriter, typename _Ch>
@@ -80,6 +102,12 @@ private:
     Stream<_Ch> m_Stream;
     _RapidWriter rapidWriter;
 
+    // Keys are most often string literals: their escaped and encoded form is computed once per pointer
+    std::unordered_map<LPCWSTR, std::pair<std::wstring, std::basic_string<_Ch>>> m_Keys;
+
+    bool m_bJsonLines = false;
+    DWORD m_dwDepth = 0L;
+
 public:
     Writer(std::shared_ptr<ByteStream> stream, std::unique_ptr<Options>&& options);
     Writer(const Writer&) = delete;
@@ -173,6 +201,13 @@ private:
     template <typename... Args>
     HRESULT WriteNamed_(LPCWSTR szName, Args&&... args);
 
+    template <typename _Fn>
+    HRESULT WriteNamedValue(LPCWSTR szName, _Fn&& writeValue);
+
+    void BeginValue();
+    void WriteKey(LPCWSTR szName);
+    void WriteString(const std::wstring_view str);
+
 protected:
     virtual HRESULT WriteFormated_(const std::wstring_view& szFormat, fmt::wformat_args args) override final;
     virtual HRESULT WriteFormated_(const std::string_view& szFormat, fmt::format_args args) override final;
@@ -0,0 +1,286 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "Lz4Stream.h"
+
+#include <lz4frame.h>
+
+using namespace Orc;
+
+namespace {
+
+LZ4F_preferences_t GetPreferences(int iCompressionLevel)
+{
+    LZ4F_preferences_t preferences;
+    ZeroMemory(&preferences, sizeof(preferences));
+
+    preferences.frameInfo.blockSizeID = LZ4F_max64KB;
+    preferences.frameInfo.blockMode = LZ4F_blockLinked;
+    preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+    preferences.compressionLevel = iCompressionLevel;
+    return preferences;
+}
+
+}  // namespace
+
+HRESULT Lz4Stream::OpenToCompress(const std::shared_ptr<ByteStream>& pChainedStream, int iCompressionLevel)
+{
+    if (pChainedStream == nullptr)
+        return E_POINTER;
+
+    if (pChainedStream->CanWrite() != S_OK)
+    {
+        Log::Error("Lz4Stream: chained stream cannot be written to");
+        return HRESULT_FROM_WIN32(ERROR_INVALID_ACCESS);
+    }
+
+    auto ret = LZ4F_createCompressionContext(&m_pCCtx, LZ4F_VERSION);
+    if (LZ4F_isError(ret))
+    {
+        Log::Error("Lz4Stream: failed to create compression context ({})", LZ4F_getErrorName(ret));
+        return E_OUTOFMEMORY;
+    }
+
+    const auto preferences = GetPreferences(iCompressionLevel);
+    if (!m_Buffer.SetCount(LZ4F_compressBound(kChunkSize, &preferences)))
+        return E_OUTOFMEMORY;
+
+    m_pChainedStream = pChainedStream;
+
+    ret = LZ4F_compressBegin(m_pCCtx, m_Buffer.GetData(), m_Buffer.GetCount(), &preferences);
+    if (LZ4F_isError(ret))
+    {
+        Log::Error("Lz4Stream: failed to begin frame ({})", LZ4F_getErrorName(ret));
+        return E_FAIL;
+    }
+
+    if (auto hr = WriteOutput(ret); FAILED(hr))
+        return hr;
+
+    m_bCompressing = true;
+    m_ullProcessed = 0LL;
+    return S_OK;
+}
+
+HRESULT Lz4Stream::OpenToDecompress(const std::shared_ptr<ByteStream>& pChainedStream)
+{
+    if (pChainedStream == nullptr)
+        return E_POINTER;
+
+    if (pChainedStream->CanRead() != S_OK)
+    {
+        Log::Error("Lz4Stream: chained stream cannot be read from");
+        return HRESULT_FROM_WIN32(ERROR_INVALID_ACCESS);
+    }
+
+    auto ret = LZ4F_createDecompressionContext(&m_pDCtx, LZ4F_VERSION);
+    if (LZ4F_isError(ret))
+    {
+        Log::Error("Lz4Stream: failed to create decompression context ({})", LZ4F_getErrorName(ret));
+        return E_OUTOFMEMORY;
+    }
+
+    if (!m_Buffer.SetCount(kChunkSize))
+        return E_OUTOFMEMORY;
+
+    m_bCompressing = false;
+    m_pChainedStream = pChainedStream;
+    m_cbBufferPos = 0L;
+    m_cbBufferSize = 0L;
+    m_bEndOfInput = false;
+    m_ullProcessed = 0LL;
+    return S_OK;
+}
+
+HRESULT Lz4Stream::WriteOutput(size_t cbBytes)
+{
+    if (cbBytes == 0)
+        return S_OK;
+
+    ULONGLONG ullWritten = 0LL;
+    if (auto hr = m_pChainedStream->Write(m_Buffer.GetData(), cbBytes, &ullWritten); FAILED(hr))
+    {
+        Log::Error("Lz4Stream: failed to write compressed data ({} bytes, [{}])", cbBytes, SystemError(hr));
+        return hr;
+    }
+    return S_OK;
+}
+
+HRESULT Lz4Stream::Read(
+    __out_bcount_part(cbBytes, *pcbBytesRead) PVOID pReadBuffer,
+    __in ULONGLONG cbBytes,
+    __out_opt PULONGLONG pcbBytesRead)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pcbBytesRead == NULL)
+        return E_POINTER;
+    *pcbBytesRead = 0;
+
+    if (m_pChainedStream == nullptr)
+        return E_POINTER;
+    if (m_pDCtx == nullptr)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_ACCESS);
+    if (pReadBuffer == NULL)
+        return E_INVALIDARG;
+
+    const auto pOutput = static_cast<BYTE*>(pReadBuffer);
+    const auto cbOutput = static_cast<size_t>(cbBytes);
+    size_t cbOutputPos = 0L;
+
+    while (cbOutputPos < cbOutput)
+    {
+        if (m_cbBufferPos == m_cbBufferSize && !m_bEndOfInput)
+        {
+            ULONGLONG cbRead = 0LL;
+            if (FAILED(hr = m_pChainedStream->Read(m_Buffer.GetData(), m_Buffer.GetCount(), &cbRead)))
+            {
+                Log::Error("Lz4Stream: failed to read compressed data [{}]", SystemError(hr));
+                return hr;
+            }
+
+            m_cbBufferPos = 0L;
+            m_cbBufferSize = static_cast<size_t>(cbRead);
+            m_bEndOfInput = cbRead == 0;
+        }
+
+        size_t cbDecompressed = cbOutput - cbOutputPos;
+        size_t cbConsumed = m_cbBufferSize - m_cbBufferPos;
+
+        const auto ret = LZ4F_decompress(
+            m_pDCtx,
+            pOutput + cbOutputPos,
+            &cbDecompressed,
+            m_Buffer.GetData() + m_cbBufferPos,
+            &cbConsumed,
+            nullptr);
+        if (LZ4F_isError(ret))
+        {
+            Log::Error("Lz4Stream: failed to decompress data ({})", LZ4F_getErrorName(ret));
+            return E_FAIL;
+        }
+
+        m_cbBufferPos += cbConsumed;
+        cbOutputPos += cbDecompressed;
+
+        // Compressed data is exhausted and the decoder has nothing left to flush
+        if (m_bEndOfInput && cbDecompressed == 0)
+            break;
+    }
+
+    m_ullProcessed += cbOutputPos;
+    *pcbBytesRead = cbOutputPos;
+    return S_OK;
+}
+
+HRESULT Lz4Stream::Write(
+    __in_bcount(cbBytesToWrite) const PVOID pWriteBuffer,
+    __in ULONGLONG cbBytesToWrite,
+    __out_opt PULONGLONG pcbBytesWritten)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pcbBytesWritten)
+        *pcbBytesWritten = 0;
+
+    if (m_pChainedStream == nullptr)
+        return E_POINTER;
+    if (m_pCCtx == nullptr)
+        return E_NOTIMPL;
+    if (pWriteBuffer == NULL)
+        return E_POINTER;
+
+    const auto pInput = static_cast<const BYTE*>(pWriteBuffer);
+    ULONGLONG ullPos = 0LL;
+
+    while (ullPos < cbBytesToWrite)
+    {
+        const auto cbChunk = static_cast<size_t>(std::min<ULONGLONG>(kChunkSize, cbBytesToWrite - ullPos));
+
+        const auto ret =
+            LZ4F_compressUpdate(m_pCCtx, m_Buffer.GetData(), m_Buffer.GetCount(), pInput + ullPos, cbChunk, nullptr);
+        if (LZ4F_isError(ret))
+        {
+            Log::Error("Lz4Stream: failed to compress data ({})", LZ4F_getErrorName(ret));
+            return E_FAIL;
+        }
+
+        if (FAILED(hr = WriteOutput(ret)))
+            return hr;
+
+        ullPos += cbChunk;
+    }
+
+    m_ullProcessed += cbBytesToWrite;
+
+    if (pcbBytesWritten)
+        *pcbBytesWritten = cbBytesToWrite;
+
+    return S_OK;
+}
+
+HRESULT Lz4Stream::SetFilePointer(
+    __in LONGLONG DistanceToMove,
+    __in DWORD dwMoveMethod,
+    __out_opt PULONG64 pCurrPointer)
+{
+    // Only querying the current (uncompressed) position is supported
+    if (DistanceToMove != 0LL || dwMoveMethod != FILE_CURRENT)
+        return E_NOTIMPL;
+
+    if (pCurrPointer)
+        *pCurrPointer = m_ullProcessed;
+    return S_OK;
+}
+
+HRESULT Lz4Stream::Close()
+{
+    HRESULT hr = S_OK;
+
+    if (m_pCCtx != nullptr)
+    {
+        if (m_pChainedStream != nullptr)
+        {
+            const auto ret = LZ4F_compressEnd(m_pCCtx, m_Buffer.GetData(), m_Buffer.GetCount(), nullptr);
+            if (LZ4F_isError(ret))
+            {
+                Log::Error("Lz4Stream: failed to end frame ({})", LZ4F_getErrorName(ret));
+                hr = E_FAIL;
+            }
+            else
+            {
+                hr = WriteOutput(ret);
+            }
+        }
+        LZ4F_freeCompressionContext(m_pCCtx);
+        m_pCCtx = nullptr;
+    }
+
+    if (m_pDCtx != nullptr)
+    {
+        LZ4F_freeDecompressionContext(m_pDCtx);
+        m_pDCtx = nullptr;
+    }
+
+    if (m_pChainedStream != nullptr)
+    {
+        if (auto hrClose = m_pChainedStream->Close(); SUCCEEDED(hr))
+            hr = hrClose;
+    }
+
+    return hr;
+}
+
+Lz4Stream::~Lz4Stream()
+{
+    if (m_pCCtx != nullptr)
+        LZ4F_freeCompressionContext(m_pCCtx);
+    if (m_pDCtx != nullptr)
+        LZ4F_freeDecompressionContext(m_pDCtx);
+}
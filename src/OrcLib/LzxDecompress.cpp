@@ -0,0 +1,489 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#include "stdafx.h"
+
+#include "LzxDecompress.h"
+
+#include <array>
+
+using namespace Orc;
+
+namespace {
+
+constexpr unsigned LZX_NUM_CHARS = 256;
+constexpr unsigned LZX_NUM_PRIMARY_LENS = 7;
+constexpr unsigned LZX_MIN_MATCH_LEN = 2;
+constexpr unsigned LZX_NUM_RECENT_OFFSETS = 3;
+constexpr unsigned LZX_OFFSET_ADJUSTMENT = LZX_NUM_RECENT_OFFSETS - 1;
+
+// A 32KB window has 30 offset slots, each with 8 length headers
+constexpr unsigned LZX_NUM_OFFSET_SLOTS = 30;
+constexpr unsigned LZX_MAINCODE_NUM_SYMBOLS = LZX_NUM_CHARS + LZX_NUM_OFFSET_SLOTS * 8;
+constexpr unsigned LZX_LENCODE_NUM_SYMBOLS = 249;
+constexpr unsigned LZX_ALIGNEDCODE_NUM_SYMBOLS = 8;
+constexpr unsigned LZX_PRECODE_NUM_SYMBOLS = 20;
+
+constexpr unsigned LZX_NUM_ALIGNED_OFFSET_BITS = 3;
+constexpr unsigned LZX_ALIGNEDCODE_ELEMENT_SIZE = 3;
+constexpr unsigned LZX_PRECODE_ELEMENT_SIZE = 4;
+constexpr unsigned LZX_MAX_CODEWORD_LEN = 16;
+
+constexpr unsigned LZX_BLOCKTYPE_VERBATIM = 1;
+constexpr unsigned LZX_BLOCKTYPE_ALIGNED = 2;
+constexpr unsigned LZX_BLOCKTYPE_UNCOMPRESSED = 3;
+constexpr size_t LZX_DEFAULT_BLOCK_SIZE = 0x8000;
+
+// The 'file size' of the x86 call translation, fixed for WIM and WOF
+constexpr int32_t LZX_E8_FILE_SIZE = 12000000;
+
+// The bitstream is a sequence of little endian 16 bits words, read from their most significant bit
+class BitReader
+{
+public:
+    BitReader(const uint8_t* begin, const uint8_t* end)
+        : m_next(begin)
+        , m_end(end)
+    {
+    }
+
+    // Up to 16 bits, past the end of the input the stream is padded with zeroes
+    void Ensure(unsigned bits)
+    {
+        if (m_bitsLeft >= bits)
+            return;
+
+        uint32_t word = 0;
+        if (m_end - m_next >= 2)
+        {
+            word = m_next[0] | (m_next[1] << 8);
+            m_next += 2;
+        }
+        else
+        {
+            m_next = m_end;
+        }
+
+        m_buffer |= word << (16 - m_bitsLeft);
+        m_bitsLeft += 16;
+    }
+
+    uint32_t Peek(unsigned bits) const { return m_buffer >> (32 - bits); }
+
+    void Skip(unsigned bits)
+    {
+        m_buffer <<= bits;
+        m_bitsLeft -= bits;
+    }
+
+    uint32_t Read(unsigned bits)
+    {
+        if (bits == 0)
+            return 0;
+
+        Ensure(bits);
+        const uint32_t value = Peek(bits);
+        Skip(bits);
+        return value;
+    }
+
+    // Uncompressed blocks start on the next word: when already aligned, a whole word is skipped
+    void Align()
+    {
+        Ensure(1);
+        m_buffer = 0;
+        m_bitsLeft = 0;
+    }
+
+    // Raw bytes of uncompressed blocks, at the position of an aligned stream
+    const uint8_t* Next() const { return m_next; }
+    const uint8_t* End() const { return m_end; }
+
+    void Reset(const uint8_t* next)
+    {
+        m_next = next;
+        m_buffer = 0;
+        m_bitsLeft = 0;
+    }
+
+private:
+    const uint8_t* m_next;
+    const uint8_t* const m_end;
+    uint32_t m_buffer = 0;
+    unsigned m_bitsLeft = 0;
+};
+
+// Canonical Huffman code: codewords up to 'kTableBits' are decoded with a lookup, longer ones symbol by symbol
+template <unsigned NumSymbols>
+class HuffmanCode
+{
+public:
+    static constexpr unsigned kInvalidSymbol = NumSymbols;
+
+    // Incomplete codes are accepted, decoding one of their missing codewords fails
+    bool Build(const uint8_t* lens)
+    {
+        m_counts.fill(0);
+        for (unsigned i = 0; i < NumSymbols; i++)
+        {
+            if (lens[i] > LZX_MAX_CODEWORD_LEN)
+                return false;
+            m_counts[lens[i]]++;
+        }
+        m_counts[0] = 0;
+
+        int32_t left = 1;
+        for (unsigned len = 1; len <= LZX_MAX_CODEWORD_LEN; len++)
+        {
+            left <<= 1;
+            left -= m_counts[len];
+            if (left < 0)
+                return false;
+        }
+
+        std::array<uint16_t, LZX_MAX_CODEWORD_LEN + 1> offsets = {};
+        for (unsigned len = 1; len < LZX_MAX_CODEWORD_LEN; len++)
+            offsets[len + 1] = offsets[len] + m_counts[len];
+
+        for (unsigned i = 0; i < NumSymbols; i++)
+        {
+            if (lens[i] != 0)
+                m_symbols[offsets[lens[i]]++] = static_cast<uint16_t>(i);
+        }
+
+        m_table.fill(0);
+        uint32_t code = 0;
+        unsigned index = 0;
+        for (unsigned len = 1; len <= kTableBits; len++)
+        {
+            for (unsigned i = 0; i < m_counts[len]; i++)
+            {
+                const auto entry = static_cast<uint16_t>((m_symbols[index++] << 5) | len);
+                const auto first = std::begin(m_table) + (code << (kTableBits - len));
+                std::fill(first, first + (size_t(1) << (kTableBits - len)), entry);
+                code++;
+            }
+            code <<= 1;
+        }
+
+        return true;
+    }
+
+    unsigned Decode(BitReader& reader) const
+    {
+        reader.Ensure(LZX_MAX_CODEWORD_LEN);
+
+        const auto entry = m_table[reader.Peek(kTableBits)];
+        if (entry != 0)
+        {
+            reader.Skip(entry & 0x1F);
+            return entry >> 5;
+        }
+
+        const uint32_t bits = reader.Peek(LZX_MAX_CODEWORD_LEN);
+        uint32_t code = 0;
+        uint32_t first = 0;
+        unsigned index = 0;
+        for (unsigned len = 1; len <= LZX_MAX_CODEWORD_LEN; len++)
+        {
+            code |= (bits >> (LZX_MAX_CODEWORD_LEN - len)) & 1;
+            if (code - first < m_counts[len])
+            {
+                reader.Skip(len);
+                return m_symbols[index + code - first];
+            }
+
+            index += m_counts[len];
+            first = (first + m_counts[len]) << 1;
+            code <<= 1;
+        }
+
+        return kInvalidSymbol;
+    }
+
+private:
+    static constexpr unsigned kTableBits = 10;
+
+    std::array<uint16_t, LZX_MAX_CODEWORD_LEN + 1> m_counts;
+    std::array<uint16_t, NumSymbols> m_symbols;
+    // (symbol << 5) | codeword length, 0 for codewords longer than kTableBits
+    std::array<uint16_t, size_t(1) << kTableBits> m_table;
+};
+
+// Code lengths are stored as deltas from the previous block's, with a pre-code
+bool ReadCodeLens(BitReader& reader, uint8_t* lens, unsigned count)
+{
+    uint8_t precodeLens[LZX_PRECODE_NUM_SYMBOLS];
+    for (auto& len : precodeLens)
+        len = static_cast<uint8_t>(reader.Read(LZX_PRECODE_ELEMENT_SIZE));
+
+    HuffmanCode<LZX_PRECODE_NUM_SYMBOLS> precode;
+    if (!precode.Build(precodeLens))
+        return false;
+
+    unsigned i = 0;
+    while (i < count)
+    {
+        auto presym = precode.Decode(reader);
+        if (presym < 17)
+        {
+            lens[i] = static_cast<uint8_t>((lens[i] + 17 - presym) % 17);
+            i++;
+            continue;
+        }
+
+        unsigned run = 0;
+        uint8_t len = 0;
+        if (presym == 17)
+        {
+            run = 4 + reader.Read(4);
+        }
+        else if (presym == 18)
+        {
+            run = 20 + reader.Read(5);
+        }
+        else if (presym == 19)
+        {
+            run = 4 + reader.Read(1);
+            presym = precode.Decode(reader);
+            if (presym >= 17)
+                return false;
+            len = static_cast<uint8_t>((lens[i] + 17 - presym) % 17);
+        }
+        else
+        {
+            return false;
+        }
+
+        run = std::min(run, count - i);
+        memset(lens + i, len, run);
+        i += run;
+    }
+
+    return true;
+}
+
+unsigned GetExtraOffsetBits(unsigned slot)
+{
+    return slot < 4 ? 0 : (slot >> 1) - 1;
+}
+
+uint32_t GetOffsetSlotBase(unsigned slot)
+{
+    return slot < 4 ? slot : (2 | (slot & 1)) << GetExtraOffsetBits(slot);
+}
+
+// Calls were translated from relative to absolute targets to compress better
+void UndoE8Translation(uint8_t* data, size_t size)
+{
+    if (size <= 10)
+        return;
+
+    for (size_t i = 0; i < size - 10;)
+    {
+        if (data[i] != 0xE8)
+        {
+            i++;
+            continue;
+        }
+
+        const auto pos = static_cast<int32_t>(i);
+        int32_t target = 0;
+        memcpy(&target, data + i + 1, sizeof(target));
+        if (target >= 0 && target < LZX_E8_FILE_SIZE)
+        {
+            target -= pos;
+            memcpy(data + i + 1, &target, sizeof(target));
+        }
+        else if (target < 0 && target >= -pos)
+        {
+            target += LZX_E8_FILE_SIZE;
+            memcpy(data + i + 1, &target, sizeof(target));
+        }
+        i += 5;
+    }
+}
+
+struct LzxCodes
+{
+    uint8_t mainLens[LZX_MAINCODE_NUM_SYMBOLS] = {};
+    uint8_t lenLens[LZX_LENCODE_NUM_SYMBOLS] = {};
+    uint8_t alignedLens[LZX_ALIGNEDCODE_NUM_SYMBOLS] = {};
+
+    HuffmanCode<LZX_MAINCODE_NUM_SYMBOLS> mainCode;
+    HuffmanCode<LZX_LENCODE_NUM_SYMBOLS> lenCode;
+    HuffmanCode<LZX_ALIGNEDCODE_NUM_SYMBOLS> alignedCode;
+};
+
+HRESULT DecompressBlock(
+    BitReader& reader,
+    const LzxCodes& codes,
+    bool bAligned,
+    uint32_t* recentOffsets,
+    uint8_t* const dest,
+    uint8_t*& out,
+    uint8_t* const blockEnd)
+{
+    while (out < blockEnd)
+    {
+        auto mainsym = codes.mainCode.Decode(reader);
+        if (mainsym >= LZX_MAINCODE_NUM_SYMBOLS)
+            return E_FAIL;
+
+        if (mainsym < LZX_NUM_CHARS)
+        {
+            *out++ = static_cast<uint8_t>(mainsym);
+            continue;
+        }
+
+        mainsym -= LZX_NUM_CHARS;
+        size_t length = mainsym & 7;
+        const unsigned slot = mainsym >> 3;
+
+        if (length == LZX_NUM_PRIMARY_LENS)
+        {
+            const auto lensym = codes.lenCode.Decode(reader);
+            if (lensym >= LZX_LENCODE_NUM_SYMBOLS)
+                return E_FAIL;
+            length += lensym;
+        }
+        length += LZX_MIN_MATCH_LEN;
+
+        uint32_t offset = 0;
+        if (slot < LZX_NUM_RECENT_OFFSETS)
+        {
+            offset = recentOffsets[slot];
+            recentOffsets[slot] = recentOffsets[0];
+            recentOffsets[0] = offset;
+        }
+        else
+        {
+            const auto extraBits = GetExtraOffsetBits(slot);
+            offset = GetOffsetSlotBase(slot);
+            if (bAligned && extraBits >= LZX_NUM_ALIGNED_OFFSET_BITS)
+            {
+                offset += reader.Read(extraBits - LZX_NUM_ALIGNED_OFFSET_BITS) << LZX_NUM_ALIGNED_OFFSET_BITS;
+
+                const auto alignedsym = codes.alignedCode.Decode(reader);
+                if (alignedsym >= LZX_ALIGNEDCODE_NUM_SYMBOLS)
+                    return E_FAIL;
+                offset += alignedsym;
+            }
+            else
+            {
+                offset += reader.Read(extraBits);
+            }
+            offset -= LZX_OFFSET_ADJUSTMENT;
+
+            recentOffsets[2] = recentOffsets[1];
+            recentOffsets[1] = recentOffsets[0];
+            recentOffsets[0] = offset;
+        }
+
+        if (offset == 0 || offset > static_cast<size_t>(out - dest) || length > static_cast<size_t>(blockEnd - out))
+            return E_FAIL;
+
+        const uint8_t* back = out - offset;
+        if (length <= offset)
+        {
+            memcpy(out, back, length);
+            out += length;
+        }
+        else
+        {
+            // Overlapping sequence: repeats the last 'offset' bytes
+            for (size_t i = 0; i < length; i++)
+                out[i] = back[i];
+            out += length;
+        }
+    }
+
+    return S_OK;
+}
+
+}  // namespace
+
+HRESULT Orc::lzx_decompress_chunk(uint8_t* dest, const size_t dest_size, const uint8_t* src, const size_t src_size)
+{
+    if (dest_size > LZX_WOF_CHUNK_SIZE)
+        return E_INVALIDARG;
+
+    LzxCodes codes;
+    uint32_t recentOffsets[LZX_NUM_RECENT_OFFSETS] = {1, 1, 1};
+
+    BitReader reader(src, src + src_size);
+    uint8_t* out = dest;
+    uint8_t* const out_end = dest + dest_size;
+
+    while (out < out_end)
+    {
+        const auto blockType = reader.Read(3);
+        const size_t blockSize = reader.Read(1) ? LZX_DEFAULT_BLOCK_SIZE : reader.Read(16);
+        if (blockSize == 0 || blockSize > static_cast<size_t>(out_end - out))
+            return E_FAIL;
+
+        switch (blockType)
+        {
+            case LZX_BLOCKTYPE_ALIGNED:
+                for (auto& len : codes.alignedLens)
+                    len = static_cast<uint8_t>(reader.Read(LZX_ALIGNEDCODE_ELEMENT_SIZE));
+                if (!codes.alignedCode.Build(codes.alignedLens))
+                    return E_FAIL;
+                [[fallthrough]];
+
+            case LZX_BLOCKTYPE_VERBATIM:
+                if (!ReadCodeLens(reader, codes.mainLens, LZX_NUM_CHARS)
+                    || !ReadCodeLens(
+                        reader, codes.mainLens + LZX_NUM_CHARS, LZX_MAINCODE_NUM_SYMBOLS - LZX_NUM_CHARS)
+                    || !ReadCodeLens(reader, codes.lenLens, LZX_LENCODE_NUM_SYMBOLS))
+                    return E_FAIL;
+
+                if (!codes.mainCode.Build(codes.mainLens) || !codes.lenCode.Build(codes.lenLens))
+                    return E_FAIL;
+
+                if (auto hr = DecompressBlock(
+                        reader,
+                        codes,
+                        blockType == LZX_BLOCKTYPE_ALIGNED,
+                        recentOffsets,
+                        dest,
+                        out,
+                        out + blockSize);
+                    FAILED(hr))
+                    return hr;
+                break;
+
+            case LZX_BLOCKTYPE_UNCOMPRESSED: {
+                reader.Align();
+
+                const uint8_t* in = reader.Next();
+                if (static_cast<size_t>(reader.End() - in) < sizeof(recentOffsets) + blockSize)
+                    return E_FAIL;
+
+                memcpy(recentOffsets, in, sizeof(recentOffsets));
+                in += sizeof(recentOffsets);
+
+                memcpy(out, in, blockSize);
+                out += blockSize;
+                in += blockSize;
+
+                // the bitstream resumes on a word boundary
+                if ((blockSize & 1) && in < reader.End())
+                    in++;
+                reader.Reset(in);
+                break;
+            }
+
+            default:
+                return E_FAIL;
+        }
+    }
+
+    UndoE8Translation(dest, dest_size);
+    return S_OK;
+}
@@ -0,0 +1,27 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Largest chunk (and window) of the LZX variant used by WIM files and the Windows Overlay Filter
+constexpr size_t LZX_WOF_CHUNK_SIZE = 0x8000;
+
+// Decompresses the LZX chunk 'src' into 'dest' ('dest_size' is the exact uncompressed size, at most
+// LZX_WOF_CHUNK_SIZE). Chunks are independent: the window, the codes and the recent offsets start from scratch.
+// Neither allocates nor logs: chunks can be decompressed concurrently.
+HRESULT lzx_decompress_chunk(uint8_t* dest, const size_t dest_size, const uint8_t* src, const size_t src_size);
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -28,6 +28,25 @@ HRESULT MFTOffline::Initialize()
     m_pFetchReader = std::dynamic_pointer_cast<OfflineMFTReader>(m_pVolReader->ReOpen(
         FILE_READ_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE | FILE_SHARE_WRITE, FILE_RANDOM_ACCESS));
 
+    LARGE_INTEGER liSize = {0};
+    if (GetFileSizeEx(m_pVolReader->GetHandle(), &liSize))
+        m_ullMftSize = liSize.QuadPart;
+
+    // The LSN of the $MFT record, the first one of the file
+    if (m_pFetchReader != nullptr)
+    {
+        FILE_RECORD_SEGMENT_HEADER header = {0};
+        DWORD dwBytesRead = 0L;
+        LARGE_INTEGER liStart = {0};
+
+        if (SetFilePointerEx(m_pFetchReader->GetHandle(), liStart, NULL, FILE_BEGIN)
+            && ReadFile(m_pFetchReader->GetHandle(), &header, sizeof(header), &dwBytesRead, NULL)
+            && dwBytesRead == sizeof(header))
+        {
+            m_MftLsn = header.Reserved1;
+        }
+    }
+
     return S_OK;
 }
 
@@ -51,60 +70,72 @@ HRESULT MFTOffline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
         return hr;
     }
 
+    const ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
+
     CBinaryBuffer buffer;
-    if (!buffer.SetCount(m_pVolReader->GetBytesPerFRS()))
+    if (!buffer.SetCount(ulBytesPerFRS * DEFAULT_FRS_PER_READ))
         return E_OUTOFMEMORY;
 
-    ZeroMemory(buffer.GetData(), m_pVolReader->GetBytesPerFRS());
+    ZeroMemory(buffer.GetData(), buffer.GetCount());
+
+    std::vector<bool> fixedUp;
+    fixedUp.reserve(DEFAULT_FRS_PER_READ);
 
     ULONGLONG ullCurrentIndex = 0;
     ULONGLONG ullCurrentMftIndex = 0;
-    ULONGLONG ullLastIndex = (End.QuadPart - Start.QuadPart) / m_pVolReader->GetBytesPerFRS();
+    ULONGLONG ullLastIndex = (End.QuadPart - Start.QuadPart) / ulBytesPerFRS;
 
     while (ullCurrentIndex < ullLastIndex)
     {
-        DWORD dwBytesRead = 0;
+        const auto ullFRSToRead = std::min<ULONGLONG>(ullLastIndex - ullCurrentIndex, DEFAULT_FRS_PER_READ);
+        const auto dwBytesToRead = static_cast<DWORD>(ullFRSToRead * ulBytesPerFRS);
 
-        if (!ReadFile(m_pVolReader->GetHandle(), buffer.GetData(), m_pVolReader->GetBytesPerFRS(), &dwBytesRead, NULL))
+        DWORD dwBytesRead = 0;
+        if (!ReadFile(m_pVolReader->GetHandle(), buffer.GetData(), dwBytesToRead, &dwBytesRead, NULL))
         {
             hr = HRESULT_FROM_WIN32(GetLastError());
             Log::Error(L"Could not read in MFT file [{}]", SystemError(hr));
             return hr;
         }
 
-        if (dwBytesRead != m_pVolReader->GetBytesPerFRS())
-        {
-            Log::Debug(L"Reached end of offline MFT [{}]", SystemError(hr));
-            return S_OK;
-        }
-
-        PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)buffer.GetData();
+        const DWORD dwFRSRead = dwBytesRead / ulBytesPerFRS;
 
-        if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
-            || (pHeader->MultiSectorHeader.Signature[2] != 'L') || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
+        if (FAILED(
+                hr = MFTUtils::MultiSectorFixupBlocks(
+                    buffer.GetData(),
+                    dwFRSRead * ulBytesPerFRS,
+                    ulBytesPerFRS,
+                    MFTUtils::kFileSignature,
+                    fixedUp)))
         {
-            Log::Debug(
-                L"Skipping... MultiSectorHeader.Signature is not FILE - '{}{}{}{}'",
-                pHeader->MultiSectorHeader.Signature[0],
-                pHeader->MultiSectorHeader.Signature[1],
-                pHeader->MultiSectorHeader.Signature[2],
-                pHeader->MultiSectorHeader.Signature[3]);
-            continue;
+            Log::Error(L"Failed to fix up records of offline MFT [{}]", SystemError(hr));
+            return hr;
         }
 
-        if (FAILED(hr = pCallBack(ullCurrentMftIndex, buffer)))
+        for (DWORD i = 0; i < dwFRSRead; i++, ullCurrentIndex++, ullCurrentMftIndex++)
         {
-            if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+            if (!fixedUp[i])
+                continue;
+
+            CBinaryBuffer record(buffer.GetData() + i * ulBytesPerFRS, ulBytesPerFRS);
+
+            if (FAILED(hr = pCallBack(ullCurrentMftIndex, record)))
             {
-                Log::Debug("INFO: stopping enumeration [{}]", SystemError(hr));
-                return hr;
-            }
+                if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+                {
+                    Log::Debug("INFO: stopping enumeration [{}]", SystemError(hr));
+                    return hr;
+                }
 
-            Log::Warn("Add Record Callback failed [{}]", SystemError(hr));
+                Log::Warn("Add Record Callback failed [{}]", SystemError(hr));
+            }
         }
 
-        ullCurrentIndex++;
-        ullCurrentMftIndex++;
+        if (dwBytesRead != dwBytesToRead)
+        {
+            Log::Debug(L"Reached end of offline MFT");
+            return S_OK;
+        }
     }
 
     return S_OK;
@@ -138,6 +169,8 @@ HRESULT MFTOffline::FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTU
     if (!localReadBuffer.CheckCount(ulBytesPerFRS))
         return E_OUTOFMEMORY;
 
+    std::vector<bool> fixedUp;
+
     for (const auto& idx : frn)
     {
         LARGE_INTEGER Index;
@@ -204,6 +237,19 @@ HRESULT MFTOffline::FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTU
             continue;
         }
 
+        if (FAILED(
+                hr = MFTUtils::MultiSectorFixupBlocks(
+                    localReadBuffer.GetData(),
+                    ulBytesPerFRS,
+                    ulBytesPerFRS,
+                    MFTUtils::kFileSignature,
+                    fixedUp))
+            || !fixedUp.front())
+        {
+            Log::Debug(L"Skipping... Record {} cannot be fixed up", NtfsSegmentNumber(&idx));
+            continue;
+        }
+
         MFTUtils::SafeMFTSegmentNumber safeFRN = (ULONGLONG)Index.QuadPart;
         if (FAILED(hr = pCallBack(safeFRN, localReadBuffer)))
         {
@@ -31,12 +31,16 @@ public:
     virtual HRESULT FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUtils::EnumMFTRecordCall pCallBack);
     virtual ULONG GetMFTRecordCount() const;
     virtual MFTUtils::SafeMFTSegmentNumber GetUSNRoot() const;
+    virtual ULONGLONG GetMftSize() const { return m_ullMftSize; }
+    virtual ULONGLONG GetMftLsn() const { return m_MftLsn; }
 
 private:
     std::shared_ptr<OfflineMFTReader> m_pVolReader;
     std::shared_ptr<OfflineMFTReader> m_pFetchReader;
 
     MFTUtils::SafeMFTSegmentNumber m_RootUSN;
+    ULONGLONG m_ullMftSize = 0LL;
+    ULONGLONG m_MftLsn = 0LL;
 };
 }  // namespace Orc
 
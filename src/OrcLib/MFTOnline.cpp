@@ -15,8 +15,6 @@
 
 using namespace Orc;
 
-static const auto DEFAULT_FRS_PER_READ = 64;
-
 MFTOnline::MFTOnline(std::shared_ptr<VolumeReader> volReader)
     : m_pVolReader(std::move(volReader))
 {
@@ -136,6 +134,8 @@ HRESULT MFTOnline::GetMFTExtents(const CBinaryBuffer& buffer)
         return E_UNEXPECTED;
     }
 
+    m_MftLsn = pData->Reserved1;
+
     realLength = (ULONG)record.GetCount();
 
     if (pData->FirstAttributeOffset > realLength)
@@ -287,6 +287,9 @@ HRESULT MFTOnline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
     if (!localReadBuffer.CheckCount(ulBytesPerFRS * DEFAULT_FRS_PER_READ))
         return E_OUTOFMEMORY;
 
+    std::vector<bool> fixedUp;
+    fixedUp.reserve(DEFAULT_FRS_PER_READ);
+
     ULONGLONG position = 0LL;
 
     for (auto iter = m_MFT0Info.ExtentsVector.begin(); iter != m_MFT0Info.ExtentsVector.end(); ++iter)
@@ -336,6 +339,18 @@ HRESULT MFTOnline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
                     ulBytesPerFRS * ullFRSToRead);
             }
 
+            if (FAILED(
+                    hr = MFTUtils::MultiSectorFixupBlocks(
+                        localReadBuffer.GetData(),
+                        static_cast<size_t>(ullBytesRead - ullBytesRead % ulBytesPerFRS),
+                        ulBytesPerFRS,
+                        MFTUtils::kFileSignature,
+                        fixedUp)))
+            {
+                Log::Error(L"Failed to fix up records at position {} [{}]", extent_position, SystemError(hr));
+                return hr;
+            }
+
             for (unsigned int i = 0; i < (ullBytesRead / ulBytesPerFRS); i++)
             {
                 if (ullCurrentIndex * ulBytesPerFRS != position + (i * ulBytesPerFRS))
@@ -343,6 +358,13 @@ HRESULT MFTOnline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
                     Log::Warn("Index is out of sequence");
                 }
 
+                if (!fixedUp[i])
+                {
+                    ullCurrentFRNIndex++;
+                    ullCurrentIndex++;
+                    continue;
+                }
+
                 CBinaryBuffer tempFRS(localReadBuffer.GetData() + i * ulBytesPerFRS, ulBytesPerFRS);
 
                 if (FAILED(hr = pCallBack(ullCurrentFRNIndex, tempFRS)))
@@ -399,6 +421,8 @@ HRESULT MFTOnline::FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUt
     if (!localReadBuffer.CheckCount(ulBytesPerFRS))
         return E_OUTOFMEMORY;
 
+    std::vector<bool> fixedUp;
+
     UINT frnIdx = 0;
     ULONGLONG ullCurrentIndex = 0;
 
@@ -479,6 +503,24 @@ HRESULT MFTOnline::FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUt
                 continue;
             }
 
+            if (FAILED(
+                    hr = MFTUtils::MultiSectorFixupBlocks(
+                        localReadBuffer.GetData(),
+                        ulBytesPerFRS,
+                        ulBytesPerFRS,
+                        MFTUtils::kFileSignature,
+                        fixedUp))
+                || !fixedUp.front())
+            {
+                Log::Debug(L"Skipping... Record {} cannot be fixed up", NtfsSegmentNumber(&frn[frnIdx]));
+                frnIdx++;
+                if (frnIdx >= frn.size())
+                    break;
+                current.HighPart = frn[frnIdx].SegmentNumberHighPart;
+                current.LowPart = frn[frnIdx].SegmentNumberLowPart;
+                continue;
+            }
+
             if (FAILED(hr = pCallBack(current.QuadPart, localReadBuffer)))
             {
                 if (hr == E_OUTOFMEMORY)
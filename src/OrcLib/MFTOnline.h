@@ -30,6 +30,8 @@ public:
     virtual HRESULT FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUtils::EnumMFTRecordCall pCallBack);
     virtual ULONG GetMFTRecordCount() const;
     virtual MFTUtils::SafeMFTSegmentNumber GetUSNRoot() const { return m_RootUSN; }
+    virtual ULONGLONG GetMftSize() const { return m_MFT0Info.DataSize; }
+    virtual ULONGLONG GetMftLsn() const { return m_MftLsn; }
 
     const MFTUtils::NonResidentDataAttrInfo& GetMftInfo() const { return m_MFT0Info; }
 
@@ -40,6 +42,7 @@ private:
     HRESULT GetMFTExtents(const CBinaryBuffer& buffer);
 
     ULONG64 m_MftOffset;
+    ULONGLONG m_MftLsn = 0LL;
     MFTUtils::NonResidentDataAttrInfo m_MFT0Info;
 
     MFTUtils::SafeMFTSegmentNumber m_RootUSN;
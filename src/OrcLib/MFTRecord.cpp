@@ -593,6 +593,18 @@ const std::shared_ptr<BitmapAttribute> MFTRecord::GetBitmapAttribute(LPCWSTR szA
     return std::dynamic_pointer_cast<BitmapAttribute>(attr_it->Attribute());
 }
 
+const std::shared_ptr<WOFReparseAttribute> MFTRecord::GetWOFReparseAttribute() const
+{
+    auto attr_it = std::find_if(
+        begin(m_pAttributeList->m_AttList),
+        end(m_pAttributeList->m_AttList),
+        [](const AttributeListEntry& entry) -> bool { return entry.TypeCode() == $REPARSE_POINT; });
+    if (attr_it == end(m_pAttributeList->m_AttList))
+        return nullptr;
+
+    return std::dynamic_pointer_cast<WOFReparseAttribute>(attr_it->Attribute());
+}
+
 HRESULT MFTRecord::GetIndexAttributes(
     const std::shared_ptr<VolumeReader>& VolReader,
     LPCWSTR szAttrName,
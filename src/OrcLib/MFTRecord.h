@@ -92,6 +92,7 @@ public:
     const std::shared_ptr<IndexAllocationAttribute> GetIndexAllocationAttribute(LPCWSTR szAttrName) const;
     const std::shared_ptr<IndexRootAttribute> GetIndexRootAttribute(LPCWSTR szAttrName) const;
     const std::shared_ptr<BitmapAttribute> GetBitmapAttribute(LPCWSTR szAttrName) const;
+    const std::shared_ptr<WOFReparseAttribute> GetWOFReparseAttribute() const;
 
     HRESULT GetIndexAttributes(
         const std::shared_ptr<VolumeReader>& VolReader,
@@ -658,6 +658,38 @@ HRESULT MFTRecordFileInfo::WriteOwnerId(ITableOutput& output)
     return output.WriteInteger(m_pMFTRecord->m_pStandardInformation->OwnerId);
 }
 
+const SecurityDescriptorCache::Descriptor* MFTRecordFileInfo::FindSecurityDescriptor() const
+{
+    if (m_pSecDescrCache == nullptr || m_pMFTRecord == nullptr || m_pMFTRecord->m_pStandardInformation == nullptr)
+        return nullptr;
+
+    return m_pSecDescrCache->Find(m_pMFTRecord->m_pStandardInformation->SecurityId);
+}
+
+HRESULT MFTRecordFileInfo::WriteOwnerSid(ITableOutput& output)
+{
+    const auto pDescriptor = FindSecurityDescriptor();
+    if (pDescriptor == nullptr)
+        return NtfsFileInfo::WriteOwnerSid(output);
+
+    if (pDescriptor->OwnerSid.empty())
+        return output.WriteNothing();
+
+    return output.WriteString(pDescriptor->OwnerSid);
+}
+
+HRESULT MFTRecordFileInfo::WriteOwner(ITableOutput& output)
+{
+    const auto pDescriptor = FindSecurityDescriptor();
+    if (pDescriptor == nullptr)
+        return NtfsFileInfo::WriteOwner(output);
+
+    if (pDescriptor->Owner.empty())
+        return output.WriteNothing();
+
+    return output.WriteString(pDescriptor->Owner);
+}
+
 HRESULT MFTRecordFileInfo::WriteExtendedAttributes(ITableOutput& output)
 {
     HRESULT hr = E_FAIL;
@@ -14,6 +14,7 @@
 
 #include "MftRecordAttribute.h"
 #include "MftRecord.h"
+#include "SecurityDescriptorCache.h"
 
 #pragma managed(push, off)
 
@@ -47,6 +48,8 @@ public:
     virtual HRESULT WriteLastAccessDate(ITableOutput& output);
 
     virtual HRESULT WriteOwnerId(ITableOutput& output);
+    virtual HRESULT WriteOwnerSid(ITableOutput& output);
+    virtual HRESULT WriteOwner(ITableOutput& output);
 
     virtual HRESULT WriteUSN(ITableOutput& output);
     virtual HRESULT WriteFRN(ITableOutput& output);
@@ -89,10 +92,16 @@ public:
         Authenticode& verifytrust);
     virtual ~MFTRecordFileInfo(void);
 
+    // Owners are read from the volume's security descriptors instead of opening the file
+    void SetSecurityDescriptorCache(const SecurityDescriptorCache* pCache) { m_pSecDescrCache = pCache; }
+
 private:
     MFTRecord* m_pMFTRecord = nullptr;
     PFILE_NAME m_pFileName = nullptr;
     std::shared_ptr<DataAttribute> m_pDataAttr;
+    const SecurityDescriptorCache* m_pSecDescrCache = nullptr;
+
+    const SecurityDescriptorCache::Descriptor* FindSecurityDescriptor() const;
 
     virtual HRESULT Open();
 
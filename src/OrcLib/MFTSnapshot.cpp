@@ -0,0 +1,702 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#include "StdAfx.h"
+
+#include "MFTSnapshot.h"
+
+#include "MFTRecord.h"
+#include "MftRecordAttribute.h"
+#include "VolumeReader.h"
+#include "CaseInsensitive.h"
+
+#include "Log/Log.h"
+
+#include <numeric>
+
+using namespace Orc;
+
+namespace {
+
+constexpr BYTE kMagic[8] = {'O', 'R', 'C', 'M', 'F', 'T', 'S', 'S'};
+constexpr ULONG kVersion = 1L;
+constexpr ULONGLONG kColumnAlignment = 8LL;
+constexpr ULONGLONG kSegmentNumberMask = 0x0000FFFFFFFFFFFF;
+constexpr ULONGLONG kRootSegmentNumber = $ROOT_FILE_REFERENCE_NUMBER & kSegmentNumberMask;
+constexpr DWORD kWriteSize = 0x400000;
+
+// Paths deeper than this are considered as a loop in the parents
+constexpr size_t kMaxPathDepth = 1024;
+
+// Each column is an array packed at its offset in the file: records are sorted by segment number, their names and
+// runs are contiguous and delimited by 'FirstName' and 'FirstRun' (which hold one more entry for the end of the last
+// record). Names are delimited the same way by 'NameOffset', in 'NameChars'.
+enum Column : ULONG
+{
+    FRN = 0,
+    Flags,
+    Attributes,
+    Size,
+    CreationTime,
+    LastModificationTime,
+    LastAccessTime,
+    LastChangeTime,
+    FirstName,
+    FirstRun,
+    NameParent,
+    NameOffset,
+    NameChars,
+    RunDiskOffset,
+    RunLength,
+    ColumnCount
+};
+
+struct SnapshotHeader
+{
+    BYTE Magic[8];
+    ULONG Version;
+    ULONG BytesPerFRS;
+    ULONGLONG VolumeSerialNumber;
+    ULONGLONG MftSize;
+    ULONGLONG MftLsn;
+    ULONGLONG RecordCount;
+    ULONGLONG NameCount;
+    ULONGLONG RunCount;
+    ULONGLONG NameCharCount;
+    ULONGLONG ColumnOffsets[ColumnCount];
+};
+
+struct ColumnLayout
+{
+    size_t cbElement;
+    ULONGLONG ullCount;
+};
+
+ColumnLayout GetColumnLayout(Column column, const SnapshotHeader& header)
+{
+    switch (column)
+    {
+        case Column::FRN:
+        case Column::Size:
+            return {sizeof(ULONGLONG), header.RecordCount};
+        case Column::Flags:
+        case Column::Attributes:
+            return {sizeof(ULONG), header.RecordCount};
+        case Column::CreationTime:
+        case Column::LastModificationTime:
+        case Column::LastAccessTime:
+        case Column::LastChangeTime:
+            return {sizeof(LONGLONG), header.RecordCount};
+        case Column::FirstName:
+        case Column::FirstRun:
+            return {sizeof(ULONG), header.RecordCount + 1};
+        case Column::NameParent:
+            return {sizeof(ULONGLONG), header.NameCount};
+        case Column::NameOffset:
+            return {sizeof(ULONG), header.NameCount + 1};
+        case Column::NameChars:
+            return {sizeof(WCHAR), header.NameCharCount};
+        case Column::RunDiskOffset:
+        case Column::RunLength:
+            return {sizeof(ULONGLONG), header.RunCount};
+        default:
+            return {0, 0LL};
+    }
+}
+
+// Delimiters must start at 0, never decrease and end with the count of what they delimit
+bool IsValidDelimiter(const ULONG* pDelimiters, ULONGLONG ullCount, ULONGLONG ullEnd)
+{
+    if (pDelimiters[0] != 0L || pDelimiters[ullCount] != ullEnd)
+        return false;
+
+    for (ULONGLONG i = 0; i < ullCount; i++)
+    {
+        if (pDelimiters[i] > pDelimiters[i + 1])
+            return false;
+    }
+    return true;
+}
+
+LONGLONG ToLongLong(const FILETIME& ft)
+{
+    ULARGE_INTEGER li;
+    li.LowPart = ft.dwLowDateTime;
+    li.HighPart = ft.dwHighDateTime;
+    return static_cast<LONGLONG>(li.QuadPart);
+}
+
+template <typename T>
+void AppendColumn(std::vector<BYTE>& image, SnapshotHeader& header, Column column, const std::vector<T>& values)
+{
+    image.resize((image.size() + kColumnAlignment - 1) / kColumnAlignment * kColumnAlignment, 0);
+    header.ColumnOffsets[column] = image.size();
+
+    const auto pValues = reinterpret_cast<const BYTE*>(values.data());
+    image.insert(std::end(image), pValues, pValues + values.size() * sizeof(T));
+}
+
+}  // namespace
+
+HRESULT MFTSnapshot::Open(const std::wstring& strFileName, const Key& key)
+{
+    HRESULT hr = E_FAIL;
+
+    Close();
+
+    m_hFile = CreateFileW(
+        strFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Debug(L"Failed to open MFT snapshot '{}' [{}]", strFileName, SystemError(hr));
+        return hr;
+    }
+
+    LARGE_INTEGER liSize = {0};
+    if (!GetFileSizeEx(m_hFile, &liSize))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to get size of MFT snapshot '{}' [{}]", strFileName, SystemError(hr));
+        Close();
+        return hr;
+    }
+
+    if (liSize.QuadPart < sizeof(SnapshotHeader))
+    {
+        Log::Error(L"MFT snapshot '{}' is truncated", strFileName);
+        Close();
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    m_hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0L, 0L, NULL);
+    if (m_hMapping == NULL)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to create mapping of MFT snapshot '{}' [{}]", strFileName, SystemError(hr));
+        Close();
+        return hr;
+    }
+
+    m_pMapped = static_cast<const BYTE*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0L, 0L, 0L));
+    if (m_pMapped == nullptr)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to map MFT snapshot '{}' [{}]", strFileName, SystemError(hr));
+        Close();
+        return hr;
+    }
+
+    if (FAILED(hr = Load(m_pMapped, liSize.QuadPart, key)))
+    {
+        Log::Debug(L"Failed to load MFT snapshot '{}' [{}]", strFileName, SystemError(hr));
+        Close();
+        return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT MFTSnapshot::Open(std::vector<BYTE> image, const Key& key)
+{
+    HRESULT hr = E_FAIL;
+
+    Close();
+
+    m_Image = std::move(image);
+    if (FAILED(hr = Load(m_Image.data(), m_Image.size(), key)))
+    {
+        Close();
+        return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT MFTSnapshot::Close()
+{
+    if (m_pMapped != nullptr)
+    {
+        UnmapViewOfFile(m_pMapped);
+        m_pMapped = nullptr;
+    }
+    if (m_hMapping != NULL)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+
+    m_Image.clear();
+    m_Key = Key();
+    m_ullRecordCount = 0LL;
+    m_ullNameCount = 0LL;
+    m_ullRunCount = 0LL;
+    return S_OK;
+}
+
+HRESULT MFTSnapshot::Load(const BYTE* pData, ULONGLONG ullSize, const Key& key)
+{
+    if (ullSize < sizeof(SnapshotHeader))
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    SnapshotHeader header;
+    CopyMemory(&header, pData, sizeof(header));
+
+    if (memcmp(header.Magic, kMagic, sizeof(kMagic)) || header.Version != kVersion)
+    {
+        Log::Debug("Not a MFT snapshot or unsupported version");
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    Key snapshotKey;
+    snapshotKey.VolumeSerialNumber = header.VolumeSerialNumber;
+    snapshotKey.MftSize = header.MftSize;
+    snapshotKey.MftLsn = header.MftLsn;
+    snapshotKey.BytesPerFRS = header.BytesPerFRS;
+
+    if (snapshotKey != key)
+    {
+        Log::Debug(
+            L"MFT snapshot was built from another MFT (serial: {:#x}, size: {}, lsn: {:#x})",
+            snapshotKey.VolumeSerialNumber,
+            snapshotKey.MftSize,
+            snapshotKey.MftLsn);
+        return HRESULT_FROM_WIN32(ERROR_FILE_INVALID);
+    }
+
+    // Delimiters are ULONG indexes
+    if (header.RecordCount >= MAXULONG || header.NameCount >= MAXULONG || header.RunCount >= MAXULONG
+        || header.NameCharCount >= MAXULONG)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    const BYTE* columns[ColumnCount] = {nullptr};
+    for (ULONG i = 0; i < ColumnCount; i++)
+    {
+        const auto layout = GetColumnLayout(static_cast<Column>(i), header);
+        const auto ullOffset = header.ColumnOffsets[i];
+
+        if (ullOffset < sizeof(SnapshotHeader) || ullOffset % kColumnAlignment || ullOffset > ullSize
+            || layout.ullCount > (ullSize - ullOffset) / layout.cbElement)
+        {
+            Log::Debug(L"MFT snapshot column {} is out of bounds", i);
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+        columns[i] = pData + ullOffset;
+    }
+
+    m_pFRN = reinterpret_cast<const ULONGLONG*>(columns[Column::FRN]);
+    m_pFlags = reinterpret_cast<const ULONG*>(columns[Column::Flags]);
+    m_pAttributes = reinterpret_cast<const ULONG*>(columns[Column::Attributes]);
+    m_pSize = reinterpret_cast<const ULONGLONG*>(columns[Column::Size]);
+    m_pCreationTime = reinterpret_cast<const LONGLONG*>(columns[Column::CreationTime]);
+    m_pLastModificationTime = reinterpret_cast<const LONGLONG*>(columns[Column::LastModificationTime]);
+    m_pLastAccessTime = reinterpret_cast<const LONGLONG*>(columns[Column::LastAccessTime]);
+    m_pLastChangeTime = reinterpret_cast<const LONGLONG*>(columns[Column::LastChangeTime]);
+    m_pFirstName = reinterpret_cast<const ULONG*>(columns[Column::FirstName]);
+    m_pFirstRun = reinterpret_cast<const ULONG*>(columns[Column::FirstRun]);
+    m_pNameParent = reinterpret_cast<const ULONGLONG*>(columns[Column::NameParent]);
+    m_pNameOffset = reinterpret_cast<const ULONG*>(columns[Column::NameOffset]);
+    m_pNameChars = reinterpret_cast<const WCHAR*>(columns[Column::NameChars]);
+    m_pRunDiskOffset = reinterpret_cast<const ULONGLONG*>(columns[Column::RunDiskOffset]);
+    m_pRunLength = reinterpret_cast<const ULONGLONG*>(columns[Column::RunLength]);
+
+    // Checked once here so queries do not have to
+    if (!IsValidDelimiter(m_pFirstName, header.RecordCount, header.NameCount)
+        || !IsValidDelimiter(m_pFirstRun, header.RecordCount, header.RunCount)
+        || !IsValidDelimiter(m_pNameOffset, header.NameCount, header.NameCharCount))
+    {
+        Log::Debug("MFT snapshot has invalid delimiters");
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    for (ULONGLONG i = 1; i < header.RecordCount; i++)
+    {
+        if ((m_pFRN[i - 1] & kSegmentNumberMask) > (m_pFRN[i] & kSegmentNumberMask))
+        {
+            Log::Debug("MFT snapshot records are not sorted");
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+    }
+
+    m_Key = snapshotKey;
+    m_ullRecordCount = header.RecordCount;
+    m_ullNameCount = header.NameCount;
+    m_ullRunCount = header.RunCount;
+    return S_OK;
+}
+
+std::optional<size_t> MFTSnapshot::Find(ULONGLONG ullFRN) const
+{
+    const auto ullSegmentNumber = ullFRN & kSegmentNumberMask;
+
+    const auto pEnd = m_pFRN + m_ullRecordCount;
+    const auto pFound =
+        std::lower_bound(m_pFRN, pEnd, ullSegmentNumber, [](ULONGLONG ullCurrent, ULONGLONG ullSegment) {
+            return (ullCurrent & kSegmentNumberMask) < ullSegment;
+        });
+
+    if (pFound == pEnd || (*pFound & kSegmentNumberMask) != ullSegmentNumber)
+        return std::nullopt;
+
+    if (ullFRN != ullSegmentNumber && *pFound != ullFRN)
+        return std::nullopt;
+
+    return static_cast<size_t>(pFound - m_pFRN);
+}
+
+std::vector<size_t> MFTSnapshot::FindByName(std::wstring_view name) const
+{
+    std::vector<size_t> found;
+
+    for (size_t i = 0; i < m_ullRecordCount; i++)
+    {
+        for (ULONG j = m_pFirstName[i]; j < m_pFirstName[i + 1]; j++)
+        {
+            const auto fileName = GetName(j);
+            if (fileName.size() == name.size() && equalCaseInsensitive(fileName, name))
+            {
+                found.push_back(i);
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+MFTSnapshot::Record MFTSnapshot::GetRecord(size_t index) const
+{
+    Record record;
+    record.FRN = m_pFRN[index];
+    record.Flags = m_pFlags[index];
+    record.Attributes = m_pAttributes[index];
+    record.Size = m_pSize[index];
+    record.CreationTime = m_pCreationTime[index];
+    record.LastModificationTime = m_pLastModificationTime[index];
+    record.LastAccessTime = m_pLastAccessTime[index];
+    record.LastChangeTime = m_pLastChangeTime[index];
+    return record;
+}
+
+std::wstring_view MFTSnapshot::GetName(size_t nameIndex) const
+{
+    return std::wstring_view(
+        m_pNameChars + m_pNameOffset[nameIndex], m_pNameOffset[nameIndex + 1] - m_pNameOffset[nameIndex]);
+}
+
+std::vector<std::wstring_view> MFTSnapshot::GetNames(size_t index) const
+{
+    std::vector<std::wstring_view> names;
+    names.reserve(m_pFirstName[index + 1] - m_pFirstName[index]);
+
+    for (ULONG i = m_pFirstName[index]; i < m_pFirstName[index + 1]; i++)
+        names.push_back(GetName(i));
+
+    return names;
+}
+
+std::wstring MFTSnapshot::GetFullName(size_t index) const
+{
+    std::vector<std::wstring_view> components;
+    std::optional<ULONGLONG> unresolvedParent;
+
+    auto current = std::make_optional(index);
+    while (current && components.size() < kMaxPathDepth)
+    {
+        const auto ulFirstName = m_pFirstName[*current];
+        if (ulFirstName == m_pFirstName[*current + 1])
+            break;
+
+        if ((m_pFRN[*current] & kSegmentNumberMask) == kRootSegmentNumber)
+            break;
+
+        components.push_back(GetName(ulFirstName));
+        current = Find(m_pNameParent[ulFirstName]);
+        if (!current)
+            unresolvedParent = m_pNameParent[ulFirstName];
+    }
+
+    if (components.empty())
+        return (m_pFRN[index] & kSegmentNumberMask) == kRootSegmentNumber ? L"\\" : std::wstring();
+
+    // Parent was not found (or was reused since): placeholder, as MFTWalker does
+    std::wstring fullName = unresolvedParent ? fmt::format(L"\\__{:016X}__", *unresolvedParent) : std::wstring();
+    fullName.reserve(std::accumulate(
+        std::cbegin(components),
+        std::cend(components),
+        fullName.size() + components.size(),
+        [](size_t count, std::wstring_view name) { return count + name.size(); }));
+
+    for (auto it = std::crbegin(components); it != std::crend(components); ++it)
+    {
+        fullName.push_back(L'\\');
+        fullName.append(*it);
+    }
+    return fullName;
+}
+
+std::vector<MFTSnapshot::DataRun> MFTSnapshot::GetDataRuns(size_t index) const
+{
+    std::vector<DataRun> runs;
+    runs.reserve(m_pFirstRun[index + 1] - m_pFirstRun[index]);
+
+    for (ULONG i = m_pFirstRun[index]; i < m_pFirstRun[index + 1]; i++)
+        runs.push_back({m_pRunDiskOffset[i], m_pRunLength[i]});
+
+    return runs;
+}
+
+HRESULT MFTSnapshotWriter::Add(const std::shared_ptr<VolumeReader>& volReader, MFTRecord* pRecord)
+{
+    if (pRecord == nullptr)
+        return E_POINTER;
+
+    MFTSnapshot::Record record;
+    record.FRN = pRecord->GetSafeMFTSegmentNumber();
+
+    if (pRecord->IsRecordInUse())
+        record.Flags |= MFTSnapshot::RecordFlags::InUse;
+    if (pRecord->IsDirectory())
+        record.Flags |= MFTSnapshot::RecordFlags::Directory;
+    if (pRecord->HasNamedDataAttr())
+        record.Flags |= MFTSnapshot::RecordFlags::HasNamedData;
+    if (pRecord->HasReparsePoint())
+        record.Flags |= MFTSnapshot::RecordFlags::ReparsePoint;
+
+    if (const auto pSI = pRecord->GetStandardInformation(); pSI != nullptr)
+    {
+        record.Attributes = pSI->FileAttributes;
+        record.CreationTime = ToLongLong(pSI->CreationTime);
+        record.LastModificationTime = ToLongLong(pSI->LastModificationTime);
+        record.LastAccessTime = ToLongLong(pSI->LastAccessTime);
+        record.LastChangeTime = ToLongLong(pSI->LastChangeTime);
+    }
+
+    // DOS names are only kept when the record has no other name
+    std::vector<Name> names;
+    const auto& fileNames = pRecord->GetFileNames();
+    for (const auto pFileName : fileNames)
+    {
+        if (pFileName->Flags == FILE_NAME_DOS83 && fileNames.size() > 1)
+            continue;
+
+        names.push_back(
+            {NtfsFullSegmentNumber(&pFileName->ParentDirectory),
+             std::wstring_view(pFileName->FileName, pFileName->FileNameLength)});
+    }
+
+    std::vector<MFTSnapshot::DataRun> runs;
+    for (const auto& pDataAttr : pRecord->GetDataAttributes())
+    {
+        if (pDataAttr->NameLength() != 0)
+            continue;
+
+        DWORDLONG dwlSize = 0LL;
+        if (SUCCEEDED(pDataAttr->DataSize(volReader, dwlSize)))
+            record.Size = dwlSize;
+
+        if (pDataAttr->IsNonResident())
+        {
+            if (const auto pInfo = pDataAttr->GetNonResidentInformation(volReader); pInfo != nullptr)
+            {
+                for (const auto& extent : pInfo->ExtentsVector)
+                {
+                    if (!extent.bZero)
+                        runs.push_back({extent.DiskOffset, extent.DiskAlloc});
+                }
+            }
+        }
+        break;
+    }
+
+    return Add(record, names, runs);
+}
+
+HRESULT MFTSnapshotWriter::Add(
+    const MFTSnapshot::Record& record,
+    const std::vector<Name>& names,
+    const std::vector<MFTSnapshot::DataRun>& runs)
+{
+    if (m_Records.size() >= MAXULONG - 1 || m_NameOffsets.size() + names.size() >= MAXULONG
+        || m_Runs.size() + runs.size() >= MAXULONG)
+        return E_OUTOFMEMORY;
+
+    Entry entry;
+    entry.Record = record;
+    entry.FirstName = static_cast<ULONG>(m_NameOffsets.size());
+    entry.NameCount = static_cast<ULONG>(names.size());
+    entry.FirstRun = static_cast<ULONG>(m_Runs.size());
+    entry.RunCount = static_cast<ULONG>(runs.size());
+
+    for (const auto& name : names)
+    {
+        m_NameParents.push_back(name.ParentFRN);
+        m_NameOffsets.push_back(static_cast<ULONG>(m_NameChars.size()));
+        m_NameChars.append(name.FileName);
+    }
+    m_Runs.insert(std::end(m_Runs), std::cbegin(runs), std::cend(runs));
+
+    m_Records.push_back(entry);
+    return S_OK;
+}
+
+HRESULT MFTSnapshotWriter::Serialize(const MFTSnapshot::Key& key, std::vector<BYTE>& image) const
+{
+    if (m_NameChars.size() >= MAXULONG)
+        return E_OUTOFMEMORY;
+
+    // Records are walked in any order, they are sorted by segment number for lookups
+    std::vector<ULONG> order(m_Records.size());
+    std::iota(std::begin(order), std::end(order), 0UL);
+    std::sort(std::begin(order), std::end(order), [this](ULONG left, ULONG right) {
+        return (m_Records[left].Record.FRN & kSegmentNumberMask) < (m_Records[right].Record.FRN & kSegmentNumberMask);
+    });
+
+    std::vector<ULONGLONG> frn, size;
+    std::vector<LONGLONG> creation, modification, access, change;
+    std::vector<ULONG> flags, attributes, firstName, firstRun;
+    std::vector<ULONGLONG> nameParent, runDiskOffset, runLength;
+    std::vector<ULONG> nameOffset;
+    std::vector<WCHAR> nameChars;
+
+    for (auto column : {&frn, &size})
+        column->reserve(m_Records.size());
+    for (auto column : {&creation, &modification, &access, &change})
+        column->reserve(m_Records.size());
+    for (auto column : {&flags, &attributes, &firstName, &firstRun})
+        column->reserve(m_Records.size() + 1);
+    nameParent.reserve(m_NameParents.size());
+    nameOffset.reserve(m_NameOffsets.size() + 1);
+    nameChars.reserve(m_NameChars.size());
+    runDiskOffset.reserve(m_Runs.size());
+    runLength.reserve(m_Runs.size());
+
+    for (const auto ulIndex : order)
+    {
+        const auto& entry = m_Records[ulIndex];
+
+        frn.push_back(entry.Record.FRN);
+        flags.push_back(entry.Record.Flags);
+        attributes.push_back(entry.Record.Attributes);
+        size.push_back(entry.Record.Size);
+        creation.push_back(entry.Record.CreationTime);
+        modification.push_back(entry.Record.LastModificationTime);
+        access.push_back(entry.Record.LastAccessTime);
+        change.push_back(entry.Record.LastChangeTime);
+
+        firstName.push_back(static_cast<ULONG>(nameParent.size()));
+        for (ULONG i = entry.FirstName; i < entry.FirstName + entry.NameCount; i++)
+        {
+            nameParent.push_back(m_NameParents[i]);
+            nameOffset.push_back(static_cast<ULONG>(nameChars.size()));
+
+            const size_t cchEnd = i + 1 < m_NameOffsets.size() ? m_NameOffsets[i + 1] : m_NameChars.size();
+            nameChars.insert(
+                std::end(nameChars), m_NameChars.data() + m_NameOffsets[i], m_NameChars.data() + cchEnd);
+        }
+
+        firstRun.push_back(static_cast<ULONG>(runDiskOffset.size()));
+        for (ULONG i = entry.FirstRun; i < entry.FirstRun + entry.RunCount; i++)
+        {
+            runDiskOffset.push_back(m_Runs[i].DiskOffset);
+            runLength.push_back(m_Runs[i].Length);
+        }
+    }
+
+    firstName.push_back(static_cast<ULONG>(nameParent.size()));
+    firstRun.push_back(static_cast<ULONG>(runDiskOffset.size()));
+    nameOffset.push_back(static_cast<ULONG>(nameChars.size()));
+
+    SnapshotHeader header;
+    ZeroMemory(&header, sizeof(header));
+    CopyMemory(header.Magic, kMagic, sizeof(kMagic));
+    header.Version = kVersion;
+    header.BytesPerFRS = key.BytesPerFRS;
+    header.VolumeSerialNumber = key.VolumeSerialNumber;
+    header.MftSize = key.MftSize;
+    header.MftLsn = key.MftLsn;
+    header.RecordCount = frn.size();
+    header.NameCount = nameParent.size();
+    header.RunCount = runDiskOffset.size();
+    header.NameCharCount = nameChars.size();
+
+    image.assign(sizeof(SnapshotHeader), 0);
+    AppendColumn(image, header, Column::FRN, frn);
+    AppendColumn(image, header, Column::Flags, flags);
+    AppendColumn(image, header, Column::Attributes, attributes);
+    AppendColumn(image, header, Column::Size, size);
+    AppendColumn(image, header, Column::CreationTime, creation);
+    AppendColumn(image, header, Column::LastModificationTime, modification);
+    AppendColumn(image, header, Column::LastAccessTime, access);
+    AppendColumn(image, header, Column::LastChangeTime, change);
+    AppendColumn(image, header, Column::FirstName, firstName);
+    AppendColumn(image, header, Column::FirstRun, firstRun);
+    AppendColumn(image, header, Column::NameParent, nameParent);
+    AppendColumn(image, header, Column::NameOffset, nameOffset);
+    AppendColumn(image, header, Column::NameChars, nameChars);
+    AppendColumn(image, header, Column::RunDiskOffset, runDiskOffset);
+    AppendColumn(image, header, Column::RunLength, runLength);
+
+    CopyMemory(image.data(), &header, sizeof(header));
+    return S_OK;
+}
+
+HRESULT MFTSnapshotWriter::Write(const std::wstring& strFileName, const MFTSnapshot::Key& key) const
+{
+    HRESULT hr = E_FAIL;
+
+    std::vector<BYTE> image;
+    if (FAILED(hr = Serialize(key, image)))
+        return hr;
+
+    const std::wstring strTempName = strFileName + L".tmp";
+
+    HANDLE hFile =
+        CreateFileW(strTempName.c_str(), GENERIC_WRITE, 0L, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to create MFT snapshot '{}' [{}]", strTempName, SystemError(hr));
+        return hr;
+    }
+
+    size_t offset = 0;
+    while (offset < image.size())
+    {
+        const auto dwToWrite = static_cast<DWORD>(std::min<size_t>(image.size() - offset, kWriteSize));
+
+        DWORD dwWritten = 0L;
+        if (!WriteFile(hFile, image.data() + offset, dwToWrite, &dwWritten, NULL))
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+            Log::Error(L"Failed to write MFT snapshot '{}' [{}]", strTempName, SystemError(hr));
+            CloseHandle(hFile);
+            DeleteFileW(strTempName.c_str());
+            return hr;
+        }
+        offset += dwWritten;
+    }
+
+    CloseHandle(hFile);
+
+    if (!MoveFileExW(strTempName.c_str(), strFileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Failed to move MFT snapshot to '{}' [{}]", strFileName, SystemError(hr));
+        DeleteFileW(strTempName.c_str());
+        return hr;
+    }
+
+    Log::Debug(L"MFT snapshot '{}' written ({} records, {} bytes)", strFileName, m_Records.size(), image.size());
+    return S_OK;
+}
@@ -0,0 +1,186 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include "NtfsDataStructures.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+class VolumeReader;
+class MFTRecord;
+
+// Columnar snapshot of the records of a MFT: reference numbers, names and parents, sizes, timestamps and runs of the
+// unnamed $DATA attribute. It is written once per volume and then mapped by later runs to answer name, path, size
+// and location queries without walking the MFT again.
+//
+// A snapshot is tied to the state of the MFT it was built from by its key: a snapshot whose key does not match the
+// volume is rejected when opened. On a live volume, the snapshot is the state of the MFT when it was built.
+class ORCLIB_API MFTSnapshot
+{
+public:
+    struct Key
+    {
+        ULONGLONG VolumeSerialNumber = 0LL;
+        ULONGLONG MftSize = 0LL;
+        ULONGLONG MftLsn = 0LL;
+        ULONG BytesPerFRS = 0L;
+
+        bool operator==(const Key& other) const
+        {
+            return VolumeSerialNumber == other.VolumeSerialNumber && MftSize == other.MftSize
+                && MftLsn == other.MftLsn && BytesPerFRS == other.BytesPerFRS;
+        }
+        bool operator!=(const Key& other) const { return !(*this == other); }
+    };
+
+    enum RecordFlags : ULONG
+    {
+        InUse = 0x1,
+        Directory = 0x2,
+        HasNamedData = 0x4,
+        ReparsePoint = 0x8
+    };
+
+    struct Record
+    {
+        ULONGLONG FRN = 0LL;
+        ULONG Flags = 0L;
+        ULONG Attributes = 0L;
+        ULONGLONG Size = 0LL;
+        LONGLONG CreationTime = 0LL;
+        LONGLONG LastModificationTime = 0LL;
+        LONGLONG LastAccessTime = 0LL;
+        LONGLONG LastChangeTime = 0LL;
+    };
+
+    struct DataRun
+    {
+        ULONGLONG DiskOffset = 0LL;
+        ULONGLONG Length = 0LL;
+    };
+
+    MFTSnapshot() = default;
+    MFTSnapshot(const MFTSnapshot&) = delete;
+    ~MFTSnapshot() { Close(); }
+
+    // Fails with HRESULT_FROM_WIN32(ERROR_FILE_INVALID) when the snapshot was built from another state of the MFT
+    HRESULT Open(const std::wstring& strFileName, const Key& key);
+
+    // Opens a snapshot built in memory (see MFTSnapshotWriter::Serialize)
+    HRESULT Open(std::vector<BYTE> image, const Key& key);
+
+    HRESULT Close();
+
+    const Key& GetKey() const { return m_Key; }
+
+    size_t GetRecordCount() const { return static_cast<size_t>(m_ullRecordCount); }
+
+    // Index of the record with this segment number, the sequence number is also checked when 'ullFRN' has one
+    std::optional<size_t> Find(ULONGLONG ullFRN) const;
+
+    // Indexes of the records with a name matching (case insensitive) 'name'
+    std::vector<size_t> FindByName(std::wstring_view name) const;
+
+    Record GetRecord(size_t index) const;
+
+    // Views on the mapped names of the record, they remain valid until the snapshot is closed
+    std::vector<std::wstring_view> GetNames(size_t index) const;
+
+    // Full path of the record built from its first name and parents, empty if the record has no name.
+    // A parent missing from the snapshot is replaced with a '\__<FRN>__' placeholder, as MFTWalker does.
+    std::wstring GetFullName(size_t index) const;
+
+    std::vector<DataRun> GetDataRuns(size_t index) const;
+
+private:
+    HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    HANDLE m_hMapping = NULL;
+    const BYTE* m_pMapped = nullptr;
+    std::vector<BYTE> m_Image;
+
+    Key m_Key;
+    ULONGLONG m_ullRecordCount = 0LL;
+    ULONGLONG m_ullNameCount = 0LL;
+    ULONGLONG m_ullRunCount = 0LL;
+
+    const ULONGLONG* m_pFRN = nullptr;
+    const ULONG* m_pFlags = nullptr;
+    const ULONG* m_pAttributes = nullptr;
+    const ULONGLONG* m_pSize = nullptr;
+    const LONGLONG* m_pCreationTime = nullptr;
+    const LONGLONG* m_pLastModificationTime = nullptr;
+    const LONGLONG* m_pLastAccessTime = nullptr;
+    const LONGLONG* m_pLastChangeTime = nullptr;
+    const ULONG* m_pFirstName = nullptr;
+    const ULONG* m_pFirstRun = nullptr;
+    const ULONGLONG* m_pNameParent = nullptr;
+    const ULONG* m_pNameOffset = nullptr;
+    const WCHAR* m_pNameChars = nullptr;
+    const ULONGLONG* m_pRunDiskOffset = nullptr;
+    const ULONGLONG* m_pRunLength = nullptr;
+
+    HRESULT Load(const BYTE* pData, ULONGLONG ullSize, const Key& key);
+
+    std::wstring_view GetName(size_t nameIndex) const;
+};
+
+// Collects the records of a walk (from MFTWalker's ElementCallback) and writes them as a MFTSnapshot
+class ORCLIB_API MFTSnapshotWriter
+{
+public:
+    struct Name
+    {
+        ULONGLONG ParentFRN = 0LL;
+        std::wstring_view FileName;
+    };
+
+    MFTSnapshotWriter() = default;
+
+    HRESULT Add(const std::shared_ptr<VolumeReader>& volReader, MFTRecord* pRecord);
+    HRESULT Add(
+        const MFTSnapshot::Record& record,
+        const std::vector<Name>& names,
+        const std::vector<MFTSnapshot::DataRun>& runs);
+
+    size_t GetRecordCount() const { return m_Records.size(); }
+
+    HRESULT Serialize(const MFTSnapshot::Key& key, std::vector<BYTE>& image) const;
+
+    // The snapshot is written next to 'strFileName' then renamed: readers never see a partial snapshot
+    HRESULT Write(const std::wstring& strFileName, const MFTSnapshot::Key& key) const;
+
+private:
+    struct Entry
+    {
+        MFTSnapshot::Record Record;
+        ULONG FirstName = 0L;
+        ULONG NameCount = 0L;
+        ULONG FirstRun = 0L;
+        ULONG RunCount = 0L;
+    };
+
+    std::vector<Entry> m_Records;
+    std::vector<ULONGLONG> m_NameParents;
+    std::vector<ULONG> m_NameOffsets;
+    std::wstring m_NameChars;
+    std::vector<MFTSnapshot::DataRun> m_Runs;
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -14,6 +14,8 @@
 
 #include "Log/Log.h"
 
+#include <emmintrin.h>
+
 using namespace Orc;
 
 inline auto IsCharLtrZero(DWORD C)
@@ -361,6 +363,165 @@ HRESULT MFTUtils::MultiSectorFixup(PFILE_RECORD_SEGMENT_HEADER pFRS, const std::
     return S_OK;
 }
 
+MFTUtils::RecordTriage MFTUtils::TriageRecord(
+    const FILE_RECORD_SEGMENT_HEADER* pFRS,
+    ULONG ulBytesPerFRS,
+    bool bFixedUp)
+{
+    const auto pBytes = reinterpret_cast<const BYTE*>(pFRS);
+    const auto read16 = [pBytes](size_t offset) {
+        USHORT value;
+        CopyMemory(&value, pBytes + offset, sizeof(value));
+        return value;
+    };
+
+    ULONG ulSignature = 0L;
+    CopyMemory(&ulSignature, pFRS->MultiSectorHeader.Signature, sizeof(ulSignature));
+    if (ulSignature != kFileSignature)
+        return RecordTriage::NoSignature;
+
+    if (ulBytesPerFRS < SEQUENCE_NUMBER_STRIDE || ulBytesPerFRS % SEQUENCE_NUMBER_STRIDE)
+        return RecordTriage::BadHeader;
+
+    // the array holds the sequence number then the saved end of each 512 bytes stride (whatever the size of the
+    // sectors of the volume), it lies in the first stride
+    const ULONG ulStrides = ulBytesPerFRS / SEQUENCE_NUMBER_STRIDE;
+    const ULONG ulArrayOffset = pFRS->MultiSectorHeader.UpdateSequenceArrayOffset;
+    const ULONG ulArrayEnd = ulArrayOffset + pFRS->MultiSectorHeader.UpdateSequenceArraySize * sizeof(USHORT);
+    if (pFRS->MultiSectorHeader.UpdateSequenceArraySize < ulStrides + 1 || ulArrayOffset % sizeof(USHORT)
+        || ulArrayOffset < sizeof(MULTI_SECTOR_HEADER) || ulArrayEnd > SEQUENCE_NUMBER_STRIDE - sizeof(USHORT))
+        return RecordTriage::BadUpdateSequence;
+
+    // each stride ends with the sequence number, unless the write of the record was torn
+    const USHORT usSequenceNumber = read16(ulArrayOffset);
+    for (ULONG i = 1; !bFixedUp && i <= ulStrides; i++)
+    {
+        if (read16(i * SEQUENCE_NUMBER_STRIDE - sizeof(USHORT)) != usSequenceNumber)
+            return RecordTriage::BadUpdateSequence;
+    }
+
+    // Reserved3 holds the bytes in use and the bytes allocated for the record
+    const ULONG ulFirstAttributeOffset = pFRS->FirstAttributeOffset;
+    const ULONG ulBytesInUse = pFRS->Reserved3[0];
+    const ULONG ulBytesAllocated = pFRS->Reserved3[1];
+    if (ulFirstAttributeOffset % 8 || ulFirstAttributeOffset < ulArrayEnd || ulBytesAllocated != ulBytesPerFRS
+        || ulBytesInUse > ulBytesPerFRS || ulBytesInUse < ulFirstAttributeOffset + sizeof(ATTRIBUTE_TYPE_CODE))
+        return RecordTriage::BadHeader;
+
+    // the type of the first attribute is checked when it is not covered by the end of a stride
+    if (ulFirstAttributeOffset + sizeof(ATTRIBUTE_TYPE_CODE) <= SEQUENCE_NUMBER_STRIDE - sizeof(USHORT))
+    {
+        ATTRIBUTE_TYPE_CODE TypeCode = $UNUSED;
+        CopyMemory(&TypeCode, pBytes + ulFirstAttributeOffset, sizeof(TypeCode));
+        if (TypeCode != $END && (TypeCode < $STANDARD_INFORMATION || TypeCode % 0x10))
+            return RecordTriage::BadHeader;
+    }
+
+    return RecordTriage::Viable;
+}
+
+HRESULT MFTUtils::MultiSectorFixupBlocks(
+    LPBYTE pBlocks,
+    size_t cbBlocks,
+    DWORD dwBlockSize,
+    ULONG ulSignature,
+    std::vector<bool>& fixedUp)
+{
+    if (pBlocks == nullptr)
+        return E_POINTER;
+
+    if (dwBlockSize < SEQUENCE_NUMBER_STRIDE || dwBlockSize % SEQUENCE_NUMBER_STRIDE)
+        return E_INVALIDARG;
+
+    // Update sequences protect each 512 bytes of a block, even on volumes with larger sectors
+    const size_t cBlocks = cbBlocks / dwBlockSize;
+    const DWORD dwStrides = dwBlockSize / SEQUENCE_NUMBER_STRIDE;
+    const size_t cTails = cBlocks * dwStrides;
+
+    fixedUp.assign(cBlocks, false);
+
+    // Gather the end of each stride and the sequence number expected there. A block whose header cannot be fixed up
+    // expects the complement of its stride ends: it never matches
+    std::vector<USHORT> tails(cTails);
+    std::vector<USHORT> expected(cTails);
+
+    for (size_t i = 0; i < cBlocks; i++)
+    {
+        const auto pHeader = reinterpret_cast<PMULTI_SECTOR_HEADER>(pBlocks + i * dwBlockSize);
+        const auto pTails = tails.data() + i * dwStrides;
+
+        for (DWORD j = 0; j < dwStrides; j++)
+        {
+            pTails[j] =
+                *reinterpret_cast<const USHORT*>((LPBYTE)pHeader + (j + 1) * SEQUENCE_NUMBER_STRIDE - sizeof(USHORT));
+        }
+
+        ULONG ulBlockSignature = 0L;
+        CopyMemory(&ulBlockSignature, pHeader->Signature, sizeof(ulBlockSignature));
+
+        const ULONG ulArrayOffset = pHeader->UpdateSequenceArrayOffset;
+        const ULONG ulArrayEnd = ulArrayOffset + pHeader->UpdateSequenceArraySize * sizeof(USHORT);
+        const bool bValidHeader = ulBlockSignature == ulSignature && pHeader->UpdateSequenceArraySize >= dwStrides + 1
+            && ulArrayOffset % sizeof(USHORT) == 0 && ulArrayOffset >= sizeof(MULTI_SECTOR_HEADER)
+            && ulArrayEnd <= SEQUENCE_NUMBER_STRIDE - sizeof(USHORT);
+
+        const USHORT usSequenceNumber =
+            bValidHeader ? *reinterpret_cast<const USHORT*>((LPBYTE)pHeader + ulArrayOffset) : 0;
+        for (DWORD j = 0; j < dwStrides; j++)
+            expected[i * dwStrides + j] = bValidHeader ? usSequenceNumber : static_cast<USHORT>(~pTails[j]);
+
+        fixedUp[i] = bValidHeader;
+    }
+
+    // Compare eight stride ends at once, a mismatching one invalidates its block
+    size_t k = 0;
+    for (; k + 8 <= cTails; k += 8)
+    {
+        const __m128i xmmTails = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tails.data() + k));
+        const __m128i xmmExpected = _mm_loadu_si128(reinterpret_cast<const __m128i*>(expected.data() + k));
+        const int iMask = _mm_movemask_epi8(_mm_cmpeq_epi16(xmmTails, xmmExpected));
+        if (iMask == 0xFFFF)
+            continue;
+
+        for (size_t lane = 0; lane < 8; lane++)
+        {
+            if (((iMask >> (lane * 2)) & 0x3) != 0x3)
+                fixedUp[(k + lane) / dwStrides] = false;
+        }
+    }
+    for (; k < cTails; k++)
+    {
+        if (tails[k] != expected[k])
+            fixedUp[k / dwStrides] = false;
+    }
+
+    for (size_t i = 0; i < cBlocks; i++)
+    {
+        const auto pHeader = reinterpret_cast<PMULTI_SECTOR_HEADER>(pBlocks + i * dwBlockSize);
+
+        if (!fixedUp[i])
+        {
+            // Cold path: only blocks with the expected signature are worth a diagnostic
+            if (!memcmp(pHeader->Signature, &ulSignature, sizeof(ulSignature)))
+            {
+                Log::Debug(
+                    L"Skipping block {}: update sequence array (offset: {}, size: {}) is invalid or does not match "
+                    L"the end of its strides",
+                    i,
+                    pHeader->UpdateSequenceArrayOffset,
+                    pHeader->UpdateSequenceArraySize);
+            }
+            continue;
+        }
+
+        const auto fixupArray = (const WORD*)((LPBYTE)pHeader + pHeader->UpdateSequenceArrayOffset) + 1;
+        for (DWORD j = 0; j < dwStrides; j++)
+            *(WORD*)((LPBYTE)pHeader + (j + 1) * SEQUENCE_NUMBER_STRIDE - sizeof(USHORT)) = fixupArray[j];
+    }
+
+    return S_OK;
+}
+
 HRESULT MFTUtils::MultiSectorFixup(
     PINDEX_ALLOCATION_BUFFER pFRS,
     DWORD dwSizeOfIndex,
@@ -24,10 +24,16 @@ namespace Orc {
 
 class VolumeReader;
 
+// MFT records are read (and fixed up) by chunks of this many records
+constexpr auto DEFAULT_FRS_PER_READ = 64;
+
 class ORCLIB_API MFTUtils
 {
 
 public:
+    static constexpr ULONG kFileSignature = 0x454C4946;  // "FILE"
+    static constexpr ULONG kIndexSignature = 0x58444E49;  // "INDX"
+
     class DataSegment
     {
     public:
@@ -89,6 +95,7 @@ public:
     typedef ULONG UnSafeMFTSegmentNumber;
     typedef ULONGLONG SafeMFTSegmentNumber;
 
+    // Records are handed with their update sequence fixups applied
     typedef std::function<HRESULT(SafeMFTSegmentNumber& ulRecordIndex, CBinaryBuffer& Data)> EnumMFTRecordCall;
 
     static HRESULT GetAttributeNRExtents(
@@ -103,6 +110,33 @@ public:
         std::vector<DataSegment>& ListOfSegments,
         ULONGLONG ullBlockSize = DEFAULT_READ_SIZE);
     static HRESULT MultiSectorFixup(PFILE_RECORD_SEGMENT_HEADER pFRS, const std::shared_ptr<VolumeReader>& pVolReader);
+
+    enum class RecordTriage
+    {
+        Viable,
+        NoSignature,
+        BadUpdateSequence,
+        BadHeader
+    };
+
+    // Cheap checks of a record before its parsing: signature, update sequence array and header offsets. The end of
+    // each 512 bytes stride is only checked against the sequence number when the record is not 'bFixedUp' yet.
+    // The record is not modified and nothing is logged.
+    static RecordTriage TriageRecord(
+        const FILE_RECORD_SEGMENT_HEADER* pFRS,
+        ULONG ulBytesPerFRS,
+        bool bFixedUp = false);
+
+    // Applies in place the update sequence fixups of the 'dwBlockSize' blocks (records or index blocks with the
+    // 'ulSignature' signature) of a whole chunk. 'fixedUp[i]' tells if block i was fixed up: blocks with another
+    // signature, an invalid update sequence array or a torn write are left untouched.
+    static HRESULT MultiSectorFixupBlocks(
+        LPBYTE pBlocks,
+        size_t cbBlocks,
+        DWORD dwBlockSize,
+        ULONG ulSignature,
+        std::vector<bool>& fixedUp);
+
     static HRESULT MultiSectorFixup(
         PINDEX_ALLOCATION_BUFFER pFRS,
         DWORD dwSizeOfIndex,
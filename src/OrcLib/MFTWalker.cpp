@@ -21,6 +21,8 @@
 
 #include <boost/scope_exit.hpp>
 
+#include <ppl.h>
+
 #include "Log/Log.h"
 
 using namespace std;
@@ -116,49 +118,6 @@ HRESULT MFTWalker::Initialize(const shared_ptr<Location>& loc, bool bIncludeNoIn
     return S_OK;
 }
 
-HRESULT MFTWalker::ExtendNameBuffer(WCHAR** pCurrent)
-{
-    WCHAR* pNewBuf = NULL;
-
-    pNewBuf = (WCHAR*)HeapAlloc(GetProcessHeap(), 0L, m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength());
-    if (!pNewBuf)
-        return E_OUTOFMEMORY;
-
-    if (m_pFullNameBuffer)
-    {
-#ifdef DEBUG
-        wmemset(pNewBuf, L'#', (m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength()) / sizeof(WCHAR));
-        pNewBuf[(m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength()) / sizeof(WCHAR) - 1] = 0;
-#endif
-        memcpy_s(
-            pNewBuf + (m_pVolReader->MaxComponentLength() / sizeof(WCHAR)) - 1,
-            m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength(),
-            m_pFullNameBuffer,
-            m_dwFullNameBufferLen);
-    }
-
-    if (pCurrent)
-    {
-        DWORD dwIndex = (DWORD)(*pCurrent - m_pFullNameBuffer);
-
-        *pCurrent = pNewBuf + (m_pVolReader->MaxComponentLength() / sizeof(WCHAR)) - 1;
-        *pCurrent += dwIndex;
-        if (*pCurrent >= (pNewBuf + (m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength()) / sizeof(WCHAR)))
-        {
-            HeapFree(GetProcessHeap(), 0L, pNewBuf);
-            return E_FAIL;
-        }
-    }
-
-    if (m_pFullNameBuffer)
-        HeapFree(GetProcessHeap(), 0L, m_pFullNameBuffer);
-
-    m_pFullNameBuffer = pNewBuf;
-    m_dwFullNameBufferLen += m_pVolReader->MaxComponentLength();
-
-    return S_OK;
-}
-
 HRESULT MFTWalker::UpdateAttributeList(MFTRecord* pRecord)
 {
     HRESULT hr = E_FAIL;
@@ -278,306 +237,186 @@ bool MFTWalker::IsInLocation(PFILE_NAME pFileName)
     }
 }
 
-const WCHAR* MFTWalker::GetFullNameAndIfInLocation(
-    PFILE_NAME pFileName,
-    const std::shared_ptr<DataAttribute>& pDataAttr,
-    DWORD* pdwLen,
-    bool* pbInSpecificLocation)
+std::wstring_view MFTWalker::GetDirectoryPath(MFTUtils::SafeMFTSegmentNumber ullDirectory, bool& bResolved)
 {
-    WCHAR* pCurrent = NULL;
+    // Walking up to the root or to a directory already resolved
+    m_PathChain.clear();
 
-    if (m_Locations.empty() && pbInSpecificLocation != nullptr)
-        *pbInSpecificLocation = true;
-
-    if (m_pFullNameBuffer == NULL)
+    std::optional<DirectoryPath> prefix;
+    MFTUtils::SafeMFTSegmentNumber ullCurrent = ullDirectory;
+    while (!prefix)
     {
-        m_dwFullNameBufferLen = msl::utilities::SafeInt(m_pVolReader->MaxComponentLength()) * 2;
-        m_pFullNameBuffer = (WCHAR*)HeapAlloc(GetProcessHeap(), 0L, m_dwFullNameBufferLen);
-        if (!m_pFullNameBuffer)
-            return NULL;
-    }
-#ifdef DEBUG
-    wmemset(m_pFullNameBuffer, L'_', m_dwFullNameBufferLen / sizeof(WCHAR));
-    m_pFullNameBuffer[(m_pVolReader->MaxComponentLength() / sizeof(WCHAR)) - 1] = 0;
-#endif
+        if (ullCurrent == m_pMFT->GetUSNRoot())
+        {
+            prefix = DirectoryPath {0, 0};
+            break;
+        }
 
-    DWORD dwCount = 0;
-    DWORD dwBaseNameCount = 0;
+        if (const auto cached = m_DirectoryPaths.find(ullCurrent); cached != end(m_DirectoryPaths))
+        {
+            prefix = cached->second;
+            break;
+        }
 
-    // Doing trailing \0
-    if (dwCount > m_dwFullNameBufferLen)
-    {
-        if (FAILED(ExtendNameBuffer(&pCurrent)))
-            return NULL;
-    }
-    _ASSERT(dwCount < m_dwFullNameBufferLen);
-    {
-        dwCount += sizeof(WCHAR);
+        // a cycle in the parents cannot be resolved
+        const auto directory = m_DirectoryNames.find(ullCurrent);
+        if (directory == end(m_DirectoryNames) || m_PathChain.size() > m_DirectoryNames.size())
+            break;
 
-        if (dwCount > m_dwFullNameBufferLen)
+        const PFILE_NAME pFileName = directory->second.FileName();
+        if (pFileName == nullptr)
         {
-            if (FAILED(ExtendNameBuffer(&pCurrent)))
-                return NULL;
+            Log::Debug("Could not determine main parent file name for directory {}", ullCurrent);
+            break;
         }
-        _ASSERT(dwCount <= m_dwFullNameBufferLen);
 
-        pCurrent = m_pFullNameBuffer + (m_dwFullNameBufferLen / sizeof(WCHAR)) - 1;
-        _ASSERT(pCurrent >= m_pFullNameBuffer);
-        *pCurrent = 0;
+        m_PathChain.emplace_back(ullCurrent, pFileName);
+        ullCurrent = NtfsFullSegmentNumber(&(pFileName->ParentDirectory));
     }
 
-    // Doing Stream name
-    if (pDataAttr != NULL)
+    const auto isDot = [](const PFILE_NAME pFileName) {
+        return pFileName->FileNameLength == 1 && *pFileName->FileName == L'.';
+    };
+
+    bResolved = prefix.has_value();
+    if (!bResolved)
     {
-        PATTRIBUTE_RECORD_HEADER pHeader = pDataAttr->Header();
+        // Parent folder was _not_ found, inserting "place holder"
+        m_UnresolvedPath = fmt::format(L"\\__{:016X}__", ullCurrent);
+        for (auto it = rbegin(m_PathChain); it != rend(m_PathChain); ++it)
+        {
+            if (isDot(it->second))
+                continue;
 
-        if (pHeader->NameLength)
+            m_UnresolvedPath.push_back(L'\\');
+            m_UnresolvedPath.append(it->second->FileName, it->second->FileNameLength);
+        }
+        return m_UnresolvedPath;
+    }
+
+    // Walking down, each directory's path is its parent's followed by its name
+    for (auto it = rbegin(m_PathChain); it != rend(m_PathChain); ++it)
+    {
+        const PFILE_NAME pFileName = it->second;
+
+        DirectoryPath path = *prefix;
+        if (!isDot(pFileName))
         {
-            // Stream has a name, we have to add it
+            const size_t cchPath = prefix->Length + 1 + pFileName->FileNameLength;
+            if (m_DirectoryPathArena.capacity() - m_DirectoryPathArena.size() < cchPath)
             {
-                dwCount += pHeader->NameLength * sizeof(WCHAR);
-                dwBaseNameCount += pHeader->NameLength;
+                m_DirectoryPathArena.reserve(
+                    std::max(m_DirectoryPathArena.size() + cchPath, m_DirectoryPathArena.capacity() * 2));
+            }
 
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
+            // the arena is not reallocated while the prefix is copied
+            path = {m_DirectoryPathArena.size(), cchPath};
+            m_DirectoryPathArena.append(m_DirectoryPathArena.data() + prefix->Offset, prefix->Length);
+            m_DirectoryPathArena.push_back(L'\\');
+            m_DirectoryPathArena.append(pFileName->FileName, pFileName->FileNameLength);
+        }
 
-                pCurrent -= pHeader->NameLength;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
+        m_DirectoryPaths.emplace(it->first, path);
+        prefix = path;
+    }
 
-                memcpy_s(
-                    pCurrent, dwCount, ((BYTE*)pHeader) + pHeader->NameOffset, pHeader->NameLength * sizeof(WCHAR));
-            }
+    return std::wstring_view(m_DirectoryPathArena).substr(prefix->Offset, prefix->Length);
+}
 
-            // adding colon
-            {
-                dwCount += 1 * sizeof(WCHAR);
-                dwBaseNameCount += 1;
+void MFTWalker::ResolveDirectoryPaths()
+{
+    m_DirectoryPaths.reserve(m_DirectoryNames.size());
 
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
+    bool bResolved = false;
+    for (const auto& [ullDirectory, fileName] : m_DirectoryNames)
+        GetDirectoryPath(ullDirectory, bResolved);
 
-                pCurrent -= 1;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
+    Log::Debug(
+        "Resolved {} directory paths out of {} ({} characters)",
+        m_DirectoryPaths.size(),
+        m_DirectoryNames.size(),
+        m_DirectoryPathArena.size());
+}
 
-                *pCurrent = L':';
-            }
-        }
-    }
+const WCHAR* MFTWalker::GetFullNameAndIfInLocation(
+    PFILE_NAME pFileName,
+    const std::shared_ptr<DataAttribute>& pDataAttr,
+    DWORD* pdwLen,
+    bool* pbInSpecificLocation)
+{
+    if (m_Locations.empty() && pbInSpecificLocation != nullptr)
+        *pbInSpecificLocation = true;
 
-    // Doing base file name
-    PFILE_NAME pCurFileName = pFileName;
-    if (pCurFileName != nullptr)
+    m_FullName.clear();
+
+    bool bResolved = false;
+    auto pDirectParent = end(m_DirectoryNames);
+
+    // Doing parent path and base file name
+    if (pFileName != nullptr)
     {
-        dwCount += pCurFileName->FileNameLength * sizeof(WCHAR);
-        dwBaseNameCount += pCurFileName->FileNameLength;
+        const MFTUtils::SafeMFTSegmentNumber ullParent = NtfsFullSegmentNumber(&(pFileName->ParentDirectory));
 
-        if (dwCount > m_dwFullNameBufferLen)
-        {
-            if (FAILED(ExtendNameBuffer(&pCurrent)))
-                return NULL;
-        }
-        _ASSERT(dwCount <= m_dwFullNameBufferLen);
+        m_FullName.append(GetDirectoryPath(ullParent, bResolved));
+        m_FullName.push_back(L'\\');
+        m_FullName.append(pFileName->FileName, pFileName->FileNameLength);
 
-        pCurrent -= pCurFileName->FileNameLength;
-        _ASSERT(pCurrent >= m_pFullNameBuffer);
-        memcpy_s(pCurrent, dwCount, pCurFileName->FileName, pCurFileName->FileNameLength * sizeof(WCHAR));
+        pDirectParent = m_DirectoryNames.find(ullParent);
     }
     else
     {
-        const WCHAR szNullFileName[] = L"<NoName>";
-        const DWORD dwNullFileName = (DWORD)wcslen(szNullFileName);
-
-        dwCount += dwNullFileName * sizeof(WCHAR);
-        dwBaseNameCount += dwNullFileName;
-
-        if (dwCount > m_dwFullNameBufferLen)
-        {
-            if (FAILED(ExtendNameBuffer(&pCurrent)))
-                return NULL;
-        }
-        _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-        pCurrent -= dwNullFileName;
-        _ASSERT(pCurrent >= m_pFullNameBuffer);
-        memcpy_s(pCurrent, dwCount, szNullFileName, dwNullFileName * sizeof(WCHAR));
+        m_FullName.append(L"<NoName>");
 
         // Entries with lost parents are
         if (pbInSpecificLocation != nullptr)
             *pbInSpecificLocation = m_Locations.empty() ? true : false;
-
-        if (pdwLen)
-            *pdwLen = dwCount;
-        return pCurrent;
     }
 
-    MFTUtils::SafeMFTSegmentNumber ulLastSegmentNumber = NtfsFullSegmentNumber(&(pCurFileName->ParentDirectory));
-
-    auto pParentPair = m_DirectoryNames.find(NtfsFullSegmentNumber(&(pCurFileName->ParentDirectory)));
-    auto pDirectParent = pParentPair;
-
-    while (pParentPair != end(m_DirectoryNames))
+    // Doing Stream name
+    if (pDataAttr != NULL)
     {
-        PFILE_NAME pParentName = pParentPair->second.FileName();
-
-        if (pParentName == NULL)
-        {
-            std::wstring_view fileName(pCurFileName->FileName, pCurFileName->FileNameLength);
-            Log::Debug(L"Could not determine main parent file name for '{}'", fileName);
-            break;
-        }
+        PATTRIBUTE_RECORD_HEADER pHeader = pDataAttr->Header();
 
-        if (!(pParentName->FileNameLength == 1 && *pParentName->FileName == L'.'))
+        if (pHeader->NameLength)
         {
-            // Adding \\ (i.e. one backslash)
-            {
-                dwCount += sizeof(WCHAR);
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-                pCurrent--;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
-
-                *pCurrent = L'\\';
-            }
-
-            // Adding parent file name
-            {
-                dwCount += pParentName->FileNameLength * sizeof(WCHAR);
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-                pCurrent -= pParentName->FileNameLength;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
-
-                memcpy_s(pCurrent, dwCount, pParentName->FileName, pParentName->FileNameLength * sizeof(WCHAR));
-            }
+            // Stream has a name, we have to add it
+            m_FullName.push_back(L':');
+            m_FullName.append((WCHAR*)(((BYTE*)pHeader) + pHeader->NameOffset), pHeader->NameLength);
         }
-        ulLastSegmentNumber = NtfsFullSegmentNumber(&(pParentName->ParentDirectory));
-        pParentPair = m_DirectoryNames.find(NtfsFullSegmentNumber(&(pParentName->ParentDirectory)));
-
-        if (ulLastSegmentNumber == m_pMFT->GetUSNRoot())
-            break;
     }
 
-    if (ulLastSegmentNumber == m_pMFT->GetUSNRoot())
+    if (bResolved && pDirectParent != end(m_DirectoryNames))
     {
-        // Adding \\ (i.e. one backslash)
+        // Looking for presence in specific locations
+        if (!m_Locations.empty() && boost::logic::indeterminate(pDirectParent->second.m_InLocation))
         {
-            dwCount += sizeof(WCHAR);
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent--;
-            _ASSERT(pCurrent >= m_pFullNameBuffer);
-
-            *pCurrent = L'\\';
+            pDirectParent->second.m_InLocation =
+                std::any_of(begin(m_Locations), end(m_Locations), [this](const wstring& item) {
+                    return !_wcsnicmp(m_FullName.c_str(), item.c_str(), item.size());
+                });
         }
-
-        if (pDirectParent != end(m_DirectoryNames))
+        if (pbInSpecificLocation != nullptr)
         {
-            // Looking for presence in specific locations
-            if (!m_Locations.empty() && boost::logic::indeterminate(pDirectParent->second.m_InLocation))
-            {
-                pDirectParent->second.m_InLocation = std::any_of(
-                    begin(m_Locations), end(m_Locations), [pCurrent, pbInSpecificLocation](const wstring& item) {
-                        return !_wcsnicmp(pCurrent, item.c_str(), item.size());
-                    });
-            }
-            if (pbInSpecificLocation != nullptr)
+            if (m_Locations.empty())
+                *pbInSpecificLocation = true;
+            else
             {
-                if (m_Locations.empty())
+                if (pDirectParent->second.m_InLocation)
                     *pbInSpecificLocation = true;
+                else if (!pDirectParent->second.m_InLocation)
+                    *pbInSpecificLocation = false;
                 else
                 {
-                    if (pDirectParent->second.m_InLocation)
-                        *pbInSpecificLocation = true;
-                    else if (!pDirectParent->second.m_InLocation)
-                        *pbInSpecificLocation = false;
-                    else
-                    {
-                        Log::Error(L"Failed to determine if in location for '{}'", pCurrent);
-                        *pbInSpecificLocation = false;
-                    }
+                    Log::Error(L"Failed to determine if in location for '{}'", m_FullName);
+                    *pbInSpecificLocation = false;
                 }
             }
         }
-
-        // And we're done :-)
-        if (pdwLen)
-            *pdwLen = dwCount;
-        return pCurrent;
     }
-    else
-    {
-        // Parent folder was _not_ found, inserting "place holder"
-        // Adding \\ (i.e. one backslash)
 
-        {
-            dwCount += sizeof(WCHAR);
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent--;
-            _ASSERT(pCurrent >= m_pFullNameBuffer);
-            *pCurrent = L'\\';
-        }
-
-        {
-            dwCount += sizeof(WCHAR) * 20;
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent -= 20;
-            swprintf_s(pCurrent, 21, L"__%.16I64X__", ulLastSegmentNumber);
-            pCurrent[20] = L'\\';
-        }
-
-        {
-            dwCount += sizeof(WCHAR);
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent--;
-            _ASSERT(pCurrent >= m_pFullNameBuffer);
-            *pCurrent = L'\\';
-        }
-
-        if (pdwLen)
-            *pdwLen = dwCount;
-        return pCurrent;
-    }
+    if (pdwLen)
+        *pdwLen = static_cast<DWORD>((m_FullName.size() + 1) * sizeof(WCHAR));
+    return m_FullName.c_str();
 }
 
 bool MFTWalker::AreAttributesComplete(const MFTRecord* pBaseRecord, std::vector<MFT_SEGMENT_REFERENCE>& missingRecords)
@@ -813,108 +652,280 @@ HRESULT MFTWalker::ParseI30AndCallback(MFTRecord* pRecord)
         }
     }
 
-    if (pIA != nullptr && m_Callbacks.I30Callback != nullptr)
+    // $INDEX_ALLOCATION is read later, in disk order with the one of other directories
+    if (pIA != nullptr && pIR != nullptr && m_Callbacks.I30Callback != nullptr)
     {
-        ULONGLONG ToRead = 0ULL;
-        if (FAILED(hr = pIA->DataSize(m_pVolReader, ToRead)))
+        if (FAILED(hr = AddPendingI30(pRecord, pIR, pIA, pBM)))
         {
-            Log::Error(L"Failed to determine $INDEX_ALLOCATION size");
+            Log::Error(L"Failed to add $INDEX_ALLOCATION [{}]", SystemError(hr));
             return hr;
         }
+    }
+    return S_OK;
+}
 
-        UINT i = 0L;
+HRESULT MFTWalker::AddPendingI30(
+    MFTRecord* pRecord,
+    const std::shared_ptr<IndexRootAttribute>& pIR,
+    const std::shared_ptr<IndexAllocationAttribute>& pIA,
+    const std::shared_ptr<BitmapAttribute>& pBM)
+{
+    HRESULT hr = E_FAIL;
 
-        if (FAILED(
-                hr = pRecord->EnumData(
-                    m_pVolReader,
-                    pIA,
-                    0ULL,
-                    ToRead,
-                    pIR->SizePerIndex(),
-                    [this, pBM, pIR, &hr, pRecord, &i](ULONGLONG ullBufferStartOffset, CBinaryBuffer& Data) -> HRESULT {
-                        DBG_UNREFERENCED_PARAMETER(ullBufferStartOffset);
-                        PINDEX_ALLOCATION_BUFFER pIABuff = (PINDEX_ALLOCATION_BUFFER)Data.GetData();
+    PendingI30 pending;
+    pending.m_ullDirectory = pRecord->GetSafeMFTSegmentNumber();
+    pending.m_dwSizePerIndex = pIR->SizePerIndex();
 
-                        if ((*pBM)[i])
-                        {
-                            if (FAILED(hr = MFTUtils::MultiSectorFixup(pIABuff, pIR->SizePerIndex(), m_pVolReader)))
-                            {
-                                if (HRESULT_FROM_NT(NTE_BAD_SIGNATURE) != hr)
-                                {
-                                    Log::Error(L"Failed to fixup $INDEX_ALLOCATION header");
-                                    return hr;
-                                }
-                            }
-                            else
-                            {
-                                PINDEX_HEADER pHeader = &(pIABuff->IndexHeader);
-                                PINDEX_ENTRY pEntry = (PINDEX_ENTRY)NtfsFirstIndexEntry(pHeader);
-                                while (!(pEntry->Flags & INDEX_ENTRY_END))
-                                {
-                                    PFILE_NAME pFileName = (PFILE_NAME)((PBYTE)pEntry + sizeof(INDEX_ENTRY));
+    if (FAILED(hr = pIA->DataSize(m_pVolReader, pending.m_ullDataSize)))
+    {
+        Log::Error(L"Failed to determine $INDEX_ALLOCATION size");
+        return hr;
+    }
 
-                                    m_Callbacks.I30Callback(m_pVolReader, pRecord, pEntry, pFileName, false);
+    if (pending.m_dwSizePerIndex == 0 || pending.m_ullDataSize < pending.m_dwSizePerIndex)
+        return S_OK;
 
-                                    pEntry = NtfsNextIndexEntry(pEntry);
-                                }
+    MFTUtils::NonResidentDataAttrInfo* pInfo = pIA->GetNonResidentInformation(m_pVolReader);
+    if (pInfo == nullptr)
+    {
+        Log::Error(L"Failed to get $INDEX_ALLOCATION extents (FRN: {:#x})", pending.m_ullDirectory);
+        return E_FAIL;
+    }
 
-                                LPBYTE pFirstFreeByte =
-                                    (((LPBYTE)NtfsFirstIndexEntry(pHeader)) + pHeader->FirstFreeByte);
+    if (FAILED(hr = MFTUtils::GetDataSegments(*pInfo, pending.m_Segments)))
+    {
+        Log::Error(L"Failed to get $INDEX_ALLOCATION segments (FRN: {:#x})", pending.m_ullDirectory);
+        return hr;
+    }
 
-                                while (pFirstFreeByte + sizeof(FILE_NAME) < Data.GetData() + Data.GetCount())
-                                {
-                                    PFILE_NAME pCarvedFileName = (PFILE_NAME)pFirstFreeByte;
+    if (pBM != nullptr)
+        pending.m_InUse = pBM->Bits();
 
-                                    if (NtfsFullSegmentNumber(&pCarvedFileName->ParentDirectory)
-                                        == pRecord->GetSafeMFTSegmentNumber())
-                                    {
-                                        PINDEX_ENTRY pEntry =
-                                            (PINDEX_ENTRY)((LPBYTE)pCarvedFileName - sizeof(INDEX_ENTRY));
-                                        m_Callbacks.I30Callback(m_pVolReader, pRecord, pEntry, pCarvedFileName, true);
-                                    }
-                                    pFirstFreeByte++;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            Log::Debug(
-                                L"Index {} of $INDEX_ALLOCATION is not in use (FRN: {:#x}) only carving...",
-                                i,
-                                NtfsFullSegmentNumber(&pRecord->GetFileReferenceNumber()));
+    m_ullPendingI30Size += pending.m_ullDataSize;
+    m_PendingI30.push_back(std::move(pending));
 
-                            if (FAILED(hr = MFTUtils::MultiSectorFixup(pIABuff, pIR->SizePerIndex(), m_pVolReader)))
-                            {
-                                Log::Debug(L"Failed to fixup carved $INDEX_ALLOCATION [{}]", SystemError(hr));
-                                return S_OK;
-                            }
-                            else
-                            {
-                                LPBYTE pFirstFreeByte = (LPBYTE)pIABuff;
+    if (m_ullPendingI30Size >= kMaxPendingI30Size)
+        return ParsePendingI30AndCallback();
 
-                                while (pFirstFreeByte + sizeof(FILE_NAME) < Data.GetData() + Data.GetCount())
-                                {
-                                    PFILE_NAME pCarvedFileName = (PFILE_NAME)pFirstFreeByte;
+    return S_OK;
+}
 
-                                    if (NtfsFullSegmentNumber(&pCarvedFileName->ParentDirectory)
-                                        == pRecord->GetSafeMFTSegmentNumber())
-                                    {
-                                        PINDEX_ENTRY pEntry =
-                                            (PINDEX_ENTRY)((LPBYTE)pCarvedFileName - sizeof(INDEX_ENTRY));
-                                        m_Callbacks.I30Callback(m_pVolReader, pRecord, pEntry, pCarvedFileName, true);
-                                    }
-                                    pFirstFreeByte++;
-                                }
-                            }
-                        }
-                        i++;
-                        return S_OK;
-                    })))
+HRESULT MFTWalker::ReadPendingI30(std::vector<PendingI30>& pending)
+{
+    HRESULT hr = E_FAIL;
+
+    struct IndexRead
+    {
+        PendingI30* m_Directory;
+        ULONGLONG m_ullDiskOffset;
+        ULONGLONG m_ullFileOffset;
+        ULONGLONG m_ullLength;
+    };
+
+    std::vector<IndexRead> reads;
+    for (auto& directory : pending)
+    {
+        // entries carved at the start of the buffer are preceded by their INDEX_ENTRY header
+        directory.m_Data.assign(sizeof(INDEX_ENTRY) + static_cast<size_t>(directory.m_ullDataSize), 0);
+
+        for (const auto& segment : directory.m_Segments)
         {
-            Log::Error(L"Failed to read from $INDEX_ALLOCATION [{}]", SystemError(hr));
-            return hr;
+            if (segment.bUnallocated || !segment.bValidData || segment.ullFileBasedOffset >= directory.m_ullDataSize)
+                continue;
+
+            const auto ullLength = std::min(segment.ullSize, directory.m_ullDataSize - segment.ullFileBasedOffset);
+            if (ullLength > 0)
+                reads.push_back({&directory, segment.ullDiskBasedOffset, segment.ullFileBasedOffset, ullLength});
         }
     }
+
+    std::sort(std::begin(reads), std::end(reads), [](const IndexRead& left, const IndexRead& right) {
+        return left.m_ullDiskOffset < right.m_ullDiskOffset;
+    });
+
+    CBinaryBuffer buffer;
+    ULONGLONG ullReads = 0LL;
+    ULONGLONG ullBytesRead = 0LL;
+
+    auto first = std::cbegin(reads);
+    while (first != std::cend(reads))
+    {
+        // read neighbour extents at once
+        const ULONGLONG ullStart = first->m_ullDiskOffset;
+        ULONGLONG ullEnd = ullStart + first->m_ullLength;
+
+        auto last = first + 1;
+        while (last != std::cend(reads) && last->m_ullDiskOffset <= ullEnd + kI30MaxReadGap
+               && std::max(ullEnd, last->m_ullDiskOffset + last->m_ullLength) - ullStart <= kI30ReadAheadSize)
+        {
+            ullEnd = std::max(ullEnd, last->m_ullDiskOffset + last->m_ullLength);
+            ++last;
+        }
+
+        if (!buffer.SetCount(static_cast<size_t>(ullEnd - ullStart)))
+            return E_OUTOFMEMORY;
+
+        ULONGLONG ullDone = 0LL;
+        while (ullDone < buffer.GetCount())
+        {
+            CBinaryBuffer view(buffer.GetData() + ullDone, static_cast<size_t>(buffer.GetCount() - ullDone));
+
+            ULONGLONG ullThisRead = 0LL;
+            if (FAILED(hr = m_pVolReader->Read(ullStart + ullDone, view, view.GetCount(), ullThisRead)))
+            {
+                Log::Error(
+                    L"Failed to read $INDEX_ALLOCATION at offset {:#x} [{}]", ullStart + ullDone, SystemError(hr));
+                break;
+            }
+
+            ullReads++;
+            if (ullThisRead == 0LL)
+                break;
+            ullDone += ullThisRead;
+        }
+        ullBytesRead += ullDone;
+
+        // what could not be read is left zeroed, and fails fixups
+        for (; first != last; ++first)
+        {
+            const ULONGLONG ullOffset = first->m_ullDiskOffset - ullStart;
+            if (ullOffset >= ullDone)
+                continue;
+
+            CopyMemory(
+                first->m_Directory->m_Data.data() + sizeof(INDEX_ENTRY) + first->m_ullFileOffset,
+                buffer.GetData() + ullOffset,
+                static_cast<size_t>(std::min(first->m_ullLength, ullDone - ullOffset)));
+        }
+    }
+
+    Log::Debug(
+        L"Read $INDEX_ALLOCATION of {} directories: {} extents, {} reads, {} bytes",
+        pending.size(),
+        reads.size(),
+        ullReads,
+        ullBytesRead);
+    return S_OK;
+}
+
+void MFTWalker::ParseI30Block(
+    const std::shared_ptr<VolumeReader>& pVolReader,
+    MFTUtils::SafeMFTSegmentNumber ullDirectory,
+    std::vector<BYTE>& data,
+    DWORD dwSizePerIndex,
+    DWORD dwIndex,
+    bool bInUse,
+    std::vector<I30Entry>& entries)
+{
+    HRESULT hr = E_FAIL;
+
+    // the fixup is applied in place, blocks do not overlap
+    const LPBYTE pBlock = data.data() + sizeof(INDEX_ENTRY) + static_cast<size_t>(dwIndex) * dwSizePerIndex;
+    const LPBYTE pBlockEnd = pBlock + dwSizePerIndex;
+    PINDEX_ALLOCATION_BUFFER pIABuff = (PINDEX_ALLOCATION_BUFFER)pBlock;
+
+    const auto carve = [ullDirectory, &entries, pBlockEnd](LPBYTE pFirstFreeByte) {
+        while (pFirstFreeByte + sizeof(FILE_NAME) < pBlockEnd)
+        {
+            PFILE_NAME pCarvedFileName = (PFILE_NAME)pFirstFreeByte;
+
+            if (NtfsFullSegmentNumber(&pCarvedFileName->ParentDirectory) == ullDirectory)
+            {
+                PINDEX_ENTRY pEntry = (PINDEX_ENTRY)((LPBYTE)pCarvedFileName - sizeof(INDEX_ENTRY));
+                entries.push_back({pEntry, pCarvedFileName, true});
+            }
+            pFirstFreeByte++;
+        }
+    };
+
+    if (bInUse)
+    {
+        if (FAILED(hr = MFTUtils::MultiSectorFixup(pIABuff, dwSizePerIndex, pVolReader)))
+        {
+            if (HRESULT_FROM_NT(NTE_BAD_SIGNATURE) != hr)
+                Log::Error(L"Failed to fixup $INDEX_ALLOCATION header (FRN: {:#x})", ullDirectory);
+            return;
+        }
+
+        PINDEX_HEADER pHeader = &(pIABuff->IndexHeader);
+        PINDEX_ENTRY pEntry = (PINDEX_ENTRY)NtfsFirstIndexEntry(pHeader);
+        while ((LPBYTE)pEntry + sizeof(INDEX_ENTRY) <= pBlockEnd && !(pEntry->Flags & INDEX_ENTRY_END))
+        {
+            PFILE_NAME pFileName = (PFILE_NAME)((PBYTE)pEntry + sizeof(INDEX_ENTRY));
+            entries.push_back({pEntry, pFileName, false});
+
+            pEntry = NtfsNextIndexEntry(pEntry);
+        }
+
+        carve(((LPBYTE)NtfsFirstIndexEntry(pHeader)) + pHeader->FirstFreeByte);
+    }
+    else
+    {
+        Log::Debug(L"Index {} of $INDEX_ALLOCATION is not in use (FRN: {:#x}) only carving...", dwIndex, ullDirectory);
+
+        if (FAILED(hr = MFTUtils::MultiSectorFixup(pIABuff, dwSizePerIndex, pVolReader)))
+        {
+            Log::Debug(L"Failed to fixup carved $INDEX_ALLOCATION [{}]", SystemError(hr));
+            return;
+        }
+
+        carve(pBlock);
+    }
+}
+
+HRESULT MFTWalker::ParsePendingI30AndCallback()
+{
+    HRESULT hr = E_FAIL;
+
+    if (m_PendingI30.empty())
+        return S_OK;
+
+    std::vector<PendingI30> pending;
+    std::swap(pending, m_PendingI30);
+    m_ullPendingI30Size = 0LL;
+
+    if (FAILED(hr = ReadPendingI30(pending)))
+    {
+        Log::Error(L"Failed to read $INDEX_ALLOCATION [{}]", SystemError(hr));
+        return hr;
+    }
+
+    struct IndexBlock
+    {
+        PendingI30* m_Directory;
+        DWORD m_dwIndex;
+    };
+
+    std::vector<IndexBlock> blocks;
+    for (auto& directory : pending)
+    {
+        const auto ullCount = directory.m_ullDataSize / directory.m_dwSizePerIndex;
+        for (ULONGLONG i = 0; i < ullCount; i++)
+            blocks.push_back({&directory, static_cast<DWORD>(i)});
+    }
+
+    // fixups and carving are done concurrently
+    std::vector<std::vector<I30Entry>> entries(blocks.size());
+    concurrency::parallel_for(size_t(0), blocks.size(), [this, &blocks, &entries](size_t i) {
+        auto& directory = *blocks[i].m_Directory;
+        const auto dwIndex = blocks[i].m_dwIndex;
+        ParseI30Block(
+            m_pVolReader,
+            directory.m_ullDirectory,
+            directory.m_Data,
+            directory.m_dwSizePerIndex,
+            dwIndex,
+            dwIndex < directory.m_InUse.size() && directory.m_InUse[dwIndex],
+            entries[i]);
+    });
+
+    // entries are delivered in the order of the directories and of their index blocks
+    for (const auto& blockEntries : entries)
+    {
+        for (const auto& entry : blockEntries)
+            m_Callbacks.I30Callback(m_pVolReader, nullptr, entry.m_pEntry, entry.m_pFileName, entry.m_bCarved);
+    }
+
     return S_OK;
 }
 
@@ -1378,6 +1389,9 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
 
         PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)Data.GetData();
 
+        if (m_bIncludeNotInUse && !(pHeader->Flags & FILE_RECORD_SEGMENT_IN_USE) && !TriageNotInUseRecord(pHeader))
+            return S_OK;
+
         if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
             || (pHeader->MultiSectorHeader.Signature[2] != 'L') || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
         {
@@ -1454,6 +1468,8 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
                 Data.GetData(),
                 m_pVolReader->GetBytesPerFRS());
 
+            // IMFT hands records already fixed up
+            pRecord->m_bIsMultiSectorFixed = true;
             pRecord->m_FileReferenceNumber = SafeReference;
         }
         else
@@ -1507,6 +1523,9 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
             {
                 Log::Trace(L"Record {} parsed", NtfsFullSegmentNumber(&pRecord->m_FileReferenceNumber));
 
+                if (!(pRecord->m_pRecord->Flags & FILE_RECORD_SEGMENT_IN_USE))
+                    m_ResurrectionStatistics.ullResurrected++;
+
                 m_MFTMap.insert(pair<MFTUtils::SafeMFTSegmentNumber, MFTRecord*>(
                     NtfsFullSegmentNumber(&pRecord->m_FileReferenceNumber), pRecord));
 
@@ -1632,6 +1651,26 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
     return S_OK;
 }
 
+bool MFTWalker::TriageNotInUseRecord(const FILE_RECORD_SEGMENT_HEADER* pHeader)
+{
+    switch (MFTUtils::TriageRecord(pHeader, m_pVolReader->GetBytesPerFRS(), true))
+    {
+        case MFTUtils::RecordTriage::Viable:
+            m_ResurrectionStatistics.ullCandidates++;
+            return true;
+        case MFTUtils::RecordTriage::NoSignature:
+            m_ResurrectionStatistics.ullNoSignature++;
+            break;
+        case MFTUtils::RecordTriage::BadUpdateSequence:
+            m_ResurrectionStatistics.ullBadUpdateSequence++;
+            break;
+        case MFTUtils::RecordTriage::BadHeader:
+            m_ResurrectionStatistics.ullBadHeader++;
+            break;
+    }
+    return false;
+}
+
 HRESULT MFTWalker::AddRecordCallback(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data)
 {
     HRESULT hr = E_FAIL;
@@ -1843,7 +1882,18 @@ HRESULT MFTWalker::Walk(const Callbacks& Callbacks)
         return hr;  // no more enumeration nor walking...
     }
 
-    return WalkRecords(true);
+    // All the directories are known: their paths are resolved at once for the records left
+    ResolveDirectoryPaths();
+
+    if (FAILED(hr = WalkRecords(true)))
+        return hr;
+
+    if (FAILED(hr = ParsePendingI30AndCallback()))
+    {
+        Log::Error(L"Failed to parse pending $I30 [{}]", SystemError(hr));
+    }
+
+    return S_OK;
 }
 
 ULONG MFTWalker::GetMFTRecordCount() const
@@ -1856,6 +1906,24 @@ ULONG MFTWalker::GetMFTRecordCount() const
     return 0;
 }
 
+MFTSnapshot::Key MFTWalker::GetSnapshotKey() const
+{
+    MFTSnapshot::Key key;
+
+    if (m_pVolReader != nullptr)
+    {
+        key.VolumeSerialNumber = m_pVolReader->VolumeSerialNumber();
+        key.BytesPerFRS = m_pVolReader->GetBytesPerFRS();
+    }
+    if (m_pMFT != nullptr)
+    {
+        key.MftSize = m_pMFT->GetMftSize();
+        key.MftLsn = m_pMFT->GetMftLsn();
+    }
+
+    return key;
+}
+
 HRESULT MFTWalker::Statistics(const WCHAR* szMsg)
 {
     HRESULT hr = E_FAIL;
@@ -1897,6 +1965,16 @@ HRESULT MFTWalker::Statistics(const WCHAR* szMsg)
             dwDeletedDirCount,
             dwDeletedNotParsedCount,
             dwDeletedIncompleteCount);
+
+        const auto& stats = m_ResurrectionStatistics;
+        Log::Debug(
+            L"Not in use records -> Rejected (no signature: {}, bad update sequence: {}, bad header: {}), "
+            L"Parsed: {}, Resurrected: {}",
+            stats.ullNoSignature,
+            stats.ullBadUpdateSequence,
+            stats.ullBadHeader,
+            stats.ullCandidates,
+            stats.ullResurrected);
     }
     Log::Trace(
         L"Total   -> Available: {}, Directories: {}, Not parsed: {}, Incomplete: {}",
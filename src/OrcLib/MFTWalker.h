@@ -17,6 +17,7 @@
 
 #include "MFTRecord.h"
 #include "MFTUtils.h"
+#include "MFTSnapshot.h"
 #include "IMFT.h"
 
 #include "CaseInsensitive.h"
@@ -57,6 +58,8 @@ public:
         MFTRecord* pElt,
         const PFILE_NAME pFileName,
         const std::shared_ptr<IndexAllocationAttribute>& pAttr)>;
+    // Entries of $INDEX_ALLOCATION are delivered after the directory record was walked, with a null pElt: the
+    // directory is pFileName->ParentDirectory
     using I30EntryCall = std::function<void(
         const std::shared_ptr<VolumeReader>& volreader,
         MFTRecord* pElt,
@@ -98,6 +101,37 @@ public:
         std::function<const WCHAR*(const PFILE_NAME pFileName, const std::shared_ptr<DataAttribute>& pDataAttr)>;
     using InLocationBuilder = std::function<bool(const PFILE_NAME pFileName)>;
 
+    // Not in use records seen when records are resurrected: most are rejected before they are parsed
+    struct ResurrectionStatistics
+    {
+        ULONGLONG ullNoSignature = 0LL;
+        ULONGLONG ullBadUpdateSequence = 0LL;
+        ULONGLONG ullBadHeader = 0LL;
+        ULONGLONG ullCandidates = 0LL;
+        ULONGLONG ullResurrected = 0LL;
+    };
+
+    // Entry of an $I30 index block, carved entries were found in the free space of the block
+    struct I30Entry
+    {
+        PINDEX_ENTRY m_pEntry;
+        PFILE_NAME m_pFileName;
+        bool m_bCarved;
+    };
+
+    // Fixes up the 'dwIndex'th block of 'dwSizePerIndex' bytes of the $INDEX_ALLOCATION 'data' of the directory
+    // 'ullDirectory' and lists its entries: those of the index when the block is in use, then those carved in its
+    // free space. 'data' starts with sizeof(INDEX_ENTRY) bytes of padding: entries carved at the start of the first
+    // block have a header too.
+    static void ParseI30Block(
+        const std::shared_ptr<VolumeReader>& pVolReader,
+        MFTUtils::SafeMFTSegmentNumber ullDirectory,
+        std::vector<BYTE>& data,
+        DWORD dwSizePerIndex,
+        DWORD dwIndex,
+        bool bInUse,
+        std::vector<I30Entry>& entries);
+
 public:
     MFTWalker()
         : m_SegmentStore(L"MFTSegmentStore")
@@ -121,7 +155,11 @@ public:
     HRESULT Walk(const Callbacks& pCallbacks);
 
     ULONG GetMFTRecordCount() const;
+
+    // Identifies the state of the walked MFT, available once initialized
+    MFTSnapshot::Key GetSnapshotKey() const;
     HRESULT Statistics(const WCHAR* szMsg);
+    const ResurrectionStatistics& GetResurrectionStatistics() const { return m_ResurrectionStatistics; }
 
     ~MFTWalker();
 
@@ -161,6 +199,9 @@ private:
     std::unordered_set<std::wstring, CaseInsensitiveUnordered> m_Locations;
 
     bool m_bIncludeNotInUse = false;
+    ResurrectionStatistics m_ResurrectionStatistics;
+
+    bool TriageNotInUseRecord(const FILE_RECORD_SEGMENT_HEADER* pHeader);
 
     ULONG m_ulMFTRecordCount = 0LU;
 
@@ -182,10 +223,27 @@ private:
 
     DWORD m_dwWalkedItems = 0L;
 
-    WCHAR* m_pFullNameBuffer = nullptr;
-    DWORD m_dwFullNameBufferLen = 0LU;
+    // Paths of the directories resolved up to the root ('\dir\subdir', empty for the root), keyed by reference number
+    // (segment and sequence numbers): the path of a directory is the path of its parent followed by its name
+    struct DirectoryPath
+    {
+        size_t Offset;
+        size_t Length;
+    };
+    std::unordered_map<MFTUtils::SafeMFTSegmentNumber, DirectoryPath> m_DirectoryPaths;
+    std::wstring m_DirectoryPathArena;
+
+    // Directories walked up while resolving a path
+    std::vector<std::pair<MFTUtils::SafeMFTSegmentNumber, PFILE_NAME>> m_PathChain;
+    std::wstring m_UnresolvedPath;
+    std::wstring m_FullName;
+
+    // Path of a directory. 'bResolved' is false when an ancestor is unknown: the path then starts with a
+    // '\__<reference number>__' placeholder and is not kept
+    std::wstring_view GetDirectoryPath(MFTUtils::SafeMFTSegmentNumber ullDirectory, bool& bResolved);
 
-    HRESULT ExtendNameBuffer(WCHAR** pCurrent);
+    // Resolves the paths of all the known directories at once, each parent before its children
+    void ResolveDirectoryPaths();
 
     HRESULT UpdateAttributeList(MFTRecord* pRecord);
 
@@ -205,6 +263,33 @@ private:
 
     HRESULT ParseI30AndCallback(MFTRecord* pRecord);
 
+    // $INDEX_ALLOCATION of a directory, read and parsed once enough of them are collected (or the walk is done)
+    struct PendingI30
+    {
+        MFTUtils::SafeMFTSegmentNumber m_ullDirectory;
+        DWORD m_dwSizePerIndex;
+        ULONGLONG m_ullDataSize;
+        boost::dynamic_bitset<size_t> m_InUse;
+        std::vector<MFTUtils::DataSegment> m_Segments;
+        std::vector<BYTE> m_Data;
+    };
+
+    static constexpr ULONGLONG kMaxPendingI30Size = 0x10000000;
+    // Index extents closer than this on disk are read at once, up to kI30ReadAheadSize bytes
+    static constexpr ULONGLONG kI30MaxReadGap = 0x10000;
+    static constexpr ULONGLONG kI30ReadAheadSize = 0x100000;
+
+    std::vector<PendingI30> m_PendingI30;
+    ULONGLONG m_ullPendingI30Size = 0LL;
+
+    HRESULT AddPendingI30(
+        MFTRecord* pRecord,
+        const std::shared_ptr<IndexRootAttribute>& pIR,
+        const std::shared_ptr<IndexAllocationAttribute>& pIA,
+        const std::shared_ptr<BitmapAttribute>& pBM);
+    HRESULT ReadPendingI30(std::vector<PendingI30>& pending);
+    HRESULT ParsePendingI30AndCallback();
+
     HRESULT Parse$SecureAndCallback(MFTRecord* pRecord);
 
     bool IsInLocation(PFILE_NAME pFileName);
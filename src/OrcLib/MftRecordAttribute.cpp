@@ -19,6 +19,7 @@
 #include "BufferStream.h"
 #include "NTFSStream.h"
 #include "UncompressNTFSStream.h"
+#include "WofDecompressStream.h"
 
 #include "SystemDetails.h"
 
@@ -261,6 +262,14 @@ HRESULT MftRecordAttribute::GetStreams(
 
     _ASSERT(m_pHeader != nullptr);
 
+    if (m_pHeader->TypeCode == $DATA && m_pHeader->NameLength == 0 && m_pHostRecord != nullptr
+        && m_pHostRecord->IsOverlayFile())
+    {
+        // Without a supported WOF compressed stream, the (sparse) $DATA attribute is used
+        if (SUCCEEDED(hr = GetOverlayStreams(pVolReader, rawStream, dataStream)))
+            return S_OK;
+    }
+
     if (m_pHeader->FormCode == NONRESIDENT_FORM)
     {
         switch (m_pHeader->Form.Nonresident.CompressionUnit)
@@ -382,6 +391,69 @@ HRESULT MftRecordAttribute::GetStreams(
     return E_FAIL;
 }
 
+HRESULT MftRecordAttribute::GetOverlayStreams(
+    const std::shared_ptr<VolumeReader>& pVolReader,
+    std::shared_ptr<ByteStream>& rawStream,
+    std::shared_ptr<ByteStream>& dataStream)
+{
+    HRESULT hr = E_FAIL;
+
+    const auto pReparse = m_pHostRecord->GetWOFReparseAttribute();
+    if (pReparse == nullptr)
+        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+
+    ULONG ulAlgorithm = 0L;
+    if (FAILED(hr = pReparse->GetFileProviderAlgorithm(ulAlgorithm)))
+        return hr;
+
+    const auto algorithm = static_cast<WofDecompressStream::Algorithm>(ulAlgorithm);
+    if (!WofDecompressStream::IsSupported(algorithm))
+    {
+        if (!m_bUnsupportedOverlayLogged)
+        {
+            Log::Warn(
+                L"Unsupported WOF compression algorithm {} for record {:#x}",
+                ulAlgorithm,
+                m_pHostRecord->GetSafeMFTSegmentNumber());
+            m_bUnsupportedOverlayLogged = true;
+        }
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    const auto pCompressedData = m_pHostRecord->GetDataAttribute(L"WofCompressedData");
+    if (pCompressedData == nullptr)
+        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+
+    const auto compressed = pCompressedData->GetDataStream(pVolReader);
+    if (compressed == nullptr)
+        return E_FAIL;
+
+    DWORDLONG ullDataSize = 0LL;
+    if (FAILED(hr = DataSize(pVolReader, ullDataSize)))
+        return hr;
+
+    auto stream = std::make_shared<WofDecompressStream>();
+    if (FAILED(hr = stream->Open(compressed, algorithm, ullDataSize)))
+    {
+        Log::Error(
+            L"Failed to open WofDecompressStream for record {:#x} [{}]",
+            m_pHostRecord->GetSafeMFTSegmentNumber(),
+            SystemError(hr));
+        return hr;
+    }
+
+    dataStream = stream;
+    rawStream = compressed;
+    if (m_Details == nullptr)
+        m_Details = std::make_unique<DataDetails>();
+    if (m_Details != nullptr)
+    {
+        m_Details->SetDataStream(dataStream);
+        m_Details->SetRawStream(rawStream);
+    }
+    return S_OK;
+}
+
 HRESULT MftRecordAttribute::CleanCachedData()
 {
     if (m_pNonResidentInfo != NULL)
@@ -660,6 +732,32 @@ HRESULT ReparsePointAttribute::Parse()
     return S_OK;
 }
 
+HRESULT WOFReparseAttribute::GetFileProviderAlgorithm(ULONG& ulAlgorithm) const
+{
+    // WOF_EXTERNAL_INFO followed by FILE_PROVIDER_EXTERNAL_INFO_V1
+    constexpr ULONG kWofProviderFile = 2;
+    constexpr USHORT kExternalInfoSize = 5 * sizeof(ULONG);
+
+    if (m_pHeader->FormCode != RESIDENT_FORM
+        || m_pHeader->Form.Resident.ValueLength < FIELD_OFFSET(REPARSE_POINT_ATTRIBUTE, Data) + kExternalInfoSize)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    PREPARSE_POINT_ATTRIBUTE pReparse =
+        (PREPARSE_POINT_ATTRIBUTE)(((BYTE*)m_pHeader) + m_pHeader->Form.Resident.ValueOffset);
+    if (pReparse->DataLength < kExternalInfoSize)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    const auto pInfo = reinterpret_cast<const ULONG*>(pReparse->Data);
+    if (pInfo[1] != kWofProviderFile)
+    {
+        Log::Debug(L"WOF provider {} is not the file provider", pInfo[1]);
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    ulAlgorithm = pInfo[3];
+    return S_OK;
+}
+
 HRESULT ReparsePointAttribute::CleanCachedData()
 {
     strSubstituteName.clear();
@@ -46,6 +46,15 @@ protected:
     bool m_bNonResidentInfoPresent;
     LONGLONG m_LowestVcn;
 
+    // An unsupported WOF algorithm is only reported once, the streams are requested for each read
+    bool m_bUnsupportedOverlayLogged = false;
+
+    // The unnamed $DATA of a WOF compressed file is sparse: data is decompressed from 'WofCompressedData'
+    HRESULT GetOverlayStreams(
+        const std::shared_ptr<VolumeReader>& pVolReader,
+        std::shared_ptr<ByteStream>& rawStream,
+        std::shared_ptr<ByteStream>& dataStream);
+
 public:
     MftRecordAttribute(PATTRIBUTE_RECORD_HEADER pHeader, MFTRecord* pHostingRecord)
         : m_pHeader(pHeader)
@@ -331,6 +340,9 @@ class ORCLIB_API WOFReparseAttribute : public ReparsePointAttribute
 public:
     WOFReparseAttribute(PATTRIBUTE_RECORD_HEADER pHeader, MFTRecord* pRecord)
         : ReparsePointAttribute(pHeader, pRecord) {};
+
+    // Compression algorithm (FILE_PROVIDER_EXTERNAL_INFO_V1) of a file backed by the WOF file provider
+    HRESULT GetFileProviderAlgorithm(ULONG& ulAlgorithm) const;
 };
 
 class ORCLIB_API ExtendedAttribute : public MftRecordAttribute
@@ -466,3 +466,97 @@ return_overflow:
     Log::Error(L"Failed to decompress file");
     return E_FAIL;
 }
+
+HRESULT Orc::lznt1_decompress_unit(uint8_t* dest, const size_t dest_size, const uint8_t* src, const size_t src_size)
+{
+    uint8_t* out = dest;
+    uint8_t* const out_end = dest + dest_size;
+    const uint8_t* in = src;
+    const uint8_t* const in_end = src + src_size;
+
+    while (in + 2 <= in_end && out < out_end)
+    {
+        const uint16_t sb_header = le16_to_cpup(in);
+        if (sb_header == 0)
+            break;
+
+        const uint8_t* const sb_end = in + (sb_header & NTFS_SB_SIZE_MASK) + 3;
+        if (sb_end > in_end)
+            return E_FAIL;
+        in += 2;
+
+        uint8_t* const out_sb_start = out;
+        uint8_t* const out_sb_end = out + std::min<size_t>(NTFS_SB_SIZE, out_end - out);
+
+        if (!(sb_header & NTFS_SB_IS_COMPRESSED))
+        {
+            if (sb_end - in > out_sb_end - out)
+                return E_FAIL;
+
+            memcpy(out, in, sb_end - in);
+            out += sb_end - in;
+            in = sb_end;
+        }
+
+        while (in < sb_end)
+        {
+            uint8_t tag = *in++;
+
+            for (int token = 0; token < 8 && in < sb_end; token++, tag >>= 1)
+            {
+                if ((tag & NTFS_TOKEN_MASK) == NTFS_SYMBOL_TOKEN)
+                {
+                    if (out >= out_sb_end)
+                        return E_FAIL;
+                    *out++ = *in++;
+                    continue;
+                }
+
+                if (in + 2 > sb_end)
+                    return E_FAIL;
+
+                const uint16_t pt = le16_to_cpup(in);
+                in += 2;
+
+                // The split between offset and length depends on the position in the sub-block
+                const size_t position = out - out_sb_start;
+                if (position == 0)
+                    return E_FAIL;
+
+                unsigned long lg = 0;
+                if (position - 1 >= 0x10)
+                {
+                    _BitScanReverse(&lg, static_cast<unsigned long>(position - 1));
+                    lg -= 3;
+                }
+
+                const size_t offset = (pt >> (12 - lg)) + 1;
+                const size_t length = (pt & (0xfff >> lg)) + 3;
+
+                if (offset > position || length > static_cast<size_t>(out_sb_end - out))
+                    return E_FAIL;
+
+                const uint8_t* back = out - offset;
+                if (length <= offset)
+                {
+                    memcpy(out, back, length);
+                    out += length;
+                }
+                else
+                {
+                    // Overlapping sequence: repeats the last 'offset' bytes
+                    for (size_t i = 0; i < length; i++)
+                        out[i] = back[i];
+                    out += length;
+                }
+            }
+        }
+
+        // Sub-blocks are 4KB once decompressed, a shorter one is zero padded
+        memset(out, 0, out_sb_end - out);
+        out = out_sb_end;
+    }
+
+    memset(out, 0, out_end - out);
+    return S_OK;
+}
@@ -35,6 +35,10 @@ HRESULT ntfs_uncompress_compunit(NTFS_COMP_INFO* comp);
 // NTFS-3G
 HRESULT ntfs_decompress(uint8_t* dest, const size_t dest_size, uint8_t* const cb_start, const size_t cb_size);
 
+// Decompresses the LZNT1 compression unit 'src' into 'dest' (1 compression unit), the end of 'dest' is zeroed.
+// Neither allocates nor logs: compression units can be decompressed concurrently.
+HRESULT lznt1_decompress_unit(uint8_t* dest, const size_t dest_size, const uint8_t* src, const size_t src_size);
+
 }  // namespace Orc
 
 #pragma managed(pop)
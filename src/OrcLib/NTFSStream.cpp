@@ -16,6 +16,8 @@
 #include "MFTRecord.h"
 #include "MFTUtils.h"
 
+#include <algorithm>
+
 using namespace Orc;
 
 NTFSStream::NTFSStream()
@@ -36,6 +38,16 @@ NTFSStream::NTFSStream()
 */
 HRESULT NTFSStream::Close()
 {
+    if (m_ReadStatistics.ullReads > 0LL)
+    {
+        Log::Debug(
+            L"NTFSStream statistics: {} read(s), {} bytes read, {} bytes zeroed, {} seek(s)",
+            m_ReadStatistics.ullReads,
+            m_ReadStatistics.ullBytesRead,
+            m_ReadStatistics.ullBytesZeroed,
+            m_ReadStatistics.ullSeeks);
+    }
+
     m_pVolReader.reset();
     m_DataSegments.clear();
     m_CurrentPosition = 0;
@@ -43,6 +55,9 @@ HRESULT NTFSStream::Close()
     m_CurrentSegmentOffset = 0LL;
     m_CurrentSegmentIndex = 0;
     m_bAllocatedData = false;
+    m_ReadPlan.clear();
+    m_ReadStatistics = ReadStatistics();
+    m_ullLastDiskOffset = 0LL;
     return S_OK;
 }
 
@@ -71,6 +86,21 @@ HRESULT NTFSStream::OpenStream(
     return S_OK;
 }
 
+HRESULT NTFSStream::OpenStream(
+    const std::shared_ptr<VolumeReader>& pReader,
+    std::vector<MFTUtils::DataSegment> segments,
+    ULONGLONG ullDataSize)
+{
+    Close();
+
+    _ASSERT(pReader);
+
+    m_pVolReader = pReader;
+    m_DataSegments = std::move(segments);
+    m_DataSize = ullDataSize;
+    return S_OK;
+}
+
 HRESULT NTFSStream::OpenAllocatedDataStream(
     const std::shared_ptr<VolumeReader>& pReader,
     const std::shared_ptr<MftRecordAttribute>& pDataAttr)
@@ -82,10 +112,69 @@ HRESULT NTFSStream::OpenAllocatedDataStream(
     return hr;
 }
 
+std::vector<std::pair<ULONGLONG, ULONGLONG>> NTFSStream::AllocatedRanges() const
+{
+    std::vector<std::pair<ULONGLONG, ULONGLONG>> ranges;
+
+    for (const auto& segment : m_DataSegments)
+    {
+        if (segment.bUnallocated || !segment.bValidData || segment.ullFileBasedOffset >= m_DataSize)
+            continue;
+
+        const auto ullSize = std::min(segment.ullSize, m_DataSize - segment.ullFileBasedOffset);
+        if (ullSize == 0LL)
+            continue;
+
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == segment.ullFileBasedOffset)
+            ranges.back().second += ullSize;
+        else
+            ranges.emplace_back(segment.ullFileBasedOffset, ullSize);
+    }
+    return ranges;
+}
+
+ULONGLONG NTFSStream::PlanRead(ULONGLONG cbBytes)
+{
+    m_ReadPlan.clear();
+
+    auto index = m_CurrentSegmentIndex;
+    auto ullOffset = m_CurrentSegmentOffset;
+    ULONGLONG ullPlanned = 0LL;
+
+    while (ullPlanned < cbBytes && index < m_DataSegments.size())
+    {
+        const auto& segment = m_DataSegments[index];
+        const auto ullLength = SegmentLength(segment);
+        if (ullOffset >= ullLength)
+        {
+            index++;
+            ullOffset = 0LL;
+            continue;
+        }
+
+        const auto ullChunk = std::min(cbBytes - ullPlanned, ullLength - ullOffset);
+        const bool bZero = segment.bUnallocated || !segment.bValidData;
+        const ULONGLONG ullDiskOffset = bZero ? 0LL : segment.ullDiskBasedOffset + ullOffset;
+
+        // Runs following each other on disk, or both sparse, are merged
+        if (!m_ReadPlan.empty() && m_ReadPlan.back().bZero == bZero
+            && (bZero || m_ReadPlan.back().ullDiskOffset + m_ReadPlan.back().ullLength == ullDiskOffset))
+            m_ReadPlan.back().ullLength += ullChunk;
+        else
+            m_ReadPlan.push_back({ullPlanned, ullDiskOffset, ullChunk, bZero});
+
+        ullPlanned += ullChunk;
+        ullOffset += ullChunk;
+    }
+
+    return ullPlanned;
+}
+
 /*
     NTFSStream::Read
 
-    Reads data from the stream
+    Reads data from the stream: the read spans as many segments as needed, sparse ranges are zeroed and the others are
+    read in disk order, directly in the caller's buffer
 
     Parameters:
         pReadBuffer     -   Pointer to buffer which receives the data
@@ -105,45 +194,73 @@ HRESULT NTFSStream::Read(
     if (cbBytes == 0LL)
         return S_OK;
 
-    if (m_CurrentSegmentIndex >= m_DataSegments.size())
+    const ULONGLONG ullPlanned = PlanRead(cbBytes);
+    if (ullPlanned == 0LL)
         return S_OK;
 
-    if (m_CurrentSegmentOffset
-        >= (m_bAllocatedData ? m_DataSegments[m_CurrentSegmentIndex].ullAllocatedSize
-                             : m_DataSegments[m_CurrentSegmentIndex].ullSize))
+    const auto pBuffer = reinterpret_cast<LPBYTE>(pReadBuffer);
+
+    for (const auto& range : m_ReadPlan)
     {
-        m_CurrentSegmentIndex++;  // We have reached the end of the segment, moving to the next
-        m_CurrentSegmentOffset = 0LL;
+        if (range.bZero)
+        {
+            ZeroMemory(pBuffer + range.ullBufferOffset, static_cast<size_t>(range.ullLength));
+            m_ReadStatistics.ullBytesZeroed += range.ullLength;
+        }
     }
 
-    if (m_CurrentSegmentIndex >= m_DataSegments.size())
-        return S_OK;
-
-    ULONGLONG ullToRead = std::min(
-        cbBytes,
-        (m_bAllocatedData ? m_DataSegments[m_CurrentSegmentIndex].ullAllocatedSize
-                          : m_DataSegments[m_CurrentSegmentIndex].ullSize)
-            - m_CurrentSegmentOffset);
-
-    CBinaryBuffer buffer((PBYTE)pReadBuffer, static_cast<size_t>(cbBytes));
-    ULONGLONG ullBytesRead = 0LL;
+    const auto dataEnd =
+        std::remove_if(begin(m_ReadPlan), end(m_ReadPlan), [](const ReadRange& range) { return range.bZero; });
+    std::sort(begin(m_ReadPlan), dataEnd, [](const ReadRange& left, const ReadRange& right) {
+        return left.ullDiskOffset < right.ullDiskOffset;
+    });
 
-    if (m_DataSegments[m_CurrentSegmentIndex].bUnallocated || !m_DataSegments[m_CurrentSegmentIndex].bValidData)
+    // A short read truncates the result to the data read before it in the caller's buffer
+    ULONGLONG ullBytesRead = ullPlanned;
+    for (auto it = begin(m_ReadPlan); it != dataEnd; ++it)
     {
-        ZeroMemory(buffer.GetData(), static_cast<size_t>(ullToRead));
-        ullBytesRead = ullToRead;
+        ULONGLONG ullDone = 0LL;
+        while (ullDone < it->ullLength)
+        {
+            const ULONGLONG ullDiskOffset = it->ullDiskOffset + ullDone;
+            CBinaryBuffer buffer(pBuffer + it->ullBufferOffset + ullDone, static_cast<size_t>(it->ullLength - ullDone));
+
+            if (ullDiskOffset != m_ullLastDiskOffset)
+                m_ReadStatistics.ullSeeks++;
+
+            ULONGLONG ullThisRead = 0LL;
+            if (FAILED(hr = m_pVolReader->Read(ullDiskOffset, buffer, it->ullLength - ullDone, ullThisRead)))
+                return hr;
+
+            m_ReadStatistics.ullReads++;
+            m_ReadStatistics.ullBytesRead += ullThisRead;
+            m_ullLastDiskOffset = ullDiskOffset + ullThisRead;
+
+            if (ullThisRead == 0LL)
+                break;
+            ullDone += ullThisRead;
+        }
+
+        if (ullDone < it->ullLength)
+            ullBytesRead = std::min(ullBytesRead, it->ullBufferOffset + ullDone);
     }
-    else
+
+    ULONGLONG ullToSkip = ullBytesRead;
+    while (ullToSkip > 0LL && m_CurrentSegmentIndex < m_DataSegments.size())
     {
-        if (FAILED(
-                hr = m_pVolReader->Read(
-                    m_DataSegments[m_CurrentSegmentIndex].ullDiskBasedOffset + m_CurrentSegmentOffset,
-                    buffer,
-                    ullToRead,
-                    ullBytesRead)))
-            return hr;
+        const auto ullLength = SegmentLength(m_DataSegments[m_CurrentSegmentIndex]);
+        if (m_CurrentSegmentOffset >= ullLength)
+        {
+            m_CurrentSegmentIndex++;  // We have reached the end of the segment, moving to the next
+            m_CurrentSegmentOffset = 0LL;
+            continue;
+        }
+
+        const auto ullChunk = std::min(ullToSkip, ullLength - m_CurrentSegmentOffset);
+        m_CurrentSegmentOffset += ullChunk;
+        ullToSkip -= ullChunk;
     }
-    m_CurrentSegmentOffset += ullBytesRead;
+
     m_CurrentPosition += ullBytesRead;
     if (pullBytesRead != nullptr)
         *pullBytesRead = ullBytesRead;
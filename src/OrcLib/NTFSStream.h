@@ -47,11 +47,31 @@ public:
     (__in_opt const std::shared_ptr<VolumeReader>& pVolReader,
      __in_opt const std::shared_ptr<MftRecordAttribute>& pDataAttr);
 
+    // Opens the stream over 'segments', as built by MFTUtils::GetDataSegments, holding 'ullDataSize' bytes
+    STDMETHOD(OpenStream)
+    (__in const std::shared_ptr<VolumeReader>& pVolReader,
+     __in std::vector<MFTUtils::DataSegment> segments,
+     __in ULONGLONG ullDataSize);
+
     STDMETHOD(OpenAllocatedDataStream)
     (__in_opt const std::shared_ptr<VolumeReader>& pVolReader,
      __in_opt const std::shared_ptr<MftRecordAttribute>& pDataAttr);
 
-    const std::vector<MFTUtils::DataSegment> DataSegments() const { return m_DataSegments; }
+    const std::vector<MFTUtils::DataSegment>& DataSegments() const { return m_DataSegments; }
+
+    // Ranges (offset, length) of the stream backed by clusters with valid data, adjacent ranges are merged. Sparse runs
+    // and data past the valid data length read as zeroes and are not listed.
+    std::vector<std::pair<ULONGLONG, ULONGLONG>> AllocatedRanges() const;
+
+    struct ReadStatistics
+    {
+        ULONGLONG ullReads = 0LL;  // Reads issued to the volume reader
+        ULONGLONG ullBytesRead = 0LL;
+        ULONGLONG ullBytesZeroed = 0LL;  // Sparse runs and data past the valid data length, without I/O
+        ULONGLONG ullSeeks = 0LL;  // Reads not starting where the previous one ended
+    };
+
+    const ReadStatistics& GetReadStatistics() const { return m_ReadStatistics; }
 
     STDMETHOD(Read)
     (__out_bcount_part(cbBytesToRead, *pcbBytesRead) PVOID pBuffer,
@@ -69,6 +89,24 @@ public:
     STDMETHOD(Close)();
 
 private:
+    // Part of a read: 'ullLength' bytes at 'ullBufferOffset' in the caller's buffer, read from 'ullDiskOffset' or
+    // zeroed
+    struct ReadRange
+    {
+        ULONGLONG ullBufferOffset;
+        ULONGLONG ullDiskOffset;
+        ULONGLONG ullLength;
+        bool bZero;
+    };
+
+    ULONGLONG SegmentLength(const MFTUtils::DataSegment& segment) const
+    {
+        return m_bAllocatedData ? segment.ullAllocatedSize : segment.ullSize;
+    }
+
+    // Splits a read of 'cbBytes' from the current position in ranges, merging physically adjacent runs
+    ULONGLONG PlanRead(ULONGLONG cbBytes);
+
     std::shared_ptr<VolumeReader> m_pVolReader;
     std::vector<MFTUtils::DataSegment> m_DataSegments;
 
@@ -79,6 +117,10 @@ private:
     std::vector<MFTUtils::DataSegment>::size_type m_CurrentSegmentIndex;  // Current segment index
 
     bool m_bAllocatedData;
+
+    std::vector<ReadRange> m_ReadPlan;
+    ReadStatistics m_ReadStatistics;
+    ULONGLONG m_ullLastDiskOffset = 0LL;
 };
 
 }  // namespace Orc
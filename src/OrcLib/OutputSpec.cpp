@@ -46,6 +46,32 @@ bool HasValue(const ConfigItem& item, DWORD dwIndex)
     return true;
 }
 
+// Extract the stream compression from a double extension like '.csv.zst' and return the inner extension
+OutputSpec::StreamCompression GetStreamCompression(const fs::path& path, fs::path& extension)
+{
+    extension = path.extension();
+
+    auto compression = OutputSpec::StreamCompression::None;
+    if (equalCaseInsensitive(extension.c_str(), L".zst"sv))
+        compression = OutputSpec::StreamCompression::Zstd;
+    else if (equalCaseInsensitive(extension.c_str(), L".lz4"sv))
+        compression = OutputSpec::StreamCompression::Lz4;
+    else
+        return OutputSpec::StreamCompression::None;
+
+    const auto inner = path.stem().extension();
+    for (const auto& supported : {L".csv"sv, L".tsv"sv, L".xml"sv, L".json"sv, L".jsonl"sv})
+    {
+        if (equalCaseInsensitive(inner.c_str(), supported))
+        {
+            extension = inner;
+            return compression;
+        }
+    }
+
+    return OutputSpec::StreamCompression::None;
+}
+
 }  // namespace
 
 namespace Orc {
@@ -142,6 +168,8 @@ HRESULT OutputSpec::Configure(
     HRESULT hr = E_FAIL;
 
     Type = OutputSpec::Kind::None;
+    StreamCompression = StreamCompression::None;
+    bJsonLines = false;
 
     // Now on with regular file paths
     fs::path outPath;
@@ -174,13 +202,15 @@ HRESULT OutputSpec::Configure(
 
     FileName = outPath.filename().wstring();
 
-    auto extension = outPath.extension();
+    fs::path extension;
+    const auto compression = GetStreamCompression(outPath, extension);
 
     if (HasFlag(supported, OutputSpec::Kind::TableFile))
     {
         if (equalCaseInsensitive(extension.c_str(), L".csv"sv))
         {
             Type = static_cast<OutputSpec::Kind>(OutputSpec::Kind::TableFile | OutputSpec::Kind::CSV);
+            StreamCompression = compression;
             szSeparator = L",";
             szQuote = L"\"";
             ArchiveFormat = ArchiveFormat::Unknown;
@@ -189,6 +219,7 @@ HRESULT OutputSpec::Configure(
         else if (equalCaseInsensitive(extension.c_str(), L".tsv"sv))
         {
             Type = static_cast<OutputSpec::Kind>(OutputSpec::Kind::TableFile | OutputSpec::Kind::TSV);
+            StreamCompression = compression;
             szSeparator = L"\t";
             szQuote = L"";
             ArchiveFormat = ArchiveFormat::Unknown;
@@ -212,15 +243,19 @@ HRESULT OutputSpec::Configure(
         if (equalCaseInsensitive(extension.c_str(), L".xml"sv))
         {
             Type = static_cast<OutputSpec::Kind>(OutputSpec::Kind::StructuredFile | OutputSpec::Kind::XML);
+            StreamCompression = compression;
             ArchiveFormat = ArchiveFormat::Unknown;
             return Orc::GetOutputFile(outPath.c_str(), Path, true);
         }
     }
     if (HasFlag(supported, OutputSpec::Kind::StructuredFile))
     {
-        if (equalCaseInsensitive(extension.c_str(), L".json"sv))
+        if (equalCaseInsensitive(extension.c_str(), L".json"sv)
+            || equalCaseInsensitive(extension.c_str(), L".jsonl"sv))
         {
             Type = static_cast<OutputSpec::Kind>(OutputSpec::Kind::StructuredFile | OutputSpec::Kind::JSON);
+            StreamCompression = compression;
+            bJsonLines = equalCaseInsensitive(extension.c_str(), L".jsonl"sv);
             ArchiveFormat = ArchiveFormat::Unknown;
             return Orc::GetOutputFile(outPath.c_str(), Path, true);
         }
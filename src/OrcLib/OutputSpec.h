@@ -38,6 +38,7 @@ public:
     using Disposition = OutputSpecTypes::Disposition;
     using Status = OutputSpecTypes::Status;
     using Encoding = OutputSpecTypes::Encoding;
+    using StreamCompression = OutputSpecTypes::StreamCompression;
 
     class ORCLIB_API Upload
     {
@@ -84,6 +85,11 @@ public:
 
     ArchiveFormat ArchiveFormat = ArchiveFormat::Unknown;
     std::wstring Compression;
+
+    // Inline compression of table and structured files (ie: 'NTFSInfo.csv.zst')
+    StreamCompression StreamCompression = StreamCompression::None;
+    // JSON output is written as one object per line (ie: 'NTFSInfo.jsonl')
+    bool bJsonLines = false;
     std::wstring Password;
 
     std::shared_ptr<Upload> UploadOutput;
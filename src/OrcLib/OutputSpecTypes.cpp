@@ -123,4 +123,19 @@ std::wstring ToString(OutputSpecTypes::Encoding encoding)
     return L"Unknown";
 }
 
+std::wstring ToString(OutputSpecTypes::StreamCompression compression)
+{
+    switch (compression)
+    {
+        case Orc::OutputSpecTypes::StreamCompression::None:
+            return L"none";
+        case Orc::OutputSpecTypes::StreamCompression::Zstd:
+            return L"zstd";
+        case Orc::OutputSpecTypes::StreamCompression::Lz4:
+            return L"lz4";
+    }
+
+    return L"Unknown";
+}
+
 }  // namespace Orc
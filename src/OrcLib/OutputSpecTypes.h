@@ -91,6 +91,13 @@ enum class Encoding
     UTF16
 };
 
+enum class StreamCompression
+{
+    None = 0,
+    Zstd,
+    Lz4
+};
+
 }  // namespace OutputSpecTypes
 
 std::wstring ToString(OutputSpecTypes::UploadAuthScheme method);
@@ -99,6 +106,7 @@ std::wstring ToString(OutputSpecTypes::UploadOperation method);
 std::wstring ToString(OutputSpecTypes::UploadMode mode);
 std::wstring ToString(OutputSpecTypes::Kind kind);
 std::wstring ToString(OutputSpecTypes::Encoding encoding);
+std::wstring ToString(OutputSpecTypes::StreamCompression compression);
 
 ENABLE_BITMASK_OPERATORS(OutputSpecTypes::Kind);
 
@@ -920,9 +920,105 @@ HRESULT RegFind::AddSearchTerm(const std::shared_ptr<RegFind::SearchTerm>& pMatc
         m_Specs.push_back(pMatch);
     }
 
+    m_pIndex.reset();
     return S_OK;
 }
 
+HRESULT RegFind::Compile()
+{
+    auto pIndex = std::make_shared<TermIndex>();
+
+    // A term can be registered in several maps
+    std::vector<std::shared_ptr<SearchTerm>> terms(std::cbegin(m_Specs), std::cend(m_Specs));
+    for (const auto specs : {&m_ExactKeyNameSpecs, &m_ExactKeyPathSpecs, &m_ExactValueNameSpecs})
+    {
+        for (const auto& [name, term] : *specs)
+            terms.push_back(term);
+    }
+    std::sort(std::begin(terms), std::end(terms));
+    terms.erase(std::unique(std::begin(terms), std::end(terms)), std::end(terms));
+
+    pIndex->bPruneKeys = !terms.empty();
+    for (const auto& term : terms)
+    {
+        // A key matches an exact path when its name is a prefix of the path: subkeys are only walked below the keys
+        // whose name is a path prefix ending on a separator
+        if (term->m_criteriaRequired & SearchTerm::Criteria::KEY_PATH)
+        {
+            const auto& path = term->m_strPathName;
+            for (auto pos = path.find('\\', 1); pos != std::string::npos; pos = path.find('\\', pos + 1))
+                pIndex->KeyPathPrefixes.insert(path.substr(0, pos));
+        }
+        else
+        {
+            pIndex->bPruneKeys = false;
+        }
+
+        if ((term->m_criteriaRequired & SearchTerm::Criteria::DATA_CONTAINS)
+            && term->m_DataContentContains.GetCount() > 0 && term->m_WDataContentContains.GetCount() > 0)
+        {
+            const auto dwId = static_cast<DWORD>(pIndex->ContainsIds.size());
+            pIndex->ContainsIds.emplace(term.get(), dwId);
+            pIndex->Contains.Add(term->m_DataContentContains.GetData(), term->m_DataContentContains.GetCount(), dwId);
+            pIndex->WideContains.Add(
+                term->m_WDataContentContains.GetData(), term->m_WDataContentContains.GetCount(), dwId);
+        }
+    }
+
+    pIndex->Contains.Build();
+    pIndex->WideContains.Build();
+
+    Log::Debug(
+        "RegFind: compiled {} terms ({} key path prefixes, key pruning: {}, {} contains patterns)",
+        terms.size(),
+        pIndex->KeyPathPrefixes.size(),
+        pIndex->bPruneKeys,
+        pIndex->ContainsIds.size());
+
+    m_pIndex = std::move(pIndex);
+    return S_OK;
+}
+
+bool RegFind::TermIndex::CanDescend(const RegistryKey* const RegKey) const
+{
+    const auto& name = RegKey->GetKeyName();
+    return name.empty() || KeyPathPrefixes.find(name) != std::cend(KeyPathPrefixes);
+}
+
+std::vector<bool> RegFind::TermIndex::FindContained(const RegistryValue* const RegValue) const
+{
+    std::vector<bool> contained(ContainsIds.size(), false);
+
+    // Same pattern selection as DatasContains
+    const AhoCorasick* pPatterns = nullptr;
+    switch (RegValue->GetType())
+    {
+        case ValueType::RegDWORD:
+        case ValueType::RegDWORDBE:
+        case ValueType::RegQWORD:
+            return contained;
+        case ValueType::RegSZ:
+        case ValueType::ExpandSZ:
+        case ValueType::RegMultiSZ:
+            pPatterns = &WideContains;
+            break;
+        default:
+            pPatterns = &Contains;
+            break;
+    }
+
+    const BYTE* pDatas = nullptr;
+    const size_t DatasSize = RegValue->GetDatas(&pDatas);
+    if (pDatas == nullptr || DatasSize == 0)
+        return contained;
+
+    pPatterns->Search(pDatas, DatasSize, [&contained](DWORD dwId, size_t) {
+        contained[dwId] = true;
+        return true;
+    });
+    return contained;
+}
+
 // Name specs: Only depend on KeyName
 RegFind::SearchTerm::Criteria
 RegFind::ExactKeyName(const std::shared_ptr<SearchTerm>& aTerm, const RegistryKey* const Regkey) const
@@ -1553,299 +1649,182 @@ RegFind::SearchTerm::Criteria RegFind::LookupSpec(
     return RegFind::SearchTerm::Criteria::NONE;
 }
 
-const std::vector<std::shared_ptr<RegFind::Match>> RegFind::FindMatch(const RegistryKey* const RegKey)
+void RegFind::MatchSet::Add(const std::shared_ptr<SearchTerm>& aTerm, const RegistryKey* const RegKey)
+{
+    concurrency::critical_section::scoped_lock lock(m_Lock);
+
+    auto term = m_Matches.find(aTerm);
+    if (term == m_Matches.end())
+        term = m_Matches.insert(MatchesMap::value_type(aTerm, std::make_shared<Match>(aTerm)));
+
+    term->second->AddKeyNameMatch(RegKey);
+}
+
+void RegFind::MatchSet::Add(const std::shared_ptr<SearchTerm>& aTerm, const RegistryValue* const RegValue)
+{
+    concurrency::critical_section::scoped_lock lock(m_Lock);
+
+    auto term = m_Matches.find(aTerm);
+    if (term == m_Matches.end())
+        term = m_Matches.insert(MatchesMap::value_type(aTerm, std::make_shared<Match>(aTerm)));
+
+    term->second->AddValueNameMatch(RegValue);
+}
+
+void RegFind::MatchSet::Sort()
+{
+    concurrency::critical_section::scoped_lock lock(m_Lock);
+
+    for (auto& [term, match] : m_Matches)
+    {
+        std::sort(
+            std::begin(match->MatchingKeys),
+            std::end(match->MatchingKeys),
+            [](const Match::KeyNameMatch& left, const Match::KeyNameMatch& right) {
+                return left.KeyName < right.KeyName;
+            });
+
+        std::sort(
+            std::begin(match->MatchingValues),
+            std::end(match->MatchingValues),
+            [](const Match::ValueNameMatch& left, const Match::ValueNameMatch& right) {
+                if (left.KeyName != right.KeyName)
+                    return left.KeyName < right.KeyName;
+                return left.ValueName < right.ValueName;
+            });
+    }
+}
+
+const std::vector<std::shared_ptr<RegFind::Match>>
+RegFind::FindMatch(const RegistryKey* const RegKey, MatchSet& matches) const
 {
     std::vector<std::shared_ptr<RegFind::Match>> MatchVector;
-    std::shared_ptr<RegFind::Match> retval;
+
+    const auto lookup = [this, RegKey, &matches, &MatchVector](
+                            const std::shared_ptr<SearchTerm>& aTerm, SearchTerm::Criteria criteria) {
+        std::shared_ptr<RegFind::Match> retval;
+        auto matched = LookupSpec(aTerm, criteria, retval, RegKey);
+        if (matched != SearchTerm::Criteria::NONE)
+        {
+            // Add into this specific key match vector (used by callback)
+            MatchVector.push_back(retval);
+            // Add into the global match vector
+            matches.Add(aTerm, RegKey);
+        }
+    };
 
     if (!m_ExactKeyNameSpecs.empty())
     {
         const std::string& name = RegKey->GetShortKeyName();
-        auto it = m_ExactKeyNameSpecs.find(name);
-        while (it != m_ExactKeyNameSpecs.end())
+        const auto [first, last] = m_ExactKeyNameSpecs.equal_range(name);
+        for (auto it = first; it != last; ++it)
         {
-            if (it->second->DependsOnValueOrData())
-            {
-                it++;
-                continue;
-            }
-
-            // check if term already matched
-            auto term = m_Matches.find(it->second);
-            retval = std::make_shared<RegFind::Match>(it->second);
-            if (term != m_Matches.end())
-            {
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_NAME, retval, RegKey);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                    // Add into the global match vector
-                    term->second->AddKeyNameMatch(RegKey);
-                }
-            }
-            // if not, use new match
-            else
-            {
-
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_NAME, retval, RegKey);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // Add into the global match vector
-                    m_Matches.insert(MatchesMap::value_type(it->second, retval));
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                }
-            }
-            it++;
+            if (!it->second->DependsOnValueOrData())
+                lookup(it->second, SearchTerm::Criteria::KEY_NAME);
         }
     }
 
     if (!m_ExactKeyPathSpecs.empty())
     {
         const std::string& name = RegKey->GetKeyName();
-        auto it = m_ExactKeyPathSpecs.find(name);
-        while (it != m_ExactKeyPathSpecs.end())
+        const auto [first, last] = m_ExactKeyPathSpecs.equal_range(name);
+        for (auto it = first; it != last; ++it)
         {
-            if (it->second->DependsOnValueOrData())
-            {
-                it++;
-                continue;
-            }
-            // check if term already matched
-            auto term = m_Matches.find(it->second);
-            retval = std::make_shared<RegFind::Match>(it->second);
-            if (term != m_Matches.end())
-            {
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_PATH, retval, RegKey);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                    // Add into the global match vector
-                    term->second->AddKeyNameMatch(RegKey);
-                }
-            }
-            // if not, use new match
-            else
-            {
-
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_PATH, retval, RegKey);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // Add into the global match vector
-                    m_Matches.insert(MatchesMap::value_type(it->second, retval));
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                }
-            }
-            it++;
+            if (!it->second->DependsOnValueOrData())
+                lookup(it->second, SearchTerm::Criteria::KEY_PATH);
         }
     }
-    else if (retval != nullptr)
-        retval->Reset();
 
-    for (auto term_it = begin(m_Specs); term_it != end(m_Specs); ++term_it)
+    for (const auto& term : m_Specs)
     {
-        if (!(*term_it)->DependsOnValueOrData())
-        {
-            // check if term already matched
-            auto term = m_Matches.find(*term_it);
-            std::shared_ptr<RegFind::Match> retval = std::make_shared<RegFind::Match>(*term_it);
-            if (term != m_Matches.end())
-            {
-                auto matched = LookupSpec(*term_it, SearchTerm::Criteria::NONE, retval, RegKey);
-                if (matched == (*term_it)->m_criteriaRequired)
-                {
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                    // Add into the global match vector
-                    term->second->AddKeyNameMatch(RegKey);
-                }
-            }
-            // if not, use new match
-            else
-            {
-
-                auto matched = LookupSpec(*term_it, SearchTerm::Criteria::NONE, retval, RegKey);
-                if (matched == (*term_it)->m_criteriaRequired)
-                {
-                    // Add into the global match vector
-                    m_Matches.insert(MatchesMap::value_type(*term_it, retval));
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                }
-            }
-        }
+        if (!term->DependsOnValueOrData())
+            lookup(term, SearchTerm::Criteria::NONE);
     }
 
     return MatchVector;
 }
 
-const std::vector<std::shared_ptr<RegFind::Match>> RegFind::FindMatch(const RegistryValue* const RegValue)
+const std::vector<std::shared_ptr<RegFind::Match>>
+RegFind::FindMatch(const RegistryValue* const RegValue, MatchSet& matches) const
 {
-    std::shared_ptr<RegFind::Match> retval;
     const RegistryKey* const pKey = RegValue->GetParentKey();
-    std::shared_ptr<RegFind::Match> pRetval;
     std::vector<std::shared_ptr<RegFind::Match>> MatchVector;
 
+    // Terms whose 'contains' pattern is absent from the value data cannot match
+    std::vector<bool> contained;
+    if (m_pIndex && !m_pIndex->ContainsIds.empty())
+        contained = m_pIndex->FindContained(RegValue);
+
+    const auto lookup = [this, RegValue, &matches, &MatchVector, &contained](
+                            const std::shared_ptr<SearchTerm>& aTerm, SearchTerm::Criteria criteria) {
+        if (!contained.empty())
+        {
+            const auto id = m_pIndex->ContainsIds.find(aTerm.get());
+            if (id != std::cend(m_pIndex->ContainsIds) && !contained[id->second])
+                return;
+        }
+
+        std::shared_ptr<RegFind::Match> retval;
+        auto matched = LookupSpec(aTerm, criteria, retval, RegValue);
+        if (matched != SearchTerm::Criteria::NONE)
+        {
+            // Add into this specific value match vector (used by callback)
+            MatchVector.push_back(retval);
+            // Add into the global match vector
+            matches.Add(aTerm, RegValue);
+        }
+    };
+
     if (!m_ExactKeyNameSpecs.empty())
     {
         const std::string& name = pKey->GetShortKeyName();
-        auto it = m_ExactKeyNameSpecs.find(name);
-        while (it != m_ExactKeyNameSpecs.end())
+        const auto [first, last] = m_ExactKeyNameSpecs.equal_range(name);
+        for (auto it = first; it != last; ++it)
         {
-            if (!it->second->DependsOnValueOrData())
-            {
-                it++;
-                continue;
-            }
-
-            // check if term already matched
-            auto term = m_Matches.find(it->second);
-            if (term != m_Matches.end())
-            {
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_NAME, retval, RegValue);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                    // Add into the global match vector
-                    term->second->AddValueNameMatch(RegValue);
-                }
-            }
-            // if not, use new match
-            else
-            {
-                retval = std::make_shared<RegFind::Match>(it->second);
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_NAME, retval, RegValue);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    m_Matches.insert(MatchesMap::value_type(it->second, retval));
-                    MatchVector.push_back(retval);
-                }
-            }
-            it++;
+            if (it->second->DependsOnValueOrData())
+                lookup(it->second, SearchTerm::Criteria::KEY_NAME);
         }
     }
 
     if (!m_ExactKeyPathSpecs.empty())
     {
         const std::string& name = pKey->GetKeyName();
-        auto it = m_ExactKeyPathSpecs.find(name);
-        while (it != m_ExactKeyPathSpecs.end())
+        const auto [first, last] = m_ExactKeyPathSpecs.equal_range(name);
+        for (auto it = first; it != last; ++it)
         {
-            if (!it->second->DependsOnValueOrData())
-            {
-                it = next(it);
-                continue;
-            }
-            // check if term already matched
-            auto term = m_Matches.find(it->second);
-            if (term != m_Matches.end())
-            {
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_PATH, retval, RegValue);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                    // Add into the global match vector
-                    term->second->AddValueNameMatch(RegValue);
-                }
-            }
-            // if not, use new match
-            else
-            {
-                retval = std::make_shared<RegFind::Match>(it->second);
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::KEY_PATH, retval, RegValue);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    m_Matches.insert(MatchesMap::value_type(it->second, retval));
-                    MatchVector.push_back(retval);
-                }
-            }
-            it = next(it);
+            if (it->second->DependsOnValueOrData())
+                lookup(it->second, SearchTerm::Criteria::KEY_PATH);
         }
     }
 
-    std::string name = RegValue->GetValueName();
     if (!m_ExactValueNameSpecs.empty())
     {
-        auto it = m_ExactValueNameSpecs.find(name);
-        while (it != m_ExactValueNameSpecs.end())
+        const std::string& name = RegValue->GetValueName();
+        const auto [first, last] = m_ExactValueNameSpecs.equal_range(name);
+        for (auto it = first; it != last; ++it)
         {
-            if (!it->second->DependsOnValueOrData())
-            {
-                it++;
-                continue;
-            }
-
-            // check if term already matched
-            auto term = m_Matches.find(it->second);
-            if (term != m_Matches.end())
-            {
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::VALUE_NAME, retval, RegValue);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                    // Add into the global match vector
-                    term->second->AddValueNameMatch(RegValue);
-                }
-            }
-            // if not, use new match
-            else
-            {
-                retval = std::make_shared<RegFind::Match>(it->second);
-                auto matched = LookupSpec(it->second, SearchTerm::Criteria::VALUE_NAME, retval, RegValue);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    m_Matches.insert(MatchesMap::value_type(it->second, retval));
-                    MatchVector.push_back(retval);
-                }
-            }
-            it++;
+            if (it->second->DependsOnValueOrData())
+                lookup(it->second, SearchTerm::Criteria::VALUE_NAME);
         }
     }
 
-    for (auto term_it = begin(m_Specs); term_it != end(m_Specs); ++term_it)
+    for (const auto& term : m_Specs)
     {
-        if (!(*term_it)->DependsOnValueOrData())
-        {
-            continue;
-        }
-
-        else
-        {
-            // check if term already matched
-            auto term = m_Matches.find(*term_it);
-            if (term != m_Matches.end())
-            {
-                auto matched = LookupSpec(*term_it, SearchTerm::Criteria::NONE, retval, RegValue);
-                if (matched == (*term_it)->m_criteriaRequired)
-                {
-                    // Add into this specific key match vector (used by callback)
-                    MatchVector.push_back(retval);
-                    // Add into the global match vector
-                    term->second->AddValueNameMatch(RegValue);
-                }
-            }
-            // if not, use new match
-            else
-            {
-                retval = std::make_shared<RegFind::Match>(*term_it);
-                auto matched = LookupSpec(*term_it, SearchTerm::Criteria::NONE, retval, RegValue);
-                if (matched == (*term_it)->m_criteriaRequired)
-                {
-                    m_Matches.insert(MatchesMap::value_type(*term_it, retval));
-                    MatchVector.push_back(retval);
-                }
-            }
-        }
+        if (term->DependsOnValueOrData())
+            lookup(term, SearchTerm::Criteria::NONE);
     }
+
     return MatchVector;
 }
 
+std::function<bool(const RegistryKey* const)> RegFind::GetSubKeysFilter() const
+{
+    if (m_pIndex == nullptr || !m_pIndex->bPruneKeys)
+        return nullptr;
+
+    return [pIndex = m_pIndex](const RegistryKey* const RegKey) { return pIndex->CanDescend(RegKey); };
+}
+
 HRESULT RegFind::Find(
     const std::shared_ptr<ByteStream>& location,
     FoundKeyMatchCallback aKeyCallback,
@@ -1859,28 +1838,33 @@ HRESULT RegFind::Find(
     if (location != nullptr)
     {
         RegistryHive Hive;
-        hr = Hive.LoadHive(*location);
+        hr = Hive.LoadHive(location, RegistryHive::LoadMode::Mapped);
         if (hr != S_OK)
         {
             Log::Error(L"Failed RegFind::Find: cannot load hive [{}]", SystemError(hr));
             return hr;
         }
 
-        std::function<void(const RegistryKey* const)> CallbackOnKey = [this,
-                                                                       aKeyCallback](const RegistryKey* const RegKey) {
-            std::vector<std::shared_ptr<RegFind::Match>> result = FindMatch(RegKey);
-            if ((aKeyCallback != nullptr) && (!result.empty()))
-                aKeyCallback(result);
-        };
+        if (m_pIndex == nullptr)
+            Compile();
+
+        MatchSet matches(m_Matches);
+
+        std::function<void(const RegistryKey* const)> CallbackOnKey =
+            [this, &matches, aKeyCallback](const RegistryKey* const RegKey) {
+                std::vector<std::shared_ptr<RegFind::Match>> result = FindMatch(RegKey, matches);
+                if ((aKeyCallback != nullptr) && (!result.empty()))
+                    aKeyCallback(result);
+            };
 
         std::function<void(const RegistryValue* const)> CallBackOnValue =
-            [this, aValueCallback](const RegistryValue* const RegValue) {
-                std::vector<std::shared_ptr<RegFind::Match>> result = FindMatch(RegValue);
+            [this, &matches, aValueCallback](const RegistryValue* const RegValue) {
+                std::vector<std::shared_ptr<RegFind::Match>> result = FindMatch(RegValue, matches);
                 if ((aValueCallback != nullptr) && (!result.empty()))
                     aValueCallback(result);
             };
 
-        if (FAILED(hr = Hive.Walk(CallbackOnKey, CallBackOnValue)))
+        if (FAILED(hr = Hive.Walk(CallbackOnKey, CallBackOnValue, GetSubKeysFilter())))
         {
             Log::Error(L"Failed RegFind::Find: cannot walk hive [{}]", SystemError(hr));
             return hr;
@@ -1895,3 +1879,69 @@ HRESULT RegFind::Find(
     Log::Debug("RegFind::Find: done");
     return hr;
 }
+
+HRESULT RegFind::ParallelFind(
+    const std::shared_ptr<ByteStream>& location,
+    const std::vector<std::shared_ptr<ByteStream>>& logs,
+    MatchesMap& matches,
+    FoundKeyMatchCallback aKeyCallback,
+    FoundValueMatchCallback aValueCallback) const
+{
+    HRESULT hr = S_OK;
+
+    if (location == nullptr)
+    {
+        Log::Error("RegFind::ParallelFind: a search location is required");
+        return HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER);
+    }
+
+    RegistryHive Hive;
+    hr = Hive.LoadHive(location, RegistryHive::LoadMode::Mapped);
+    if (hr != S_OK)
+    {
+        Log::Error(L"Failed RegFind::ParallelFind: cannot load hive [{}]", SystemError(hr));
+        return hr;
+    }
+
+    if (!logs.empty() && FAILED(hr = Hive.ReplayLogs(logs)))
+    {
+        Log::Warn(L"RegFind::ParallelFind: failed to replay transaction logs [{}]", SystemError(hr));
+
+        // A failed replay leaves the hive partly patched or unloaded: the base hive is walked instead
+        hr = Hive.LoadHive(location, RegistryHive::LoadMode::Mapped);
+        if (hr != S_OK)
+        {
+            Log::Error(L"Failed RegFind::ParallelFind: cannot reload hive [{}]", SystemError(hr));
+            return hr;
+        }
+    }
+    hr = S_OK;
+
+    matches.clear();
+    MatchSet set(matches);
+
+    std::function<void(const RegistryKey* const)> CallbackOnKey =
+        [this, &set, aKeyCallback](const RegistryKey* const RegKey) {
+            std::vector<std::shared_ptr<RegFind::Match>> result = FindMatch(RegKey, set);
+            if ((aKeyCallback != nullptr) && (!result.empty()))
+                aKeyCallback(result);
+        };
+
+    std::function<void(const RegistryValue* const)> CallBackOnValue =
+        [this, &set, aValueCallback](const RegistryValue* const RegValue) {
+            std::vector<std::shared_ptr<RegFind::Match>> result = FindMatch(RegValue, set);
+            if ((aValueCallback != nullptr) && (!result.empty()))
+                aValueCallback(result);
+        };
+
+    if (FAILED(hr = Hive.ParallelWalk(CallbackOnKey, CallBackOnValue, GetSubKeysFilter())))
+    {
+        Log::Error(L"Failed RegFind::ParallelFind: cannot walk hive [{}]", SystemError(hr));
+        return hr;
+    }
+
+    set.Sort();
+
+    Log::Debug("RegFind::ParallelFind: done");
+    return hr;
+}
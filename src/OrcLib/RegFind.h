@@ -11,13 +11,17 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <iterator>
 #include <regex>
 
+#include <concrt.h>
+
 #include <boost/algorithm/searching/boyer_moore.hpp>
 
 #include "RegistryWalker.h"
+#include "AhoCorasick.h"
 #include "ByteStream.h"
 #include "CaseInsensitive.h"
 #include "FileFind.h"
@@ -406,6 +410,7 @@ private:
         size_t operator()(const std::shared_ptr<SearchTerm>& s) const { return hashSearchTermUnordered(s); }
     };
 
+public:
     typedef std::unordered_multimap<
         std::shared_ptr<SearchTerm>,
         std::shared_ptr<Match>,
@@ -413,6 +418,27 @@ private:
         SearchTermUnordered>
         MatchesMap;
 
+private:
+    // Accumulates the matches of a walk, walker threads may add concurrently
+    class MatchSet
+    {
+    public:
+        MatchSet(MatchesMap& matches)
+            : m_Matches(matches)
+        {
+        }
+
+        void Add(const std::shared_ptr<SearchTerm>& aTerm, const RegistryKey* const RegKey);
+        void Add(const std::shared_ptr<SearchTerm>& aTerm, const RegistryValue* const RegValue);
+
+        // Orders matching keys and values by path, so the result does not depend on thread scheduling
+        void Sort();
+
+    private:
+        MatchesMap& m_Matches;
+        concurrency::critical_section m_Lock;
+    };
+
     TermMap m_ExactKeyNameSpecs;
     TermMap m_ExactKeyPathSpecs;
     TermMap m_ExactValueNameSpecs;
@@ -420,6 +446,26 @@ private:
 
     MatchesMap m_Matches;
 
+    // Search terms compiled once (see Compile), read concurrently by the walker threads
+    struct TermIndex
+    {
+        // When every term has an exact key path, only keys leading to those paths have their subkeys walked
+        bool bPruneKeys = false;
+        std::unordered_set<std::string, CaseInsensitiveUnorderedAnsi, CaseInsensitiveUnorderedAnsi> KeyPathPrefixes;
+
+        // 'DATA_CONTAINS' patterns of all terms searched in one pass over the value data
+        AhoCorasick Contains;
+        AhoCorasick WideContains;
+        std::unordered_map<const SearchTerm*, DWORD> ContainsIds;
+
+        bool CanDescend(const RegistryKey* const RegKey) const;
+        std::vector<bool> FindContained(const RegistryValue* const RegValue) const;
+    };
+
+    std::shared_ptr<const TermIndex> m_pIndex;
+
+    std::function<bool(const RegistryKey* const)> GetSubKeysFilter() const;
+
     // Name specs: Only depend on KeyName (aka ShotKeyName)
     SearchTerm::Criteria ExactKeyName(const std::shared_ptr<SearchTerm>& aTerm, const RegistryKey* const Regkey) const;
     SearchTerm::Criteria RegexKeyName(const std::shared_ptr<SearchTerm>& aTerm, const RegistryKey* const Regkey) const;
@@ -483,8 +529,9 @@ private:
         std::shared_ptr<Match>& aMatch,
         const RegistryValue* const RegValue) const;
 
-    const std::vector<std::shared_ptr<Match>> FindMatch(const RegistryKey* const RegKey);
-    const std::vector<std::shared_ptr<Match>> FindMatch(const RegistryValue* const RegValue);
+    const std::vector<std::shared_ptr<Match>> FindMatch(const RegistryKey* const RegKey, MatchSet& matches) const;
+    const std::vector<std::shared_ptr<Match>>
+    FindMatch(const RegistryValue* const RegValue, MatchSet& matches) const;
 
     static ValueType GetRegistryValueType(LPCWSTR szValueType);
 
@@ -497,11 +544,25 @@ public:
     HRESULT AddRegFindFromTemplate(const std::vector<ConfigItem>& items);
     HRESULT AddSearchTerm(const std::shared_ptr<SearchTerm>& MatchSpec);
 
+    // Builds the term index once all terms are added, Find compiles when needed but ParallelFind only uses an index
+    // compiled beforehand
+    HRESULT Compile();
+
     HRESULT Find(
         const std::shared_ptr<ByteStream>& location,
         FoundKeyMatchCallback aKeyCallback,
         FoundValueMatchCallback aValueCallback);
 
+    // Walks the hive subtrees concurrently: callbacks must be thread safe. Matches are returned in 'matches' (not in
+    // Matches()) so that several hives can be searched at once with the same specs. Transaction 'logs' are replayed
+    // over the hive before the walk.
+    HRESULT ParallelFind(
+        const std::shared_ptr<ByteStream>& location,
+        const std::vector<std::shared_ptr<ByteStream>>& logs,
+        MatchesMap& matches,
+        FoundKeyMatchCallback aKeyCallback = nullptr,
+        FoundValueMatchCallback aValueCallback = nullptr) const;
+
     const MatchesMap& Matches() const { return m_Matches; }
     void ClearMatches() { m_Matches.clear(); }
 
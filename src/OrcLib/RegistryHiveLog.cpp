@@ -0,0 +1,512 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "RegistryWalker.h"
+
+#include <array>
+#include <optional>
+
+using namespace Orc;
+
+namespace {
+
+// Base block of a hive is 4KB, only its first 512 bytes are used and stored in the transaction logs
+constexpr ULONG64 kBaseBlockSize = 0x1000;
+constexpr ULONG64 kLogBaseBlockSize = 0x200;
+constexpr ULONG64 kLogSectorSize = 0x200;
+constexpr ULONG64 kHivePageSize = 0x1000;
+
+constexpr size_t kPrimarySequenceOffset = 0x04;
+constexpr size_t kSecondarySequenceOffset = 0x08;
+constexpr size_t kFileTypeOffset = 0x1C;
+constexpr size_t kHiveBinsDataSizeOffset = 0x28;
+constexpr size_t kCheckSumOffset = 0x1FC;
+
+// Transaction logs written before Windows 8.1 hold a dirty vector, later ones hold a list of log entries
+constexpr DWORD kFileTypeLog = 1;
+constexpr DWORD kFileTypeLogAlternate = 2;
+constexpr DWORD kFileTypeLogEntries = 6;
+
+constexpr ULONG64 kMarvinSeed = 0x82EF4D887A4E55C5ULL;
+
+#pragma pack(push, 1)
+
+struct LogEntryHeader
+{
+    char Signature[4];  // "HvLE"
+    DWORD Size;  // Size of the entry, a multiple of 512 bytes
+    DWORD Flags;
+    DWORD SequenceNumber;
+    DWORD HiveBinsDataSize;  // Size of the hive bins once the entry is applied
+    DWORD DirtyPagesCount;
+    ULONG64 Hash1;  // Marvin32 of the entry past this header
+    ULONG64 Hash2;  // Marvin32 of the first 32 bytes of the entry
+};
+
+struct DirtyPageReference
+{
+    DWORD Offset;  // Relative to the first hbin
+    DWORD Size;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(LogEntryHeader) == 40);
+
+DWORD GetField(const BYTE* pBaseBlock, size_t offset)
+{
+    return *reinterpret_cast<const DWORD*>(pBaseBlock + offset);
+}
+
+void SetField(BYTE* pBaseBlock, size_t offset, DWORD dwValue)
+{
+    *reinterpret_cast<DWORD*>(pBaseBlock + offset) = dwValue;
+}
+
+DWORD ComputeCheckSum(const BYTE* pBaseBlock)
+{
+    DWORD dwCheckSum = 0L;
+    for (size_t i = 0; i < kCheckSumOffset; i += sizeof(DWORD))
+        dwCheckSum ^= GetField(pBaseBlock, i);
+
+    if (dwCheckSum == MAXDWORD)
+        return MAXDWORD - 1;
+    if (dwCheckSum == 0L)
+        return 1L;
+    return dwCheckSum;
+}
+
+bool IsValidBaseBlock(const BYTE* pBaseBlock)
+{
+    return strncmp(reinterpret_cast<const char*>(pBaseBlock), "regf", 4) == 0
+        && GetField(pBaseBlock, kCheckSumOffset) == ComputeCheckSum(pBaseBlock);
+}
+
+HRESULT ReadAt(ByteStream& stream, ULONG64 ullOffset, BYTE* pBuffer, ULONG64 ullSize)
+{
+    HRESULT hr = E_FAIL;
+
+    if (FAILED(hr = stream.SetFilePointer(ullOffset, FILE_BEGIN, nullptr)))
+        return hr;
+
+    ULONG64 ullRead = 0LL;
+    while (ullRead < ullSize)
+    {
+        ULONG64 ullChunk = 0LL;
+        stream.Read(pBuffer + ullRead, ullSize - ullRead, &ullChunk);
+        if (ullChunk == 0)
+            return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+        ullRead += ullChunk;
+    }
+    return S_OK;
+}
+
+// Reads and validates the log entry at 'ullOffset'
+HRESULT ReadLogEntry(ByteStream& log, ULONG64 ullOffset, std::vector<BYTE>& entry)
+{
+    HRESULT hr = E_FAIL;
+
+    const auto ullLogSize = log.GetSize();
+    if (ullOffset + sizeof(LogEntryHeader) > ullLogSize)
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+    LogEntryHeader header;
+    if (FAILED(hr = ReadAt(log, ullOffset, reinterpret_cast<BYTE*>(&header), sizeof(header))))
+        return hr;
+
+    if (strncmp(header.Signature, "HvLE", 4) != 0 || header.Size % kLogSectorSize != 0
+        || header.Size < sizeof(LogEntryHeader) + header.DirtyPagesCount * sizeof(DirtyPageReference)
+        || ullOffset + header.Size > ullLogSize || header.HiveBinsDataSize % kHivePageSize != 0)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    entry.resize(header.Size);
+    if (FAILED(hr = ReadAt(log, ullOffset, entry.data(), entry.size())))
+        return hr;
+
+    const BYTE* pEntry = entry.data();
+    if (RegistryHive::Marvin32(pEntry, offsetof(LogEntryHeader, Hash2), kMarvinSeed) != header.Hash2
+        || RegistryHive::Marvin32(pEntry + sizeof(header), entry.size() - sizeof(header), kMarvinSeed) != header.Hash1)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    const auto pPages = reinterpret_cast<const DirtyPageReference*>(entry.data() + sizeof(header));
+    ULONG64 ullPagesSize = sizeof(header) + header.DirtyPagesCount * sizeof(DirtyPageReference);
+    for (DWORD i = 0; i < header.DirtyPagesCount; i++)
+    {
+        if (pPages[i].Offset % kHivePageSize != 0 || pPages[i].Size % kHivePageSize != 0
+            || static_cast<ULONG64>(pPages[i].Offset) + pPages[i].Size > header.HiveBinsDataSize)
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ullPagesSize += pPages[i].Size;
+    }
+
+    if (ullPagesSize > header.Size)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    return S_OK;
+}
+
+}  // namespace
+
+ULONG64 RegistryHive::Marvin32(const BYTE* pData, size_t cbData, ULONG64 ullSeed)
+{
+    DWORD lo = static_cast<DWORD>(ullSeed);
+    DWORD hi = static_cast<DWORD>(ullSeed >> 32);
+
+    const auto block = [&lo, &hi]() {
+        hi ^= lo;
+        lo = _rotl(lo, 20);
+        lo += hi;
+        hi = _rotl(hi, 9);
+        hi ^= lo;
+        lo = _rotl(lo, 27);
+        lo += hi;
+        hi = _rotl(hi, 19);
+    };
+
+    for (; cbData >= sizeof(DWORD); cbData -= sizeof(DWORD), pData += sizeof(DWORD))
+    {
+        lo += *reinterpret_cast<const DWORD*>(pData);
+        block();
+    }
+
+    DWORD dwFinal = 0x80;
+    for (size_t i = cbData; i > 0; i--)
+        dwFinal = (dwFinal << 8) | pData[i - 1];
+
+    lo += dwFinal;
+    block();
+    block();
+
+    return (static_cast<ULONG64>(hi) << 32) | lo;
+}
+
+HRESULT RegistryHive::GrowHive(ULONG64 ullSize)
+{
+    if (ullSize <= m_ulHiveBufferSize)
+        return S_OK;
+
+    BYTE* pBuffer = nullptr;
+    if (m_pLazyStream != nullptr)
+    {
+        pBuffer = (BYTE*)VirtualAlloc(NULL, (SIZE_T)ullSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (pBuffer == nullptr)
+            return E_OUTOFMEMORY;
+
+        for (size_t i = 0; i < m_LoadedPages.size(); i++)
+        {
+            if (!m_LoadedPages[i])
+                continue;
+
+            const auto ullPageStart = i * kLazyPageSize;
+            CopyMemory(
+                pBuffer + ullPageStart,
+                m_pHiveBuffer + ullPageStart,
+                (size_t)std::min(kLazyPageSize, m_ulHiveBufferSize - ullPageStart));
+        }
+
+        VirtualFree(m_pHiveBuffer, 0L, MEM_RELEASE);
+
+        // Pages past the end of the stream have nothing to read
+        m_LoadedPages.resize((size_t)((ullSize + kLazyPageSize - 1) / kLazyPageSize), true);
+    }
+    else
+    {
+        // A mapped hive that grows is copied: its pages cannot extend the file mapping
+        pBuffer = (BYTE*)malloc((size_t)ullSize);
+        if (pBuffer == nullptr)
+            return E_OUTOFMEMORY;
+
+        CopyMemory(pBuffer, m_pHiveBuffer, (size_t)m_ulHiveBufferSize);
+        ZeroMemory(pBuffer + m_ulHiveBufferSize, (size_t)(ullSize - m_ulHiveBufferSize));
+
+        if (m_hMapping != NULL)
+        {
+            UnmapViewOfFile(m_pHiveBuffer);
+            CloseHandle(m_hMapping);
+            m_hMapping = NULL;
+        }
+        else
+        {
+            free(m_pHiveBuffer);
+        }
+    }
+
+    Log::Debug(
+        L"Hive '{}': grown from {} to {} bytes by its transaction logs", m_strHiveName, m_ulHiveBufferSize, ullSize);
+
+    m_pHiveBuffer = pBuffer;
+    m_ulHiveBufferSize = ullSize;
+    return S_OK;
+}
+
+void RegistryHive::WriteHive(ULONG64 ullOffset, const BYTE* pData, ULONG64 ullSize)
+{
+    if (ullOffset >= m_ulHiveBufferSize)
+        return;
+
+    ullSize = std::min(ullSize, m_ulHiveBufferSize - ullOffset);
+
+    // Lazily loaded pages are read before being patched, they would be read over the replayed data otherwise
+    if (m_pLazyStream != nullptr)
+        LoadRange(ullOffset, ullSize);
+
+    CopyMemory(m_pHiveBuffer + ullOffset, pData, (size_t)ullSize);
+}
+
+HRESULT RegistryHive::ReplayLogEntries(
+    const std::vector<std::shared_ptr<ByteStream>>& logs,
+    DWORD& dwSequence,
+    ULONG64& ullPages)
+{
+    HRESULT hr = E_FAIL;
+
+    struct Entry
+    {
+        size_t Log;
+        ULONG64 Offset;
+        DWORD Sequence;
+    };
+
+    // The entries of both logs are validated then applied in sequence order, their content is only kept while applied
+    std::vector<Entry> entries;
+    std::vector<BYTE> entry;
+
+    for (size_t i = 0; i < logs.size(); i++)
+    {
+        ULONG64 ullOffset = kLogBaseBlockSize;
+        while (SUCCEEDED(ReadLogEntry(*logs[i], ullOffset, entry)))
+        {
+            const auto& header = *reinterpret_cast<const LogEntryHeader*>(entry.data());
+            entries.push_back({i, ullOffset, header.SequenceNumber});
+            ullOffset += header.Size;
+        }
+    }
+
+    std::stable_sort(std::begin(entries), std::end(entries), [](const Entry& left, const Entry& right) {
+        return left.Sequence < right.Sequence;
+    });
+
+    // Entries already in the hive are replayed again (they hold whole pages), the run stops on a missing entry
+    auto it = std::find_if(std::cbegin(entries), std::cend(entries), [dwSequence](const Entry& e) {
+        return e.Sequence >= dwSequence;
+    });
+
+    // Entries applied over a hive missing the previous ones would leave it inconsistent: the logs are not replayed
+    if (it != std::cend(entries) && it->Sequence != dwSequence)
+    {
+        Log::Warn(
+            L"Hive '{}': transaction logs start at sequence {} instead of {}, they are not replayed",
+            m_strHiveName,
+            it->Sequence,
+            dwSequence);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    DWORD dwHiveBinsDataSize = 0L;
+    std::optional<DWORD> lastSequence;
+    for (; it != std::cend(entries); ++it)
+    {
+        if (lastSequence && it->Sequence == *lastSequence)
+            continue;
+
+        if (lastSequence && it->Sequence != *lastSequence + 1)
+        {
+            Log::Debug(L"Hive '{}': transaction log entry {} is missing", m_strHiveName, *lastSequence + 1);
+            break;
+        }
+
+        if (FAILED(hr = ReadLogEntry(*logs[it->Log], it->Offset, entry)))
+            break;
+
+        const auto& header = *reinterpret_cast<const LogEntryHeader*>(entry.data());
+        if (FAILED(hr = GrowHive(kBaseBlockSize + header.HiveBinsDataSize)))
+        {
+            Log::Error(L"Hive '{}': not enough memory to replay transaction logs", m_strHiveName);
+            return hr;
+        }
+
+        const auto pPages = reinterpret_cast<const DirtyPageReference*>(entry.data() + sizeof(header));
+        const BYTE* pData = entry.data() + sizeof(header) + header.DirtyPagesCount * sizeof(DirtyPageReference);
+        for (DWORD i = 0; i < header.DirtyPagesCount; i++)
+        {
+            WriteHive(kBaseBlockSize + pPages[i].Offset, pData, pPages[i].Size);
+            pData += pPages[i].Size;
+            ullPages += pPages[i].Size / kHivePageSize;
+        }
+
+        dwHiveBinsDataSize = header.HiveBinsDataSize;
+        lastSequence = it->Sequence;
+    }
+
+    if (!lastSequence)
+        return S_FALSE;
+
+    dwSequence = *lastSequence + 1;
+
+    std::array<BYTE, kLogBaseBlockSize> baseBlock;
+    CopyMemory(baseBlock.data(), m_pHiveBuffer, baseBlock.size());
+    SetField(baseBlock.data(), kHiveBinsDataSizeOffset, dwHiveBinsDataSize);
+    SetField(baseBlock.data(), kPrimarySequenceOffset, dwSequence);
+    SetField(baseBlock.data(), kSecondarySequenceOffset, dwSequence);
+    SetField(baseBlock.data(), kCheckSumOffset, ComputeCheckSum(baseBlock.data()));
+    WriteHive(0LL, baseBlock.data(), baseBlock.size());
+
+    return S_OK;
+}
+
+HRESULT RegistryHive::ReplayDirtyVector(ByteStream& log, ULONG64& ullPages)
+{
+    HRESULT hr = E_FAIL;
+
+    std::array<BYTE, kLogBaseBlockSize> baseBlock;
+    if (FAILED(hr = ReadAt(log, 0LL, baseBlock.data(), baseBlock.size())))
+        return hr;
+
+    // One bit per 512 bytes sector of the hive bins, then the dirty sectors
+    const ULONG64 ullHiveBinsDataSize = GetField(baseBlock.data(), kHiveBinsDataSizeOffset);
+    const ULONG64 ullSectors = ullHiveBinsDataSize / kLogSectorSize;
+
+    std::vector<BYTE> vector((size_t)(4 + (ullSectors + 7) / 8));
+    if (FAILED(hr = ReadAt(log, kLogBaseBlockSize, vector.data(), vector.size())))
+        return hr;
+
+    if (strncmp(reinterpret_cast<const char*>(vector.data()), "DIRT", 4) != 0)
+    {
+        Log::Debug(L"Hive '{}': transaction log has no dirty vector", m_strHiveName);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    if (FAILED(hr = GrowHive(kBaseBlockSize + ullHiveBinsDataSize)))
+    {
+        Log::Error(L"Hive '{}': not enough memory to replay transaction log", m_strHiveName);
+        return hr;
+    }
+
+    const BYTE* pBitmap = vector.data() + 4;
+    const auto isDirty = [pBitmap](ULONG64 ullSector) {
+        return (pBitmap[ullSector / 8] & (1 << (ullSector % 8))) != 0;
+    };
+
+    // Runs of dirty sectors are stored one after the other, each run is read at once
+    ULONG64 ullLogOffset = (kLogBaseBlockSize + vector.size() + kLogSectorSize - 1) / kLogSectorSize * kLogSectorSize;
+    std::vector<BYTE> run;
+    for (ULONG64 ullSector = 0; ullSector < ullSectors;)
+    {
+        if (!isDirty(ullSector))
+        {
+            ullSector++;
+            continue;
+        }
+
+        ULONG64 ullCount = 1;
+        while (ullSector + ullCount < ullSectors && isDirty(ullSector + ullCount))
+            ullCount++;
+
+        run.resize((size_t)(ullCount * kLogSectorSize));
+        if (FAILED(hr = ReadAt(log, ullLogOffset, run.data(), run.size())))
+        {
+            Log::Debug(L"Hive '{}': transaction log is truncated [{}]", m_strHiveName, SystemError(hr));
+            return hr;
+        }
+
+        WriteHive(kBaseBlockSize + ullSector * kLogSectorSize, run.data(), run.size());
+
+        ullLogOffset += run.size();
+        ullPages += ullCount;
+        ullSector += ullCount;
+    }
+
+    // The log base block is the one of the hive once the sectors are written
+    SetField(baseBlock.data(), kFileTypeOffset, 0L);
+    SetField(baseBlock.data(), kSecondarySequenceOffset, GetField(baseBlock.data(), kPrimarySequenceOffset));
+    SetField(baseBlock.data(), kCheckSumOffset, ComputeCheckSum(baseBlock.data()));
+    WriteHive(0LL, baseBlock.data(), baseBlock.size());
+
+    return S_OK;
+}
+
+HRESULT RegistryHive::ReplayLogs(const std::vector<std::shared_ptr<ByteStream>>& logs)
+{
+    HRESULT hr = E_FAIL;
+
+    if (m_pHiveBuffer == nullptr || m_ulHiveBufferSize < kBaseBlockSize)
+    {
+        Log::Error(L"Hive '{}': hive is not loaded", m_strHiveName);
+        return E_UNEXPECTED;
+    }
+
+    if (m_pLazyStream != nullptr)
+        LoadRange(0LL, kLogBaseBlockSize);
+
+    std::vector<std::shared_ptr<ByteStream>> entryLogs;
+    std::shared_ptr<ByteStream> vectorLog;
+    DWORD dwVectorLogSequence = 0L;
+
+    for (const auto& log : logs)
+    {
+        if (log == nullptr)
+            continue;
+
+        std::array<BYTE, kLogBaseBlockSize> baseBlock;
+        if (FAILED(ReadAt(*log, 0LL, baseBlock.data(), baseBlock.size())) || !IsValidBaseBlock(baseBlock.data()))
+        {
+            Log::Debug(L"Hive '{}': ignoring a transaction log without a valid base block", m_strHiveName);
+            continue;
+        }
+
+        // Log entries are matched to the hive by their sequence number when replayed, of the dirty vector logs only
+        // the most recent complete one is kept
+        const auto dwType = GetField(baseBlock.data(), kFileTypeOffset);
+        if (dwType == kFileTypeLogEntries)
+        {
+            entryLogs.push_back(log);
+        }
+        else if (dwType == kFileTypeLog || dwType == kFileTypeLogAlternate)
+        {
+            const auto dwSequence = GetField(baseBlock.data(), kPrimarySequenceOffset);
+            if (dwSequence == GetField(baseBlock.data(), kSecondarySequenceOffset)
+                && (vectorLog == nullptr || dwSequence > dwVectorLogSequence))
+            {
+                vectorLog = log;
+                dwVectorLogSequence = dwSequence;
+            }
+        }
+    }
+
+    const auto dwPrimary = GetField(m_pHiveBuffer, kPrimarySequenceOffset);
+    const auto dwSecondary = GetField(m_pHiveBuffer, kSecondarySequenceOffset);
+
+    ULONG64 ullPages = 0LL;
+    if (!entryLogs.empty())
+    {
+        DWORD dwSequence = std::min(dwPrimary, dwSecondary);
+        if (FAILED(hr = ReplayLogEntries(entryLogs, dwSequence, ullPages)))
+            return hr;
+    }
+    else if (vectorLog != nullptr && dwPrimary != dwSecondary)
+    {
+        if (FAILED(hr = ReplayDirtyVector(*vectorLog, ullPages)))
+            return hr;
+    }
+    else
+    {
+        hr = S_FALSE;
+    }
+
+    if (hr == S_FALSE)
+    {
+        if (dwPrimary != dwSecondary)
+            Log::Warn(L"Hive '{}': hive is dirty and no transaction log could be replayed", m_strHiveName);
+        return S_FALSE;
+    }
+
+    Log::Debug(L"Hive '{}': replayed {} dirty pages from transaction logs", m_strHiveName, ullPages);
+
+    m_bIsComplete = true;
+    return CheckHive();
+}
@@ -9,6 +9,10 @@
 
 #include "RegistryWalker.h"
 
+#include "FileStream.h"
+
+#include <ppl.h>
+
 using namespace Orc;
 
 RegistryValue::RegistryValue(
@@ -90,6 +94,7 @@ RegistryKey::RegistryKey(
     , m_Type(Type)
     , m_pRegKey(pRegKey)
     , m_bTreated(false)
+    , m_bSubKeysPruned(false)
     , m_dwSubKeysSeen(0)
     , m_bSubkeyListIsResident(bSukeyListIsResident)
     , m_bHasNonResidentSubkeys(false)
@@ -250,6 +255,8 @@ HRESULT RegistryHive::LoadHive(ByteStream& HiveStream)
         return E_FAIL;
     }
 
+    Unload();
+
     m_pHiveBuffer = (BYTE*)malloc((size_t)ulSize);
     if (m_pHiveBuffer == NULL)
     {
@@ -257,6 +264,7 @@ HRESULT RegistryHive::LoadHive(ByteStream& HiveStream)
         return E_OUTOFMEMORY;
     }
     m_ulHiveBufferSize = ulSize;
+    m_Mode = LoadMode::Copy;
 
     ULONG64 ulRead = 0LL;
     ULONG64 ulTmp = 0LL;
@@ -268,33 +276,212 @@ HRESULT RegistryHive::LoadHive(ByteStream& HiveStream)
         if (ulTmp == 0)
         {
             Log::Error("Read error, aborting read operation");
-            free(m_pHiveBuffer);
-            m_pHiveBuffer = nullptr;
-            m_ulHiveBufferSize = 0LL;
+            Unload();
             return hr;
         }
         ulRead += ulTmp;
     }
+
+    return CheckHive();
+}
+
+HRESULT RegistryHive::LoadHive(const std::shared_ptr<ByteStream>& pHiveStream, LoadMode mode)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pHiveStream == nullptr)
+        return E_INVALIDARG;
+
+    if (mode == LoadMode::Copy)
+        return LoadHive(*pHiveStream);
+
+    if ((hr = pHiveStream->IsOpen()) != S_OK)
+    {
+        Log::Error("Hive stream seems to be closed");
+        return hr;
+    }
+    if ((hr = pHiveStream->CanRead()) != S_OK)
+    {
+        Log::Error("Can't read hive stream");
+        return hr;
+    }
+
+    ULONG64 ulSize = pHiveStream->GetSize();
+    if (ulSize == 0)
+    {
+        Log::Error("Hive size is 0");
+        return E_FAIL;
+    }
+
+    Unload();
+
+    auto pFileStream = std::dynamic_pointer_cast<FileStream>(pHiveStream);
+    if (pFileStream != nullptr && pFileStream->GetHandle() != INVALID_HANDLE_VALUE)
+        hr = MapHive(pFileStream->GetHandle(), ulSize);
+    else
+        hr = ReserveHive(pHiveStream, ulSize);
+
+    if (FAILED(hr))
+    {
+        Unload();
+        return hr;
+    }
+
+    m_Mode = LoadMode::Mapped;
+    return CheckHive();
+}
+
+HRESULT RegistryHive::MapHive(HANDLE hFile, ULONG64 ulSize)
+{
+    HRESULT hr = E_FAIL;
+
+    m_hMapping = CreateFileMappingW(hFile, NULL, PAGE_WRITECOPY, 0L, 0L, NULL);
+    if (m_hMapping == NULL)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Hive '{}': failed to create file mapping [{}]", m_strHiveName, SystemError(hr));
+        return hr;
+    }
+
+    // Pages are only faulted in as the walk reaches them. The view is copy on write so that pages replayed from the
+    // transaction logs get a private copy while the others stay shared with the file cache.
+    m_pHiveBuffer = (BYTE*)MapViewOfFile(m_hMapping, FILE_MAP_COPY, 0L, 0L, (SIZE_T)ulSize);
+    if (m_pHiveBuffer == nullptr)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        Log::Error(L"Hive '{}': failed to map hive [{}]", m_strHiveName, SystemError(hr));
+        return hr;
+    }
+
+    m_ulHiveBufferSize = ulSize;
+    return S_OK;
+}
+
+HRESULT RegistryHive::ReserveHive(const std::shared_ptr<ByteStream>& pHiveStream, ULONG64 ulSize)
+{
+    // Committed pages are only backed by physical memory once touched, which only happens when they are read
+    m_pHiveBuffer = (BYTE*)VirtualAlloc(NULL, (SIZE_T)ulSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (m_pHiveBuffer == nullptr)
+    {
+        Log::Error("Not enough memory to reserve hive");
+        return E_OUTOFMEMORY;
+    }
+
+    m_ulHiveBufferSize = ulSize;
+    m_pLazyStream = pHiveStream;
+    m_LoadedPages.assign((size_t)((ulSize + kLazyPageSize - 1) / kLazyPageSize), false);
+
+    // Base block and first hbin header
+    LoadRange(0LL, std::min<ULONG64>(ulSize, 0x1000 + sizeof(HBINHeader)));
+    return S_OK;
+}
+
+void RegistryHive::LoadRange(ULONG64 ullStart, ULONG64 ullLength) const
+{
+    if (ullStart >= m_ulHiveBufferSize || ullLength == 0)
+        return;
+
+    ullLength = std::min(ullLength, m_ulHiveBufferSize - ullStart);
+
+    const auto ullFirstPage = ullStart / kLazyPageSize;
+    const auto ullLastPage = (ullStart + ullLength - 1) / kLazyPageSize;
+
+    concurrency::critical_section::scoped_lock lock(m_LazyLock);
+
+    for (auto ullPage = ullFirstPage; ullPage <= ullLastPage; ullPage++)
+    {
+        if (m_LoadedPages[(size_t)ullPage])
+            continue;
+
+        // Failed pages are not retried, they remain zeroed and fail the cells checks
+        m_LoadedPages[(size_t)ullPage] = true;
+
+        const auto ullPageStart = ullPage * kLazyPageSize;
+        const auto ullPageSize = std::min(kLazyPageSize, m_ulHiveBufferSize - ullPageStart);
+
+        if (FAILED(m_pLazyStream->SetFilePointer(ullPageStart, FILE_BEGIN, nullptr)))
+        {
+            Log::Debug(L"Hive '{}': failed to seek to offset {:#x}", m_strHiveName, ullPageStart);
+            continue;
+        }
+
+        ULONG64 ullRead = 0LL;
+        while (ullRead < ullPageSize)
+        {
+            ULONG64 ullChunk = 0LL;
+            m_pLazyStream->Read(m_pHiveBuffer + ullPageStart + ullRead, ullPageSize - ullRead, &ullChunk);
+            if (ullChunk == 0)
+            {
+                Log::Debug(L"Hive '{}': failed to read page at offset {:#x}", m_strHiveName, ullPageStart);
+                break;
+            }
+            ullRead += ullChunk;
+        }
+    }
+}
+
+void RegistryHive::LoadCell(DWORD dwOffset) const
+{
+    const LONG64 llStart = (LONG64)(int)dwOffset + 0x1000;
+    if (llStart < 0 || (ULONG64)llStart >= m_ulHiveBufferSize)
+        return;
+
+    LoadRange(llStart, sizeof(BlockHeader));
+
+    // Allocated cells have a negative size
+    const auto lCellSize = static_cast<LONG64>(*reinterpret_cast<const int*>(m_pHiveBuffer + llStart));
+    LoadRange(llStart, lCellSize < 0 ? -lCellSize : lCellSize);
+}
+
+HRESULT RegistryHive::CheckHive()
+{
+    HRESULT hr = E_FAIL;
+
     if ((hr = ParseHiveHeader()) != S_OK)
     {
-        free(m_pHiveBuffer);
-        m_pHiveBuffer = nullptr;
-        m_ulHiveBufferSize = 0L;
+        Unload();
         Log::Error("Error during hive header parsing [{}]", SystemError(hr));
         return hr;
     }
 
     if ((hr = ParseHBinHeader()) != S_OK)
     {
-        free(m_pHiveBuffer);
-        m_pHiveBuffer = nullptr;
-        m_ulHiveBufferSize = 0;
+        Unload();
         Log::Error("Error during hive hbin header parsing [{}]", SystemError(hr));
         return hr;
     }
     return S_OK;
 }
 
+void RegistryHive::Unload()
+{
+    if (m_pHiveBuffer != nullptr)
+    {
+        if (m_hMapping != NULL)
+            UnmapViewOfFile(m_pHiveBuffer);
+        else if (m_pLazyStream != nullptr)
+            VirtualFree(m_pHiveBuffer, 0L, MEM_RELEASE);
+        else
+            free(m_pHiveBuffer);
+        m_pHiveBuffer = nullptr;
+    }
+
+    if (m_hMapping != NULL)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+
+    m_pLazyStream.reset();
+    m_LoadedPages.clear();
+    m_ulHiveBufferSize = 0LL;
+}
+
+RegistryHive::~RegistryHive()
+{
+    Unload();
+}
+
 HRESULT RegistryHive::CheckBlockHeader(const BlockHeader* const pBlockHeader) const
 {
     HRESULT hr = E_FAIL;
@@ -1026,12 +1213,8 @@ HRESULT RegistryHive::ParseHBinHeader()
     return S_OK;
 }
 
-HRESULT RegistryHive::Walk(
-    std::function<void(const RegistryKey* const)> RegistryKeyCallBack,
-    std::function<void(const RegistryValue* const)> RegistryValueCallback)
+HRESULT RegistryHive::BuildRootKey(RegistryKey*& pRootKey)
 {
-    HRESULT hr = E_FAIL;
-
     bool bSubkeyListIsResident;
     bool bValueListIsResident;
     bool bSkHeaderIsResident;
@@ -1077,7 +1260,7 @@ HRESULT RegistryHive::Walk(
     std::string ShortName(pRegKey->Name, pRegKey->NameLength);
 
     // Build rootkey
-    RegistryKey* const RootKeyRegistryKey = new RegistryKey(
+    pRootKey = new RegistryKey(
         std::move(Name),
         std::move(ShortName),
         std::move(ClassName),
@@ -1092,8 +1275,18 @@ HRESULT RegistryHive::Walk(
         bSkHeaderIsResident,
         bHasClassName);
 
-    std::vector<RegistryKey*> CurrentKeySet;
-    CurrentKeySet.push_back(RootKeyRegistryKey);
+    return S_OK;
+}
+
+void RegistryHive::WalkKeys(
+    std::vector<RegistryKey*>& CurrentKeySet,
+    const RegistryKey* const pSharedKey,
+    const std::function<void(const RegistryKey* const)>& RegistryKeyCallBack,
+    const std::function<void(const RegistryValue* const)>& RegistryValueCallback,
+    const std::function<bool(const RegistryKey* const)>& SubKeysFilter)
+{
+    HRESULT hr = E_FAIL;
+
     RegistryKey* CurrentKey;
     while (!CurrentKeySet.empty())
     {
@@ -1103,7 +1296,7 @@ HRESULT RegistryHive::Walk(
         if (CurrentKey->GetKeyStatus())
         {
             CurrentKeySet.pop_back();
-            if (CurrentKey->GetSubKeysCount() != CurrentKey->GetSeenSubKeysCount())
+            if (!CurrentKey->m_bSubKeysPruned && CurrentKey->GetSubKeysCount() != CurrentKey->GetSeenSubKeysCount())
                 Log::Debug(
                     "Key '{}': number of subkeys parsed is different from number of subkeys announced.({} announced, "
                     "{} parsed)",
@@ -1117,11 +1310,15 @@ HRESULT RegistryHive::Walk(
 
         RegistryKey* const pParentKey = CurrentKey->GetAlterableParentKey();
 
-        // Increment counter of treated subkeys
-        if (pParentKey != nullptr)
+        // Increment counter of treated subkeys, the shared key is counted by its owner
+        if (pParentKey != nullptr && pParentKey != pSharedKey)
             pParentKey->IncrementSubKeysSeenCount();
 
-        if ((hr = ParseNks(CurrentKey, CurrentKeySet)) != S_OK)
+        if (SubKeysFilter && !SubKeysFilter(CurrentKey))
+        {
+            CurrentKey->m_bSubKeysPruned = true;
+        }
+        else if ((hr = ParseNks(CurrentKey, CurrentKeySet)) != S_OK)
         {
             Log::Debug("Error during parsing of '{}' subkeys", CurrentKey->GetKeyName());
         }
@@ -1135,5 +1332,70 @@ HRESULT RegistryHive::Walk(
         // call key callback
         RegistryKeyCallBack(CurrentKey);
     }
+}
+
+HRESULT RegistryHive::Walk(
+    std::function<void(const RegistryKey* const)> RegistryKeyCallBack,
+    std::function<void(const RegistryValue* const)> RegistryValueCallback,
+    std::function<bool(const RegistryKey* const)> SubKeysFilter)
+{
+    HRESULT hr = E_FAIL;
+
+    RegistryKey* pRootKey = nullptr;
+    if ((hr = BuildRootKey(pRootKey)) != S_OK)
+        return hr;
+
+    std::vector<RegistryKey*> CurrentKeySet;
+    CurrentKeySet.push_back(pRootKey);
+    WalkKeys(CurrentKeySet, nullptr, RegistryKeyCallBack, RegistryValueCallback, SubKeysFilter);
+    return S_OK;
+}
+
+HRESULT RegistryHive::ParallelWalk(
+    std::function<void(const RegistryKey* const)> RegistryKeyCallBack,
+    std::function<void(const RegistryValue* const)> RegistryValueCallback,
+    std::function<bool(const RegistryKey* const)> SubKeysFilter)
+{
+    HRESULT hr = E_FAIL;
+
+    RegistryKey* pRootKey = nullptr;
+    if ((hr = BuildRootKey(pRootKey)) != S_OK)
+        return hr;
+
+    // Root key is parsed here, each of its subkeys is the root of a subtree walked by a worker
+    std::vector<RegistryKey*> SubKeys;
+    if (SubKeysFilter && !SubKeysFilter(pRootKey))
+    {
+        pRootKey->m_bSubKeysPruned = true;
+    }
+    else if ((hr = ParseNks(pRootKey, SubKeys)) != S_OK)
+    {
+        Log::Debug("Error during parsing of '{}' subkeys", pRootKey->GetKeyName());
+    }
+    if ((hr = ParseValues(pRootKey, RegistryValueCallback)) != S_OK)
+    {
+        Log::Debug("Error during parsing of '{}' values", pRootKey->GetKeyName());
+    }
+    pRootKey->SetAsTreated();
+    RegistryKeyCallBack(pRootKey);
+
+    concurrency::parallel_for(size_t(0), SubKeys.size(), [&](size_t i) {
+        std::vector<RegistryKey*> CurrentKeySet;
+        CurrentKeySet.push_back(SubKeys[i]);
+        WalkKeys(CurrentKeySet, pRootKey, RegistryKeyCallBack, RegistryValueCallback, SubKeysFilter);
+    });
+
+    for (size_t i = 0; i < SubKeys.size(); i++)
+        pRootKey->IncrementSubKeysSeenCount();
+
+    if (!pRootKey->m_bSubKeysPruned && pRootKey->GetSubKeysCount() != pRootKey->GetSeenSubKeysCount())
+        Log::Debug(
+            "Key '{}': number of subkeys parsed is different from number of subkeys announced.({} announced, "
+            "{} parsed)",
+            pRootKey->GetKeyName(),
+            pRootKey->GetSubKeysCount(),
+            pRootKey->GetSeenSubKeysCount());
+
+    delete pRootKey;
     return S_OK;
 }
@@ -12,6 +12,10 @@
 #include <string>
 #include <functional>
 #include <algorithm>
+#include <memory>
+#include <atomic>
+
+#include <concrt.h>
 
 #include "ByteStream.h"
 
@@ -267,21 +271,60 @@ public:
 
 class ORCLIB_API RegistryHive
 {
+public:
+    enum class LoadMode
+    {
+        // The whole hive is read in private memory
+        Copy,
+        // Hive files are mapped copy on write, other streams (ie: NTFS data streams) are read by pages as cells are
+        // accessed. Only the hbins reached by the walk are read.
+        Mapped
+    };
+
 private:
     BYTE* m_pHiveBuffer;
     ULONG64 m_ulHiveBufferSize;
 
+    LoadMode m_Mode = LoadMode::Copy;
+    HANDLE m_hMapping = NULL;
+
+    // Mapped mode over a stream: pages of the hive buffer are read on first access
+    static constexpr ULONG64 kLazyPageSize = 0x10000;
+    std::shared_ptr<ByteStream> m_pLazyStream;
+    mutable std::vector<bool> m_LoadedPages;
+    mutable concurrency::critical_section m_LazyLock;
+
     FILETIME* m_pLastModificationTime;
     DWORD m_dwRootKeyOffset;
     DWORD m_dwDataBlockSize;
-    bool m_bIsComplete;
+    std::atomic<bool> m_bIsComplete;
 
     std::wstring m_strHiveName;
 
     std::function<void(const RegistryKey&)> m_RegistryKeyCallBack;
     std::function<void(const RegistryValue&)> m_RegistryValueCallback;
 
-    BYTE* FixOffset(DWORD offset) const { return (m_pHiveBuffer + (int)offset + 0x1000); };
+    BYTE* FixOffset(DWORD offset) const
+    {
+        if (m_pLazyStream)
+            LoadCell(offset);
+        return (m_pHiveBuffer + (int)offset + 0x1000);
+    };
+
+    void LoadCell(DWORD dwOffset) const;
+    void LoadRange(ULONG64 ullStart, ULONG64 ullLength) const;
+
+    HRESULT MapHive(HANDLE hFile, ULONG64 ulSize);
+    HRESULT ReserveHive(const std::shared_ptr<ByteStream>& pHiveStream, ULONG64 ulSize);
+    HRESULT CheckHive();
+    void Unload();
+
+    // Transaction logs replay (see RegistryHiveLog.cpp)
+    HRESULT GrowHive(ULONG64 ullSize);
+    void WriteHive(ULONG64 ullOffset, const BYTE* pData, ULONG64 ullSize);
+    HRESULT
+    ReplayLogEntries(const std::vector<std::shared_ptr<ByteStream>>& logs, DWORD& dwSequence, ULONG64& ullPages);
+    HRESULT ReplayDirtyVector(ByteStream& log, ULONG64& ullPages);
 
     bool IsOffsetValid(DWORD dwOffset) const
     {
@@ -322,29 +365,51 @@ private:
 
     void SetHiveIsNotComplete();
 
+    HRESULT BuildRootKey(RegistryKey*& pRootKey);
+    void WalkKeys(
+        std::vector<RegistryKey*>& CurrentKeySet,
+        const RegistryKey* const pSharedKey,
+        const std::function<void(const RegistryKey* const)>& RegistryKeyCallBack,
+        const std::function<void(const RegistryValue* const)>& RegistryValueCallback,
+        const std::function<bool(const RegistryKey* const)>& SubKeysFilter);
+
 public:
     RegistryHive(const std::wstring& HiveName);
     RegistryHive();
 
     HRESULT LoadHive(ByteStream& HiveStream);
+    HRESULT LoadHive(const std::shared_ptr<ByteStream>& pHiveStream, LoadMode mode);
+
+    // Applies the dirty pages of the transaction logs ('.LOG1', '.LOG2') of a loaded hive. Only modified pages use
+    // memory: mapped hives get private copies of the replayed pages, others are written in place.
+    // Returns S_FALSE when the hive is up to date with its logs. Logs missing entries the hive needs are not replayed
+    // and fail with HRESULT_FROM_WIN32(ERROR_INVALID_DATA).
+    HRESULT ReplayLogs(const std::vector<std::shared_ptr<ByteStream>>& logs);
+
+    // Marvin32 hash of 'pData', log entries are hashed with a fixed seed
+    static ULONG64 Marvin32(const BYTE* pData, size_t cbData, ULONG64 ullSeed);
+
+    // When 'SubKeysFilter' returns false for a key, its subkeys are not parsed (the key and its values still are)
     HRESULT Walk(
         std::function<void(const RegistryKey* const)> RegistryKeyCallBack,
-        std::function<void(const RegistryValue* const)> RegistryValueCallback);
+        std::function<void(const RegistryValue* const)> RegistryValueCallback,
+        std::function<bool(const RegistryKey* const)> SubKeysFilter = nullptr);
+
+    // Walks the subtrees of the root key's subkeys concurrently: callbacks must be thread safe and are called in no
+    // particular order between subtrees
+    HRESULT ParallelWalk(
+        std::function<void(const RegistryKey* const)> RegistryKeyCallBack,
+        std::function<void(const RegistryValue* const)> RegistryValueCallback,
+        std::function<bool(const RegistryKey* const)> SubKeysFilter = nullptr);
     bool IsHiveComplete() const;
 
-    ~RegistryHive()
-    {
-        if (m_pHiveBuffer != nullptr)
-            free(m_pHiveBuffer);
-    };
+    ~RegistryHive();
 };
 
 class ORCLIB_API RegistryKey
 {
 
-    friend HRESULT RegistryHive::Walk(
-        std::function<void(const RegistryKey* const)> RegistryKeyCallBack,
-        std::function<void(const RegistryValue* const)> RegistryValueCallback);
+    friend class RegistryHive;
 
 private:
     RegistryKey* GetAlterableParentKey();
@@ -363,6 +428,7 @@ private:
 
     const KeyHeader* const m_pRegKey;
     bool m_bTreated;
+    bool m_bSubKeysPruned;
 
     // Non resident/incomplete keys
 
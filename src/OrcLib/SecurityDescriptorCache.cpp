@@ -0,0 +1,135 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "SecurityDescriptorCache.h"
+
+#include <Sddl.h>
+
+#include "Log/Log.h"
+
+using namespace Orc;
+
+HRESULT SecurityDescriptorCache::Add(const SECURITY_DESCRIPTOR_ENTRY& entry)
+{
+    HRESULT hr = E_FAIL;
+
+    constexpr DWORD dwHeaderSize = sizeof(SECURITY_DESCRIPTOR_ENTRY) - sizeof(SECURITY_DESCRIPTOR_RELATIVE);
+
+    if (m_BySecurityId.find(entry.SecID) != std::end(m_BySecurityId))
+        return S_FALSE;
+
+    const auto pSD = (PSECURITY_DESCRIPTOR)&entry.SecurityDescriptor;
+    if (entry.SizeEntry <= dwHeaderSize || !IsValidSecurityDescriptor(pSD))
+    {
+        Log::Debug("Invalid security descriptor entry (id: {})", entry.SecID);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    const DWORD dwLength = GetSecurityDescriptorLength(pSD);
+    if (dwLength > entry.SizeEntry - dwHeaderSize)
+    {
+        Log::Debug("Invalid security descriptor length (id: {}, length: {})", entry.SecID, dwLength);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    const auto pBytes = reinterpret_cast<const BYTE*>(pSD);
+
+    const auto [first, last] = m_ByHash.equal_range(entry.Hash);
+    for (auto it = first; it != last; ++it)
+    {
+        const auto& bytes = it->second->Bytes;
+        if (bytes.size() == dwLength && std::equal(std::cbegin(bytes), std::cend(bytes), pBytes))
+        {
+            m_BySecurityId.emplace(entry.SecID, it->second);
+            return S_OK;
+        }
+    }
+
+    auto descriptor = std::make_shared<Descriptor>();
+    descriptor->Hash = entry.Hash;
+    descriptor->Bytes.assign(pBytes, pBytes + dwLength);
+
+    if (FAILED(hr = Render(pSD, *descriptor)))
+    {
+        Log::Debug("Failed to render security descriptor (id: {}) [{}]", entry.SecID, SystemError(hr));
+        return hr;
+    }
+
+    m_ByHash.emplace(entry.Hash, descriptor);
+    m_BySecurityId.emplace(entry.SecID, std::move(descriptor));
+    return S_OK;
+}
+
+const SecurityDescriptorCache::Descriptor* SecurityDescriptorCache::Find(ULONG ulSecurityId) const
+{
+    const auto it = m_BySecurityId.find(ulSecurityId);
+    if (it == std::cend(m_BySecurityId))
+        return nullptr;
+    return it->second.get();
+}
+
+HRESULT SecurityDescriptorCache::Render(PSECURITY_DESCRIPTOR pSD, Descriptor& descriptor)
+{
+    const SECURITY_INFORMATION InfoFlags = OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION
+        | DACL_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION | LABEL_SECURITY_INFORMATION
+        | PROTECTED_DACL_SECURITY_INFORMATION | PROTECTED_SACL_SECURITY_INFORMATION
+        | UNPROTECTED_DACL_SECURITY_INFORMATION;
+
+    LPWSTR szSDDL = nullptr;
+    if (!ConvertSecurityDescriptorToStringSecurityDescriptor(pSD, SDDL_REVISION_1, InfoFlags, &szSDDL, NULL))
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    descriptor.SDDL = szSDDL;
+    LocalFree(szSDDL);
+
+    PSID pSidOwner = nullptr;
+    BOOL bOwnerDefaulted = FALSE;
+    if (!GetSecurityDescriptorOwner(pSD, &pSidOwner, &bOwnerDefaulted))
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    if (pSidOwner == nullptr)
+        return S_OK;
+
+    LPWSTR szSid = nullptr;
+    if (!ConvertSidToStringSid(pSidOwner, &szSid))
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    descriptor.OwnerSid = szSid;
+    LocalFree(szSid);
+
+    descriptor.Owner = LookupAccount(pSidOwner, descriptor.OwnerSid);
+    return S_OK;
+}
+
+const std::wstring& SecurityDescriptorCache::LookupAccount(PSID pSid, const std::wstring& strSid)
+{
+    const auto it = m_Accounts.find(strSid);
+    if (it != std::cend(m_Accounts))
+        return it->second;
+
+    constexpr DWORD kMaxName = 512;
+    DWORD dwNameLen = kMaxName;
+    WCHAR szName[kMaxName];
+    DWORD dwDomainLen = kMaxName;
+    WCHAR szDomain[kMaxName];
+    SID_NAME_USE NameUse;
+
+    std::wstring strAccount;
+    if (LookupAccountSid(NULL, pSid, szName, &dwNameLen, szDomain, &dwDomainLen, &NameUse))
+    {
+        strAccount = fmt::format(L"{}\\{}", szDomain, szName);
+    }
+    else
+    {
+        Log::Debug(L"Failed to lookup account of {} [{}]", strSid, LastWin32Error());
+        strAccount = strSid;
+    }
+
+    return m_Accounts.emplace(strSid, std::move(strAccount)).first->second;
+}
@@ -0,0 +1,65 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include "NtfsDataStructures.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Security descriptors of a volume's $Secure:$SDS, rendered once and looked up by the security ID of
+// $STANDARD_INFORMATION.
+//
+// The cache is filled from the $SDS entries before it is read: once filled, lookups do not lock and can be made
+// from any thread.
+class ORCLIB_API SecurityDescriptorCache
+{
+public:
+    struct Descriptor
+    {
+        ULONG Hash;
+        std::vector<BYTE> Bytes;
+        std::wstring SDDL;
+        std::wstring OwnerSid;
+        // DOMAIN\name, or the SID when it is not mapped to an account
+        std::wstring Owner;
+    };
+
+    SecurityDescriptorCache() = default;
+
+    // Returns S_FALSE when the security ID is already known ($SDS stores each entry twice)
+    HRESULT Add(const SECURITY_DESCRIPTOR_ENTRY& entry);
+
+    const Descriptor* Find(ULONG ulSecurityId) const;
+
+    size_t Count() const { return m_BySecurityId.size(); }
+    size_t DescriptorCount() const { return m_ByHash.size(); }
+
+private:
+    // Security IDs sharing the same descriptor share its rendering
+    std::unordered_map<ULONG, std::shared_ptr<const Descriptor>> m_BySecurityId;
+    std::unordered_multimap<ULONG, std::shared_ptr<const Descriptor>> m_ByHash;
+
+    // Owners of different descriptors are often the same account
+    std::unordered_map<std::wstring, std::wstring> m_Accounts;
+
+    HRESULT Render(PSECURITY_DESCRIPTOR pSD, Descriptor& descriptor);
+    const std::wstring& LookupAccount(PSID pSid, const std::wstring& strSid);
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -256,6 +256,31 @@ StructuredOutput::Writer::GetWriter(const OutputSpec& outFile, std::unique_ptr<S
         Log::Error(L"Failed to open file '{}' for writing [{}]", outFile.Path, SystemError(hr));
         return nullptr;
     }
+
+    if (outFile.bJsonLines)
+    {
+        auto jsonOptions = dynamic_unique_ptr_cast<JSONOutputOptions>(std::move(pOptions));
+        if (jsonOptions == nullptr)
+        {
+            jsonOptions = std::make_unique<JSONOutputOptions>();
+            if (pOptions != nullptr)
+                jsonOptions->Encoding = pOptions->Encoding;
+        }
+        jsonOptions->bJsonLines = true;
+        pOptions = std::move(jsonOptions);
+    }
+
+    if (outFile.StreamCompression != OutputSpec::StreamCompression::None)
+    {
+        auto compressed = ByteStream::GetCompressingStream(stream, outFile.StreamCompression);
+        if (compressed == nullptr)
+        {
+            Log::Error(L"Failed to compress file '{}' ({})", outFile.Path, ToString(outFile.StreamCompression));
+            return nullptr;
+        }
+        return GetWriter(compressed, outFile.Type, std::move(pOptions));
+    }
+
     return GetWriter(stream, outFile.Type, std::move(pOptions));
 }
 
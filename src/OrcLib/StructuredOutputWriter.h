@@ -35,6 +35,8 @@ struct ORCLIB_API Options : public StructuredOutput::Options
 {
     bool bPrettyPrint = false;
     DWORD indentCharCount = 4;
+    // Write one compact JSON document per top level element (JSON Lines), pretty printing is ignored
+    bool bJsonLines = false;
 };
 }  // namespace JSON
 
@@ -0,0 +1,658 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#include "stdafx.h"
+
+#include "TableMerger.h"
+
+#include "CaseInsensitive.h"
+#include "WideAnsi.h"
+
+#include "Log/Log.h"
+
+#include <charconv>
+#include <filesystem>
+#include <numeric>
+#include <set>
+
+using namespace std;
+
+using namespace Orc;
+using namespace Orc::TableOutput;
+
+namespace {
+
+bool ParseUnsigned(std::string_view value, ULONGLONG& result)
+{
+    int base = 10;
+    if (value.size() > 2 && value[0] == '0' && (value[1] == 'x' || value[1] == 'X'))
+    {
+        value.remove_prefix(2);
+        base = 16;
+    }
+
+    const auto pEnd = value.data() + value.size();
+    const auto [ptr, ec] = std::from_chars(value.data(), pEnd, result, base);
+    return ec == std::errc() && ptr == pEnd;
+}
+
+bool ParseSigned(std::string_view value, LONGLONG& result)
+{
+    const auto pEnd = value.data() + value.size();
+    const auto [ptr, ec] = std::from_chars(value.data(), pEnd, result, 10);
+    return ec == std::errc() && ptr == pEnd;
+}
+
+// Time stamps are written by the table writers as 'YYYY-MM-DD hh:mm:ss.mmm' (UTC)
+bool ParseTimeStamp(std::string_view value, FILETIME& result)
+{
+    constexpr auto kPattern = "0000-00-00 00:00:00.000"sv;
+
+    if (value.size() != kPattern.size())
+        return false;
+
+    for (size_t i = 0; i < kPattern.size(); i++)
+    {
+        if (kPattern[i] == '0' ? !isdigit(static_cast<unsigned char>(value[i])) : value[i] != kPattern[i])
+            return false;
+    }
+
+    const auto number = [&value](size_t offset, size_t length) {
+        WORD wNumber = 0;
+        for (size_t i = offset; i < offset + length; i++)
+            wNumber = wNumber * 10 + (value[i] - '0');
+        return wNumber;
+    };
+
+    SYSTEMTIME st {0};
+    st.wYear = number(0, 4);
+    st.wMonth = number(5, 2);
+    st.wDay = number(8, 2);
+    st.wHour = number(11, 2);
+    st.wMinute = number(14, 2);
+    st.wSecond = number(17, 2);
+    st.wMilliseconds = number(20, 3);
+
+    return SystemTimeToFileTime(&st, &result) != FALSE;
+}
+
+std::wstring GetExtension(OutputSpec::Kind kind)
+{
+    if (HasFlag(kind, OutputSpec::Kind::Parquet))
+        return L".parquet";
+    if (HasFlag(kind, OutputSpec::Kind::ORC))
+        return L".orc";
+    return L".csv";
+}
+
+std::wstring GetPartitionFileName(std::string_view value)
+{
+    // a value that does not convert never names a partition '.csv'
+    std::wstring strName;
+    if (value.empty() || FAILED(AnsiToWide(value, strName)) || strName.empty())
+        return L"null";
+
+    constexpr size_t kMaxNameLength = 128;
+    if (strName.size() > kMaxNameLength)
+        strName.resize(kMaxNameLength);
+
+    for (auto& wChar : strName)
+    {
+        if (wChar < L' ' || wcschr(L"\\/:*?\"<>|", wChar) != nullptr)
+            wChar = L'_';
+    }
+    return strName;
+}
+
+}  // namespace
+
+void Merger::ColumnStats::Add(std::string_view value)
+{
+    if (value.empty())
+        return;
+
+    m_ullValues++;
+
+    if (m_bInteger)
+    {
+        ULONGLONG ullValue = 0LL;
+        LONGLONG llValue = 0LL;
+
+        if (ParseUnsigned(value, ullValue))
+            m_bAboveInt64 |= ullValue > static_cast<ULONGLONG>(LLONG_MAX);
+        else if (ParseSigned(value, llValue))
+            m_bNegative = true;
+        else
+            m_bInteger = false;
+    }
+
+    if (m_bTimeStamp)
+    {
+        FILETIME ft;
+        m_bTimeStamp = ParseTimeStamp(value, ft);
+    }
+}
+
+void Merger::ColumnStats::Merge(const ColumnStats& other)
+{
+    m_ullValues += other.m_ullValues;
+    m_bInteger &= other.m_bInteger;
+    m_bNegative |= other.m_bNegative;
+    m_bAboveInt64 |= other.m_bAboveInt64;
+    m_bTimeStamp &= other.m_bTimeStamp;
+}
+
+ColumnType Merger::ColumnStats::GetType() const
+{
+    if (m_ullValues == 0LL)
+        return UTF8Type;
+
+    if (m_bInteger && !(m_bNegative && m_bAboveInt64))
+        return m_bNegative ? Int64Type : UInt64Type;
+
+    if (m_bTimeStamp)
+        return TimeStampType;
+
+    return UTF8Type;
+}
+
+HRESULT Merger::AddInput(const std::wstring& strPath)
+{
+    if (strPath.empty())
+        return E_INVALIDARG;
+
+    auto input = std::make_unique<Input>();
+    input->strPath = strPath;
+    m_Inputs.push_back(std::move(input));
+    return S_OK;
+}
+
+HRESULT Merger::LoadInput(Input& input)
+{
+    HRESULT hr = E_FAIL;
+
+    if (FAILED(hr = input.Reader.OpenFile(input.strPath.c_str())))
+        return hr;
+
+    input.dwColumnCount = static_cast<DWORD>(input.Reader.GetHeaders().size());
+    if (input.dwColumnCount == 0L)
+    {
+        Log::Warn(L"Table '{}' has no headers and is ignored", input.strPath);
+        return S_OK;
+    }
+
+    const auto chunks = input.Reader.Split();
+    const auto cQuote = input.Reader.GetQuote();
+
+    std::vector<std::vector<std::string_view>> fields(chunks.size());
+    std::vector<std::vector<ColumnStats>> stats(chunks.size(), std::vector<ColumnStats>(input.dwColumnCount));
+    std::vector<ULONGLONG> skipped(chunks.size(), 0LL);
+    std::vector<HRESULT> results(chunks.size(), S_OK);
+
+    concurrency::parallel_for(size_t(0), chunks.size(), [&](size_t i) {
+        std::string unescaped;
+        results[i] = input.Reader.Parse(chunks[i], [&](const CSV::MappedFileReader::Record& record) -> HRESULT {
+            if (record.GetColumnCount() != input.dwColumnCount)
+            {
+                skipped[i]++;
+                return S_OK;
+            }
+
+            for (DWORD dwColumn = 0; dwColumn < input.dwColumnCount; dwColumn++)
+            {
+                const auto raw = record.GetRaw(dwColumn);
+                fields[i].push_back(raw);
+                stats[i][dwColumn].Add(CSV::MappedFileReader::Unquote(raw, cQuote, unescaped));
+            }
+            return S_OK;
+        });
+    });
+
+    size_t fieldCount = 0;
+    ULONGLONG ullSkipped = 0LL;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        if (FAILED(results[i]))
+            return results[i];
+        fieldCount += fields[i].size();
+        ullSkipped += skipped[i];
+    }
+
+    if (ullSkipped > 0)
+        Log::Warn(L"Table '{}': {} records with an unexpected column count are ignored", input.strPath, ullSkipped);
+
+    input.Fields.reserve(fieldCount);
+    input.Stats.resize(input.dwColumnCount);
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        std::copy(std::cbegin(fields[i]), std::cend(fields[i]), std::back_inserter(input.Fields));
+        for (DWORD dwColumn = 0; dwColumn < input.dwColumnCount; dwColumn++)
+            input.Stats[dwColumn].Merge(stats[i][dwColumn]);
+    }
+
+    return S_OK;
+}
+
+HRESULT Merger::UnifySchema()
+{
+    std::vector<std::wstring> names;
+    std::unordered_map<std::wstring, DWORD> indexes;
+
+    for (const auto& input : m_Inputs)
+    {
+        for (const auto& header : input->Reader.GetHeaders())
+        {
+            if (indexes.find(header) == std::end(indexes))
+            {
+                indexes.emplace(header, static_cast<DWORD>(names.size()));
+                names.push_back(header);
+            }
+        }
+    }
+
+    std::vector<ColumnStats> stats(names.size());
+
+    for (auto& input : m_Inputs)
+    {
+        const auto& headers = input->Reader.GetHeaders();
+
+        input->Columns.assign(names.size(), kNoColumn);
+        for (DWORD dwColumn = 0; dwColumn < input->dwColumnCount; dwColumn++)
+        {
+            const auto dwMerged = indexes[headers[dwColumn]];
+            if (input->Columns[dwMerged] != kNoColumn)
+            {
+                Log::Warn(L"Table '{}': duplicate column '{}' is ignored", input->strPath, headers[dwColumn]);
+                continue;
+            }
+
+            input->Columns[dwMerged] = dwColumn;
+            stats[dwMerged].Merge(input->Stats[dwColumn]);
+        }
+    }
+
+    m_Schema = Schema();
+    m_Schema.reserve(names.size());
+    for (DWORD dwColumn = 0; dwColumn < names.size(); dwColumn++)
+    {
+        auto column = std::make_unique<Column>(stats[dwColumn].GetType(), names[dwColumn]);
+        column->dwColumnID = dwColumn + 1;
+        m_Schema.AddColumn(std::move(column));
+    }
+
+    return S_OK;
+}
+
+HRESULT Merger::Load()
+{
+    m_Rows.clear();
+
+    std::vector<HRESULT> results(m_Inputs.size(), S_OK);
+    concurrency::parallel_for(
+        size_t(0), m_Inputs.size(), [this, &results](size_t i) { results[i] = LoadInput(*m_Inputs[i]); });
+
+    for (size_t i = 0; i < m_Inputs.size(); i++)
+    {
+        if (FAILED(results[i]))
+        {
+            Log::Error(L"Failed to load table '{}' [{}]", m_Inputs[i]->strPath, SystemError(results[i]));
+            return results[i];
+        }
+    }
+
+    if (auto hr = UnifySchema(); FAILED(hr))
+        return hr;
+
+    size_t rowCount = 0;
+    for (const auto& input : m_Inputs)
+    {
+        if (input->dwColumnCount > 0)
+            rowCount += input->Fields.size() / input->dwColumnCount;
+    }
+
+    m_Rows.reserve(rowCount);
+    for (DWORD dwInput = 0; dwInput < m_Inputs.size(); dwInput++)
+    {
+        const auto& input = m_Inputs[dwInput];
+        if (input->dwColumnCount == 0L)
+            continue;
+
+        const auto dwRowCount = static_cast<DWORD>(input->Fields.size() / input->dwColumnCount);
+        for (DWORD dwRow = 0; dwRow < dwRowCount; dwRow++)
+            m_Rows.push_back({dwInput, dwRow});
+    }
+
+    Log::Debug(L"Merged {} tables: {} rows, {} columns", m_Inputs.size(), m_Rows.size(), m_Schema.size());
+
+    if (m_Options.SortColumn.has_value())
+        return Sort();
+
+    return S_OK;
+}
+
+std::optional<DWORD> Merger::FindColumn(const std::wstring& strName) const
+{
+    for (DWORD dwColumn = 0; dwColumn < m_Schema.size(); dwColumn++)
+    {
+        if (equalCaseInsensitive(m_Schema[dwColumn].ColumnName, strName))
+            return dwColumn;
+    }
+    return std::nullopt;
+}
+
+std::string_view Merger::GetValue(const RowRef& row, DWORD dwColumn, std::string& unescaped) const
+{
+    const auto& input = *m_Inputs[row.dwInput];
+
+    const auto dwInputColumn = input.Columns[dwColumn];
+    if (dwInputColumn == kNoColumn)
+        return {};
+
+    const auto raw = input.Fields[static_cast<size_t>(row.dwRow) * input.dwColumnCount + dwInputColumn];
+    return CSV::MappedFileReader::Unquote(raw, input.Reader.GetQuote(), unescaped);
+}
+
+HRESULT Merger::Sort()
+{
+    const auto column = FindColumn(m_Options.SortColumn.value());
+    if (!column.has_value())
+    {
+        Log::Error(L"Failed to sort merged tables: no column '{}'", m_Options.SortColumn.value());
+        return E_INVALIDARG;
+    }
+
+    const auto type = m_Schema[column.value()].Type;
+    const bool bNumeric = type == UInt64Type || type == Int64Type || type == TimeStampType;
+
+    struct Key
+    {
+        bool bNull = true;
+        ULONGLONG ullValue = 0LL;
+        std::string strValue;
+    };
+
+    std::vector<Key> keys(m_Rows.size());
+    concurrency::parallel_for(size_t(0), m_Rows.size(), [&](size_t i) {
+        std::string unescaped;
+        const auto value = GetValue(m_Rows[i], column.value(), unescaped);
+        if (value.empty())
+            return;
+
+        auto& key = keys[i];
+        key.bNull = false;
+
+        switch (type)
+        {
+            case UInt64Type:
+                ParseUnsigned(value, key.ullValue);
+                break;
+            case Int64Type: {
+                LONGLONG llValue = 0LL;
+                if (!ParseSigned(value, llValue))
+                    ParseUnsigned(value, key.ullValue);
+                else
+                    key.ullValue = static_cast<ULONGLONG>(llValue);
+                // Flip the sign bit to order signed values as unsigned ones
+                key.ullValue ^= 0x8000000000000000ULL;
+                break;
+            }
+            case TimeStampType: {
+                FILETIME ft {0};
+                ParseTimeStamp(value, ft);
+                key.ullValue = (static_cast<ULONGLONG>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+                break;
+            }
+            default:
+                key.strValue.assign(value);
+                break;
+        }
+    });
+
+    std::vector<size_t> order(m_Rows.size());
+    std::iota(std::begin(order), std::end(order), 0);
+
+    // Null values come first, ties are broken on the input order to keep the result stable
+    const bool bDescending = m_Options.bDescending;
+    concurrency::parallel_buffered_sort(
+        std::begin(order), std::end(order), [&keys, bNumeric, bDescending](size_t left, size_t right) {
+            const auto& leftKey = keys[left];
+            const auto& rightKey = keys[right];
+
+            if (leftKey.bNull != rightKey.bNull)
+                return leftKey.bNull;
+
+            int comparison = 0;
+            if (!leftKey.bNull)
+            {
+                if (bNumeric)
+                    comparison = leftKey.ullValue < rightKey.ullValue ? -1 : (leftKey.ullValue > rightKey.ullValue);
+                else
+                    comparison = leftKey.strValue.compare(rightKey.strValue);
+            }
+
+            if (comparison != 0)
+                return bDescending ? comparison > 0 : comparison < 0;
+            return left < right;
+        });
+
+    std::vector<RowRef> sorted;
+    sorted.reserve(m_Rows.size());
+    for (const auto index : order)
+        sorted.push_back(m_Rows[index]);
+    m_Rows = std::move(sorted);
+
+    return S_OK;
+}
+
+HRESULT Merger::WriteRows(const OutputSpec& output, const std::vector<RowRef>& rows) const
+{
+    HRESULT hr = E_FAIL;
+
+    std::shared_ptr<IWriter> pWriter;
+
+    if (HasFlag(output.Type, OutputSpec::Kind::Parquet) || HasFlag(output.Type, OutputSpec::Kind::ORC))
+    {
+        std::shared_ptr<IStreamWriter> pStreamWriter;
+        if (HasFlag(output.Type, OutputSpec::Kind::Parquet))
+        {
+            auto options = std::make_unique<Parquet::Options>();
+            options->BatchSize = m_Options.dwRowGroupSize;
+            pStreamWriter = GetParquetWriter(std::move(options));
+        }
+        else
+        {
+            auto options = std::make_unique<ApacheOrc::Options>();
+            options->BatchSize = m_Options.dwRowGroupSize;
+            pStreamWriter = GetApacheOrcWriter(std::move(options));
+        }
+
+        if (!pStreamWriter)
+        {
+            Log::Error(L"Table format of '{}' is not available", output.Path);
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        if (FAILED(hr = pStreamWriter->SetSchema(m_Schema)))
+        {
+            Log::Error(L"Could not set schema to file: '{}' [{}]", output.Path, SystemError(hr));
+            return hr;
+        }
+
+        if (FAILED(hr = pStreamWriter->WriteToFile(output.Path)))
+        {
+            Log::Error(L"Could not create specified file: '{}' [{}]", output.Path, SystemError(hr));
+            return hr;
+        }
+        pWriter = pStreamWriter;
+    }
+    else
+    {
+        OutputSpec csv = output;
+        csv.Schema = m_Schema;
+
+        pWriter = GetWriter(csv);
+        if (!pWriter)
+            return E_FAIL;
+    }
+
+    std::vector<ColumnType> types;
+    types.reserve(m_Schema.size());
+    for (const auto& column : m_Schema)
+        types.push_back(column->Type);
+
+    try
+    {
+        std::string unescaped;
+        for (const auto& row : rows)
+        {
+            for (DWORD dwColumn = 0; dwColumn < types.size(); dwColumn++)
+            {
+                const auto value = GetValue(row, dwColumn, unescaped);
+                if (value.empty())
+                {
+                    pWriter->WriteNothing();
+                    continue;
+                }
+
+                switch (types[dwColumn])
+                {
+                    case UInt64Type: {
+                        ULONGLONG ullValue = 0LL;
+                        if (ParseUnsigned(value, ullValue))
+                            pWriter->WriteInteger(ullValue);
+                        else
+                            pWriter->WriteNothing();
+                        break;
+                    }
+                    case Int64Type: {
+                        LONGLONG llValue = 0LL;
+                        if (ParseSigned(value, llValue))
+                            pWriter->WriteInteger(llValue);
+                        else if (ULONGLONG ullValue = 0LL; ParseUnsigned(value, ullValue))
+                            pWriter->WriteInteger(static_cast<LONGLONG>(ullValue));
+                        else
+                            pWriter->WriteNothing();
+                        break;
+                    }
+                    case TimeStampType: {
+                        FILETIME ft;
+                        if (ParseTimeStamp(value, ft))
+                            pWriter->WriteFileTime(ft);
+                        else
+                            pWriter->WriteNothing();
+                        break;
+                    }
+                    default:
+                        pWriter->WriteString(value);
+                        break;
+                }
+            }
+
+            if (FAILED(hr = pWriter->WriteEndOfLine()))
+            {
+                Log::Error(L"Failed to write merged row to '{}' [{}]", output.Path, SystemError(hr));
+                pWriter->Close();
+                return hr;
+            }
+        }
+    }
+    catch (const Orc::Exception& e)
+    {
+        Log::Error(L"Failed to write merged rows to '{}': {}", output.Path, e.Description);
+        pWriter->Close();
+        return e.GetHRESULT();
+    }
+
+    if (FAILED(hr = pWriter->Close()))
+    {
+        Log::Error(L"Failed to close '{}' [{}]", output.Path, SystemError(hr));
+        return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT Merger::Write(const OutputSpec& output)
+{
+    if (!m_Schema)
+    {
+        Log::Error(L"No merged table to write (tables must be loaded first)");
+        return E_UNEXPECTED;
+    }
+
+    if (!output.IsDirectory())
+        return WriteRows(output, m_Rows);
+
+    const auto extension = GetExtension(m_Options.DirectoryFormat);
+
+    std::vector<std::pair<std::wstring, std::vector<RowRef>>> partitions;
+
+    if (m_Options.PartitionColumn.has_value())
+    {
+        const auto column = FindColumn(m_Options.PartitionColumn.value());
+        if (!column.has_value())
+        {
+            Log::Error(L"Failed to partition merged tables: no column '{}'", m_Options.PartitionColumn.value());
+            return E_INVALIDARG;
+        }
+
+        // Rows are dispatched in order: each partition is sorted too
+        std::unordered_map<std::string, size_t> indexes;
+        std::set<std::wstring, CaseInsensitive> names;
+        std::string unescaped;
+        for (const auto& row : m_Rows)
+        {
+            const auto value = GetValue(row, column.value(), unescaped);
+
+            auto it = indexes.find(std::string(value));
+            if (it == std::end(indexes))
+            {
+                auto strName = GetPartitionFileName(value);
+                for (DWORD dwSuffix = 1; names.find(strName) != std::end(names); dwSuffix++)
+                    strName = fmt::format(L"{}_{}", GetPartitionFileName(value), dwSuffix);
+                names.insert(strName);
+
+                it = indexes.emplace(std::string(value), partitions.size()).first;
+                partitions.emplace_back(strName + extension, std::vector<RowRef>());
+            }
+            partitions[it->second].second.push_back(row);
+        }
+    }
+    else
+    {
+        const auto rowsPerFile = static_cast<size_t>(std::max(1ULL, m_Options.ullRowsPerFile));
+        for (size_t first = 0; first < m_Rows.size(); first += rowsPerFile)
+        {
+            const auto last = std::min(first + rowsPerFile, m_Rows.size());
+            partitions.emplace_back(
+                fmt::format(L"part-{:05}{}", partitions.size(), extension),
+                std::vector<RowRef>(std::cbegin(m_Rows) + first, std::cbegin(m_Rows) + last));
+        }
+    }
+
+    std::vector<HRESULT> results(partitions.size(), S_OK);
+    concurrency::parallel_for(size_t(0), partitions.size(), [&](size_t i) {
+        OutputSpec file;
+        file.Type = OutputSpec::Kind::TableFile | m_Options.DirectoryFormat;
+        file.OutputEncoding = output.OutputEncoding;
+        file.Path = (std::filesystem::path(output.Path) / partitions[i].first).wstring();
+
+        results[i] = WriteRows(file, partitions[i].second);
+    });
+
+    for (const auto hr : results)
+    {
+        if (FAILED(hr))
+            return hr;
+    }
+
+    Log::Debug(L"Merged tables written to {} files in '{}'", partitions.size(), output.Path);
+    return S_OK;
+}
+
+Merger::~Merger() {}
@@ -0,0 +1,119 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "TableOutputWriter.h"
+#include "CsvMappedFileReader.h"
+
+#include <optional>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+namespace TableOutput {
+
+// Merges table outputs (ie: the per volume 'NTFSInfo_*.csv' of a collection) into a single dataset.
+// Inputs are mapped and tokenized concurrently. Their headers are unified in one schema (columns are matched by name,
+// missing values are null) and each column type is inferred from its values (integers, time stamps or UTF8 strings).
+class ORCLIB_API Merger
+{
+public:
+    struct Options
+    {
+        // Rows are sorted on this column (ie: 'FRN' or 'LastModificationDate'), input order is kept for equal values
+        std::optional<std::wstring> SortColumn;
+        bool bDescending = false;
+
+        // When the output is a directory, one file is written per distinct value of this column, or per
+        // 'ullRowsPerFile' rows without a partition column. Files are written concurrently.
+        std::optional<std::wstring> PartitionColumn;
+        ULONGLONG ullRowsPerFile = 4 * 1024 * 1024;
+        OutputSpec::Kind DirectoryFormat = OutputSpec::Kind::Parquet;
+
+        // Number of rows per Parquet row group or ORC batch
+        DWORD dwRowGroupSize = 64 * 1024;
+    };
+
+    Merger(Options options = Options())
+        : m_Options(std::move(options))
+    {
+    }
+    Merger(const Merger&) = delete;
+
+    HRESULT AddInput(const std::wstring& strPath);
+
+    HRESULT Load();
+
+    const Schema& GetSchema() const { return m_Schema; }
+    ULONGLONG GetRowCount() const { return m_Rows.size(); }
+
+    // Output is either a table file (csv, parquet, orc) or a directory receiving a partitioned dataset
+    HRESULT Write(const OutputSpec& output);
+
+    ~Merger();
+
+private:
+    static constexpr DWORD kNoColumn = MAXDWORD;
+
+    class ColumnStats
+    {
+    public:
+        void Add(std::string_view value);
+        void Merge(const ColumnStats& other);
+        ColumnType GetType() const;
+
+    private:
+        ULONGLONG m_ullValues = 0LL;
+        bool m_bInteger = true;
+        bool m_bNegative = false;
+        bool m_bAboveInt64 = false;
+        bool m_bTimeStamp = true;
+    };
+
+    struct Input
+    {
+        std::wstring strPath;
+        CSV::MappedFileReader Reader;
+
+        // Raw fields of the records, 'dwColumnCount' per record
+        DWORD dwColumnCount = 0L;
+        std::vector<std::string_view> Fields;
+        std::vector<ColumnStats> Stats;
+
+        // Index of the input column for each merged column (or kNoColumn)
+        std::vector<DWORD> Columns;
+    };
+
+    struct RowRef
+    {
+        DWORD dwInput;
+        DWORD dwRow;
+    };
+
+    HRESULT LoadInput(Input& input);
+    HRESULT UnifySchema();
+    HRESULT Sort();
+
+    std::optional<DWORD> FindColumn(const std::wstring& strName) const;
+    std::string_view GetValue(const RowRef& row, DWORD dwColumn, std::string& unescaped) const;
+
+    HRESULT WriteRows(const OutputSpec& output, const std::vector<RowRef>& rows) const;
+
+    Options m_Options;
+
+    std::vector<std::unique_ptr<Input>> m_Inputs;
+    Schema m_Schema;
+    std::vector<RowRef> m_Rows;
+};
+
+}  // namespace TableOutput
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -66,10 +66,36 @@ std::shared_ptr<IWriter> Orc::TableOutput::GetWriter(const OutputSpec& out)
                 return nullptr;
             }
 
-            if (FAILED(hr = retval->WriteToFile(out.Path)))
+            if (out.StreamCompression == OutputSpec::StreamCompression::None)
             {
-                Log::Error(L"Could not create specified file: '{}' [{}]", out.Path, SystemError(hr));
-                return nullptr;
+                if (FAILED(hr = retval->WriteToFile(out.Path)))
+                {
+                    Log::Error(L"Could not create specified file: '{}' [{}]", out.Path, SystemError(hr));
+                    return nullptr;
+                }
+            }
+            else
+            {
+                auto pFileStream = std::make_shared<FileStream>();
+                if (FAILED(hr = pFileStream->WriteTo(out.Path.c_str())))
+                {
+                    Log::Error(L"Could not create specified file: '{}' [{}]", out.Path, SystemError(hr));
+                    return nullptr;
+                }
+
+                auto pStream = ByteStream::GetCompressingStream(pFileStream, out.StreamCompression);
+                if (pStream == nullptr)
+                {
+                    Log::Error(
+                        L"Could not compress specified file: '{}' ({})", out.Path, ToString(out.StreamCompression));
+                    return nullptr;
+                }
+
+                if (FAILED(hr = retval->WriteToStream(pStream, true)))
+                {
+                    Log::Error(L"Could not write to compressed file: '{}' [{}]", out.Path, SystemError(hr));
+                    return nullptr;
+                }
             }
 
             if (out.Schema)
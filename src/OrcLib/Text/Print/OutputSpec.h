@@ -64,6 +64,16 @@ struct Printer<OutputSpec>
             properties.push_back(ToString(output.OutputEncoding));
         }
 
+        if (output.StreamCompression != OutputSpec::StreamCompression::None)
+        {
+            properties.push_back(ToString(output.StreamCompression));
+        }
+
+        if (output.bJsonLines)
+        {
+            properties.push_back(L"lines");
+        }
+
         if (output.Type == OutputSpec::Kind::Archive)
         {
             // This parameter would be filled by the user
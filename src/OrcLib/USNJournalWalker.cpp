@@ -166,10 +166,6 @@ HRESULT USNJournalWalker::Initialize(const std::shared_ptr<Location>& loc)
         });
     }
 
-    if (FAILED(hr = m_RecordStore.InitializeStore(USN_MAX_NUMBER, m_dwRecordMaxSize)))
-    {
-        return hr;
-    }
     return S_OK;
 }
 
@@ -177,17 +173,12 @@ HRESULT USNJournalWalker::WalkRecords(const Callbacks& pCallbacks, bool bWalkDir
 {
     if (pCallbacks.RecordCallback != NULL)
     {
-        // Walk through the files
-        auto iter = m_USNMap.begin();
-        do
-        {
-            USN_RECORD* pValue = iter->second;
+        m_Records.Sort();
 
+        // Walk through the files
+        m_Records.ForEach([this, &pCallbacks, bWalkDirs](USN_RECORD* pValue) {
             if (pValue->FileAttributes & FILE_ATTRIBUTE_DIRECTORY && !bWalkDirs)
-            {
-                ++iter;
-                continue;
-            }
+                return;
 
             bool bInSpecificLocation = false;
             WCHAR* pFullName = GetFullNameAndIfInLocation(pValue, NULL, &bInSpecificLocation);
@@ -200,20 +191,16 @@ HRESULT USNJournalWalker::WalkRecords(const Callbacks& pCallbacks, bool bWalkDir
 
             if (!(pValue->FileAttributes & FILE_ATTRIBUTE_DIRECTORY))
             {
-                m_USNMap.erase(iter++);
-                m_RecordStore.FreeCell(pValue);
-            }
-            else
-            {
-                ++iter;
+                m_Records.Erase(pValue->FileReferenceNumber);
             }
-        } while (iter != m_USNMap.end());
+        });
     }
     return S_OK;
 }
 
 HRESULT USNJournalWalker::EnumJournal(const IUSNJournalWalker::Callbacks& pCallbacks)
 {
+    HRESULT hr = E_FAIL;
     MFT_ENUM_DATA InBuffer = {0, 0, MAXLONGLONG};
     DWORD numBytesReturned = 0;
 
@@ -258,33 +245,23 @@ HRESULT USNJournalWalker::EnumJournal(const IUSNJournalWalker::Callbacks& pCallb
             // parse all of the entries we just got
             while ((__int64)nextUSNRecord < (__int64)((PUCHAR)pOutBuffer + numBytesReturned))
             {
-                LPBYTE pElt = (LPBYTE)m_RecordStore.GetNewCell();
-
-                if (pElt == NULL)
+                // Records only take the size of their name, the store grows as needed
+                if (FAILED(hr = m_Records.Insert(nextUSNRecord)))
                 {
-                    // We walk through FILES for our alerady recorded nodes with hope this will free some space
-                    WalkRecords(pCallbacks, false);
-                    pElt = (LPBYTE)m_RecordStore.GetNewCell();
-                    if (pElt == NULL)
-                    {
-                        /// We are still unable to move forward...
-                        return E_OUTOFMEMORY;
-                    }
+                    if (hr == E_OUTOFMEMORY)
+                        return hr;
+                    Log::Debug(L"Invalid USN record for FRN {:#x}", nextUSNRecord->FileReferenceNumber);
                 }
 
-                memset(pElt, 0, m_dwRecordMaxSize);
-                memcpy_s(pElt, m_dwRecordMaxSize, nextUSNRecord, nextUSNRecord->RecordLength);
-
-                _ASSERT(m_USNMap.find(nextUSNRecord->FileReferenceNumber) == m_USNMap.end());
-                m_USNMap.insert(
-                    std::pair<DWORDLONG, USN_RECORD*>(nextUSNRecord->FileReferenceNumber, (USN_RECORD*)pElt));
-
                 nextUSNRecord = (USN_RECORD*)((BYTE*)nextUSNRecord + nextUSNRecord->RecordLength);
             }
             InBuffer.StartFileReferenceNumber = pOutBuffer->usn;
         }
     }
 
+    m_Records.Sort();
+    Log::Debug(L"USN record store: {} records, {} bytes", m_Records.Size(), m_Records.MemoryUsage());
+
     return WalkRecords(pCallbacks, true);
 }
 
@@ -323,6 +300,19 @@ HRESULT USNJournalWalker::ReadJournal(const IUSNJournalWalker::Callbacks& pCallb
     BOOST_SCOPE_EXIT(&pOutBuffer) { HeapFree(GetProcessHeap(), 0, pOutBuffer); }
     BOOST_SCOPE_EXIT_END
 
+    // Files are removed from the map once reported, directories are kept to build the names of their children
+    IUSNJournalWalker::Callbacks walkCallbacks = pCallbacks;
+    walkCallbacks.RecordCallback =
+        [this, &pCallbacks](std::shared_ptr<VolumeReader>& volreader, WCHAR* szFullName, USN_RECORD* pElt) {
+            pCallbacks.RecordCallback(volreader, szFullName, pElt);
+
+            if (!(pElt->FileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                m_Records.Erase(pElt->FileReferenceNumber);
+            }
+        };
+
+    std::vector<USN_RECORD*> records;
     bool bDone = false;
     while (bDone == false)
     {
@@ -351,28 +341,16 @@ HRESULT USNJournalWalker::ReadJournal(const IUSNJournalWalker::Callbacks& pCallb
             {
                 USN_RECORD* nextUSNRecord = pOutBuffer->usnRecord;
 
-                // parse all of the entries we just got
+                records.clear();
                 while ((__int64)nextUSNRecord < (__int64)((PUCHAR)pOutBuffer + numBytesReturned))
                 {
-
-                    // Parsing entries...
-                    bool bInSpecificLocation = false;
-                    WCHAR* pFullName = GetFullNameAndIfInLocation(nextUSNRecord, NULL, &bInSpecificLocation);
-
-                    if (pFullName && bInSpecificLocation)
-                    {
-                        pCallbacks.RecordCallback(m_VolReader, pFullName, nextUSNRecord);
-
-                        if (!(nextUSNRecord->FileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-                        {
-                            m_USNMap.erase(nextUSNRecord->FileReferenceNumber);
-                        }
-                        m_dwWalkedItems++;
-                    }
-
+                    records.push_back(nextUSNRecord);
                     nextUSNRecord = (USN_RECORD*)((BYTE*)nextUSNRecord + nextUSNRecord->RecordLength);
                 }
 
+                // parse all of the entries we just got
+                ProcessRecords(records, walkCallbacks);
+
                 InBuffer.StartUsn = pOutBuffer->usn;
             }
         }
@@ -10,10 +10,18 @@
 #include "USNJournalWalkerBase.h"
 #include "MountedVolumeReader.h"
 
+#include <ppl.h>
+
 using namespace Orc;
 
+namespace {
+
+// Parent chains longer than this are corrupted (ie: loops)
+constexpr size_t kMaxParentDepth = 1024;
+
+}  // namespace
+
 USNJournalWalkerBase::USNJournalWalkerBase()
-    : m_RecordStore(L"USNRecordStore")
 {
     m_dwlRootUSN = 0;
     m_cchMaxComponentLength = 0;
@@ -23,6 +31,8 @@ USNJournalWalkerBase::USNJournalWalkerBase()
 
     m_pFullNameBuffer = NULL;
     m_cbFullNameBufferLen = 0L;
+
+    m_bParallel = false;
 }
 
 USNJournalWalkerBase::~USNJournalWalkerBase()
@@ -31,9 +41,9 @@ USNJournalWalkerBase::~USNJournalWalkerBase()
         HeapFree(GetProcessHeap(), 0L, m_pFullNameBuffer);
 }
 
-const USNJournalWalkerBase::USN_MAP& USNJournalWalkerBase::GetUSNMap()
+const USNRecordStore& USNJournalWalkerBase::GetRecords() const
 {
-    return m_USNMap;
+    return m_Records;
 }
 
 HRESULT USNJournalWalkerBase::ExtendNameBuffer(WCHAR** pCurrent)
@@ -106,7 +116,7 @@ WCHAR* USNJournalWalkerBase::GetFullNameAndIfInLocation(USN_RECORD* pElt, DWORD*
 #endif
 
     DWORD dwCount = 0;
-    auto pParentPair = m_USNMap.find(pElt->ParentFileReferenceNumber);
+    auto pParent = m_Records.Find(pElt->ParentFileReferenceNumber);
 
     DWORDLONG dwlLastParentRefNumber = 0;
 
@@ -148,7 +158,7 @@ WCHAR* USNJournalWalkerBase::GetFullNameAndIfInLocation(USN_RECORD* pElt, DWORD*
         }
 
     dwlLastParentRefNumber = pElt->ParentFileReferenceNumber;
-    while (pParentPair != m_USNMap.end())
+    while (pParent != nullptr)
     {
         {
             dwCount += sizeof(WCHAR);
@@ -161,17 +171,17 @@ WCHAR* USNJournalWalkerBase::GetFullNameAndIfInLocation(USN_RECORD* pElt, DWORD*
             *pCurrent = L'\\';
         }
         {
-            dwCount += pParentPair->second->FileNameLength;
+            dwCount += pParent->FileNameLength;
             if (dwCount > m_cbFullNameBufferLen)
             {
                 if (FAILED(ExtendNameBuffer(&pCurrent)))
                     return NULL;
             }
-            pCurrent -= pParentPair->second->FileNameLength / sizeof(WCHAR);
-            memcpy_s(pCurrent, dwCount, pParentPair->second->FileName, pParentPair->second->FileNameLength);
+            pCurrent -= pParent->FileNameLength / sizeof(WCHAR);
+            memcpy_s(pCurrent, dwCount, pParent->FileName, pParent->FileNameLength);
         }
-        dwlLastParentRefNumber = pParentPair->second->ParentFileReferenceNumber;
-        pParentPair = m_USNMap.find(pParentPair->second->ParentFileReferenceNumber);
+        dwlLastParentRefNumber = pParent->ParentFileReferenceNumber;
+        pParent = m_Records.Find(pParent->ParentFileReferenceNumber);
 
         if (pbInSpecificLocation)
             if (!*pbInSpecificLocation)
@@ -246,3 +256,111 @@ WCHAR* USNJournalWalkerBase::GetFullNameAndIfInLocation(USN_RECORD* pElt, DWORD*
         return pCurrent;
     }
 }
+
+std::shared_ptr<const USNJournalWalkerBase::ParentPath>
+USNJournalWalkerBase::GetParentPath(DWORDLONG dwlParentRefNumber) const
+{
+    // Directories up to the first one whose path is known
+    std::vector<std::pair<DWORDLONG, const USN_RECORD*>> chain;
+    std::shared_ptr<const ParentPath> path;
+
+    auto dwlRefNumber = dwlParentRefNumber;
+    while (path == nullptr)
+    {
+        if (auto it = m_ParentPaths.find(dwlRefNumber); it != m_ParentPaths.end())
+        {
+            path = it->second;
+            break;
+        }
+
+        const auto pParent = m_Records.Find(dwlRefNumber);
+        if (pParent != nullptr && chain.size() < kMaxParentDepth)
+        {
+            chain.emplace_back(dwlRefNumber, pParent);
+            dwlRefNumber = pParent->ParentFileReferenceNumber;
+            continue;
+        }
+
+        // Either the root or a parent folder that was _not_ found and gets a "place holder"
+        auto root = std::make_shared<ParentPath>();
+        if (dwlRefNumber == m_dwlRootUSN)
+            root->Prefix = m_VolReader->ShortVolumeName();
+        else
+            root->Prefix = fmt::format(L"\\__{:016X}__\\", dwlRefNumber);
+        root->bInSpecificLocation = m_LocationsRefNum.find(dwlRefNumber) != m_LocationsRefNum.end();
+
+        path = m_ParentPaths.insert({dwlRefNumber, std::move(root)}).first->second;
+    }
+
+    for (auto it = chain.crbegin(); it != chain.crend(); ++it)
+    {
+        const auto& [dwlRefNumber, pRecord] = *it;
+
+        auto directory = std::make_shared<ParentPath>();
+        directory->Prefix.reserve(path->Prefix.size() + pRecord->FileNameLength / sizeof(WCHAR) + 1);
+        directory->Prefix.append(path->Prefix);
+        directory->Prefix.append(pRecord->FileName, pRecord->FileNameLength / sizeof(WCHAR));
+        directory->Prefix.push_back(L'\\');
+        directory->bInSpecificLocation =
+            path->bInSpecificLocation || m_LocationsRefNum.find(dwlRefNumber) != m_LocationsRefNum.end();
+
+        // Concurrent resolutions of the same directory build the same path, the first one inserted is kept
+        path = m_ParentPaths.insert({dwlRefNumber, std::move(directory)}).first->second;
+    }
+
+    return path;
+}
+
+void USNJournalWalkerBase::GetFullName(
+    const USN_RECORD* pElt,
+    std::wstring& strFullName,
+    bool& bInSpecificLocation) const
+{
+    const auto parent = GetParentPath(pElt->ParentFileReferenceNumber);
+
+    strFullName.reserve(parent->Prefix.size() + pElt->FileNameLength / sizeof(WCHAR));
+    strFullName.assign(parent->Prefix);
+    strFullName.append(pElt->FileName, pElt->FileNameLength / sizeof(WCHAR));
+
+    bInSpecificLocation = m_LocationsRefNum.empty() || parent->bInSpecificLocation
+        || m_LocationsRefNum.find(pElt->FileReferenceNumber) != m_LocationsRefNum.end();
+}
+
+void USNJournalWalkerBase::ProcessRecords(
+    const std::vector<USN_RECORD*>& records,
+    const IUSNJournalWalker::Callbacks& pCallbacks)
+{
+    if (!m_bParallel)
+    {
+        for (auto pRecord : records)
+        {
+            bool bInSpecificLocation = false;
+            WCHAR* pFullName = GetFullNameAndIfInLocation(pRecord, NULL, &bInSpecificLocation);
+
+            if (pFullName && bInSpecificLocation)
+            {
+                pCallbacks.RecordCallback(m_VolReader, pFullName, pRecord);
+                m_dwWalkedItems++;
+            }
+        }
+        return;
+    }
+
+    std::vector<std::wstring> names(records.size());
+    std::vector<char> inSpecificLocation(records.size(), false);
+
+    concurrency::parallel_for(size_t(0), records.size(), [this, &records, &names, &inSpecificLocation](size_t i) {
+        bool bInSpecificLocation = false;
+        GetFullName(records[i], names[i], bInSpecificLocation);
+        inSpecificLocation[i] = bInSpecificLocation;
+    });
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (inSpecificLocation[i])
+        {
+            pCallbacks.RecordCallback(m_VolReader, names[i].data(), records[i]);
+            m_dwWalkedItems++;
+        }
+    }
+}
@@ -9,7 +9,7 @@
 #pragma once
 
 #include "LocationSet.h"
-#include "HeapStorage.h"
+#include "USNRecordStore.h"
 
 #include "IUSNJournalWalker.h"
 
@@ -18,14 +18,13 @@
 #include <memory>
 #include <unordered_set>
 
+#include <concurrent_unordered_map.h>
+
 #pragma managed(push, off)
 
 namespace Orc {
 class MountedVolumeReader;
 
-// Number of items in the VirtualStore
-constexpr auto USN_MAX_NUMBER = (0x80000);
-
 class ORCLIB_API USNJournalWalkerBase
 {
 public:
@@ -70,15 +69,25 @@ public:
     };
     using PUSN_RECORD_V3 = USN_RECORD_V3*;
 
-    using USN_MAP = std::map<DWORDLONG, USN_RECORD*>;
-    const USN_MAP& GetUSNMap();
+    const USNRecordStore& GetRecords() const;
 
     HRESULT ExtendNameBuffer(WCHAR** pCurrent);
     WCHAR* GetFullNameAndIfInLocation(USN_RECORD* pElt, DWORD* pdwLen, bool* pbInSpecificLocation);
 
+    // Same name as GetFullNameAndIfInLocation, safe for concurrent use once the record store is sorted: the paths of the
+    // parent directories are memoized
+    void GetFullName(const USN_RECORD* pElt, std::wstring& strFullName, bool& bInSpecificLocation) const;
+
+    // In parallel mode record names are resolved concurrently, callbacks are still called one at a time in the journal
+    // order
+    void SetParallel(bool bParallel) { m_bParallel = bParallel; }
+    bool IsParallel() const { return m_bParallel; }
+
 protected:
-    HeapStorage m_RecordStore;
-    USN_MAP m_USNMap;
+    // Calls 'RecordCallback' for the records in the locations, in the order of 'records'
+    void ProcessRecords(const std::vector<USN_RECORD*>& records, const IUSNJournalWalker::Callbacks& pCallbacks);
+
+    USNRecordStore m_Records;
 
     std::unordered_set<DWORDLONG> m_LocationsRefNum;
 
@@ -94,6 +103,18 @@ protected:
     WCHAR* m_pFullNameBuffer;
     DWORD m_cbFullNameBufferLen;
 
+private:
+    // Text preceding the name of the records of a directory
+    struct ParentPath
+    {
+        std::wstring Prefix;
+        bool bInSpecificLocation;
+    };
+
+    std::shared_ptr<const ParentPath> GetParentPath(DWORDLONG dwlParentRefNumber) const;
+
+    mutable concurrency::concurrent_unordered_map<DWORDLONG, std::shared_ptr<const ParentPath>> m_ParentPaths;
+    bool m_bParallel;
 };  // USNJournalWalkerBase
 }  // namespace Orc
 
@@ -12,8 +12,11 @@
 #include "MountedVolumeReader.h"
 
 #include "MFTWalker.h"
+#include "NTFSStream.h"
+#include "USNRecordCarver.h"
 
 #include <cmath>
+#include <numeric>
 
 #include <boost/scope_exit.hpp>
 
@@ -21,7 +24,7 @@ using namespace Orc;
 
 static const auto ROOT_USN = 0x0005000000000005LL;
 
-DWORD USNJournalWalkerOffline::m_BufferSize = 0x10000;
+DWORD USNJournalWalkerOffline::m_BufferSize = 0x100000;
 
 USNJournalWalkerOffline::USNJournalWalkerOffline()
     : m_Locations()
@@ -90,11 +93,6 @@ HRESULT USNJournalWalkerOffline::Initialize(const std::shared_ptr<Location>& loc
         Log::Error("Failed to parse location while searching for USN journal");
     }
 
-    if (FAILED(hr = m_RecordStore.InitializeStore(USN_MAX_NUMBER, m_dwRecordMaxSize)))
-    {
-        return hr;
-    }
-
     return S_OK;
 }
 
@@ -117,43 +115,45 @@ HRESULT USNJournalWalkerOffline::EnumJournal(const IUSNJournalWalker::Callbacks&
 
     MFTWalker::Callbacks callbacks;
 
-    callbacks.DirectoryCallback = [this](
+    std::vector<BYTE> buffer(m_dwRecordMaxSize);
+
+    callbacks.DirectoryCallback = [this, &buffer](
                                       const std::shared_ptr<VolumeReader>& volreader,
                                       MFTRecord* pElt,
                                       const PFILE_NAME pFileName,
                                       const std::shared_ptr<IndexAllocationAttribute>& pAttr) {
-        LPBYTE pUSNRecord = (LPBYTE)m_RecordStore.GetNewCell();
+        LARGE_INTEGER* pLI = (LARGE_INTEGER*)&pElt->GetFileReferenceNumber();
+        DWORDLONG frn = (DWORDLONG)pLI->QuadPart;
 
-        if (pUSNRecord != nullptr)
+        // we don't add the root folder and the records with filenames that use the 8.3 format only
+        if (frn != ROOT_USN && pFileName->Flags != FILE_NAME_DOS83)
         {
-            LARGE_INTEGER* pLI = (LARGE_INTEGER*)&pElt->GetFileReferenceNumber();
-            DWORDLONG frn = (DWORDLONG)pLI->QuadPart;
-
-            // we don't add the root folder and the records with filenames that use the 8.3 format only
-            if (frn != ROOT_USN && pFileName->Flags != FILE_NAME_DOS83)
-            {
-                WCHAR* fileName = (WCHAR*)&(pFileName->FileName);
-                DWORD fileNameLength = (DWORD)pFileName->FileNameLength * sizeof(WCHAR);
-
-                USN_RECORD record;
-                FillUSNRecord(record, pElt, pFileName);
-
-                memset(pUSNRecord, 0, m_dwRecordMaxSize);
-                memcpy_s(pUSNRecord, m_dwRecordMaxSize, &record, record.RecordLength - fileNameLength);
-                memcpy_s(
-                    pUSNRecord + ((__int64)&record.FileName - (__int64)&record),
-                    m_dwRecordMaxSize,
-                    fileName,
-                    fileNameLength);
-
-                m_USNMap.insert(std::pair<DWORDLONG, USN_RECORD*>(record.FileReferenceNumber, (USN_RECORD*)pUSNRecord));
-            }
-            else
-                m_RecordStore.FreeCell(pUSNRecord);
+            WCHAR* fileName = (WCHAR*)&(pFileName->FileName);
+            DWORD fileNameLength = (DWORD)pFileName->FileNameLength * sizeof(WCHAR);
+
+            USN_RECORD record;
+            FillUSNRecord(record, pElt, pFileName);
+
+            BYTE* pUSNRecord = buffer.data();
+            memset(pUSNRecord, 0, m_dwRecordMaxSize);
+            memcpy_s(pUSNRecord, m_dwRecordMaxSize, &record, record.RecordLength - fileNameLength);
+            memcpy_s(
+                pUSNRecord + ((__int64)&record.FileName - (__int64)&record),
+                m_dwRecordMaxSize,
+                fileName,
+                fileNameLength);
+
+            if (FAILED(m_Records.Insert((USN_RECORD*)pUSNRecord)))
+                Log::Debug(L"Failed to store USN record for FRN {:#x}", frn);
         }
     };
 
-    if (FAILED(hr = walk.Walk(callbacks)))
+    hr = walk.Walk(callbacks);
+
+    m_Records.Sort();
+    Log::Debug(L"USN record store: {} directories, {} bytes", m_Records.Size(), m_Records.MemoryUsage());
+
+    if (FAILED(hr))
     {
         if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
         {
@@ -169,98 +169,237 @@ HRESULT USNJournalWalkerOffline::EnumJournal(const IUSNJournalWalker::Callbacks&
     return S_OK;
 }
 
+std::vector<std::pair<ULONG64, ULONG64>> USNJournalWalkerOffline::GetJournalRanges() const
+{
+    if (const auto ntfsStream = std::dynamic_pointer_cast<NTFSStream>(m_USNJournal))
+        return ntfsStream->AllocatedRanges();
+
+    return {{0LL, m_USNJournal->GetSize()}};
+}
+
+ULONG64 USNJournalWalkerOffline::ParseChunk(
+    BYTE* pChunk,
+    BYTE* pEndChunk,
+    std::vector<USN_RECORD*>& records,
+    bool& shouldStop)
+{
+    BYTE* pCurrentChunkPosition = pChunk;
+    USN_RECORD* nextUSNRecord = nullptr;
+    ULONG64 adjustmentOffset = 0;
+    bool shouldReadAnotherChunk = false;
+
+    records.clear();
+
+    if (S_OK
+        != FindNextUSNRecord(
+            pCurrentChunkPosition,
+            pEndChunk,
+            (BYTE**)&nextUSNRecord,
+            shouldReadAnotherChunk,
+            adjustmentOffset,
+            shouldStop))
+    {
+        return adjustmentOffset;
+    }
+
+    // find all the entries we just got
+    while (!shouldReadAnotherChunk && nextUSNRecord != nullptr)
+    {
+        if (nextUSNRecord->RecordLength == 0)
+        {
+            shouldStop = true;
+            break;
+        }
+
+        records.push_back(nextUSNRecord);
+
+        pCurrentChunkPosition = reinterpret_cast<BYTE*>(nextUSNRecord) + nextUSNRecord->RecordLength;
+
+        if (S_OK
+            != FindNextUSNRecord(
+                pCurrentChunkPosition,
+                pEndChunk,
+                (BYTE**)&nextUSNRecord,
+                shouldReadAnotherChunk,
+                adjustmentOffset,
+                shouldStop))
+        {
+            break;
+        }
+    }
+
+    return adjustmentOffset;
+}
+
 HRESULT USNJournalWalkerOffline::ReadJournal(const IUSNJournalWalker::Callbacks& pCallbacks)
 {
     HRESULT hr = E_FAIL;
 
-    if (m_USNJournal)
+    if (!m_USNJournal)
+        return hr;
+
+    if (S_OK != m_USNJournal->CanRead())
+        return S_OK;
+
+    // A record truncated by the end of a chunk is moved to the start of the buffer, the next chunk is read after it
+    BYTE* pChunk = (BYTE*)HeapAlloc(GetProcessHeap(), 0, m_dwRecordMaxSize + m_BufferSize);
+    if (pChunk == nullptr)
+        return E_OUTOFMEMORY;
+
+    BOOST_SCOPE_EXIT(&pChunk) { HeapFree(GetProcessHeap(), 0, pChunk); }
+    BOOST_SCOPE_EXIT_END;
+
+    // Only the allocated tail of $J is read, purged records are sparse
+    const auto ranges = GetJournalRanges();
+    const auto ullAllocated = std::accumulate(
+        std::cbegin(ranges), std::cend(ranges), 0ULL, [](ULONG64 total, const auto& range) {
+            return total + range.second;
+        });
+
+    Log::Debug(
+        L"USN journal: reading {} bytes in {} range(s), skipping {} sparse bytes",
+        ullAllocated,
+        ranges.size(),
+        m_USNJournal->GetSize() - std::min(ullAllocated, m_USNJournal->GetSize()));
+
+    std::vector<USN_RECORD*> records;
+    bool shouldStop = false;
+    for (auto [offset, length] : ranges)
     {
-        ULONGLONG numBytesReturned = 0;
-        LPVOID pChunk = HeapAlloc(GetProcessHeap(), 0, m_BufferSize);
-        if (pChunk == nullptr)
-            return E_OUTOFMEMORY;
+        if (shouldStop)
+            break;
 
-        BOOST_SCOPE_EXIT(&pChunk) { HeapFree(GetProcessHeap(), 0, pChunk); }
-        BOOST_SCOPE_EXIT_END;
+        if (FAILED(hr = m_USNJournal->SetFilePointer(offset, FILE_BEGIN, NULL)))
+            return hr;
 
-        if (S_OK == m_USNJournal->CanRead())
+        const ULONG64 end = offset + length;
+        ULONG64 carry = 0;
+
+        while (!shouldStop && offset < end)
         {
-            ULONG64 size = m_USNJournal->GetSize();
-            ULONG64 offset = 0;
-            bool shouldStop = false;
+            // Reads are aligned on the buffer size: only the first one of a range may be shorter
+            const ULONG64 toRead = std::min<ULONG64>(m_BufferSize - offset % m_BufferSize, end - offset);
 
-            while (!shouldStop && offset < size)
+            ULONG64 numBytesRead = 0;
+            while (numBytesRead < toRead)
             {
-                if (FAILED(hr = m_USNJournal->SetFilePointer(offset, FILE_BEGIN, NULL)))
+                ULONGLONG numBytesReturned = 0;
+                if (FAILED(
+                        hr = m_USNJournal->Read(
+                            pChunk + carry + numBytesRead, toRead - numBytesRead, &numBytesReturned)))
                     return hr;
 
-                if (S_OK
-                    != m_USNJournal->Read(pChunk, std::min<ULONGLONG>(m_BufferSize, size - offset), &numBytesReturned))
-                {
-                    return hr;
-                }
-
-                BYTE* pCurrentChunkPosition = reinterpret_cast<BYTE*>(pChunk);
-                BYTE* pEndChunkPosition = reinterpret_cast<BYTE*>(pChunk) + numBytesReturned;
-                USN_RECORD* nextUSNRecord = nullptr;
-                ULONG64 adjustmentOffset = 0;
-                bool shouldReadAnotherChunk = false;
-
-                if (S_OK
-                    != FindNextUSNRecord(
-                        pCurrentChunkPosition,
-                        pEndChunkPosition,
-                        (BYTE**)&nextUSNRecord,
-                        shouldReadAnotherChunk,
-                        adjustmentOffset,
-                        shouldStop))
-                {
-                    if (shouldStop)
-                    {
-                        break;
-                    }
-                }
-                else
-                {
-                    // parse all the entries we just got
-                    while (!shouldReadAnotherChunk && nextUSNRecord != nullptr)
-                    {
-                        pCurrentChunkPosition = reinterpret_cast<BYTE*>(nextUSNRecord);
-                        bool bInSpecificLocation = false;
-                        WCHAR* pFullName = GetFullNameAndIfInLocation(nextUSNRecord, NULL, &bInSpecificLocation);
-
-                        if (pFullName && bInSpecificLocation)
-                        {
-                            pCallbacks.RecordCallback(m_VolReader, pFullName, nextUSNRecord);
-                            m_dwWalkedItems++;
-                        }
-
-                        pCurrentChunkPosition += nextUSNRecord->RecordLength;
-
-                        if (S_OK
-                            != FindNextUSNRecord(
-                                pCurrentChunkPosition,
-                                pEndChunkPosition,
-                                (BYTE**)&nextUSNRecord,
-                                shouldReadAnotherChunk,
-                                adjustmentOffset,
-                                shouldStop))
-                        {
-                            if (shouldStop)
-                            {
-                                break;
-                            }
-                        }
-                    }
-                }
+                if (numBytesReturned == 0)
+                    break;
+                numBytesRead += numBytesReturned;
+            }
+
+            if (numBytesRead == 0)
+                break;
+
+            offset += numBytesRead;
+
+            BYTE* pEndChunkPosition = pChunk + carry + numBytesRead;
+            carry = ParseChunk(pChunk, pEndChunkPosition, records, shouldStop);
+
+            // The records of the chunk are processed before the truncated one is moved
+            ProcessRecords(records, pCallbacks);
 
-                offset += (numBytesReturned - adjustmentOffset);
+            if (carry > m_dwRecordMaxSize)
+            {
+                Log::Debug(L"USN journal: skipping invalid record before offset {:#x}", offset);
+                carry = 0;
             }
-        }
 
-        hr = S_OK;
+            MoveMemory(pChunk, pEndChunkPosition - carry, (size_t)carry);
+        }
     }
 
+    return S_OK;
+}
+
+HRESULT USNJournalWalkerOffline::CarveJournal(
+    ByteStream& stream,
+    const std::vector<std::pair<ULONG64, ULONG64>>& ranges,
+    const IUSNJournalWalker::Callbacks& pCallbacks)
+{
+    constexpr size_t kBatchSize = 0x1000;
+    constexpr DWORD kHeaderV2 = FIELD_OFFSET(USN_RECORD_V2, FileName);
+
+    // Carved records are copied (as version 2 records) in 'batch' as the carver's buffer is reused
+    std::vector<BYTE> batch;
+    std::vector<size_t> offsets;
+    std::vector<USN_RECORD*> records;
+    ULONG64 ullSkipped = 0ULL;
+
+    const auto processBatch = [&]() {
+        records.clear();
+        for (auto offset : offsets)
+            records.push_back(reinterpret_cast<USN_RECORD*>(batch.data() + offset));
+
+        ProcessRecords(records, pCallbacks);
+
+        batch.clear();
+        offsets.clear();
+    };
+
+    HRESULT hr = USNRecordCarver::Carve(stream, ranges, [&](ULONG64, const BYTE* pData) {
+        const auto pRecord = reinterpret_cast<const USN_RECORD*>(pData);
+
+        if (pRecord->MajorVersion == 2)
+        {
+            offsets.push_back(batch.size());
+            batch.insert(std::end(batch), pData, pData + pRecord->RecordLength);
+        }
+        else if (pRecord->MajorVersion == 3)
+        {
+            // Only records with 64 bits reference numbers (NTFS) can be expressed as version 2 records
+            const auto pRecordV3 = reinterpret_cast<const USN_RECORD_V3*>(pData);
+            const auto highFRN = *reinterpret_cast<const DWORDLONG*>(pRecordV3->FileReferenceNumber + 8);
+            const auto highParentFRN = *reinterpret_cast<const DWORDLONG*>(pRecordV3->ParentFileReferenceNumber + 8);
+            if (highFRN != 0 || highParentFRN != 0)
+            {
+                ullSkipped++;
+                return;
+            }
+
+            const DWORD dwLength = (kHeaderV2 + pRecordV3->FileNameLength + 7) & ~7UL;
+            offsets.push_back(batch.size());
+            batch.resize(batch.size() + dwLength, 0);
+
+            auto pRecordV2 = reinterpret_cast<USN_RECORD_V2*>(batch.data() + offsets.back());
+            pRecordV2->RecordLength = dwLength;
+            pRecordV2->MajorVersion = 2;
+            pRecordV2->MinorVersion = 0;
+            pRecordV2->FileReferenceNumber = *reinterpret_cast<const DWORDLONG*>(pRecordV3->FileReferenceNumber);
+            pRecordV2->ParentFileReferenceNumber =
+                *reinterpret_cast<const DWORDLONG*>(pRecordV3->ParentFileReferenceNumber);
+            pRecordV2->Usn = pRecordV3->Usn;
+            pRecordV2->TimeStamp = pRecordV3->TimeStamp;
+            pRecordV2->Reason = pRecordV3->Reason;
+            pRecordV2->SourceInfo = pRecordV3->SourceInfo;
+            pRecordV2->SecurityId = pRecordV3->SecurityId;
+            pRecordV2->FileAttributes = pRecordV3->FileAttributes;
+            pRecordV2->FileNameLength = pRecordV3->FileNameLength;
+            pRecordV2->FileNameOffset = static_cast<WORD>(kHeaderV2);
+            CopyMemory(pRecordV2->FileName, pRecordV3->FileName, pRecordV3->FileNameLength);
+        }
+        else
+        {
+            // Version 4 records (range tracking) have no name nor time stamp
+            ullSkipped++;
+            return;
+        }
+
+        if (offsets.size() >= kBatchSize)
+            processBatch();
+    });
+
+    processBatch();
+
+    if (ullSkipped > 0)
+        Log::Debug(L"USN carving: skipped {} record(s) without a version 2 form", ullSkipped);
+
     return hr;
 }
 
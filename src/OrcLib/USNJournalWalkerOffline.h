@@ -37,6 +37,13 @@ public:
     virtual HRESULT EnumJournal(const IUSNJournalWalker::Callbacks& pCallbacks);
     virtual HRESULT ReadJournal(const IUSNJournalWalker::Callbacks& pCallbacks);
 
+    // Calls 'pCallbacks' for the records carved from the (offset, length) ranges of 'stream', the whole stream when
+    // 'ranges' is empty. Names are resolved with the directories found by EnumJournal.
+    HRESULT CarveJournal(
+        ByteStream& stream,
+        const std::vector<std::pair<ULONG64, ULONG64>>& ranges,
+        const IUSNJournalWalker::Callbacks& pCallbacks);
+
     // static functions
     static void FillUSNRecord(USN_RECORD& record, MFTRecord* pElt, const PFILE_NAME pFileName);
 
@@ -52,6 +59,12 @@ public:
     static void SetBufferSize(DWORD size);
 
 private:
+    // Ranges (offset, length) of the journal to read: the sparse head of $J is skipped
+    std::vector<std::pair<ULONG64, ULONG64>> GetJournalRanges() const;
+
+    // Finds the records of [pChunk, pEndChunk), returns the size of the record truncated by the end of the chunk
+    static ULONG64 ParseChunk(BYTE* pChunk, BYTE* pEndChunk, std::vector<USN_RECORD*>& records, bool& shouldStop);
+
     LocationSet m_Locations;
 
     std::shared_ptr<ByteStream> m_USNJournal;
@@ -0,0 +1,286 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "USNRecordCarver.h"
+
+#include "ByteStream.h"
+#include "USNJournalWalkerBase.h"
+
+#include <ppl.h>
+
+#include <emmintrin.h>
+
+using namespace Orc;
+
+namespace {
+
+constexpr size_t kChunkSize = 0x1000000;
+constexpr size_t kSliceSize = 0x100000;
+
+constexpr DWORD kHeaderV2 = FIELD_OFFSET(USNJournalWalkerBase::USN_RECORD_V2, FileName);
+constexpr DWORD kHeaderV3 = FIELD_OFFSET(USNJournalWalkerBase::USN_RECORD_V3, FileName);
+constexpr DWORD kHeaderV4 = FIELD_OFFSET(USNRecordCarver::USN_RECORD_V4, Extents);
+
+constexpr WORD kMaxFileNameLength = 255 * sizeof(WCHAR);
+
+// Time stamps outside of [2000-01-01, 2100-01-01] are very unlikely in a journal
+constexpr LONGLONG kMinTimeStamp = 125911584000000000LL;
+constexpr LONGLONG kMaxTimeStamp = 157766016000000000LL;
+
+// USN_REASON_* flags, up to USN_REASON_DESIRED_STORAGE_CLASS_CHANGE, and USN_REASON_CLOSE
+constexpr DWORD kReasonMask = 0x83FFFFFF;
+
+constexpr DWORD Align8(DWORD dwValue)
+{
+    return (dwValue + 7) & ~7UL;
+}
+
+bool IsValidCommon(USN usn, DWORD dwReason)
+{
+    return usn >= 0 && (usn % 8) == 0 && dwReason != 0 && (dwReason & ~kReasonMask) == 0;
+}
+
+bool IsValidFileName(const BYTE* pRecord, DWORD dwHeader, WORD wFileNameLength, WORD wFileNameOffset)
+{
+    if (wFileNameOffset != dwHeader || wFileNameLength == 0 || wFileNameLength % sizeof(WCHAR) != 0
+        || wFileNameLength > kMaxFileNameLength)
+        return false;
+
+    const auto pName = reinterpret_cast<const WCHAR*>(pRecord + wFileNameOffset);
+    for (size_t i = 0; i < wFileNameLength / sizeof(WCHAR); i++)
+    {
+        if (pName[i] == L'\0' || pName[i] == L'\\' || pName[i] == L'/')
+            return false;
+    }
+    return true;
+}
+
+template <typename RecordT>
+DWORD GetNamedRecordLength(const BYTE* pData, size_t cbData, DWORD dwHeader)
+{
+    if (cbData < dwHeader)
+        return 0L;
+
+    const auto pRecord = reinterpret_cast<const RecordT*>(pData);
+    if (pRecord->RecordLength != Align8(dwHeader + pRecord->FileNameLength) || pRecord->RecordLength > cbData)
+        return 0L;
+
+    if (pRecord->TimeStamp.QuadPart < kMinTimeStamp || pRecord->TimeStamp.QuadPart > kMaxTimeStamp)
+        return 0L;
+
+    if (!IsValidCommon(pRecord->Usn, pRecord->Reason))
+        return 0L;
+
+    if (!IsValidFileName(pData, dwHeader, pRecord->FileNameLength, pRecord->FileNameOffset))
+        return 0L;
+
+    return pRecord->RecordLength;
+}
+
+DWORD GetExtentRecordLength(const BYTE* pData, size_t cbData)
+{
+    if (cbData < kHeaderV4)
+        return 0L;
+
+    const auto pRecord = reinterpret_cast<const USNRecordCarver::USN_RECORD_V4*>(pData);
+    if (pRecord->ExtentSize != 2 * sizeof(LONGLONG) || pRecord->NumberOfExtents == 0
+        || pRecord->RecordLength != kHeaderV4 + pRecord->NumberOfExtents * pRecord->ExtentSize
+        || pRecord->RecordLength > cbData)
+        return 0L;
+
+    if (!IsValidCommon(pRecord->Usn, pRecord->Reason))
+        return 0L;
+
+    for (WORD i = 0; i < pRecord->NumberOfExtents; i++)
+    {
+        if (pRecord->Extents[i].Offset < 0 || pRecord->Extents[i].Length <= 0)
+            return 0L;
+    }
+
+    return pRecord->RecordLength;
+}
+
+}  // namespace
+
+DWORD USNRecordCarver::GetRecordLength(const BYTE* pData, size_t cbData)
+{
+    if (cbData < sizeof(DWORD) + 2 * sizeof(WORD))
+        return 0L;
+
+    const auto pRecord = reinterpret_cast<const USN_RECORD*>(pData);
+    if (pRecord->MinorVersion != 0 || pRecord->RecordLength > kMaxRecordSize || pRecord->RecordLength % 8 != 0)
+        return 0L;
+
+    switch (pRecord->MajorVersion)
+    {
+        case 2:
+            return GetNamedRecordLength<USNJournalWalkerBase::USN_RECORD_V2>(pData, cbData, kHeaderV2);
+        case 3:
+            return GetNamedRecordLength<USNJournalWalkerBase::USN_RECORD_V3>(pData, cbData, kHeaderV3);
+        case 4:
+            return GetExtentRecordLength(pData, cbData);
+        default:
+            return 0L;
+    }
+}
+
+void USNRecordCarver::Scan(const BYTE* pData, size_t cbScan, size_t cbData, std::vector<size_t>& offsets)
+{
+    // Two 8 bytes slots per vector. In each slot, the bits set in the mask must be clear: RecordLength is a multiple
+    // of 8 below 0x1000, MajorVersion is below 0x100 and MinorVersion is 0. MajorVersion is then checked for 2 to 4.
+    const __m128i mask = _mm_set_epi8(
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0x00,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xF0,
+        (char)0x07,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0x00,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xF0,
+        (char)0x07);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi8(2);
+
+    const auto tryAt = [pData, cbData, &offsets](size_t pos) -> DWORD {
+        const auto dwLength = GetRecordLength(pData + pos, cbData - pos);
+        if (dwLength != 0)
+            offsets.push_back(pos);
+        return dwLength;
+    };
+
+    size_t pos = 0;
+    while (pos + sizeof(__m128i) <= cbScan)
+    {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + pos));
+        const int iClear = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(value, mask), zero));
+
+        // MajorVersion - 2 <= 2 (unsigned)
+        const __m128i version = _mm_sub_epi8(value, two);
+        const int iVersion = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(version, two), version));
+
+        if ((iClear & 0x00FF) == 0x00FF && (iVersion & 0x0010))
+        {
+            if (const auto dwLength = tryAt(pos))
+            {
+                pos += dwLength;
+                continue;
+            }
+        }
+
+        if ((iClear & 0xFF00) == 0xFF00 && (iVersion & 0x1000))
+        {
+            if (const auto dwLength = tryAt(pos + 8))
+            {
+                pos += 8 + dwLength;
+                continue;
+            }
+        }
+
+        pos += sizeof(__m128i);
+    }
+
+    while (pos < cbScan)
+    {
+        const auto dwLength = tryAt(pos);
+        pos += dwLength != 0 ? dwLength : 8;
+    }
+}
+
+HRESULT USNRecordCarver::Carve(
+    ByteStream& stream,
+    const std::vector<std::pair<ULONG64, ULONG64>>& ranges,
+    const RecordCall& onRecord)
+{
+    HRESULT hr = E_FAIL;
+
+    if (S_OK != stream.CanRead())
+        return HRESULT_FROM_WIN32(ERROR_INVALID_FUNCTION);
+
+    auto toCarve = ranges;
+    if (toCarve.empty())
+        toCarve.emplace_back(0ULL, stream.GetSize());
+
+    // Each chunk is read with enough of the next one to validate the records it cuts
+    std::vector<BYTE> buffer(kChunkSize + kMaxRecordSize);
+    const size_t cSlices = kChunkSize / kSliceSize;
+    std::vector<std::vector<size_t>> slices(cSlices);
+
+    ULONG64 ullSkipUntil = 0ULL;
+    ULONG64 ullRecords = 0ULL;
+    for (auto [ullOffset, ullLength] : toCarve)
+    {
+        const ULONG64 ullEnd = ullOffset + ullLength;
+        ullOffset &= ~7ULL;
+
+        while (ullOffset < ullEnd)
+        {
+            if (FAILED(hr = stream.SetFilePointer(ullOffset, FILE_BEGIN, NULL)))
+            {
+                Log::Error(L"Failed to seek to offset {:#x} for USN carving [{}]", ullOffset, SystemError(hr));
+                return hr;
+            }
+
+            const size_t cbToRead = static_cast<size_t>(std::min<ULONG64>(buffer.size(), ullEnd - ullOffset));
+            size_t cbRead = 0;
+            while (cbRead < cbToRead)
+            {
+                ULONGLONG cbReturned = 0;
+                if (FAILED(hr = stream.Read(buffer.data() + cbRead, cbToRead - cbRead, &cbReturned)))
+                {
+                    Log::Error(L"Failed to read at offset {:#x} for USN carving [{}]", ullOffset, SystemError(hr));
+                    return hr;
+                }
+
+                if (cbReturned == 0)
+                    break;
+                cbRead += static_cast<size_t>(cbReturned);
+            }
+
+            if (cbRead == 0)
+                break;
+
+            const size_t cbScan = std::min(kChunkSize, cbRead);
+            concurrency::parallel_for(size_t(0), cSlices, [&](size_t i) {
+                slices[i].clear();
+                const size_t start = i * kSliceSize;
+                if (start < cbScan)
+                    Scan(buffer.data() + start, std::min(kSliceSize, cbScan - start), cbRead - start, slices[i]);
+            });
+
+            // Slices are scanned independently: a record found inside of the previous one is ignored
+            for (size_t i = 0; i < cSlices; i++)
+            {
+                for (const auto offset : slices[i])
+                {
+                    const ULONG64 ullRecordOffset = ullOffset + i * kSliceSize + offset;
+                    if (ullRecordOffset < ullSkipUntil)
+                        continue;
+
+                    const BYTE* pRecord = buffer.data() + i * kSliceSize + offset;
+                    ullSkipUntil = ullRecordOffset + reinterpret_cast<const USN_RECORD*>(pRecord)->RecordLength;
+                    ullRecords++;
+
+                    onRecord(ullRecordOffset, pRecord);
+                }
+            }
+
+            ullOffset += cbScan;
+        }
+    }
+
+    Log::Debug(L"USN carving: found {} record(s) in {} range(s)", ullRecords, toCarve.size());
+    return S_OK;
+}
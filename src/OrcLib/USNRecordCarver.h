@@ -0,0 +1,70 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include <winioctl.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+class ByteStream;
+
+// Finds USN records (versions 2, 3 and 4) in arbitrary data: unallocated clusters, slack, shadow copy diff areas or
+// sector dumps. Records are 8 bytes aligned in the journal and the journal is cluster aligned: only 8 bytes aligned
+// offsets of the stream are considered.
+class ORCLIB_API USNRecordCarver
+{
+public:
+    struct USN_RECORD_V4
+    {
+        DWORD RecordLength;
+        WORD MajorVersion;
+        WORD MinorVersion;
+        BYTE FileReferenceNumber[16];
+        BYTE ParentFileReferenceNumber[16];
+        USN Usn;
+        DWORD Reason;
+        DWORD SourceInfo;
+        DWORD RemainingExtents;
+        WORD NumberOfExtents;
+        WORD ExtentSize;
+        struct
+        {
+            LONGLONG Offset;
+            LONGLONG Length;
+        } Extents[1];
+    };
+
+    // Called in stream order with the offset of the record in the stream, 'pRecord' is valid during the call only
+    using RecordCall = std::function<void(ULONG64 ullOffset, const BYTE* pRecord)>;
+
+    static constexpr size_t kMaxRecordSize = 0x1000;
+
+    // Length of the valid record at 'pData' or 0 if the data there is not a plausible record
+    static DWORD GetRecordLength(const BYTE* pData, size_t cbData);
+
+    // Appends the offsets of the records starting in [pData, pData + cbScan), records may extend up to pData + cbData.
+    // 'pData' must be 8 bytes aligned in the stream.
+    static void Scan(const BYTE* pData, size_t cbScan, size_t cbData, std::vector<size_t>& offsets);
+
+    // Carves the (offset, length) ranges of 'stream', the whole stream when 'ranges' is empty. Chunks are scanned
+    // concurrently, 'onRecord' is called from the calling thread.
+    static HRESULT
+    Carve(ByteStream& stream, const std::vector<std::pair<ULONG64, ULONG64>>& ranges, const RecordCall& onRecord);
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
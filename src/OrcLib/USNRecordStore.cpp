@@ -0,0 +1,157 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "USNRecordStore.h"
+
+using namespace Orc;
+
+HRESULT USNRecordStore::Insert(const USN_RECORD* pRecord)
+{
+    if (pRecord == nullptr || pRecord->RecordLength < FIELD_OFFSET(USN_RECORD, FileName)
+        || pRecord->RecordLength > kBlockSize)
+        return E_INVALIDARG;
+
+    const auto ullKey = MakeKey(pRecord->FileReferenceNumber);
+
+    if (m_bSorted && !m_Index.empty())
+    {
+        if (m_Index.back().Key == ullKey)
+            return S_FALSE;
+        if (m_Index.back().Key > ullKey)
+            m_bSorted = false;
+    }
+
+    // Records are 8 bytes aligned, like in the journal
+    const size_t cbRecord = (pRecord->RecordLength + 7) & ~static_cast<size_t>(7);
+    if (m_BlockUsed + cbRecord > kBlockSize)
+    {
+        std::unique_ptr<BYTE[]> block(new (std::nothrow) BYTE[kBlockSize]);
+        if (block == nullptr)
+            return E_OUTOFMEMORY;
+
+        m_Blocks.push_back(std::move(block));
+        m_BlockUsed = 0;
+    }
+
+    auto pCopy = reinterpret_cast<USN_RECORD*>(m_Blocks.back().get() + m_BlockUsed);
+    CopyMemory(pCopy, pRecord, pRecord->RecordLength);
+    m_BlockUsed += cbRecord;
+
+    m_Index.push_back({ullKey, pCopy});
+    m_Count++;
+    return S_OK;
+}
+
+void USNRecordStore::Sort()
+{
+    if (m_bSorted)
+        return;
+
+    // Stable so that the first record inserted for a file reference number is kept
+    std::stable_sort(std::begin(m_Index), std::end(m_Index), [](const Entry& left, const Entry& right) {
+        return left.Key < right.Key;
+    });
+
+    auto last = std::unique(std::begin(m_Index), std::end(m_Index), [](const Entry& left, const Entry& right) {
+        return left.Key == right.Key;
+    });
+    m_Index.erase(last, std::end(m_Index));
+
+    // Erased entries are dropped
+    m_Index.erase(
+        std::remove_if(
+            std::begin(m_Index), std::end(m_Index), [](const Entry& entry) { return entry.pRecord == nullptr; }),
+        std::end(m_Index));
+
+    m_Count = m_Index.size();
+    m_bSorted = true;
+}
+
+std::vector<USNRecordStore::Entry>::const_iterator USNRecordStore::LowerBound(ULONG64 ullKey) const
+{
+    return std::lower_bound(
+        std::cbegin(m_Index), std::cend(m_Index), ullKey, [](const Entry& entry, ULONG64 key) {
+            return entry.Key < key;
+        });
+}
+
+void USNRecordStore::Erase(DWORDLONG dwlFileReferenceNumber)
+{
+    Sort();
+
+    const auto ullKey = MakeKey(dwlFileReferenceNumber);
+    auto it = LowerBound(ullKey);
+    if (it == std::cend(m_Index) || it->Key != ullKey || it->pRecord == nullptr)
+        return;
+
+    // The record space is not reused, the index entry is only marked as erased
+    m_Index[std::distance(std::cbegin(m_Index), it)].pRecord = nullptr;
+    m_Count--;
+}
+
+USN_RECORD* USNRecordStore::Find(DWORDLONG dwlFileReferenceNumber) const
+{
+    const auto ullKey = MakeKey(dwlFileReferenceNumber);
+
+    if (!m_bSorted)
+    {
+        _ASSERT(m_bSorted && "USNRecordStore must be sorted before lookups");
+        const auto it = std::find_if(std::cbegin(m_Index), std::cend(m_Index), [ullKey](const Entry& entry) {
+            return entry.Key == ullKey && entry.pRecord != nullptr;
+        });
+        return it != std::cend(m_Index) ? it->pRecord : nullptr;
+    }
+
+    const auto it = LowerBound(ullKey);
+    if (it == std::cend(m_Index) || it->Key != ullKey)
+        return nullptr;
+    return it->pRecord;
+}
+
+USN_RECORD* USNRecordStore::FindSegment(ULONG64 ullSegmentNumber) const
+{
+    _ASSERT(m_bSorted);
+
+    // Keys of a segment are [segment << 16, (segment << 16) | 0xFFFF]
+    const auto ullFirstKey = SegmentNumber(ullSegmentNumber) << 16;
+
+    USN_RECORD* pRecord = nullptr;
+    for (auto it = LowerBound(ullFirstKey); it != std::cend(m_Index) && (it->Key >> 16) == (ullFirstKey >> 16); ++it)
+    {
+        if (it->pRecord != nullptr)
+            pRecord = it->pRecord;
+    }
+    return pRecord;
+}
+
+void USNRecordStore::ForEach(const std::function<void(USN_RECORD*)>& callback) const
+{
+    _ASSERT(m_bSorted);
+
+    // Erasing only clears an entry: the index does not move while it is walked
+    for (size_t i = 0; i < m_Index.size(); i++)
+    {
+        if (m_Index[i].pRecord != nullptr)
+            callback(m_Index[i].pRecord);
+    }
+}
+
+ULONG64 USNRecordStore::MemoryUsage() const
+{
+    return m_Blocks.size() * kBlockSize + m_Index.capacity() * sizeof(Entry);
+}
+
+void USNRecordStore::Clear()
+{
+    m_Blocks.clear();
+    m_BlockUsed = kBlockSize;
+    m_Index.clear();
+    m_Count = 0;
+    m_bSorted = true;
+}
@@ -0,0 +1,82 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include <winioctl.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Records of the directories (and files) known to the USN journal walkers.
+// Records are copied with their actual length one after the other in large blocks (names are stored once, inside
+// their record) and indexed by a sorted array of file reference numbers. Records never move: the pointers returned
+// stay valid until Clear().
+class ORCLIB_API USNRecordStore
+{
+public:
+    USNRecordStore() = default;
+    USNRecordStore(const USNRecordStore&) = delete;
+    USNRecordStore& operator=(const USNRecordStore&) = delete;
+
+    // Records whose file reference number is already in the store are ignored (the first one is kept)
+    HRESULT Insert(const USN_RECORD* pRecord);
+    void Erase(DWORDLONG dwlFileReferenceNumber);
+
+    // Sorts the index once records are inserted. Lookups are safe for concurrent use once the store is sorted.
+    void Sort();
+
+    // Record with this exact file reference number (segment and sequence)
+    USN_RECORD* Find(DWORDLONG dwlFileReferenceNumber) const;
+
+    // Record with the highest sequence number for this MFT segment
+    USN_RECORD* FindSegment(ULONG64 ullSegmentNumber) const;
+
+    // Calls 'callback' in file reference order (segment, then sequence), 'callback' may erase the current record
+    void ForEach(const std::function<void(USN_RECORD*)>& callback) const;
+
+    size_t Size() const { return m_Count; }
+    ULONG64 MemoryUsage() const;
+
+    void Clear();
+
+    static ULONG64 SegmentNumber(DWORDLONG dwlFileReferenceNumber)
+    {
+        return dwlFileReferenceNumber & 0x0000FFFFFFFFFFFF;
+    }
+
+private:
+    struct Entry
+    {
+        ULONG64 Key;  // Segment number then sequence number: lookups by segment are a range of the index
+        USN_RECORD* pRecord;  // nullptr once erased
+    };
+
+    static ULONG64 MakeKey(DWORDLONG dwlFileReferenceNumber) { return _rotl64(dwlFileReferenceNumber, 16); }
+
+    std::vector<Entry>::const_iterator LowerBound(ULONG64 ullKey) const;
+
+    static constexpr size_t kBlockSize = 0x100000;
+
+    std::vector<std::unique_ptr<BYTE[]>> m_Blocks;
+    size_t m_BlockUsed = kBlockSize;
+
+    std::vector<Entry> m_Index;
+    size_t m_Count = 0;
+    bool m_bSorted = true;
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
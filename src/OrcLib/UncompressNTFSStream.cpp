@@ -15,6 +15,8 @@
 #include "NTFSStream.h"
 #include "VolumeReader.h"
 
+#include <ppl.h>
+
 using namespace Orc;
 
 UncompressNTFSStream::UncompressNTFSStream()
@@ -67,6 +69,8 @@ HRESULT UncompressNTFSStream::Open(const std::shared_ptr<ByteStream>& pChained,
         (DWORD)(pChained->GetSize() / m_dwCompressionUnit) + ((pChained->GetSize() % m_dwCompressionUnit) ? 1 : 0);
 
     m_ullPosition = 0LL;
+    m_ullUncompressedOffset = 0LL;
+    m_ullUncompressedSize = 0LL;
     return S_OK;
 }
 
@@ -181,8 +185,9 @@ HRESULT UncompressNTFSStream::Open(const std::shared_ptr<NTFSStream>& pChained,
 }
 
 HRESULT UncompressNTFSStream::ReadCompressionUnit(
+    DWORD dwFirstCU,
     DWORD dwNbCU,
-    CBinaryBuffer& uncompressedData,
+    LPBYTE pUncompressed,
     __out_opt PULONGLONG pcbBytesRead)
 {
     HRESULT hr = E_FAIL;
@@ -190,27 +195,30 @@ HRESULT UncompressNTFSStream::ReadCompressionUnit(
     if (pcbBytesRead)
         *pcbBytesRead = 0LL;
 
-    if (dwNbCU > m_dwMaxCompressionUnit)
+    if (dwFirstCU >= m_dwMaxCompressionUnit)
+        return S_OK;
+
+    if (dwNbCU > m_dwMaxCompressionUnit - dwFirstCU)
+        dwNbCU = m_dwMaxCompressionUnit - dwFirstCU;
+
+    const LONGLONG llOffset = static_cast<LONGLONG>(dwFirstCU) * m_dwCompressionUnit;
+    if (FAILED(hr = m_pChainedStream->SetFilePointer(llOffset, FILE_BEGIN, NULL)))
     {
-        Log::Error(
-            "Attempted to read past the last compression unit (tried {}, max is {})", dwNbCU, m_dwMaxCompressionUnit);
+        Log::Error(L"Failed to seek chained stream to offset {:#x} [{}]", llOffset, SystemError(hr));
         return hr;
     }
 
-    ULONGLONG ullRead = 0LL;
-    ULONGLONG ullToRead = static_cast<ULONGLONG>(dwNbCU) * m_dwCompressionUnit;
-
-    CBinaryBuffer buffer(true);
-    if (!buffer.SetCount(static_cast<size_t>(ullToRead)))
+    const ULONGLONG ullToRead = static_cast<ULONGLONG>(dwNbCU) * m_dwCompressionUnit;
+    if (m_Compressed.GetCount() < ullToRead && !m_Compressed.SetCount(static_cast<size_t>(ullToRead)))
         return E_OUTOFMEMORY;
 
-    while (ullRead < (m_dwCompressionUnit * static_cast<ULONGLONG>(dwNbCU)) && ullRead < ullToRead)
+    ULONGLONG ullRead = 0LL;
+    while (ullRead < ullToRead)
     {
         ULONGLONG ullThisRead = 0LL;
-        if (FAILED(hr = m_pChainedStream->Read(buffer.GetData() + ullRead, buffer.GetCount() - ullRead, &ullThisRead)))
+        if (FAILED(hr = m_pChainedStream->Read(m_Compressed.GetData() + ullRead, ullToRead - ullRead, &ullThisRead)))
         {
-            Log::Error(
-                L"Failed to read {} bytes from chained stream [{}]", buffer.GetCount() - ullRead, SystemError(hr));
+            Log::Error(L"Failed to read {} bytes from chained stream [{}]", ullToRead - ullRead, SystemError(hr));
             return hr;
         }
         if (ullThisRead == 0LL)
@@ -219,171 +227,51 @@ HRESULT UncompressNTFSStream::ReadCompressionUnit(
     }
 
     if (ullRead == 0LL)
-    {
-        buffer.RemoveAll();
         return S_OK;
-    }
 
-    size_t uncomp_processed = 0;
+    const DWORD dwReadCU = static_cast<DWORD>((ullRead + m_dwCompressionUnit - 1) / m_dwCompressionUnit);
 
-    for (unsigned int i = 0; i < dwNbCU; i++)
-    {
-        size_t unitIndex = ((size_t)m_ullPosition / m_dwCompressionUnit) + i;
+    // only the last compression unit can be truncated, it is decompressed in a buffer of CU size
+    if (ullRead % m_dwCompressionUnit && m_LastUnit.GetCount() < m_dwCompressionUnit
+        && !m_LastUnit.SetCount(m_dwCompressionUnit))
+        return E_OUTOFMEMORY;
+
+    const auto uncompressUnit = [this, dwFirstCU, ullRead, pUncompressed](DWORD i) {
+        const size_t unitOffset = static_cast<size_t>(i) * m_dwCompressionUnit;
+        const size_t cbUnit = static_cast<size_t>(std::min<ULONGLONG>(m_dwCompressionUnit, ullRead - unitOffset));
+        const BYTE* pIn = m_Compressed.GetData() + unitOffset;
+        BYTE* pOut = pUncompressed + unitOffset;
 
-        if (ullRead - uncomp_processed >= m_dwCompressionUnit)
+        // without compression status, compression units are assumed to be compressed
+        if (!m_IsBlockCompressed.empty() && !static_cast<bool>(m_IsBlockCompressed[dwFirstCU + i]))
         {
-            if (!m_IsBlockCompressed.empty())
-            {
-                if (m_IsBlockCompressed[unitIndex])
-                {
-                    // compression unit is compressed: proceed with decompression
-                    NTFS_COMP_INFO info;
-                    info.buf_size_b = m_dwCompressionUnit;
-                    info.comp_buf = (char*)buffer.GetData() + uncomp_processed;
-                    info.comp_len = m_dwCompressionUnit;
-                    info.uncomp_buf = (char*)uncompressedData.GetData() + uncomp_processed;
-                    info.uncomp_idx = 0L;
-
-                    if (FAILED(hr = ntfs_uncompress_compunit(&info)))
-                    {
-                        Log::Warn(
-                            L"Failed to uncompress {} bytes from compressed unit, copying as raw/uncompressed data "
-                            L"[{}]",
-                            info.comp_len,
-                            SystemError(hr));
-                        CopyMemory(
-                            (LPBYTE)uncompressedData.GetData() + uncomp_processed,
-                            (char*)buffer.GetData() + uncomp_processed,
-                            m_dwCompressionUnit);
-                        uncomp_processed += m_dwCompressionUnit;
-                    }
-                    else
-                    {
-                        uncomp_processed += info.comp_len;
-                    }
-                }
-                else
-                {
-                    CopyMemory(
-                        (LPBYTE)uncompressedData.GetData() + uncomp_processed,
-                        (char*)buffer.GetData() + uncomp_processed,
-                        m_dwCompressionUnit);
-                    uncomp_processed += m_dwCompressionUnit;
-                }
-            }
-            else
-            {
-                // compression unit is compressed: proceed with decompression
-                NTFS_COMP_INFO info;
-                info.buf_size_b = m_dwCompressionUnit;
-                info.comp_buf = (char*)buffer.GetData() + uncomp_processed;
-                info.comp_len = m_dwCompressionUnit;
-                info.uncomp_buf = (char*)uncompressedData.GetCount() + uncomp_processed;
-                info.uncomp_idx = 0L;
-
-                if (FAILED(hr = ntfs_uncompress_compunit(&info)))
-                {
-                    // If decompression failed and CUs not compressed information is not available, we assume the CU was
-                    // not compressed
-                    Log::Warn(
-                        "Failed to uncompress {} bytes from compressed unit, copying as raw/uncompressed data [{}]",
-                        info.comp_len,
-                        SystemError(hr));
-                    CopyMemory(
-                        (LPBYTE)uncompressedData.GetData() + uncomp_processed,
-                        (char*)buffer.GetData() + uncomp_processed,
-                        m_dwCompressionUnit);
-                    uncomp_processed += m_dwCompressionUnit;
-                }
-                else
-                {
-                    uncomp_processed += info.comp_len;
-                }
-            }
+            CopyMemory(pOut, pIn, cbUnit);
+            return;
         }
-        else
+
+        BYTE* pDest = cbUnit == m_dwCompressionUnit ? pOut : m_LastUnit.GetData();
+        if (FAILED(lznt1_decompress_unit(pDest, m_dwCompressionUnit, pIn, cbUnit)))
         {
-            if (!m_IsBlockCompressed.empty())
-            {
-                // the last uncompression has to take place in a buffer of at least CU size
-                if (m_IsBlockCompressed[unitIndex])
-                {
-                    CBinaryBuffer uncomp(true);
-                    uncomp.SetCount(m_dwCompressionUnit);
+            Log::Warn(
+                L"Failed to uncompress {} bytes from compressed unit {}, copying as raw/uncompressed data",
+                cbUnit,
+                dwFirstCU + i);
+            CopyMemory(pOut, pIn, cbUnit);
+            return;
+        }
 
-                    NTFS_COMP_INFO info;
-                    info.buf_size_b = m_dwCompressionUnit;
-                    info.comp_buf = (char*)buffer.GetData() + uncomp_processed;
-                    info.comp_len = m_dwCompressionUnit;
-                    info.uncomp_buf = (char*)uncomp.GetData();
-                    info.uncomp_idx = 0L;
+        if (pDest != pOut)
+            CopyMemory(pOut, pDest, cbUnit);
+    };
 
-                    if (FAILED(hr = ntfs_uncompress_compunit(&info)))
-                    {
-                        Log::Warn(
-                            L"Failed to uncompress {} bytes from compressed unit, copying as raw/uncompressed data "
-                            L"[{}]",
-                            info.comp_len,
-                            SystemError(hr));
-                        CopyMemory(
-                            (LPBYTE)uncompressedData.GetData() + uncomp_processed,
-                            (char*)buffer.GetData() + uncomp_processed,
-                            m_dwCompressionUnit);
-                        uncomp_processed += m_dwCompressionUnit;
-                    }
-                    else
-                    {
-                        CopyMemory(
-                            uncompressedData.GetData() + uncomp_processed,
-                            uncomp.GetData(),
-                            static_cast<size_t>(ullRead - uncomp_processed));
-                        uncomp_processed += static_cast<size_t>(ullRead - uncomp_processed);
-                    }
-                }
-                else
-                {
-                    CopyMemory(
-                        uncompressedData.GetData() + uncomp_processed,
-                        (char*)buffer.GetData() + uncomp_processed,
-                        static_cast<size_t>(ullRead - uncomp_processed));
-                    uncomp_processed += static_cast<size_t>(ullRead - uncomp_processed);
-                }
-            }
-            else
-            {
-                CBinaryBuffer uncomp(true);
-                uncomp.SetCount(m_dwCompressionUnit);
-
-                NTFS_COMP_INFO info;
-                info.buf_size_b = m_dwCompressionUnit;
-                info.comp_buf = (char*)buffer.GetData() + uncomp_processed;
-                info.comp_len = m_dwCompressionUnit;
-                info.uncomp_buf = (char*)uncomp.GetData();
-                info.uncomp_idx = 0L;
+    // compression units are independent
+    if (dwReadCU > 1)
+        concurrency::parallel_for(DWORD(0), dwReadCU, uncompressUnit);
+    else
+        uncompressUnit(0);
 
-                if (FAILED(hr = ntfs_uncompress_compunit(&info)))
-                {
-                    // If decompression failed and CUs not compressed information is not available, we assume the CU was
-                    // not compressed
-                    CopyMemory(
-                        (LPBYTE)uncompressedData.GetData() + uncomp_processed,
-                        (char*)buffer.GetData() + uncomp_processed,
-                        static_cast<size_t>(ullRead - uncomp_processed));
-                    uncomp_processed += m_dwCompressionUnit;
-                }
-                else
-                {
-                    CopyMemory(
-                        uncompressedData.GetData() + uncomp_processed,
-                        uncomp.GetData(),
-                        static_cast<size_t>(ullRead - uncomp_processed));
-                    uncomp_processed += static_cast<size_t>(ullRead - uncomp_processed);
-                }
-            }
-        }
-    }
     if (pcbBytesRead)
-        *pcbBytesRead = uncomp_processed;
+        *pcbBytesRead = ullRead;
     return S_OK;
 }
 
@@ -400,69 +288,68 @@ HRESULT UncompressNTFSStream::Read(
 
     ULONGLONG ullDataSize = m_pChainedStream->GetSize();
 
-    if ((cbBytesToRead + m_ullPosition) > ullDataSize)
-        cbBytesToRead = ullDataSize - m_ullPosition;
-
-    if (cbBytesToRead == 0)
-    {
-        if (pcbBytesRead != NULL)
-            *pcbBytesRead = 0LL;
+    if (m_ullPosition >= ullDataSize)
         return S_OK;
-    }
 
-    ULONGLONG ullBytesToRead = (m_ullPosition % m_dwCompressionUnit) + cbBytesToRead;
-    DWORD dwCUsToRead =
-        static_cast<DWORD>(ullBytesToRead / m_dwCompressionUnit + (ullBytesToRead % m_dwCompressionUnit > 0 ? 1 : 0));
-    ULONGLONG ullToRead = 0LLU;
-
-    if (!msl::utilities::SafeMultiply((ULONGLONG)dwCUsToRead, m_dwCompressionUnit, ullToRead))
-        return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+    if ((cbBytesToRead + m_ullPosition) > ullDataSize)
+        cbBytesToRead = ullDataSize - m_ullPosition;
 
+    LPBYTE pOut = reinterpret_cast<LPBYTE>(pBuffer);
     ULONGLONG ullRead = 0LL;
 
-    if (m_ullPosition % m_dwCompressionUnit == 0)
+    while (ullRead < cbBytesToRead)
     {
-        if (cbBytesToRead >= ullToRead)
+        const ULONGLONG ullPosition = m_ullPosition + ullRead;
+        const ULONGLONG ullRemaining = cbBytesToRead - ullRead;
+
+        // served from the last decompressed compression units
+        if (ullPosition >= m_ullUncompressedOffset && ullPosition < m_ullUncompressedOffset + m_ullUncompressedSize)
         {
-            CBinaryBuffer buffer((LPBYTE)pBuffer, (size_t)cbBytesToRead);
-            if (FAILED(hr = ReadCompressionUnit(dwCUsToRead, buffer, &ullRead)))
-                return hr;
+            const auto ullChunk =
+                std::min<ULONGLONG>(ullRemaining, m_ullUncompressedOffset + m_ullUncompressedSize - ullPosition);
+            CopyMemory(
+                pOut + ullRead, m_Uncompressed.GetData() + (ullPosition - m_ullUncompressedOffset), (size_t)ullChunk);
+            ullRead += ullChunk;
+            continue;
         }
-        else
+
+        const DWORD dwFirstCU = static_cast<DWORD>(ullPosition / m_dwCompressionUnit);
+
+        // whole compression units are decompressed directly in the caller's buffer
+        if (ullPosition % m_dwCompressionUnit == 0 && ullRemaining >= m_dwCompressionUnit)
         {
-            CBinaryBuffer buffer;
-            buffer.SetCount((size_t)ullToRead);
-            if (FAILED(hr = ReadCompressionUnit(dwCUsToRead, buffer, &ullRead)))
+            const DWORD dwNbCU = static_cast<DWORD>(ullRemaining / m_dwCompressionUnit);
+            ULONGLONG ullThisRead = 0LL;
+            if (FAILED(hr = ReadCompressionUnit(dwFirstCU, dwNbCU, pOut + ullRead, &ullThisRead)))
                 return hr;
-            CopyMemory(pBuffer, buffer.GetData(), static_cast<size_t>(std::min(cbBytesToRead, ullRead)));
-            ullRead = std::min<ULONGLONG>(cbBytesToRead, buffer.GetCount());
+            if (ullThisRead == 0LL)
+                break;
+            ullRead += std::min(ullThisRead, ullRemaining);
+            continue;
         }
-    }
-    else
-    {
-        // the read is _NOT_ aligned on a CU.
-        size_t offset = m_ullPosition % m_dwCompressionUnit;
 
-        CBinaryBuffer buffer;
-        buffer.SetCount((size_t)ullToRead);
-        if (FAILED(hr = ReadCompressionUnit(dwCUsToRead, buffer, &ullRead)))
+        // sequential reads are decompressed ahead
+        const bool bSequential = ullPosition == m_ullUncompressedOffset + m_ullUncompressedSize;
+        DWORD dwNbCU = static_cast<DWORD>(
+            (ullPosition % m_dwCompressionUnit + ullRemaining + m_dwCompressionUnit - 1) / m_dwCompressionUnit);
+        if (bSequential)
+            dwNbCU = std::max(dwNbCU, kReadAheadUnits);
+
+        const ULONGLONG ullBufferSize = static_cast<ULONGLONG>(dwNbCU) * m_dwCompressionUnit;
+        if (m_Uncompressed.GetCount() < ullBufferSize && !m_Uncompressed.SetCount(static_cast<size_t>(ullBufferSize)))
+            return E_OUTOFMEMORY;
+
+        m_ullUncompressedOffset = static_cast<ULONGLONG>(dwFirstCU) * m_dwCompressionUnit;
+        m_ullUncompressedSize = 0LL;
+        if (FAILED(hr = ReadCompressionUnit(dwFirstCU, dwNbCU, m_Uncompressed.GetData(), &m_ullUncompressedSize)))
             return hr;
-        CopyMemory(
-            pBuffer,
-            buffer.GetData() + offset,
-            static_cast<size_t>(std::min<ULONGLONG>(cbBytesToRead, ullRead - offset)));
-        ullRead = std::min<ULONGLONG>(cbBytesToRead, ullRead - offset);
+        if (m_ullUncompressedSize <= ullPosition - m_ullUncompressedOffset)
+            break;
     }
 
     if (pcbBytesRead != nullptr)
         *pcbBytesRead = ullRead;
     m_ullPosition += ullRead;
-
-    if (m_ullPosition % m_dwCompressionUnit && m_ullPosition < m_pChainedStream->GetSize())
-    {
-        // We end up in the middle of a CU, we need to rewind the underlying (compressed) stream by 1 CU...
-        m_pChainedStream->SetFilePointer(-static_cast<LONGLONG>(m_dwCompressionUnit), FILE_CURRENT, NULL);
-    }
     return S_OK;
 }
 
@@ -10,6 +10,7 @@
 #include "OrcLib.h"
 
 #include "ChainingStream.h"
+#include "BinaryBuffer.h"
 
 #include "boost/logic/tribool.hpp"
 
@@ -62,13 +63,26 @@ public:
     STDMETHOD(Close)();
 
 private:
+    // Sequential reads decompress this many compression units at once (and concurrently)
+    static constexpr DWORD kReadAheadUnits = 16;
+
     DWORD m_dwCompressionUnit;
     DWORD m_dwMaxCompressionUnit;
     ULONGLONG m_ullPosition;
 
     std::vector<boost::logic::tribool> m_IsBlockCompressed;
 
-    HRESULT ReadCompressionUnit(DWORD dwNbCU, CBinaryBuffer& uncompressedData, __out_opt PULONGLONG pcbBytesRead);
+    // Buffers are reused from one read to the next: 'm_Uncompressed' keeps the last compression units decompressed
+    // for reads smaller than a compression unit
+    CBinaryBuffer m_Compressed;
+    CBinaryBuffer m_Uncompressed;
+    CBinaryBuffer m_LastUnit;
+    ULONGLONG m_ullUncompressedOffset = 0LL;
+    ULONGLONG m_ullUncompressedSize = 0LL;
+
+    // Reads and decompresses 'dwNbCU' compression units from 'dwFirstCU' in 'pUncompressed' (dwNbCU compression
+    // units large)
+    HRESULT ReadCompressionUnit(DWORD dwFirstCU, DWORD dwNbCU, LPBYTE pUncompressed, __out_opt PULONGLONG pcbBytesRead);
 };
 }  // namespace Orc
 
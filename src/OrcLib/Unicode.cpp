@@ -10,89 +10,114 @@
 
 #include "Unicode.h"
 
-#include <sstream>
+#include <emmintrin.h>
 
 using namespace std;
 
 using namespace Orc;
 
-bool Orc::IsUnicodeValid(const IsUnicodeValidTable table[], WCHAR wCode)
+size_t Orc::IsUnicodeValidTable::FindFirstInvalid(LPCWSTR szString, size_t dwLen) const
 {
-    return table[wCode].bIsValid;
-}
-
-bool Orc::IsUnicodeStringValid(const IsUnicodeValidTable table[], LPCWSTR szString, size_t dwLen)
-{
-    const WCHAR* pCur = szString;
     size_t CurIndex = 0L;
-    while (pCur && CurIndex < dwLen)
+
+    if (szString == nullptr)
+        return dwLen;
+
+    if (m_FastRange.First <= m_FastRange.Last)
     {
-        if (!table[*pCur].bIsValid)
-            return false;
-        pCur++;
-        CurIndex++;
+        const __m128i first = _mm_set1_epi16(static_cast<short>(m_FastRange.First));
+        const __m128i width = _mm_set1_epi16(static_cast<short>(m_FastRange.Last - m_FastRange.First));
+        const __m128i zero = _mm_setzero_si128();
+
+        // Once shifted down by 'first', units of the fast range are below or equal to 'width' (unsigned)
+        const auto inFastRange = [&](const WCHAR* pCur) {
+            const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCur));
+            return _mm_cmpeq_epi16(_mm_subs_epu16(_mm_sub_epi16(units, first), width), zero);
+        };
+
+        for (; CurIndex + 16 <= dwLen; CurIndex += 16)
+        {
+            const auto low = inFastRange(szString + CurIndex);
+            const auto high = inFastRange(szString + CurIndex + 8);
+            if (_mm_movemask_epi8(_mm_and_si128(low, high)) == 0xFFFF)
+                continue;
+
+            // Rare characters: check this block unit by unit
+            for (size_t i = CurIndex; i < CurIndex + 16; i++)
+            {
+                if (!IsValid(szString[i]))
+                    return i;
+            }
+        }
     }
-    return true;
+
+    for (; CurIndex < dwLen; CurIndex++)
+    {
+        if (!IsValid(szString[CurIndex]))
+            return CurIndex;
+    }
+    return dwLen;
+}
+
+bool Orc::IsUnicodeValid(const IsUnicodeValidTable& table, WCHAR wCode)
+{
+    return table.IsValid(wCode);
+}
+
+bool Orc::IsUnicodeStringValid(const IsUnicodeValidTable& table, LPCWSTR szString, size_t dwLen)
+{
+    return table.FindFirstInvalid(szString, dwLen) == dwLen;
 }
 
 HRESULT Orc::ReplaceInvalidChars(
-    const IsUnicodeValidTable table[],
+    const IsUnicodeValidTable& table,
     LPCWSTR szString,
     size_t dwLen,
     std::wstring& dst,
     const WCHAR cReplacement)
 {
-    const WCHAR* pCur = szString;
-    size_t CurIndex = 0L;
-
-    wstringstream stream(ios_base::out);
+    if (szString == nullptr)
+    {
+        dst.clear();
+        return S_OK;
+    }
 
-    stream << hex << uppercase;
+    auto CurIndex = table.FindFirstInvalid(szString, dwLen);
+    dst.assign(szString, CurIndex);
 
-    while (pCur && CurIndex < dwLen)
+    while (CurIndex < dwLen)
     {
-        if (!table[*pCur].bIsValid)
-        {
-            stream << cReplacement;
-        }
-        else
-        {
-            stream << *pCur;
-        }
-        pCur++;
+        dst.push_back(cReplacement);
         CurIndex++;
+
+        const auto NextInvalid = CurIndex + table.FindFirstInvalid(szString + CurIndex, dwLen - CurIndex);
+        dst.append(szString + CurIndex, NextInvalid - CurIndex);
+        CurIndex = NextInvalid;
     }
 
-    dst = std::move(stream.str());
     return S_OK;
 }
 
-HRESULT Orc::SanitizeString(const IsUnicodeValidTable table[], LPCWSTR szString, size_t dwLen, std::wstring& dst)
+HRESULT Orc::SanitizeString(const IsUnicodeValidTable& table, LPCWSTR szString, size_t dwLen, std::wstring& dst)
 {
-    const WCHAR* pCur = szString;
-    size_t CurIndex = 0L;
-
-    wstringstream stream(ios_base::out);
+    if (szString == nullptr)
+    {
+        dst.clear();
+        return S_OK;
+    }
 
-    stream << hex << uppercase;
+    auto CurIndex = table.FindFirstInvalid(szString, dwLen);
+    dst.assign(szString, CurIndex);
 
-    while (pCur && CurIndex < dwLen)
+    while (CurIndex < dwLen)
     {
-        if (!table[*pCur].bIsValid)
-        {
-            stream << L"#x";
-            stream.width(4);
-            stream.fill(L'0');
-            stream << (unsigned short)*pCur << ";";
-        }
-        else
-        {
-            stream << *pCur;
-        }
-        pCur++;
+        fmt::format_to(std::back_inserter(dst), L"#x{:04X};", static_cast<unsigned short>(szString[CurIndex]));
         CurIndex++;
+
+        const auto NextInvalid = CurIndex + table.FindFirstInvalid(szString + CurIndex, dwLen - CurIndex);
+        dst.append(szString + CurIndex, NextInvalid - CurIndex);
+        CurIndex = NextInvalid;
     }
 
-    dst = std::move(stream.str());
     return S_OK;
 }
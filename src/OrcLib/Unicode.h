@@ -11,34 +11,70 @@
 
 namespace Orc {
 
-struct IsUnicodeValidTable
+// Set of the UTF-16 code units allowed in an XML construct, stored as a 8KB bitset
+class IsUnicodeValidTable
 {
-    bool bIsValid;
+public:
+    // Inclusive range of code units
+    struct Range
+    {
+        WCHAR First;
+        WCHAR Last;
+    };
+
+    // 'fastRange' must only contain valid code units: strings are checked 16 units at a time against it and only
+    // units outside of it are looked up in the bitset
+    constexpr IsUnicodeValidTable(std::initializer_list<Range> validRanges, Range fastRange = {1, 0})
+        : m_Bits {}
+        , m_FastRange(fastRange)
+    {
+        for (const auto& range : validRanges)
+        {
+            for (ULONG wCode = range.First; wCode <= range.Last;)
+            {
+                const auto shift = wCode % 64;
+                const auto count = std::min<ULONG>(64 - shift, range.Last - wCode + 1);
+                const auto mask = count == 64 ? ~0ULL : ((1ULL << count) - 1) << shift;
+
+                m_Bits[wCode / 64] |= mask;
+                wCode += count;
+            }
+        }
+    }
+
+    bool IsValid(WCHAR wCode) const { return (m_Bits[wCode / 64] >> (wCode % 64)) & 1; }
+
+    // Index of the first invalid code unit of the string, 'dwLen' when the whole string is valid
+    size_t FindFirstInvalid(LPCWSTR szString, size_t dwLen) const;
+
+private:
+    std::array<ULONG64, 65536 / 64> m_Bits;
+    Range m_FastRange;
 };
 
-extern const IsUnicodeValidTable xml_element_table[65536];
-extern const IsUnicodeValidTable xml_attr_value_table[65536];
-extern const IsUnicodeValidTable xml_string_table[65536];
-extern const IsUnicodeValidTable xml_comment_table[65536];
+extern const IsUnicodeValidTable xml_element_table;
+extern const IsUnicodeValidTable xml_attr_value_table;
+extern const IsUnicodeValidTable xml_string_table;
+extern const IsUnicodeValidTable xml_comment_table;
 
-bool IsUnicodeValid(const IsUnicodeValidTable table[], WCHAR wCode);
+bool IsUnicodeValid(const IsUnicodeValidTable& table, WCHAR wCode);
 
-bool IsUnicodeStringValid(const IsUnicodeValidTable table[], LPCWSTR szString, size_t dwLen);
+bool IsUnicodeStringValid(const IsUnicodeValidTable& table, LPCWSTR szString, size_t dwLen);
 
-inline bool IsUnicodeStringValid(IsUnicodeValidTable table[], const std::wstring& str)
+inline bool IsUnicodeStringValid(const IsUnicodeValidTable& table, const std::wstring& str)
 {
     return IsUnicodeStringValid(table, str.c_str(), str.size());
 }
 
 HRESULT ReplaceInvalidChars(
-    const IsUnicodeValidTable table[],
+    const IsUnicodeValidTable& table,
     LPCWSTR szString,
     size_t dwLen,
     std::wstring& dst,
     const WCHAR cReplacement = L'_');
 
 inline HRESULT ReplaceInvalidChars(
-    const IsUnicodeValidTable table[],
+    const IsUnicodeValidTable& table,
     LPCWSTR szString,
     std::wstring& dst,
     const WCHAR cReplacement = L'_')
@@ -47,7 +83,7 @@ inline HRESULT ReplaceInvalidChars(
 }
 
 inline HRESULT ReplaceInvalidChars(
-    const IsUnicodeValidTable table[],
+    const IsUnicodeValidTable& table,
     std::wstring_view sv,
     std::wstring& dst,
     const WCHAR cReplacement = L'_')
@@ -56,7 +92,7 @@ inline HRESULT ReplaceInvalidChars(
 }
 
 inline HRESULT ReplaceInvalidChars(
-    IsUnicodeValidTable table[],
+    const IsUnicodeValidTable& table,
     const std::wstring& str,
     std::wstring& dst,
     const WCHAR cReplacement = L'_')
@@ -64,17 +100,17 @@ inline HRESULT ReplaceInvalidChars(
     return ReplaceInvalidChars(table, str.c_str(), str.size(), dst, cReplacement);
 }
 
-HRESULT SanitizeString(const IsUnicodeValidTable table[], LPCWSTR szString, size_t dwLen, std::wstring& dst);
+HRESULT SanitizeString(const IsUnicodeValidTable& table, LPCWSTR szString, size_t dwLen, std::wstring& dst);
 
-inline HRESULT SanitizeString(const IsUnicodeValidTable table[], LPCWSTR szString, std::wstring& dst)
+inline HRESULT SanitizeString(const IsUnicodeValidTable& table, LPCWSTR szString, std::wstring& dst)
 {
     return SanitizeString(table, szString, wcslen(szString), dst);
 }
-inline HRESULT SanitizeString(const IsUnicodeValidTable table[], const std::wstring& str, std::wstring& dst)
+inline HRESULT SanitizeString(const IsUnicodeValidTable& table, const std::wstring& str, std::wstring& dst)
 {
     return SanitizeString(table, str.c_str(), (DWORD)str.size(), dst);
 }
-inline HRESULT SanitizeString(const IsUnicodeValidTable table[], const std::wstring_view& str, std::wstring& dst)
+inline HRESULT SanitizeString(const IsUnicodeValidTable& table, const std::wstring_view& str, std::wstring& dst)
 {
     return SanitizeString(table, str.data(), (DWORD)str.size(), dst);
 }
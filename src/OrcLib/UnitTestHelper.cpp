@@ -8,10 +8,12 @@
 #include "stdafx.h"
 
 #include "SystemDetails.h"
+#include "Utils/WinApi.h"
 
 #include <boost/scope_exit.hpp>
 
 #include <filesystem>
+#include <fstream>
 // Headers for CppUnitTest
 #include "CppUnitTest.h"
 
@@ -35,6 +37,23 @@ std::wstring UnitTestHelper::GetDirectoryName(const std::wstring& apath)
         return L"";
 }
 
+std::wstring UnitTestHelper::GetTempFilePath(const std::wstring& fileName)
+{
+    std::error_code ec;
+    auto path = GetTempPathApi(ec);
+    test::Assert::IsFalse((bool)ec);
+
+    path.append(fileName);
+    return path;
+}
+
+void UnitTestHelper::WriteFile(const std::filesystem::path& path, std::string_view content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size());
+    test::Assert::IsTrue(file.good());
+}
+
 HRESULT UnitTestHelper::ExtractArchive(
     ArchiveFormat format,
     ArchiveExtract::MakeArchiveStream makeArchiveStream,
@@ -7,7 +7,9 @@
 //
 #pragma once
 
+#include <filesystem>
 #include <string>
+#include <string_view>
 
 #include "ArchiveExtract.h"
 
@@ -24,6 +26,12 @@ public:
 
     std::wstring GetDirectoryName(const std::wstring& path);
 
+    // Path of 'fileName' in the temporary directory
+    std::wstring GetTempFilePath(const std::wstring& fileName);
+
+    // Replaces the content of the file 'path' with 'content'
+    void WriteFile(const std::filesystem::path& path, std::string_view content);
+
     HRESULT ExtractArchive(
         ArchiveFormat format,
         ArchiveExtract::MakeArchiveStream makeArchiveStream,
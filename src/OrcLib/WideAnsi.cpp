@@ -425,15 +425,10 @@ HRESULT Orc::AnsiToWide(__in const std::string& src, std::wstring& dest)
         return hr;
     }
 
-    if (buffer.size() > 1)
-    {
-        if (buffer[buffer.size() - 1] == 0)
-            dest.assign(buffer.data(), buffer.size() - 1);  // we need to remove the trailing \0
-        else
-            dest.assign(buffer.data(), buffer.size());
-    }
-    else
-        dest.clear();
+    // a single character is converted too, only a trailing \0 (when part of the source) is removed
+    if (cchSize > 0 && buffer[cchSize - 1] == 0)
+        cchSize--;
+    dest.assign(buffer.data(), cchSize);
     return S_OK;
 }
 
@@ -469,15 +464,10 @@ HRESULT Orc::AnsiToWide(__in const std::string_view& src, std::wstring& dest)
         return hr;
     }
 
-    if (buffer.size() > 1)
-    {
-        if (buffer[buffer.size() - 1] == 0)
-            dest.assign(buffer.data(), buffer.size() - 1);  // we need to remove the trailing \0
-        else
-            dest.assign(buffer.data(), buffer.size());
-    }
-    else
-        dest.clear();
+    // a single character is converted too, only a trailing \0 (when part of the source) is removed
+    if (cchSize > 0 && buffer[cchSize - 1] == 0)
+        cchSize--;
+    dest.assign(buffer.data(), cchSize);
     return S_OK;
 }
 
@@ -0,0 +1,462 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "WofDecompressStream.h"
+
+#include "CompressAPIExtension.h"
+#include "LzxDecompress.h"
+
+#include <atomic>
+
+using namespace Orc;
+
+WofDecompressStream::WofDecompressStream()
+    : ChainingStream()
+{
+}
+
+WofDecompressStream::~WofDecompressStream(void)
+{
+    CloseDecompressors();
+}
+
+void WofDecompressStream::CloseDecompressors()
+{
+    if (m_pCompressAPI == nullptr)
+        return;
+
+    m_Decompressors.combine_each([this](HANDLE hDecompressor) {
+        if (hDecompressor != nullptr)
+            m_pCompressAPI->CloseDecompressor(hDecompressor);
+    });
+    m_Decompressors.clear();
+}
+
+HRESULT WofDecompressStream::Close()
+{
+    CloseDecompressors();
+
+    if (m_pChainedStream == nullptr)
+        return S_OK;
+    return m_pChainedStream->Close();
+}
+
+DWORD WofDecompressStream::GetChunkSize(Algorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case Algorithm::Xpress4K:
+            return 0x1000;
+        case Algorithm::Xpress8K:
+            return 0x2000;
+        case Algorithm::Xpress16K:
+            return 0x4000;
+        case Algorithm::Lzx:
+            return 0x8000;
+        default:
+            return 0L;
+    }
+}
+
+bool WofDecompressStream::IsSupported(Algorithm algorithm)
+{
+    // XPRESS (Huffman) is decompressed by the compression API, LZX in tree
+    switch (algorithm)
+    {
+        case Algorithm::Xpress4K:
+        case Algorithm::Xpress8K:
+        case Algorithm::Xpress16K:
+        case Algorithm::Lzx:
+            return true;
+        default:
+            return false;
+    }
+}
+
+HRESULT WofDecompressStream::Open(
+    const std::shared_ptr<ByteStream>& pChained,
+    Algorithm algorithm,
+    ULONGLONG ullUncompressedSize)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pChained == NULL)
+        return E_POINTER;
+
+    if (pChained->IsOpen() != S_OK)
+    {
+        Log::Error(L"Chained stream must be opened");
+        return E_FAIL;
+    }
+
+    if (!IsSupported(algorithm))
+    {
+        Log::Error(L"Unsupported WOF compression algorithm: {}", static_cast<ULONG>(algorithm));
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    if (algorithm != Algorithm::Lzx)
+    {
+        m_pCompressAPI = ExtensionLibrary::GetLibrary<CompressAPIExtension>();
+        if (m_pCompressAPI == nullptr)
+        {
+            Log::Error(L"Failed to load the compression API");
+            return E_FAIL;
+        }
+    }
+
+    m_pChainedStream = pChained;
+    m_Algorithm = algorithm;
+    m_dwChunkSize = GetChunkSize(algorithm);
+    m_ullSize = ullUncompressedSize;
+
+    if (FAILED(hr = ReadChunkTable()))
+        return hr;
+
+    m_ullPosition = 0LL;
+    m_ullUncompressedOffset = 0LL;
+    m_ullUncompressedSize = 0LL;
+    return S_OK;
+}
+
+HRESULT WofDecompressStream::ReadChunkTable()
+{
+    HRESULT hr = E_FAIL;
+
+    const ULONGLONG ullChunks = (m_ullSize + m_dwChunkSize - 1) / m_dwChunkSize;
+    if (ullChunks > MAXDWORD)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    m_ChunkOffsets.clear();
+    if (ullChunks == 0)
+    {
+        m_ChunkOffsets.push_back(0LL);
+        return S_OK;
+    }
+
+    // The table has the end offset of each chunk but the last, relative to the end of the table
+    const size_t cbEntry = m_ullSize > MAXDWORD ? sizeof(ULONGLONG) : sizeof(DWORD);
+    const size_t cbTable = static_cast<size_t>(ullChunks - 1) * cbEntry;
+
+    CBinaryBuffer table;
+    if (!table.SetCount(cbTable))
+        return E_OUTOFMEMORY;
+
+    if (FAILED(hr = m_pChainedStream->SetFilePointer(0LL, FILE_BEGIN, NULL)))
+    {
+        Log::Error(L"Failed to seek to WOF chunk table [{}]", SystemError(hr));
+        return hr;
+    }
+
+    size_t cbRead = 0;
+    while (cbRead < cbTable)
+    {
+        ULONGLONG ullThisRead = 0LL;
+        if (FAILED(hr = m_pChainedStream->Read(table.GetData() + cbRead, cbTable - cbRead, &ullThisRead)))
+        {
+            Log::Error(L"Failed to read WOF chunk table [{}]", SystemError(hr));
+            return hr;
+        }
+        if (ullThisRead == 0LL)
+            break;
+        cbRead += static_cast<size_t>(ullThisRead);
+    }
+
+    if (cbRead < cbTable)
+    {
+        Log::Error(L"WOF chunk table is truncated ({} bytes out of {})", cbRead, cbTable);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    m_ChunkOffsets.reserve(static_cast<size_t>(ullChunks) + 1);
+    m_ChunkOffsets.push_back(cbTable);
+    for (size_t i = 0; i < ullChunks - 1; i++)
+    {
+        const ULONGLONG ullEntry = cbEntry == sizeof(DWORD)
+            ? reinterpret_cast<const DWORD*>(table.GetData())[i]
+            : reinterpret_cast<const ULONGLONG*>(table.GetData())[i];
+        m_ChunkOffsets.push_back(cbTable + ullEntry);
+    }
+    m_ChunkOffsets.push_back(m_pChainedStream->GetSize());
+
+    // A chunk is never larger once compressed: when it does not compress, it is stored
+    for (size_t i = 0; i < ullChunks; i++)
+    {
+        const ULONGLONG ullUncompressed = std::min<ULONGLONG>(m_dwChunkSize, m_ullSize - i * m_dwChunkSize);
+        if (m_ChunkOffsets[i + 1] <= m_ChunkOffsets[i] || m_ChunkOffsets[i + 1] - m_ChunkOffsets[i] > ullUncompressed)
+        {
+            Log::Error(
+                L"Invalid WOF chunk {} (offsets: {:#x}-{:#x}, size: {:#x})",
+                i,
+                m_ChunkOffsets[i],
+                m_ChunkOffsets[i + 1],
+                ullUncompressed);
+            m_ChunkOffsets.clear();
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT WofDecompressStream::DecompressChunk(DWORD dwChunk, const BYTE* pIn, size_t cbIn, BYTE* pOut, size_t cbOut)
+{
+    HRESULT hr = E_FAIL;
+
+    if (cbIn == cbOut)
+    {
+        CopyMemory(pOut, pIn, cbOut);
+        return S_OK;
+    }
+
+    if (m_Algorithm == Algorithm::Lzx)
+    {
+        if (FAILED(hr = lzx_decompress_chunk(pOut, cbOut, pIn, cbIn)))
+            Log::Debug(L"Failed to decompress WOF LZX chunk {}", dwChunk);
+        return hr;
+    }
+
+    HANDLE& hDecompressor = m_Decompressors.local();
+    if (hDecompressor == nullptr
+        && FAILED(
+            hr = m_pCompressAPI->CreateDecompressor(
+                COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW, nullptr, &hDecompressor)))
+    {
+        hDecompressor = nullptr;
+        return hr;
+    }
+
+    // Raw decompression requires the exact uncompressed size
+    SIZE_T cbDecompressed = 0;
+    if (FAILED(hr = m_pCompressAPI->Decompress(hDecompressor, pIn, cbIn, pOut, cbOut, &cbDecompressed)))
+        return hr;
+
+    if (cbDecompressed != cbOut)
+    {
+        Log::Debug(L"WOF chunk {} decompressed to {} bytes instead of {}", dwChunk, cbDecompressed, cbOut);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    return S_OK;
+}
+
+HRESULT WofDecompressStream::ReadChunks(
+    DWORD dwFirstChunk,
+    DWORD dwNbChunks,
+    LPBYTE pUncompressed,
+    __out_opt PULONGLONG pcbBytesRead)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pcbBytesRead)
+        *pcbBytesRead = 0LL;
+
+    if (dwFirstChunk >= GetChunkCount())
+        return S_OK;
+
+    if (dwNbChunks > GetChunkCount() - dwFirstChunk)
+        dwNbChunks = GetChunkCount() - dwFirstChunk;
+
+    const ULONGLONG ullOffset = m_ChunkOffsets[dwFirstChunk];
+    if (FAILED(hr = m_pChainedStream->SetFilePointer(ullOffset, FILE_BEGIN, NULL)))
+    {
+        Log::Error(L"Failed to seek chained stream to offset {:#x} [{}]", ullOffset, SystemError(hr));
+        return hr;
+    }
+
+    const ULONGLONG ullToRead = m_ChunkOffsets[dwFirstChunk + dwNbChunks] - ullOffset;
+    if (m_Compressed.GetCount() < ullToRead && !m_Compressed.SetCount(static_cast<size_t>(ullToRead)))
+        return E_OUTOFMEMORY;
+
+    ULONGLONG ullRead = 0LL;
+    while (ullRead < ullToRead)
+    {
+        ULONGLONG ullThisRead = 0LL;
+        if (FAILED(hr = m_pChainedStream->Read(m_Compressed.GetData() + ullRead, ullToRead - ullRead, &ullThisRead)))
+        {
+            Log::Error(L"Failed to read {} bytes from chained stream [{}]", ullToRead - ullRead, SystemError(hr));
+            return hr;
+        }
+        if (ullThisRead == 0LL)
+            break;
+        ullRead += ullThisRead;
+    }
+
+    if (ullRead < ullToRead)
+    {
+        Log::Error(L"WOF compressed data is truncated (chunks {} to {})", dwFirstChunk, dwFirstChunk + dwNbChunks);
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    std::atomic<HRESULT> hrChunks = S_OK;
+    const auto decompressChunk = [this, dwFirstChunk, ullOffset, pUncompressed, &hrChunks](DWORD i) {
+        const DWORD dwChunk = dwFirstChunk + i;
+        const ULONGLONG ullUncompressedOffset = static_cast<ULONGLONG>(dwChunk) * m_dwChunkSize;
+        const size_t cbOut = static_cast<size_t>(std::min<ULONGLONG>(m_dwChunkSize, m_ullSize - ullUncompressedOffset));
+        const size_t cbIn = static_cast<size_t>(m_ChunkOffsets[dwChunk + 1] - m_ChunkOffsets[dwChunk]);
+
+        if (auto hr = DecompressChunk(
+                dwChunk,
+                m_Compressed.GetData() + (m_ChunkOffsets[dwChunk] - ullOffset),
+                cbIn,
+                pUncompressed + static_cast<size_t>(i) * m_dwChunkSize,
+                cbOut);
+            FAILED(hr))
+            hrChunks = hr;
+    };
+
+    // chunks are independent
+    if (dwNbChunks > 1)
+        concurrency::parallel_for(DWORD(0), dwNbChunks, decompressChunk);
+    else
+        decompressChunk(0);
+
+    if (FAILED(hr = hrChunks))
+    {
+        Log::Error(
+            L"Failed to decompress WOF chunks {} to {} [{}]", dwFirstChunk, dwFirstChunk + dwNbChunks, SystemError(hr));
+        return hr;
+    }
+
+    if (pcbBytesRead)
+        *pcbBytesRead = std::min<ULONGLONG>(
+            static_cast<ULONGLONG>(dwNbChunks) * m_dwChunkSize,
+            m_ullSize - static_cast<ULONGLONG>(dwFirstChunk) * m_dwChunkSize);
+    return S_OK;
+}
+
+HRESULT WofDecompressStream::Read(
+    __out_bcount_part(cbBytesToRead, *pcbBytesRead) PVOID pBuffer,
+    __in ULONGLONG cbBytesToRead,
+    __out_opt PULONGLONG pcbBytesRead)
+{
+    HRESULT hr = E_FAIL;
+    if (cbBytesToRead > MAXDWORD)
+        return E_INVALIDARG;
+    if (pcbBytesRead != nullptr)
+        *pcbBytesRead = 0;
+
+    if (m_ullPosition >= m_ullSize)
+        return S_OK;
+
+    if ((cbBytesToRead + m_ullPosition) > m_ullSize)
+        cbBytesToRead = m_ullSize - m_ullPosition;
+
+    LPBYTE pOut = reinterpret_cast<LPBYTE>(pBuffer);
+    ULONGLONG ullRead = 0LL;
+
+    while (ullRead < cbBytesToRead)
+    {
+        const ULONGLONG ullPosition = m_ullPosition + ullRead;
+        const ULONGLONG ullRemaining = cbBytesToRead - ullRead;
+
+        // served from the last decompressed chunks
+        if (ullPosition >= m_ullUncompressedOffset && ullPosition < m_ullUncompressedOffset + m_ullUncompressedSize)
+        {
+            const auto ullChunk =
+                std::min<ULONGLONG>(ullRemaining, m_ullUncompressedOffset + m_ullUncompressedSize - ullPosition);
+            CopyMemory(
+                pOut + ullRead, m_Uncompressed.GetData() + (ullPosition - m_ullUncompressedOffset), (size_t)ullChunk);
+            ullRead += ullChunk;
+            continue;
+        }
+
+        const DWORD dwFirstChunk = static_cast<DWORD>(ullPosition / m_dwChunkSize);
+
+        // whole chunks are decompressed directly in the caller's buffer
+        if (ullPosition % m_dwChunkSize == 0 && ullRemaining >= m_dwChunkSize)
+        {
+            const DWORD dwNbChunks = static_cast<DWORD>(ullRemaining / m_dwChunkSize);
+            ULONGLONG ullThisRead = 0LL;
+            if (FAILED(hr = ReadChunks(dwFirstChunk, dwNbChunks, pOut + ullRead, &ullThisRead)))
+                return hr;
+            if (ullThisRead == 0LL)
+                break;
+            ullRead += ullThisRead;
+            continue;
+        }
+
+        // sequential reads are decompressed ahead
+        const bool bSequential = ullPosition == m_ullUncompressedOffset + m_ullUncompressedSize;
+        DWORD dwNbChunks =
+            static_cast<DWORD>((ullPosition % m_dwChunkSize + ullRemaining + m_dwChunkSize - 1) / m_dwChunkSize);
+        if (bSequential)
+            dwNbChunks = std::max(dwNbChunks, kReadAheadSize / m_dwChunkSize);
+
+        const ULONGLONG ullBufferSize = static_cast<ULONGLONG>(dwNbChunks) * m_dwChunkSize;
+        if (m_Uncompressed.GetCount() < ullBufferSize && !m_Uncompressed.SetCount(static_cast<size_t>(ullBufferSize)))
+            return E_OUTOFMEMORY;
+
+        m_ullUncompressedOffset = static_cast<ULONGLONG>(dwFirstChunk) * m_dwChunkSize;
+        m_ullUncompressedSize = 0LL;
+        if (FAILED(hr = ReadChunks(dwFirstChunk, dwNbChunks, m_Uncompressed.GetData(), &m_ullUncompressedSize)))
+            return hr;
+        if (m_ullUncompressedSize <= ullPosition - m_ullUncompressedOffset)
+            break;
+    }
+
+    if (pcbBytesRead != nullptr)
+        *pcbBytesRead = ullRead;
+    m_ullPosition += ullRead;
+    return S_OK;
+}
+
+HRESULT WofDecompressStream::Write(
+    __in_bcount(cbBytes) const PVOID pBuffer,
+    __in ULONGLONG cbBytes,
+    __out_opt PULONGLONG pcbBytesWritten)
+{
+    DBG_UNREFERENCED_PARAMETER(pBuffer);
+    DBG_UNREFERENCED_PARAMETER(cbBytes);
+    DBG_UNREFERENCED_PARAMETER(pcbBytesWritten);
+
+    return E_NOTIMPL;
+}
+
+HRESULT WofDecompressStream::SetFilePointer(
+    __in LONGLONG lDistanceToMove,
+    __in DWORD dwMoveMethod,
+    __out_opt PULONG64 pqwCurrPointer)
+{
+    if (!m_pChainedStream)
+        return E_FAIL;
+
+    switch (dwMoveMethod)
+    {
+        case FILE_BEGIN:
+            m_ullPosition = lDistanceToMove;
+            break;
+        case FILE_CURRENT:
+            m_ullPosition += lDistanceToMove;
+            break;
+        case FILE_END:
+            m_ullPosition = m_ullSize + lDistanceToMove;
+            break;
+    }
+
+    if (m_ullPosition > m_ullSize)
+        m_ullPosition = m_ullSize;
+
+    if (pqwCurrPointer != nullptr)
+        *pqwCurrPointer = m_ullPosition;
+
+    return S_OK;
+}
+
+ULONG64 WofDecompressStream::GetSize()
+{
+    return m_ullSize;
+}
+
+HRESULT WofDecompressStream::SetSize(ULONG64 ullNewSize)
+{
+    DBG_UNREFERENCED_PARAMETER(ullNewSize);
+
+    return S_OK;
+}
@@ -0,0 +1,117 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include "ChainingStream.h"
+#include "BinaryBuffer.h"
+
+#include <ppl.h>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+class CompressAPIExtension;
+
+// Decompresses the 'WofCompressedData' stream of a file compressed by the Windows Overlay Filter (compact.exe):
+// a table of chunk end offsets followed by the independently compressed chunks
+class ORCLIB_API WofDecompressStream : public ChainingStream
+{
+public:
+    // FILE_PROVIDER_EXTERNAL_INFO_V1's Algorithm
+    enum class Algorithm : ULONG
+    {
+        Xpress4K = 0,
+        Lzx = 1,
+        Xpress8K = 2,
+        Xpress16K = 3
+    };
+
+    WofDecompressStream();
+    virtual ~WofDecompressStream(void);
+
+    STDMETHOD(IsOpen)()
+    {
+        if (m_pChainedStream == NULL)
+            return S_FALSE;
+        return m_pChainedStream->IsOpen();
+    };
+    STDMETHOD(CanRead)() { return S_OK; };
+    STDMETHOD(CanWrite)() { return S_FALSE; };
+    STDMETHOD(CanSeek)() { return S_OK; };
+
+    //
+    // ByteStream implementation
+    //
+    STDMETHOD(Open)
+    (const std::shared_ptr<ByteStream>& pChainedStream, Algorithm algorithm, ULONGLONG ullUncompressedSize);
+
+    STDMETHOD(Read)
+    (__out_bcount_part(cbBytes, *pcbBytesRead) PVOID pReadBuffer,
+     __in ULONGLONG cbBytes,
+     __out_opt PULONGLONG pcbBytesRead);
+
+    STDMETHOD(Write)
+    (__in_bcount(cbBytesToWrite) const PVOID pWriteBuffer,
+     __in ULONGLONG cbBytesToWrite,
+     __out_opt PULONGLONG pcbBytesWritten);
+
+    STDMETHOD(SetFilePointer)
+    (__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod, __out_opt PULONG64 pCurrPointer);
+
+    STDMETHOD_(ULONG64, GetSize)();
+    STDMETHOD(SetSize)(ULONG64 ullSize);
+
+    STDMETHOD(Close)();
+
+    static DWORD GetChunkSize(Algorithm algorithm);
+    static bool IsSupported(Algorithm algorithm);
+
+private:
+    // Sequential reads decompress this many bytes of chunks at once (and concurrently)
+    static constexpr DWORD kReadAheadSize = 0x40000;
+
+    Algorithm m_Algorithm = Algorithm::Xpress4K;
+    DWORD m_dwChunkSize = 0L;
+    ULONGLONG m_ullSize = 0LL;
+    ULONGLONG m_ullPosition = 0LL;
+
+    // Offsets of the chunks in the chained stream, with the end of the last one: chunk i is
+    // [m_ChunkOffsets[i], m_ChunkOffsets[i+1])
+    std::vector<ULONGLONG> m_ChunkOffsets;
+
+    // XPRESS only: LZX chunks are decompressed by lzx_decompress_chunk
+    std::shared_ptr<CompressAPIExtension> m_pCompressAPI;
+
+    // Decompressor handles are not shared between threads
+    concurrency::combinable<HANDLE> m_Decompressors;
+
+    // Buffers are reused from one read to the next: 'm_Uncompressed' keeps the last chunks decompressed for random
+    // access reads
+    CBinaryBuffer m_Compressed;
+    CBinaryBuffer m_Uncompressed;
+    ULONGLONG m_ullUncompressedOffset = 0LL;
+    ULONGLONG m_ullUncompressedSize = 0LL;
+
+    DWORD GetChunkCount() const { return static_cast<DWORD>(m_ChunkOffsets.size() - 1); }
+
+    HRESULT ReadChunkTable();
+
+    HRESULT DecompressChunk(DWORD dwChunk, const BYTE* pIn, size_t cbIn, BYTE* pOut, size_t cbOut);
+
+    // Reads and decompresses 'dwNbChunks' chunks from 'dwFirstChunk' in 'pUncompressed'
+    HRESULT
+    ReadChunks(DWORD dwFirstChunk, DWORD dwNbChunks, LPBYTE pUncompressed, __out_opt PULONGLONG pcbBytesRead);
+
+    void CloseDecompressors();
+};
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -0,0 +1,274 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "ZstdStream.h"
+
+#include <zstd.h>
+
+using namespace Orc;
+
+HRESULT ZstdStream::OpenToCompress(
+    const std::shared_ptr<ByteStream>& pChainedStream,
+    int iCompressionLevel,
+    DWORD dwWorkers)
+{
+    if (pChainedStream == nullptr)
+        return E_POINTER;
+
+    if (pChainedStream->CanWrite() != S_OK)
+    {
+        Log::Error("ZstdStream: chained stream cannot be written to");
+        return HRESULT_FROM_WIN32(ERROR_INVALID_ACCESS);
+    }
+
+    m_pCCtx = ZSTD_createCCtx();
+    if (m_pCCtx == nullptr)
+        return E_OUTOFMEMORY;
+
+    auto ret = ZSTD_CCtx_setParameter(m_pCCtx, ZSTD_c_compressionLevel, iCompressionLevel);
+    if (ZSTD_isError(ret))
+    {
+        Log::Error("ZstdStream: invalid compression level {} ({})", iCompressionLevel, ZSTD_getErrorName(ret));
+        return E_INVALIDARG;
+    }
+
+    if (dwWorkers > 0)
+    {
+        ret = ZSTD_CCtx_setParameter(m_pCCtx, ZSTD_c_nbWorkers, dwWorkers);
+        if (ZSTD_isError(ret))
+        {
+            // zstd was built without multithreading support, compression will happen on the calling thread
+            Log::Warn("ZstdStream: failed to use {} worker threads ({})", dwWorkers, ZSTD_getErrorName(ret));
+        }
+    }
+
+    if (!m_Buffer.SetCount(ZSTD_CStreamOutSize()))
+        return E_OUTOFMEMORY;
+
+    m_bCompressing = true;
+    m_pChainedStream = pChainedStream;
+    m_ullProcessed = 0LL;
+    return S_OK;
+}
+
+HRESULT ZstdStream::OpenToDecompress(const std::shared_ptr<ByteStream>& pChainedStream)
+{
+    if (pChainedStream == nullptr)
+        return E_POINTER;
+
+    if (pChainedStream->CanRead() != S_OK)
+    {
+        Log::Error("ZstdStream: chained stream cannot be read from");
+        return HRESULT_FROM_WIN32(ERROR_INVALID_ACCESS);
+    }
+
+    m_pDCtx = ZSTD_createDCtx();
+    if (m_pDCtx == nullptr)
+        return E_OUTOFMEMORY;
+
+    if (!m_Buffer.SetCount(ZSTD_DStreamInSize()))
+        return E_OUTOFMEMORY;
+
+    m_bCompressing = false;
+    m_pChainedStream = pChainedStream;
+    m_cbBufferPos = 0L;
+    m_cbBufferSize = 0L;
+    m_bEndOfInput = false;
+    m_ullProcessed = 0LL;
+    return S_OK;
+}
+
+HRESULT ZstdStream::Read(
+    __out_bcount_part(cbBytes, *pcbBytesRead) PVOID pReadBuffer,
+    __in ULONGLONG cbBytes,
+    __out_opt PULONGLONG pcbBytesRead)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pcbBytesRead == NULL)
+        return E_POINTER;
+    *pcbBytesRead = 0;
+
+    if (m_pChainedStream == nullptr)
+        return E_POINTER;
+    if (m_pDCtx == nullptr)
+        return HRESULT_FROM_WIN32(ERROR_INVALID_ACCESS);
+    if (pReadBuffer == NULL)
+        return E_INVALIDARG;
+
+    ZSTD_outBuffer output = {pReadBuffer, static_cast<size_t>(cbBytes), 0};
+
+    while (output.pos < output.size)
+    {
+        if (m_cbBufferPos == m_cbBufferSize && !m_bEndOfInput)
+        {
+            ULONGLONG cbRead = 0LL;
+            if (FAILED(hr = m_pChainedStream->Read(m_Buffer.GetData(), m_Buffer.GetCount(), &cbRead)))
+            {
+                Log::Error("ZstdStream: failed to read compressed data [{}]", SystemError(hr));
+                return hr;
+            }
+
+            m_cbBufferPos = 0L;
+            m_cbBufferSize = static_cast<size_t>(cbRead);
+            m_bEndOfInput = cbRead == 0;
+        }
+
+        ZSTD_inBuffer input = {m_Buffer.GetData(), m_cbBufferSize, m_cbBufferPos};
+        const auto outputPos = output.pos;
+
+        const auto ret = ZSTD_decompressStream(m_pDCtx, &output, &input);
+        if (ZSTD_isError(ret))
+        {
+            Log::Error("ZstdStream: failed to decompress data ({})", ZSTD_getErrorName(ret));
+            return E_FAIL;
+        }
+        m_cbBufferPos = input.pos;
+
+        // Compressed data is exhausted and the decoder has nothing left to flush
+        if (m_bEndOfInput && output.pos == outputPos)
+            break;
+    }
+
+    m_ullProcessed += output.pos;
+    *pcbBytesRead = output.pos;
+    return S_OK;
+}
+
+HRESULT ZstdStream::Write(
+    __in_bcount(cbBytesToWrite) const PVOID pWriteBuffer,
+    __in ULONGLONG cbBytesToWrite,
+    __out_opt PULONGLONG pcbBytesWritten)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pcbBytesWritten)
+        *pcbBytesWritten = 0;
+
+    if (m_pChainedStream == nullptr)
+        return E_POINTER;
+    if (m_pCCtx == nullptr)
+        return E_NOTIMPL;
+    if (pWriteBuffer == NULL)
+        return E_POINTER;
+
+    ZSTD_inBuffer input = {pWriteBuffer, static_cast<size_t>(cbBytesToWrite), 0};
+
+    while (input.pos < input.size)
+    {
+        ZSTD_outBuffer output = {m_Buffer.GetData(), m_Buffer.GetCount(), 0};
+
+        const auto ret = ZSTD_compressStream2(m_pCCtx, &output, &input, ZSTD_e_continue);
+        if (ZSTD_isError(ret))
+        {
+            Log::Error("ZstdStream: failed to compress data ({})", ZSTD_getErrorName(ret));
+            return E_FAIL;
+        }
+
+        if (output.pos > 0)
+        {
+            ULONGLONG ullWritten = 0LL;
+            if (FAILED(hr = m_pChainedStream->Write(m_Buffer.GetData(), output.pos, &ullWritten)))
+            {
+                Log::Error("ZstdStream: failed to write compressed data ({} bytes, [{}])", output.pos, SystemError(hr));
+                return hr;
+            }
+        }
+    }
+
+    m_ullProcessed += cbBytesToWrite;
+
+    if (pcbBytesWritten)
+        *pcbBytesWritten = cbBytesToWrite;
+
+    return S_OK;
+}
+
+HRESULT ZstdStream::FlushOutput(bool bEndFrame)
+{
+    HRESULT hr = E_FAIL;
+
+    ZSTD_inBuffer input = {nullptr, 0, 0};
+
+    size_t remaining = 0L;
+    do
+    {
+        ZSTD_outBuffer output = {m_Buffer.GetData(), m_Buffer.GetCount(), 0};
+
+        remaining = ZSTD_compressStream2(m_pCCtx, &output, &input, bEndFrame ? ZSTD_e_end : ZSTD_e_flush);
+        if (ZSTD_isError(remaining))
+        {
+            Log::Error("ZstdStream: failed to flush compressed data ({})", ZSTD_getErrorName(remaining));
+            return E_FAIL;
+        }
+
+        if (output.pos > 0)
+        {
+            ULONGLONG ullWritten = 0LL;
+            if (FAILED(hr = m_pChainedStream->Write(m_Buffer.GetData(), output.pos, &ullWritten)))
+            {
+                Log::Error("ZstdStream: failed to write compressed data ({} bytes, [{}])", output.pos, SystemError(hr));
+                return hr;
+            }
+        }
+    } while (remaining > 0);
+
+    return S_OK;
+}
+
+HRESULT ZstdStream::SetFilePointer(
+    __in LONGLONG DistanceToMove,
+    __in DWORD dwMoveMethod,
+    __out_opt PULONG64 pCurrPointer)
+{
+    // Only querying the current (uncompressed) position is supported
+    if (DistanceToMove != 0LL || dwMoveMethod != FILE_CURRENT)
+        return E_NOTIMPL;
+
+    if (pCurrPointer)
+        *pCurrPointer = m_ullProcessed;
+    return S_OK;
+}
+
+HRESULT ZstdStream::Close()
+{
+    HRESULT hr = S_OK;
+
+    if (m_pCCtx != nullptr)
+    {
+        if (m_pChainedStream != nullptr)
+        {
+            hr = FlushOutput(true);
+        }
+        ZSTD_freeCCtx(m_pCCtx);
+        m_pCCtx = nullptr;
+    }
+
+    if (m_pDCtx != nullptr)
+    {
+        ZSTD_freeDCtx(m_pDCtx);
+        m_pDCtx = nullptr;
+    }
+
+    if (m_pChainedStream != nullptr)
+    {
+        if (auto hrClose = m_pChainedStream->Close(); SUCCEEDED(hr))
+            hr = hrClose;
+    }
+
+    return hr;
+}
+
+ZstdStream::~ZstdStream()
+{
+    if (m_pCCtx != nullptr)
+        ZSTD_freeCCtx(m_pCCtx);
+    if (m_pDCtx != nullptr)
+        ZSTD_freeDCtx(m_pDCtx);
+}
@@ -0,0 +1,99 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "ChainingStream.h"
+#include "BinaryBuffer.h"
+
+#include <boost/logic/tribool.hpp>
+
+#pragma managed(push, off)
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace Orc {
+
+// Compress (or decompress) on the fly the data written to (or read from) the chained stream using Zstandard frames.
+// When built with multithreading support, zstd compresses the frame on 'dwWorkers' additional threads.
+class ORCLIB_API ZstdStream : public ChainingStream
+{
+public:
+    static constexpr int kDefaultCompressionLevel = 3;
+
+    ZstdStream()
+        : ChainingStream()
+    {
+        m_bCompressing = boost::indeterminate;
+    }
+
+    STDMETHOD(IsOpen)()
+    {
+        if (m_bCompressing == boost::indeterminate)
+            return S_FALSE;
+        return ChainingStream::IsOpen();
+    };
+    STDMETHOD(CanRead)()
+    {
+        if (m_bCompressing)
+            return S_FALSE;
+        return ChainingStream::CanRead();
+    };
+    STDMETHOD(CanWrite)()
+    {
+        if (m_bCompressing)
+            return ChainingStream::CanWrite();
+        return S_FALSE;
+    };
+    STDMETHOD(CanSeek)() { return S_FALSE; };
+
+    STDMETHOD(OpenToCompress)
+    (const std::shared_ptr<ByteStream>& pChainedStream,
+     int iCompressionLevel = kDefaultCompressionLevel,
+     DWORD dwWorkers = 0L);
+    STDMETHOD(OpenToDecompress)(const std::shared_ptr<ByteStream>& pChainedStream);
+
+    STDMETHOD(Read)
+    (__out_bcount_part(cbBytes, *pcbBytesRead) PVOID pReadBuffer,
+     __in ULONGLONG cbBytes,
+     __out_opt PULONGLONG pcbBytesRead);
+
+    STDMETHOD(Write)
+    (__in_bcount(cbBytesToWrite) const PVOID pWriteBuffer,
+     __in ULONGLONG cbBytesToWrite,
+     __out_opt PULONGLONG pcbBytesWritten);
+
+    STDMETHOD(SetFilePointer)
+    (__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod, __out_opt PULONG64 pCurrPointer);
+
+    // Size of the uncompressed data processed so far
+    STDMETHOD_(ULONG64, GetSize)() { return m_ullProcessed; }
+    STDMETHOD(SetSize)(ULONG64 ullSize) { return E_NOTIMPL; }
+
+    STDMETHOD(Close)();
+
+    ~ZstdStream();
+
+private:
+    HRESULT FlushOutput(bool bEndFrame);
+
+    ZSTD_CCtx_s* m_pCCtx = nullptr;
+    ZSTD_DCtx_s* m_pDCtx = nullptr;
+    boost::logic::tribool m_bCompressing;
+
+    CBinaryBuffer m_Buffer;
+    size_t m_cbBufferPos = 0L;
+    size_t m_cbBufferSize = 0L;
+    bool m_bEndOfInput = false;
+
+    ULONG64 m_ullProcessed = 0LL;
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -0,0 +1,92 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "AhoCorasick.h"
+
+#include <set>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+void AddPattern(AhoCorasick& patterns, std::string_view pattern, DWORD dwId)
+{
+    patterns.Add(reinterpret_cast<const BYTE*>(pattern.data()), pattern.size(), dwId);
+}
+
+std::set<std::pair<DWORD, size_t>> Search(const AhoCorasick& patterns, std::string_view data)
+{
+    std::set<std::pair<DWORD, size_t>> found;
+    patterns.Search(reinterpret_cast<const BYTE*>(data.data()), data.size(), [&found](DWORD dwId, size_t offset) {
+        found.emplace(dwId, offset);
+        return true;
+    });
+    return found;
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(AhoCorasickTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(Search)
+    {
+        AhoCorasick patterns;
+        AddPattern(patterns, "he"sv, 0);
+        AddPattern(patterns, "she"sv, 1);
+        AddPattern(patterns, "his"sv, 2);
+        AddPattern(patterns, "hers"sv, 3);
+        AddPattern(patterns, ""sv, 4);
+        patterns.Build();
+
+        const auto found = ::Search(patterns, "ushers"sv);
+        const std::set<std::pair<DWORD, size_t>> expected = {{0, 3}, {1, 3}, {3, 5}};
+        Assert::IsTrue(found == expected);
+
+        Assert::IsTrue(::Search(patterns, "hhhx"sv).empty());
+        Assert::IsTrue(::Search(patterns, ""sv).empty());
+    }
+
+    TEST_METHOD(SearchStop)
+    {
+        AhoCorasick patterns;
+        AddPattern(patterns, "\x00\xFF"sv, 7);
+        patterns.Build();
+
+        size_t count = 0;
+        const auto data = "\x00\xFF\x00\xFF\x00\xFF"sv;
+        patterns.Search(reinterpret_cast<const BYTE*>(data.data()), data.size(), [&count](DWORD dwId, size_t offset) {
+            Assert::AreEqual(7UL, dwId);
+            Assert::AreEqual((size_t)1, offset);
+            count++;
+            return false;
+        });
+        Assert::AreEqual((size_t)1, count);
+    }
+
+    TEST_METHOD(Empty)
+    {
+        AhoCorasick patterns;
+        Assert::IsTrue(patterns.Empty());
+        patterns.Build();
+        Assert::IsTrue(::Search(patterns, "anything"sv).empty());
+    }
+};
+}  // namespace Orc::Test
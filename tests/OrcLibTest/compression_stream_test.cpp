@@ -0,0 +1,125 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "MemoryStream.h"
+
+#include "OutputSpec.h"
+
+#ifdef ORC_BUILD_ZSTD
+#    include "ZstdStream.h"
+#endif  // ORC_BUILD_ZSTD
+
+#ifdef ORC_BUILD_LZ4
+#    include "Lz4Stream.h"
+#endif  // ORC_BUILD_LZ4
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+std::vector<BYTE> MakeTableLikeData(size_t size)
+{
+    std::vector<BYTE> data;
+    data.reserve(size);
+
+    for (size_t i = 0; data.size() < size; ++i)
+    {
+        const auto line =
+            fmt::format("{},\"C:\\Windows\\System32\\file_{}.dll\",0x{:016X},AS.........\r\n", i, i % 512, i);
+        std::copy(std::cbegin(line), std::cend(line), std::back_inserter(data));
+    }
+
+    data.resize(size);
+    return data;
+}
+
+template <typename CompressingStream>
+void RoundTrip(const std::vector<BYTE>& data)
+{
+    auto compressed = std::make_shared<MemoryStream>();
+    Assert::IsTrue(SUCCEEDED(compressed->OpenForReadWrite()));
+
+    auto compressor = std::make_shared<CompressingStream>();
+    Assert::IsTrue(SUCCEEDED(compressor->OpenToCompress(compressed)));
+
+    // Uneven writes to cross the internal chunk boundaries
+    size_t offset = 0;
+    for (size_t chunk = 1; offset < data.size(); chunk = chunk * 3 + 7)
+    {
+        const auto toWrite = std::min(chunk, data.size() - offset);
+        ULONGLONG written = 0LL;
+        Assert::IsTrue(SUCCEEDED(compressor->Write((PVOID)(data.data() + offset), toWrite, &written)));
+        Assert::AreEqual((ULONGLONG)toWrite, written);
+        offset += toWrite;
+    }
+    Assert::IsTrue(SUCCEEDED(compressor->Close()));
+    Assert::IsTrue(compressed->GetSize() < data.size());
+
+    Assert::IsTrue(SUCCEEDED(compressed->SetFilePointer(0LL, FILE_BEGIN, nullptr)));
+
+    auto decompressor = std::make_shared<CompressingStream>();
+    Assert::IsTrue(SUCCEEDED(decompressor->OpenToDecompress(compressed)));
+
+    std::vector<BYTE> result(data.size() + 4096);
+    size_t resultSize = 0;
+    ULONGLONG read = 0LL;
+    do
+    {
+        const auto toRead = std::min<size_t>(4096 * 3, result.size() - resultSize);
+        Assert::IsTrue(SUCCEEDED(decompressor->Read(result.data() + resultSize, toRead, &read)));
+        resultSize += static_cast<size_t>(read);
+    } while (read > 0 && resultSize < result.size());
+
+    Assert::AreEqual(data.size(), resultSize);
+    Assert::IsTrue(std::equal(std::cbegin(data), std::cend(data), std::cbegin(result)));
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(CompressionStreamTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+#ifdef ORC_BUILD_ZSTD
+    TEST_METHOD(ZstdRoundTrip) { RoundTrip<ZstdStream>(MakeTableLikeData(3 * 1024 * 1024 + 17)); }
+#endif  // ORC_BUILD_ZSTD
+
+#ifdef ORC_BUILD_LZ4
+    TEST_METHOD(Lz4RoundTrip) { RoundTrip<Lz4Stream>(MakeTableLikeData(3 * 1024 * 1024 + 17)); }
+#endif  // ORC_BUILD_LZ4
+
+    TEST_METHOD(OutputSpecExtension)
+    {
+        OutputSpec output;
+        Assert::IsTrue(
+            SUCCEEDED(output.Configure(OutputSpec::Kind::TableFile, helper.GetTempFilePath(L"test.csv.zst"))));
+        Assert::IsTrue(HasFlag(output.Type, OutputSpec::Kind::CSV));
+        Assert::IsTrue(output.StreamCompression == OutputSpec::StreamCompression::Zstd);
+
+        Assert::IsTrue(SUCCEEDED(
+            output.Configure(OutputSpec::Kind::StructuredFile, helper.GetTempFilePath(L"test.json.lz4"))));
+        Assert::IsTrue(HasFlag(output.Type, OutputSpec::Kind::JSON));
+        Assert::IsTrue(output.StreamCompression == OutputSpec::StreamCompression::Lz4);
+
+        Assert::IsTrue(
+            SUCCEEDED(output.Configure(OutputSpec::Kind::TableFile, helper.GetTempFilePath(L"test.csv"))));
+        Assert::IsTrue(output.StreamCompression == OutputSpec::StreamCompression::None);
+    }
+};
+}  // namespace Orc::Test
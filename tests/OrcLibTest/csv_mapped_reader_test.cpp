@@ -0,0 +1,175 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "CsvMappedFileReader.h"
+
+#include <filesystem>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+// Quoted fields with separators, line feeds and escaped quotes land on 64 bytes block boundaries
+std::wstring MakeTableLikeFile(UnitTestHelper& helper, const std::wstring& fileName, size_t size)
+{
+    std::string content = "Index,FullName,Size,Attributes\r\n";
+    for (size_t i = 0; content.size() < size; ++i)
+    {
+        if (i % 7 == 0)
+            content += fmt::format("{},\"C:\\Users\\{},\n\"\"quoted\"\"\",0x{:X},\"A,S\"\r\n", i, i % 513, i);
+        else
+            content += fmt::format("{},\"C:\\Windows\\System32\\file_{}.dll\",0x{:X},A\r\n", i, i % 512, i);
+    }
+
+    const auto path = helper.GetTempFilePath(fileName);
+    helper.WriteFile(path, content);
+    return path;
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(CsvMappedReaderTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(Parse)
+    {
+        const auto path = helper.GetTempFilePath(L"mapped_reader.csv");
+        helper.WriteFile(
+            path,
+            "\xEF\xBB\xBF"
+            "Name,Size,Date,F\r\n"
+            "plain,12,2021-03-04 05:06:07.000,Y\r\n"
+            "\"with, separator\",0x10,,N\r\n"
+            "\r\n"
+            "\"multi\r\nline \"\"quoted\"\"\",4294967295,2020-01-01 00:00:00.000,Y\n"
+            "z,,,N"sv);
+
+        TableOutput::CSV::MappedFileReader reader;
+        Assert::IsTrue(SUCCEEDED(reader.OpenFile(path.c_str())));
+
+        Assert::AreEqual((size_t)4, reader.GetHeaders().size());
+        Assert::AreEqual(L"Name", reader.GetHeaders()[0].c_str());
+        // single character headers and fields
+        Assert::AreEqual(L"F", reader.GetHeaders()[3].c_str());
+
+        std::vector<std::wstring> names;
+        std::vector<ULONGLONG> lines;
+        Assert::IsTrue(SUCCEEDED(reader.Parse([&](const TableOutput::CSV::MappedFileReader::Record& record) {
+            Assert::AreEqual((size_t)4, record.GetColumnCount());
+
+            std::wstring name;
+            Assert::IsTrue(SUCCEEDED(record.GetString(0, name)));
+            names.push_back(name);
+            lines.push_back(record.ullLineNumber);
+
+            bool bFlag = false;
+            Assert::IsTrue(SUCCEEDED(record.GetBoolean(3, bFlag)));
+
+            DWORD dwSize = 0L;
+            if (names.size() == 1)
+            {
+                Assert::IsTrue(SUCCEEDED(record.GetInteger(1, dwSize)));
+                Assert::AreEqual(12UL, dwSize);
+
+                FILETIME ft;
+                Assert::IsTrue(SUCCEEDED(record.GetDateTime(2, ft)));
+                Assert::IsTrue(ft.dwHighDateTime != 0L);
+                Assert::IsTrue(bFlag);
+            }
+            else if (names.size() == 2)
+            {
+                Assert::IsTrue(SUCCEEDED(record.GetInteger(1, dwSize)));
+                Assert::AreEqual(16UL, dwSize);
+                Assert::IsFalse(bFlag);
+            }
+            else if (names.size() == 3)
+            {
+                Assert::IsTrue(SUCCEEDED(record.GetInteger(1, dwSize)));
+                Assert::AreEqual(MAXDWORD, dwSize);
+            }
+            else
+            {
+                Assert::IsTrue(FAILED(record.GetInteger(1, dwSize)));
+            }
+            return S_OK;
+        })));
+
+        Assert::AreEqual((size_t)4, names.size());
+        Assert::AreEqual(L"plain", names[0].c_str());
+        Assert::AreEqual(L"with, separator", names[1].c_str());
+        Assert::AreEqual(L"multi\r\nline \"quoted\"", names[2].c_str());
+        Assert::AreEqual(L"z", names[3].c_str());
+
+        Assert::AreEqual(2ULL, lines[0]);
+        Assert::AreEqual(5ULL, lines[2]);
+
+        // S_FALSE stops the parsing
+        size_t count = 0;
+        Assert::IsTrue(SUCCEEDED(reader.Parse([&count](const auto&) {
+            count++;
+            return S_FALSE;
+        })));
+        Assert::AreEqual((size_t)1, count);
+
+        reader.Close();
+        std::filesystem::remove(path);
+    }
+
+    TEST_METHOD(ParallelParse)
+    {
+        const auto path = MakeTableLikeFile(helper, L"mapped_reader_parallel.csv", 3 * 4 * 1024 * 1024 + 4567);
+
+        TableOutput::CSV::MappedFileReader reader;
+        Assert::IsTrue(SUCCEEDED(reader.OpenFile(path.c_str())));
+
+        std::vector<std::pair<ULONGLONG, std::string>> sequential;
+        Assert::IsTrue(SUCCEEDED(reader.Parse([&](const auto& record) {
+            Assert::AreEqual((size_t)4, record.GetColumnCount());
+            sequential.emplace_back(record.ullLineNumber, std::string(record.GetRaw(1)));
+            return S_OK;
+        })));
+
+        const auto chunks = reader.Split(8);
+        Assert::IsTrue(chunks.size() > 1);
+
+        std::vector<std::vector<std::pair<ULONGLONG, std::string>>> perChunk(chunks.size());
+        Assert::IsTrue(SUCCEEDED(reader.ParallelParse(
+            [&](const auto& chunk, const auto& record) {
+                const auto it = std::find_if(std::cbegin(chunks), std::cend(chunks), [&chunk](const auto& c) {
+                    return c.ullOffset == chunk.ullOffset;
+                });
+                const auto index = std::distance(std::cbegin(chunks), it);
+                perChunk[index].emplace_back(record.ullLineNumber, std::string(record.GetRaw(1)));
+                return S_OK;
+            },
+            8)));
+
+        std::vector<std::pair<ULONGLONG, std::string>> parallel;
+        for (const auto& records : perChunk)
+            std::copy(std::cbegin(records), std::cend(records), std::back_inserter(parallel));
+
+        Assert::AreEqual(sequential.size(), parallel.size());
+        Assert::IsTrue(sequential == parallel);
+
+        reader.Close();
+        std::filesystem::remove(path);
+    }
+};
+}  // namespace Orc::Test
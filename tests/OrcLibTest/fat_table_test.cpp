@@ -52,7 +52,7 @@ public:
         CBinaryBuffer buffer2(data2, sizeof(data2));
         fatTable.AddChunk(std::make_shared<CBinaryBuffer>(buffer2));
 
-        Assert::IsTrue(2 == fatTable.GetFatTableChunks().size());
+        Assert::IsTrue(28 == fatTable.GetEntryCount());
 
         {
             // root folder
@@ -61,8 +61,9 @@ public:
             Assert::IsTrue(true == entry.IsEOFEntry());
 
             FatTable::ClusterChain clusterChain;
-            fatTable.FillClusterChain(2, clusterChain);
+            Assert::IsTrue(S_OK == fatTable.FillClusterChain(2, clusterChain));
             Assert::IsTrue(1 == clusterChain.size());
+            Assert::IsTrue(2 == clusterChain[0].FirstCluster && 1 == clusterChain[0].Count);
         }
 
         {
@@ -72,8 +73,12 @@ public:
             Assert::IsTrue(true == entry.IsUsed());
 
             FatTable::ClusterChain clusterChain;
-            fatTable.FillClusterChain(7, clusterChain);
-            Assert::IsTrue(20 == clusterChain.size());
+            Assert::IsTrue(S_OK == fatTable.FillClusterChain(7, clusterChain));
+            Assert::IsTrue(20 == FatTable::GetClusterCount(clusterChain));
+
+            // clusters 7 to 0x1A are contiguous
+            Assert::IsTrue(1 == clusterChain.size());
+            Assert::IsTrue(7 == clusterChain[0].FirstCluster && 20 == clusterChain[0].Count);
         }
 
         {
@@ -83,5 +88,28 @@ public:
             Assert::IsTrue(true == entry.IsFree());
         }
     }
+
+    TEST_METHOD(Fat16FragmentedChainTest)
+    {
+        FatTable fatTable(FatTable::FAT16);
+
+        // chain 2 -> 3 -> 6 -> 7 -> 8 -> EOF, chain 4 -> 5 -> 4 loops
+        unsigned short data[10] = {0xFFF8, 0xFFFF, 0x0003, 0x0006, 0x0005, 0x0004, 0x0007, 0x0008, 0xFFFF, 0x0000};
+        CBinaryBuffer buffer(reinterpret_cast<BYTE*>(data), sizeof(data));
+        fatTable.AddChunk(std::make_shared<CBinaryBuffer>(buffer));
+
+        FatTable::ClusterChain clusterChain;
+        Assert::IsTrue(S_OK == fatTable.FillClusterChain(2, clusterChain));
+        Assert::IsTrue(2 == clusterChain.size());
+        Assert::IsTrue(2 == clusterChain[0].FirstCluster && 2 == clusterChain[0].Count);
+        Assert::IsTrue(6 == clusterChain[1].FirstCluster && 3 == clusterChain[1].Count);
+        Assert::IsTrue(5 == FatTable::GetClusterCount(clusterChain));
+
+        Assert::IsTrue(FAILED(fatTable.FillClusterChain(4, clusterChain)));
+
+        // free first cluster: empty chain
+        Assert::IsTrue(S_OK == fatTable.FillClusterChain(0, clusterChain));
+        Assert::IsTrue(clusterChain.empty());
+    }
 };
 }  // namespace Orc::Test
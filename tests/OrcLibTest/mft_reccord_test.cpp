@@ -7,10 +7,66 @@
 //
 #include "stdafx.h"
 
+#include "MFTUtils.h"
+#include "VolumeReaderTest.h"
+
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
 using namespace Orc;
 using namespace Orc::Test;
 
+namespace {
+
+constexpr ULONG kBytesPerFRS = 1024;
+constexpr ULONG kBytesPerSector = 512;
+
+class FixupVolumeReader : public VolumeReaderTest
+{
+public:
+    FixupVolumeReader()
+        : VolumeReaderTest(nullptr, nullptr)
+    {
+        m_BytesPerFRS = kBytesPerFRS;
+        m_BytesPerSector = kBytesPerSector;
+    }
+};
+
+// Records as written on disk: the end of each sector is saved in the update sequence array and replaced by the
+// sequence number
+std::vector<BYTE> MakeRecords(size_t cRecords)
+{
+    std::vector<BYTE> records(cRecords * kBytesPerFRS, 0);
+
+    for (size_t i = 0; i < cRecords; i++)
+    {
+        const auto pRecord = records.data() + i * kBytesPerFRS;
+        const auto pHeader = reinterpret_cast<PFILE_RECORD_SEGMENT_HEADER>(pRecord);
+
+        CopyMemory(pHeader->MultiSectorHeader.Signature, "FILE", 4);
+        pHeader->MultiSectorHeader.UpdateSequenceArrayOffset = 0x30;
+        pHeader->MultiSectorHeader.UpdateSequenceArraySize = kBytesPerFRS / kBytesPerSector + 1;
+        pHeader->FirstAttributeOffset = 0x38;
+        pHeader->Reserved3[0] = 0x40;
+        pHeader->Reserved3[1] = kBytesPerFRS;
+        *reinterpret_cast<ULONG*>(pRecord + 0x38) = $END;
+
+        const auto usSequenceNumber = static_cast<USHORT>(i + 1);
+        const auto pArray = reinterpret_cast<USHORT*>(pRecord + 0x30);
+        pArray[0] = usSequenceNumber;
+        for (ULONG j = 0; j < kBytesPerFRS / kBytesPerSector; j++)
+        {
+            const auto pTail = reinterpret_cast<USHORT*>(pRecord + (j + 1) * kBytesPerSector - sizeof(USHORT));
+            *pTail = static_cast<USHORT>(0xA000 + j);
+            pArray[j + 1] = *pTail;
+            *pTail = usSequenceNumber;
+        }
+    }
+
+    return records;
+}
+
+}  // namespace
+
 namespace Orc::Test {
 TEST_CLASS(MFTTest)
 {
@@ -28,6 +84,106 @@ public:
         // TODO
     };
 
+    TEST_METHOD(TriageRecord)
+    {
+        constexpr ULONG ulBytesPerFRS = 1024;
+        constexpr ULONG ulBytesPerSector = 512;
+        constexpr USHORT usSequenceNumber = 0x0042;
+
+        std::vector<BYTE> record(ulBytesPerFRS, 0);
+        const auto pHeader = reinterpret_cast<PFILE_RECORD_SEGMENT_HEADER>(record.data());
+
+        Assert::IsTrue(MFTUtils::RecordTriage::NoSignature == MFTUtils::TriageRecord(pHeader, ulBytesPerFRS));
+
+        CopyMemory(pHeader->MultiSectorHeader.Signature, "FILE", 4);
+        pHeader->MultiSectorHeader.UpdateSequenceArrayOffset = 0x30;
+        pHeader->MultiSectorHeader.UpdateSequenceArraySize = 3;
+        pHeader->FirstAttributeOffset = 0x38;
+        pHeader->Reserved3[0] = 0x40;
+        pHeader->Reserved3[1] = ulBytesPerFRS;
+        *reinterpret_cast<USHORT*>(record.data() + 0x30) = usSequenceNumber;
+        *reinterpret_cast<ULONG*>(record.data() + 0x38) = $END;
+
+        // torn write
+        *reinterpret_cast<USHORT*>(record.data() + ulBytesPerSector - 2) = usSequenceNumber;
+        Assert::IsTrue(MFTUtils::RecordTriage::BadUpdateSequence == MFTUtils::TriageRecord(pHeader, ulBytesPerFRS));
+
+        *reinterpret_cast<USHORT*>(record.data() + ulBytesPerFRS - 2) = usSequenceNumber;
+        Assert::IsTrue(MFTUtils::RecordTriage::Viable == MFTUtils::TriageRecord(pHeader, ulBytesPerFRS));
+
+        *reinterpret_cast<ULONG*>(record.data() + 0x38) = 0x1234;
+        Assert::IsTrue(MFTUtils::RecordTriage::BadHeader == MFTUtils::TriageRecord(pHeader, ulBytesPerFRS));
+
+        *reinterpret_cast<ULONG*>(record.data() + 0x38) = $STANDARD_INFORMATION;
+        pHeader->Reserved3[0] = ulBytesPerFRS + 8;
+        Assert::IsTrue(MFTUtils::RecordTriage::BadHeader == MFTUtils::TriageRecord(pHeader, ulBytesPerFRS));
+
+        pHeader->Reserved3[0] = 0x40;
+        *reinterpret_cast<USHORT*>(record.data() + ulBytesPerFRS - 2) = 0x1234;
+        Assert::IsTrue(MFTUtils::RecordTriage::Viable == MFTUtils::TriageRecord(pHeader, ulBytesPerFRS, true));
+
+        pHeader->MultiSectorHeader.UpdateSequenceArraySize = 2;
+        Assert::IsTrue(
+            MFTUtils::RecordTriage::BadUpdateSequence
+            == MFTUtils::TriageRecord(pHeader, ulBytesPerFRS, true));
+
+        // a 4096 bytes record (4K sectors volume) still ends each 512 bytes with the sequence number
+        std::vector<BYTE> largeRecord(4096, 0);
+        CopyMemory(largeRecord.data(), record.data(), 0x40);
+        const auto pLargeHeader = reinterpret_cast<PFILE_RECORD_SEGMENT_HEADER>(largeRecord.data());
+        pLargeHeader->MultiSectorHeader.UpdateSequenceArraySize = 4096 / 512 + 1;
+        pLargeHeader->FirstAttributeOffset = 0x48;
+        pLargeHeader->Reserved3[0] = 0x50;
+        pLargeHeader->Reserved3[1] = 4096;
+        *reinterpret_cast<ULONG*>(largeRecord.data() + 0x48) = $END;
+        for (size_t i = 512; i <= largeRecord.size(); i += 512)
+            *reinterpret_cast<USHORT*>(largeRecord.data() + i - 2) = usSequenceNumber;
+        Assert::IsTrue(MFTUtils::RecordTriage::Viable == MFTUtils::TriageRecord(pLargeHeader, 4096));
+
+        *reinterpret_cast<USHORT*>(largeRecord.data() + 1024 - 2) = 0x1234;
+        Assert::IsTrue(MFTUtils::RecordTriage::BadUpdateSequence == MFTUtils::TriageRecord(pLargeHeader, 4096));
+    }
+
+    TEST_METHOD(MultiSectorFixupBlocks)
+    {
+        // 13 records: the sector ends of the last one are compared out of the SIMD loop
+        auto records = MakeRecords(13);
+
+        // torn write, not a record and invalid update sequence array
+        records[3 * kBytesPerFRS + kBytesPerFRS - 2] ^= 0xFF;
+        CopyMemory(records.data() + 7 * kBytesPerFRS, "BAAD", 4);
+        reinterpret_cast<PFILE_RECORD_SEGMENT_HEADER>(records.data() + 12 * kBytesPerFRS)
+            ->MultiSectorHeader.UpdateSequenceArrayOffset = 0xFFFE;
+        const auto damaged = records;
+
+        std::vector<bool> fixedUp;
+        Assert::IsTrue(SUCCEEDED(MFTUtils::MultiSectorFixupBlocks(
+            records.data(), records.size(), kBytesPerFRS, MFTUtils::kFileSignature, fixedUp)));
+        Assert::AreEqual<size_t>(13, fixedUp.size());
+
+        for (size_t i = 0; i < fixedUp.size(); i++)
+        {
+            const auto pRecord = records.data() + i * kBytesPerFRS;
+            if (i == 3 || i == 7 || i == 12)
+            {
+                Assert::IsFalse(fixedUp[i]);
+                Assert::IsTrue(std::equal(pRecord, pRecord + kBytesPerFRS, damaged.data() + i * kBytesPerFRS));
+                continue;
+            }
+
+            Assert::IsTrue(fixedUp[i]);
+            for (ULONG j = 0; j < kBytesPerFRS / kBytesPerSector; j++)
+            {
+                const auto pTail = reinterpret_cast<const USHORT*>(pRecord + (j + 1) * kBytesPerSector - 2);
+                Assert::AreEqual<USHORT>(static_cast<USHORT>(0xA000 + j), *pTail);
+            }
+        }
+
+        // blocks must hold whole 512 bytes strides
+        Assert::IsTrue(FAILED(MFTUtils::MultiSectorFixupBlocks(
+            records.data(), records.size(), kBytesPerFRS - 3, MFTUtils::kFileSignature, fixedUp)));
+    }
+
 private:
 };
 }  // namespace Orc::Test
@@ -0,0 +1,215 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "MFTSnapshot.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+constexpr ULONGLONG kRootFRN = 0x0005000000000005;
+constexpr ULONGLONG kDirectoryFRN = 0x0002000000000040;
+constexpr ULONGLONG kFileFRN = 0x0003000000000041;
+constexpr ULONGLONG kOrphanFRN = 0x0001000000000042;
+constexpr ULONGLONG kStaleFRN = 0x0001000000000044;
+constexpr ULONGLONG kLostFRN = 0x0001000000000045;
+constexpr ULONGLONG kLostDirectoryFRN = 0x0001000000000046;
+
+// Parents that are not in the snapshot: reused directory, missing record
+constexpr ULONGLONG kReusedDirectoryFRN = 0x0001000000000040;
+constexpr ULONGLONG kMissingFRN = 0x0001000000000050;
+
+MFTSnapshot::Key MakeKey()
+{
+    MFTSnapshot::Key key;
+    key.VolumeSerialNumber = 0x1234ABCD5678EF90;
+    key.MftSize = 0x40000;
+    key.MftLsn = 0x12345678;
+    key.BytesPerFRS = 1024;
+    return key;
+}
+
+MFTSnapshot::Record MakeRecord(ULONGLONG ullFRN, ULONG ulFlags, ULONGLONG ullSize)
+{
+    MFTSnapshot::Record record;
+    record.FRN = ullFRN;
+    record.Flags = ulFlags;
+    record.Attributes = (ulFlags & MFTSnapshot::Directory) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE;
+    record.Size = ullSize;
+    record.CreationTime = 0x01D7000000000000 + ullFRN;
+    record.LastModificationTime = record.CreationTime + 1;
+    record.LastAccessTime = record.CreationTime + 2;
+    record.LastChangeTime = record.CreationTime + 3;
+    return record;
+}
+
+// Records are added out of order, as a walk would
+void AddRecords(MFTSnapshotWriter& writer)
+{
+    Assert::IsTrue(SUCCEEDED(writer.Add(
+        MakeRecord(kFileFRN, MFTSnapshot::InUse, 0x3000),
+        {{kDirectoryFRN, L"File.txt"sv}, {kRootFRN, L"HardLink.txt"sv}},
+        {{0x100000, 0x2000}, {0x800000, 0x1000}})));
+
+    Assert::IsTrue(SUCCEEDED(writer.Add(
+        MakeRecord(kDirectoryFRN, MFTSnapshot::InUse | MFTSnapshot::Directory, 0LL), {{kRootFRN, L"Dir"sv}}, {})));
+
+    Assert::IsTrue(SUCCEEDED(writer.Add(
+        MakeRecord(kRootFRN, MFTSnapshot::InUse | MFTSnapshot::Directory, 0LL), {{kRootFRN, L"."sv}}, {})));
+
+    Assert::IsTrue(SUCCEEDED(writer.Add(MakeRecord(kOrphanFRN, 0L, 0x10), {}, {})));
+
+    Assert::IsTrue(SUCCEEDED(
+        writer.Add(MakeRecord(kStaleFRN, MFTSnapshot::InUse, 0x10), {{kReusedDirectoryFRN, L"Stale.txt"sv}}, {})));
+
+    Assert::IsTrue(SUCCEEDED(
+        writer.Add(MakeRecord(kLostFRN, MFTSnapshot::InUse, 0x10), {{kLostDirectoryFRN, L"Lost.txt"sv}}, {})));
+
+    Assert::IsTrue(SUCCEEDED(writer.Add(
+        MakeRecord(kLostDirectoryFRN, MFTSnapshot::InUse | MFTSnapshot::Directory, 0LL),
+        {{kMissingFRN, L"Lost"sv}},
+        {})));
+}
+
+void CheckSnapshot(const MFTSnapshot& snapshot)
+{
+    Assert::AreEqual(static_cast<size_t>(7), snapshot.GetRecordCount());
+    Assert::IsTrue(snapshot.GetKey() == MakeKey());
+
+    const auto file = snapshot.Find(kFileFRN);
+    Assert::IsTrue(file.has_value());
+
+    // the sequence number is only checked when there is one
+    Assert::IsTrue(snapshot.Find(kFileFRN & 0x0000FFFFFFFFFFFF) == file);
+    Assert::IsFalse(snapshot.Find(0x0004000000000041).has_value());
+    Assert::IsFalse(snapshot.Find(0x43).has_value());
+
+    const auto record = snapshot.GetRecord(*file);
+    Assert::AreEqual(kFileFRN, record.FRN);
+    Assert::AreEqual(static_cast<ULONG>(MFTSnapshot::InUse), record.Flags);
+    Assert::AreEqual(static_cast<ULONG>(FILE_ATTRIBUTE_ARCHIVE), record.Attributes);
+    Assert::AreEqual(0x3000ULL, record.Size);
+    Assert::AreEqual(static_cast<LONGLONG>(0x01D7000000000000 + kFileFRN + 3), record.LastChangeTime);
+
+    const auto names = snapshot.GetNames(*file);
+    Assert::AreEqual(static_cast<size_t>(2), names.size());
+    Assert::IsTrue(names[0] == L"File.txt"sv);
+    Assert::IsTrue(names[1] == L"HardLink.txt"sv);
+
+    Assert::AreEqual(L"\\Dir\\File.txt", snapshot.GetFullName(*file).c_str());
+    Assert::AreEqual(L"\\", snapshot.GetFullName(*snapshot.Find(kRootFRN)).c_str());
+    Assert::IsTrue(snapshot.GetFullName(*snapshot.Find(kOrphanFRN)).empty());
+
+    // unresolved parents are replaced with a placeholder, as MFTWalker does
+    Assert::AreEqual(
+        L"\\__0001000000000040__\\Stale.txt", snapshot.GetFullName(*snapshot.Find(kStaleFRN)).c_str());
+    Assert::AreEqual(
+        L"\\__0001000000000050__\\Lost\\Lost.txt", snapshot.GetFullName(*snapshot.Find(kLostFRN)).c_str());
+
+    const auto runs = snapshot.GetDataRuns(*file);
+    Assert::AreEqual(static_cast<size_t>(2), runs.size());
+    Assert::AreEqual(0x100000ULL, runs[0].DiskOffset);
+    Assert::AreEqual(0x2000ULL, runs[0].Length);
+    Assert::AreEqual(0x800000ULL, runs[1].DiskOffset);
+    Assert::AreEqual(0x1000ULL, runs[1].Length);
+    Assert::IsTrue(snapshot.GetDataRuns(*snapshot.Find(kDirectoryFRN)).empty());
+
+    // names match case insensitively, on any of the names of a record
+    Assert::IsTrue(snapshot.FindByName(L"file.TXT"sv) == std::vector<size_t> {*file});
+    Assert::IsTrue(snapshot.FindByName(L"hardlink.txt"sv) == std::vector<size_t> {*file});
+    Assert::IsTrue(snapshot.FindByName(L"dir"sv) == std::vector<size_t> {*snapshot.Find(kDirectoryFRN)});
+    Assert::IsTrue(snapshot.FindByName(L"File"sv).empty());
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(MFTSnapshotTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(InMemory)
+    {
+        MFTSnapshotWriter writer;
+        AddRecords(writer);
+        Assert::AreEqual(static_cast<size_t>(7), writer.GetRecordCount());
+
+        std::vector<BYTE> image;
+        Assert::IsTrue(SUCCEEDED(writer.Serialize(MakeKey(), image)));
+
+        MFTSnapshot snapshot;
+        Assert::IsTrue(SUCCEEDED(snapshot.Open(std::move(image), MakeKey())));
+        CheckSnapshot(snapshot);
+    }
+
+    TEST_METHOD(WriteAndOpen)
+    {
+        const auto path = helper.GetTempFilePath(L"mft_snapshot_test.snapshot");
+
+        MFTSnapshotWriter writer;
+        AddRecords(writer);
+        Assert::IsTrue(SUCCEEDED(writer.Write(path, MakeKey())));
+
+        {
+            MFTSnapshot snapshot;
+            Assert::IsTrue(SUCCEEDED(snapshot.Open(path, MakeKey())));
+            CheckSnapshot(snapshot);
+        }
+
+        // a snapshot of another state of the MFT is rejected
+        std::vector<MFTSnapshot::Key> staleKeys(4, MakeKey());
+        staleKeys[0].VolumeSerialNumber++;
+        staleKeys[1].MftSize += 1024;
+        staleKeys[2].MftLsn++;
+        staleKeys[3].BytesPerFRS = 4096;
+
+        for (const auto& stale : staleKeys)
+        {
+            MFTSnapshot snapshot;
+            Assert::AreEqual(HRESULT_FROM_WIN32(ERROR_FILE_INVALID), snapshot.Open(path, stale));
+        }
+
+        Assert::IsTrue(DeleteFileW(path.c_str()));
+    }
+
+    TEST_METHOD(Corrupted)
+    {
+        MFTSnapshotWriter writer;
+        AddRecords(writer);
+
+        std::vector<BYTE> image;
+        Assert::IsTrue(SUCCEEDED(writer.Serialize(MakeKey(), image)));
+
+        {
+            auto truncated = image;
+            truncated.resize(truncated.size() / 2);
+
+            MFTSnapshot snapshot;
+            Assert::IsTrue(FAILED(snapshot.Open(std::move(truncated), MakeKey())));
+        }
+
+        {
+            auto badMagic = image;
+            badMagic[0] ^= 0xFF;
+
+            MFTSnapshot snapshot;
+            Assert::IsTrue(FAILED(snapshot.Open(std::move(badMagic), MakeKey())));
+        }
+    }
+};
+}  // namespace Orc::Test
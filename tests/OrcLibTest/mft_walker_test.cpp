@@ -16,11 +16,79 @@
 #include "Temporary.h"
 #include "MFTRecordFileInfo.h"
 #include "BinaryBuffer.h"
+#include "VolumeReaderTest.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace Orc;
 using namespace Orc::Test;
 
+namespace {
+
+constexpr DWORD kSizePerIndex = 0x1000;
+constexpr ULONG kBytesPerSector = 512;
+constexpr ULONGLONG kDirectory = 0x0003000000001234;
+constexpr ULONG kFirstEntryOffset = 0x40;
+
+class IndexVolumeReader : public VolumeReaderTest
+{
+public:
+    IndexVolumeReader()
+        : VolumeReaderTest(nullptr, nullptr)
+    {
+        m_BytesPerSector = kBytesPerSector;
+    }
+};
+
+// Writes the header of an index block, entries start at kFirstEntryOffset
+void InitIndexBlock(LPBYTE pBlock)
+{
+    const auto pIABuff = reinterpret_cast<PINDEX_ALLOCATION_BUFFER>(pBlock);
+    CopyMemory(pIABuff->MultiSectorHeader.Signature, "INDX", 4);
+    pIABuff->MultiSectorHeader.UpdateSequenceArrayOffset = offsetof(INDEX_ALLOCATION_BUFFER, UpdateSequenceArray);
+    pIABuff->MultiSectorHeader.UpdateSequenceArraySize = kSizePerIndex / kBytesPerSector + 1;
+    pIABuff->IndexHeader.FirstIndexEntry = kFirstEntryOffset - offsetof(INDEX_ALLOCATION_BUFFER, IndexHeader);
+    pIABuff->IndexHeader.BytesAvailable = kSizePerIndex - offsetof(INDEX_ALLOCATION_BUFFER, IndexHeader);
+}
+
+// Writes the entry of 'name' (a file of kDirectory), returns its length
+ULONG WriteIndexEntry(LPBYTE pEntry, ULONGLONG ullFile, std::wstring_view name)
+{
+    const auto cbFileName = static_cast<ULONG>(NtfsFileNameSizeFromLength(name.size() * sizeof(WCHAR)));
+    const auto cbEntry = (static_cast<ULONG>(sizeof(INDEX_ENTRY)) + cbFileName + 7) & ~7UL;
+
+    const auto pIndexEntry = reinterpret_cast<PINDEX_ENTRY>(pEntry);
+    CopyMemory(&pIndexEntry->FileReference, &ullFile, sizeof(ullFile));
+    pIndexEntry->Length = static_cast<USHORT>(cbEntry);
+    pIndexEntry->AttributeLength = static_cast<USHORT>(cbFileName);
+
+    const auto pFileName = reinterpret_cast<PFILE_NAME>(pEntry + sizeof(INDEX_ENTRY));
+    CopyMemory(&pFileName->ParentDirectory, &kDirectory, sizeof(kDirectory));
+    pFileName->FileNameLength = static_cast<UCHAR>(name.size());
+    CopyMemory(pFileName->FileName, name.data(), name.size() * sizeof(WCHAR));
+    return cbEntry;
+}
+
+// Protects the block as NTFS writes it: the sequence number replaces the last word of each sector, which moves to the
+// update sequence array
+void ProtectIndexBlock(LPBYTE pBlock, USHORT usSequenceNumber)
+{
+    const auto pArray = reinterpret_cast<USHORT*>(pBlock + offsetof(INDEX_ALLOCATION_BUFFER, UpdateSequenceArray));
+    pArray[0] = usSequenceNumber;
+    for (ULONG i = 0; i < kSizePerIndex / kBytesPerSector; i++)
+    {
+        const auto pTail = reinterpret_cast<USHORT*>(pBlock + (i + 1) * kBytesPerSector - sizeof(USHORT));
+        pArray[i + 1] = *pTail;
+        *pTail = usSequenceNumber;
+    }
+}
+
+std::wstring_view EntryName(const MFTWalker::I30Entry& entry)
+{
+    return std::wstring_view(entry.m_pFileName->FileName, entry.m_pFileName->FileNameLength);
+}
+
+}  // namespace
+
 namespace Orc::Test {
 TEST_CLASS(MFTWalkerTest)
 {
@@ -44,6 +112,73 @@ public:
         DeleteFile(m_ArchiveItem.Path.c_str());
     };
 
+    TEST_METHOD(ParseI30Block)
+    {
+        const auto reader = std::make_shared<IndexVolumeReader>();
+
+        // two index blocks preceded by the padding used as header of entries carved at the start of the buffer
+        std::vector<BYTE> data(sizeof(INDEX_ENTRY) + 2 * kSizePerIndex, 0);
+        const auto pFirstBlock = data.data() + sizeof(INDEX_ENTRY);
+        const auto pSecondBlock = pFirstBlock + kSizePerIndex;
+
+        // first block, in use: two entries, the end entry, then a deleted entry in the free space
+        InitIndexBlock(pFirstBlock);
+        const auto pEntryA = pFirstBlock + kFirstEntryOffset;
+        const auto pEntryB = pEntryA + WriteIndexEntry(pEntryA, 0x40, L"a");
+        const auto pEnd = pEntryB + WriteIndexEntry(pEntryB, 0x41, L"b");
+        reinterpret_cast<PINDEX_ENTRY>(pEnd)->Length = sizeof(INDEX_ENTRY);
+        reinterpret_cast<PINDEX_ENTRY>(pEnd)->Flags = INDEX_ENTRY_END;
+        const auto pHeader = &reinterpret_cast<PINDEX_ALLOCATION_BUFFER>(pFirstBlock)->IndexHeader;
+        pHeader->FirstFreeByte = static_cast<ULONG>(pEnd + sizeof(INDEX_ENTRY) - reinterpret_cast<LPBYTE>(pHeader));
+        const auto pEntryC = pFirstBlock + 0x300;
+        WriteIndexEntry(pEntryC, 0x42, L"c");
+        ProtectIndexBlock(pFirstBlock, 0x0042);
+
+        // second block, not in use: its first entry is stale
+        InitIndexBlock(pSecondBlock);
+        const auto pEntryD = pSecondBlock + kFirstEntryOffset;
+        WriteIndexEntry(pEntryD, 0x43, L"d");
+        ProtectIndexBlock(pSecondBlock, 0x0043);
+
+        // as with the former inline parsing: the entries of the index then the carved ones, block after block
+        std::vector<MFTWalker::I30Entry> entries;
+        MFTWalker::ParseI30Block(reader, kDirectory, data, kSizePerIndex, 0, true, entries);
+        MFTWalker::ParseI30Block(reader, kDirectory, data, kSizePerIndex, 1, false, entries);
+
+        const std::vector<std::tuple<LPBYTE, std::wstring_view, bool>> expected = {
+            {pEntryA, L"a", false}, {pEntryB, L"b", false}, {pEntryC, L"c", true}, {pEntryD, L"d", true}};
+        Assert::AreEqual(expected.size(), entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            const auto& [pEntry, name, bCarved] = expected[i];
+            Assert::IsTrue(reinterpret_cast<LPBYTE>(entries[i].m_pEntry) == pEntry);
+            Assert::IsTrue(reinterpret_cast<LPBYTE>(entries[i].m_pFileName) == pEntry + sizeof(INDEX_ENTRY));
+            Assert::IsTrue(EntryName(entries[i]) == name);
+            Assert::AreEqual(bCarved, entries[i].m_bCarved);
+        }
+
+        // the sector ends were fixed up
+        Assert::AreEqual<USHORT>(0, *reinterpret_cast<const USHORT*>(pFirstBlock + kBytesPerSector - sizeof(USHORT)));
+        Assert::AreEqual<USHORT>(0, *reinterpret_cast<const USHORT*>(pSecondBlock + kSizePerIndex - sizeof(USHORT)));
+
+        // a reference to the directory at the very start of the first block (here its Lsn) is carved with the padding
+        // as header
+        std::vector<BYTE> slack(sizeof(INDEX_ENTRY) + kSizePerIndex, 0);
+        const auto pSlackBlock = slack.data() + sizeof(INDEX_ENTRY);
+        InitIndexBlock(pSlackBlock);
+        CopyMemory(&reinterpret_cast<PINDEX_ALLOCATION_BUFFER>(pSlackBlock)->Lsn, &kDirectory, sizeof(kDirectory));
+        ProtectIndexBlock(pSlackBlock, 0x0044);
+
+        entries.clear();
+        MFTWalker::ParseI30Block(reader, kDirectory, slack, kSizePerIndex, 0, false, entries);
+        Assert::AreEqual<size_t>(1, entries.size());
+        Assert::IsTrue(entries[0].m_bCarved);
+        Assert::IsTrue(
+            reinterpret_cast<LPBYTE>(entries[0].m_pFileName)
+            == pSlackBlock + offsetof(INDEX_ALLOCATION_BUFFER, Lsn));
+        Assert::IsTrue(reinterpret_cast<LPBYTE>(entries[0].m_pEntry) >= slack.data());
+    }
+
 private:
     DWORD64 m_NbFiles;
     DWORD64 m_NbFolders;
@@ -84,6 +219,14 @@ private:
                                                 const std::shared_ptr<DataAttribute>& pDataAttr) {
             using namespace std::string_literals;
 
+            // Paths are built from the memoized path of the parent directory, the builder reuses its buffer
+            const std::wstring fullName = walker.GetFullNameBuilder()(pFileName, pDataAttr);
+            const std::wstring_view baseName(pFileName->FileName, pFileName->FileNameLength);
+            const auto nameEnd = std::min(fullName.find(L':'), fullName.size());
+            Assert::IsTrue(fullName.front() == L'\\' && nameEnd > baseName.size());
+            Assert::IsTrue(std::wstring_view(fullName).substr(nameEnd - baseName.size(), baseName.size()) == baseName);
+            Assert::IsTrue(fullName == walker.GetFullNameBuilder()(pFileName, pDataAttr));
+
             std::vector<Filter> empty;
             Authenticode authenticode;
             MFTRecordFileInfo fi(
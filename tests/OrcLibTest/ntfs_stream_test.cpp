@@ -0,0 +1,154 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "NTFSStream.h"
+
+#include "VolumeReaderTest.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+constexpr ULONGLONG kRunSize = 0x1000;
+
+// Disk bytes are never zero: zeroed ranges of a stream cannot be mistaken for data
+BYTE DiskByte(ULONGLONG ullDiskOffset)
+{
+    return static_cast<BYTE>(ullDiskOffset % 251 + 1);
+}
+
+MFTUtils::DataSegment
+MakeSegment(ULONGLONG ullFileOffset, ULONGLONG ullDiskOffset, bool bUnallocated = false, bool bValidData = true)
+{
+    return {ullDiskOffset, ullFileOffset, kRunSize, kRunSize, bUnallocated, bValidData};
+}
+
+// File layout, one run each:
+//  [0] at disk 0x8000, [1] at disk 0x9000 (follows [0]), [2] sparse, [3] at disk 0 (before [0]), [4] past the VDL
+std::vector<MFTUtils::DataSegment> MakeSegments()
+{
+    return {
+        MakeSegment(0 * kRunSize, 0x8000),
+        MakeSegment(1 * kRunSize, 0x9000),
+        MakeSegment(2 * kRunSize, 0, true),
+        MakeSegment(3 * kRunSize, 0),
+        MakeSegment(4 * kRunSize, 0xC000, false, false)};
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(NTFSStreamTest)
+{
+private:
+    UnitTestHelper helper;
+
+    struct DiskRead
+    {
+        ULONGLONG ullOffset;
+        ULONGLONG ullLength;
+    };
+
+    std::vector<DiskRead> m_reads;
+    ULONGLONG m_ullReadableEnd = ULLONG_MAX;  // reads return nothing past this disk offset
+
+    VolumeReaderTest::ReadCallBack m_readCallBack =
+        [this](ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) {
+            m_reads.push_back({offset, ullBytesToRead});
+
+            ullBytesRead = offset < m_ullReadableEnd ? std::min(ullBytesToRead, m_ullReadableEnd - offset) : 0LL;
+            for (ULONGLONG i = 0; i < ullBytesRead; i++)
+                data.GetData()[i] = DiskByte(offset + i);
+            return S_OK;
+        };
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(NTFSStreamPlannedRead)
+    {
+        m_reads.clear();
+        m_ullReadableEnd = ULLONG_MAX;
+
+        auto reader = std::make_shared<VolumeReaderTest>(nullptr, &m_readCallBack);
+        NTFSStream stream;
+        Assert::AreEqual(S_OK, stream.OpenStream(reader, MakeSegments(), 5 * kRunSize));
+
+        std::vector<BYTE> buffer(5 * kRunSize, 0xFF);
+        ULONGLONG ullBytesRead = 0LL;
+        Assert::AreEqual(S_OK, stream.Read(buffer.data(), buffer.size(), &ullBytesRead));
+        Assert::AreEqual(5 * kRunSize, ullBytesRead);
+
+        // the two adjacent runs are read at once, after the run stored before them on disk
+        Assert::AreEqual<size_t>(2, m_reads.size());
+        Assert::AreEqual<ULONGLONG>(0, m_reads[0].ullOffset);
+        Assert::AreEqual(kRunSize, m_reads[0].ullLength);
+        Assert::AreEqual<ULONGLONG>(0x8000, m_reads[1].ullOffset);
+        Assert::AreEqual(2 * kRunSize, m_reads[1].ullLength);
+
+        for (ULONGLONG i = 0; i < 2 * kRunSize; i++)
+            Assert::AreEqual(DiskByte(0x8000 + i), buffer[i]);
+        for (ULONGLONG i = 0; i < kRunSize; i++)
+        {
+            Assert::AreEqual<BYTE>(0, buffer[2 * kRunSize + i]);
+            Assert::AreEqual(DiskByte(i), buffer[3 * kRunSize + i]);
+            Assert::AreEqual<BYTE>(0, buffer[4 * kRunSize + i]);
+        }
+
+        const auto& statistics = stream.GetReadStatistics();
+        Assert::AreEqual<ULONGLONG>(2, statistics.ullReads);
+        Assert::AreEqual(3 * kRunSize, statistics.ullBytesRead);
+        Assert::AreEqual(2 * kRunSize, statistics.ullBytesZeroed);
+        Assert::AreEqual<ULONGLONG>(1, statistics.ullSeeks);
+
+        // a read within a run and across the sparse one
+        Assert::AreEqual(S_OK, stream.SetFilePointer(kRunSize + 0x10, FILE_BEGIN, nullptr));
+        m_reads.clear();
+        Assert::AreEqual(S_OK, stream.Read(buffer.data(), kRunSize * 2, &ullBytesRead));
+        Assert::AreEqual(kRunSize * 2, ullBytesRead);
+        Assert::AreEqual<size_t>(2, m_reads.size());
+        Assert::AreEqual<ULONGLONG>(0, m_reads[0].ullOffset);
+        Assert::AreEqual<ULONGLONG>(0x10, m_reads[0].ullLength);
+        Assert::AreEqual<ULONGLONG>(0x9010, m_reads[1].ullOffset);
+        Assert::AreEqual(kRunSize - 0x10, m_reads[1].ullLength);
+        Assert::AreEqual(DiskByte(0x9010), buffer[0]);
+        Assert::AreEqual<BYTE>(0, buffer[kRunSize - 0x10]);
+        Assert::AreEqual(DiskByte(0), buffer[2 * kRunSize - 0x10]);
+    }
+
+    TEST_METHOD(NTFSStreamShortRead)
+    {
+        m_reads.clear();
+        m_ullReadableEnd = 0x8800;
+
+        auto reader = std::make_shared<VolumeReaderTest>(nullptr, &m_readCallBack);
+        NTFSStream stream;
+        Assert::AreEqual(S_OK, stream.OpenStream(reader, MakeSegments(), 5 * kRunSize));
+
+        // the merged runs stop after 0x800 bytes: what follows in the buffer is dropped, even the run read before
+        std::vector<BYTE> buffer(5 * kRunSize, 0xFF);
+        ULONGLONG ullBytesRead = 0LL;
+        Assert::AreEqual(S_OK, stream.Read(buffer.data(), buffer.size(), &ullBytesRead));
+        Assert::AreEqual<ULONGLONG>(0x800, ullBytesRead);
+        for (ULONGLONG i = 0; i < ullBytesRead; i++)
+            Assert::AreEqual(DiskByte(0x8000 + i), buffer[i]);
+
+        // the next read starts where the short one ended
+        m_ullReadableEnd = ULLONG_MAX;
+        m_reads.clear();
+        Assert::AreEqual(S_OK, stream.Read(buffer.data(), 0x10, &ullBytesRead));
+        Assert::AreEqual<ULONGLONG>(0x10, ullBytesRead);
+        Assert::AreEqual<size_t>(1, m_reads.size());
+        Assert::AreEqual<ULONGLONG>(0x8800, m_reads[0].ullOffset);
+    }
+};
+}  // namespace Orc::Test
@@ -0,0 +1,266 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "MemoryStream.h"
+#include "RegistryWalker.h"
+
+#include <optional>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+constexpr ULONG64 kLogEntrySeed = 0x82EF4D887A4E55C5ULL;
+
+constexpr size_t kBaseBlockSize = 0x1000;
+constexpr size_t kLogBaseBlockSize = 0x200;
+constexpr size_t kHiveBinsSize = 0x1000;
+
+constexpr DWORD kFileTypeLog = 1;
+constexpr DWORD kFileTypeLogEntries = 6;
+
+constexpr DWORD kHiveValue = 0x11111111;
+constexpr DWORD kLoggedValue = 0x22222222;
+
+template <typename T>
+void Put(std::vector<BYTE>& buffer, size_t offset, T value)
+{
+    CopyMemory(buffer.data() + offset, &value, sizeof(T));
+}
+
+void PutBytes(std::vector<BYTE>& buffer, size_t offset, std::string_view bytes)
+{
+    CopyMemory(buffer.data() + offset, bytes.data(), bytes.size());
+}
+
+// The first 512 bytes of the base block, as stored in the transaction logs
+std::vector<BYTE> MakeBaseBlock(DWORD dwPrimary, DWORD dwSecondary, DWORD dwFileType)
+{
+    std::vector<BYTE> baseBlock(kLogBaseBlockSize);
+    PutBytes(baseBlock, 0x00, "regf"sv);
+    Put<DWORD>(baseBlock, 0x04, dwPrimary);
+    Put<DWORD>(baseBlock, 0x08, dwSecondary);
+    Put<DWORD>(baseBlock, 0x14, 1);
+    Put<DWORD>(baseBlock, 0x18, 5);
+    Put<DWORD>(baseBlock, 0x1C, dwFileType);
+    Put<DWORD>(baseBlock, 0x20, 1);
+    Put<DWORD>(baseBlock, 0x24, 0x20);  // root key
+    Put<DWORD>(baseBlock, 0x28, kHiveBinsSize);
+    Put<DWORD>(baseBlock, 0x2C, 1);
+
+    DWORD dwCheckSum = 0L;
+    for (size_t i = 0; i < 0x1FC; i += sizeof(DWORD))
+        dwCheckSum ^= *reinterpret_cast<const DWORD*>(baseBlock.data() + i);
+    if (dwCheckSum == 0L || dwCheckSum == MAXDWORD)
+        dwCheckSum = dwCheckSum == 0L ? 1L : MAXDWORD - 1;
+    Put<DWORD>(baseBlock, 0x1FC, dwCheckSum);
+    return baseBlock;
+}
+
+// A single hbin with a root key holding a REG_DWORD 'Value' (its data is stored in the vk cell)
+std::vector<BYTE> MakeHiveBins(DWORD dwValue)
+{
+    std::vector<BYTE> bins(kHiveBinsSize);
+    PutBytes(bins, 0x00, "hbin"sv);
+    Put<DWORD>(bins, 0x08, kHiveBinsSize);
+
+    // nk
+    Put<LONG>(bins, 0x20, -0x60);
+    PutBytes(bins, 0x24, "nk"sv);
+    Put<WORD>(bins, 0x26, KeyType::rootkey);
+    Put<DWORD>(bins, 0x40, MAXDWORD);  // no subkeys
+    Put<DWORD>(bins, 0x48, 1);
+    Put<DWORD>(bins, 0x4C, 0x80);
+    Put<DWORD>(bins, 0x50, MAXDWORD);
+    Put<DWORD>(bins, 0x54, MAXDWORD);
+    Put<WORD>(bins, 0x6C, 4);
+    PutBytes(bins, 0x70, "ROOT"sv);
+
+    // value list
+    Put<LONG>(bins, 0x80, -0x10);
+    Put<DWORD>(bins, 0x84, 0x90);
+
+    // vk
+    Put<LONG>(bins, 0x90, -0x20);
+    PutBytes(bins, 0x94, "vk"sv);
+    Put<WORD>(bins, 0x96, 5);
+    Put<DWORD>(bins, 0x98, 0x80000000 | 4);  // resident data
+    Put<DWORD>(bins, 0x9C, dwValue);
+    Put<DWORD>(bins, 0xA0, ValueType::RegDWORD);
+    PutBytes(bins, 0xA8, "Value"sv);
+    return bins;
+}
+
+std::vector<BYTE> MakeHive(DWORD dwPrimary, DWORD dwSecondary, DWORD dwValue)
+{
+    auto hive = MakeBaseBlock(dwPrimary, dwSecondary, 0L);
+    hive.resize(kBaseBlockSize);
+
+    const auto bins = MakeHiveBins(dwValue);
+    hive.insert(std::end(hive), std::cbegin(bins), std::cend(bins));
+    return hive;
+}
+
+// A log with a single HvLE entry holding the whole hbin
+std::vector<BYTE> MakeEntryLog(DWORD dwSequence, DWORD dwValue)
+{
+    constexpr size_t kHeaderSize = 40;
+
+    std::vector<BYTE> entry(0x1200);
+    PutBytes(entry, 0x00, "HvLE"sv);
+    Put<DWORD>(entry, 0x04, static_cast<DWORD>(entry.size()));
+    Put<DWORD>(entry, 0x0C, dwSequence);
+    Put<DWORD>(entry, 0x10, kHiveBinsSize);
+    Put<DWORD>(entry, 0x14, 1);
+
+    // dirty page reference then the page
+    Put<DWORD>(entry, kHeaderSize, 0L);
+    Put<DWORD>(entry, kHeaderSize + 4, kHiveBinsSize);
+    const auto bins = MakeHiveBins(dwValue);
+    std::copy(std::cbegin(bins), std::cend(bins), std::begin(entry) + kHeaderSize + 8);
+
+    Put<ULONG64>(
+        entry, 0x18, RegistryHive::Marvin32(entry.data() + kHeaderSize, entry.size() - kHeaderSize, kLogEntrySeed));
+    Put<ULONG64>(entry, 0x20, RegistryHive::Marvin32(entry.data(), 0x20, kLogEntrySeed));
+
+    auto log = MakeBaseBlock(dwSequence, dwSequence, kFileTypeLogEntries);
+    log.insert(std::end(log), std::cbegin(entry), std::cend(entry));
+    return log;
+}
+
+// A log with a dirty vector: only the first sector of the hbin (where the vk cell is) is dirty
+std::vector<BYTE> MakeVectorLog(DWORD dwSequence, DWORD dwValue)
+{
+    auto log = MakeBaseBlock(dwSequence, dwSequence, kFileTypeLog);
+    log.resize(0x400);
+    PutBytes(log, kLogBaseBlockSize, "DIRT"sv);
+    Put<BYTE>(log, kLogBaseBlockSize + 4, 0x01);
+
+    const auto bins = MakeHiveBins(dwValue);
+    log.insert(std::end(log), std::cbegin(bins), std::cbegin(bins) + 0x200);
+    return log;
+}
+
+std::shared_ptr<ByteStream> OpenStream(std::vector<BYTE>& data)
+{
+    auto stream = std::make_shared<MemoryStream>();
+    Assert::IsTrue(SUCCEEDED(stream->OpenForReadOnly(data.data(), data.size())));
+    return stream;
+}
+
+std::optional<DWORD> ReadValue(RegistryHive& hive)
+{
+    std::optional<DWORD> value;
+    Assert::IsTrue(SUCCEEDED(hive.Walk(
+        [](const RegistryKey* const) {},
+        [&value](const RegistryValue* const pValue) {
+            const BYTE* pData = nullptr;
+            if (pValue->GetValueName() == "Value" && pValue->GetDatas(&pData) == sizeof(DWORD))
+                value = *reinterpret_cast<const DWORD*>(pData);
+        })));
+    return value;
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(RegistryHiveLogTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(Marvin32)
+    {
+        constexpr ULONG64 kSeed = 0x004FB61A001BDBCCULL;
+
+        const BYTE data1[] = {0xAF};
+        const BYTE data2[] = {0xE7, 0x0F};
+        const BYTE data4[] = {0x86, 0x42, 0xDC, 0x59};
+        const BYTE data7[] = {0xAB, 0x42, 0x7E, 0xA8, 0xD1, 0x0F, 0xC7};
+
+        Assert::AreEqual(0x48E73FC77D75DDC1ULL, RegistryHive::Marvin32(data1, sizeof(data1), kSeed));
+        Assert::AreEqual(0xB5F6E1FC485DBFF8ULL, RegistryHive::Marvin32(data2, sizeof(data2), kSeed));
+        Assert::AreEqual(0x7008F2E87E9CF556ULL, RegistryHive::Marvin32(data4, sizeof(data4), kSeed));
+        Assert::AreEqual(0xE11847E4F0678C41ULL, RegistryHive::Marvin32(data7, sizeof(data7), kSeed));
+    }
+
+    TEST_METHOD(ReplayLogEntries)
+    {
+        for (const auto mode : {RegistryHive::LoadMode::Copy, RegistryHive::LoadMode::Mapped})
+        {
+            auto data = MakeHive(2, 1, kHiveValue);
+            auto log = MakeEntryLog(1, kLoggedValue);
+
+            RegistryHive hive;
+            Assert::AreEqual(S_OK, hive.LoadHive(OpenStream(data), mode));
+            Assert::IsTrue(ReadValue(hive) == kHiveValue);
+
+            Assert::AreEqual(S_OK, hive.ReplayLogs({OpenStream(log)}));
+            Assert::IsTrue(ReadValue(hive) == kLoggedValue);
+        }
+
+        {
+            // the hive is already up to date with the log
+            auto data = MakeHive(2, 2, kHiveValue);
+            auto log = MakeEntryLog(1, kLoggedValue);
+
+            RegistryHive hive;
+            Assert::AreEqual(S_OK, hive.LoadHive(OpenStream(data), RegistryHive::LoadMode::Copy));
+            Assert::AreEqual(S_FALSE, hive.ReplayLogs({OpenStream(log)}));
+            Assert::IsTrue(ReadValue(hive) == kHiveValue);
+        }
+
+        {
+            // an entry whose hash does not match is ignored
+            auto data = MakeHive(2, 1, kHiveValue);
+            auto log = MakeEntryLog(1, kLoggedValue);
+            log.back() ^= 0xFF;
+
+            RegistryHive hive;
+            Assert::AreEqual(S_OK, hive.LoadHive(OpenStream(data), RegistryHive::LoadMode::Copy));
+            Assert::AreEqual(S_FALSE, hive.ReplayLogs({OpenStream(log)}));
+            Assert::IsTrue(ReadValue(hive) == kHiveValue);
+        }
+    }
+
+    TEST_METHOD(ReplayLogEntriesMissingSequence)
+    {
+        // the hive expects entry 1, the log starts at 3
+        auto data = MakeHive(2, 1, kHiveValue);
+        auto log = MakeEntryLog(3, kLoggedValue);
+
+        RegistryHive hive;
+        Assert::AreEqual(S_OK, hive.LoadHive(OpenStream(data), RegistryHive::LoadMode::Copy));
+        Assert::AreEqual(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), hive.ReplayLogs({OpenStream(log)}));
+        Assert::IsTrue(ReadValue(hive) == kHiveValue);
+    }
+
+    TEST_METHOD(ReplayDirtyVector)
+    {
+        for (const auto mode : {RegistryHive::LoadMode::Copy, RegistryHive::LoadMode::Mapped})
+        {
+            auto data = MakeHive(2, 1, kHiveValue);
+            auto log = MakeVectorLog(2, kLoggedValue);
+
+            RegistryHive hive;
+            Assert::AreEqual(S_OK, hive.LoadHive(OpenStream(data), mode));
+            Assert::AreEqual(S_OK, hive.ReplayLogs({OpenStream(log)}));
+            Assert::IsTrue(ReadValue(hive) == kLoggedValue);
+        }
+    }
+};
+}  // namespace Orc::Test
@@ -0,0 +1,110 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include <Sddl.h>
+
+#include "SecurityDescriptorCache.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+// Builds a $SDS entry as stored on disk: the entry header followed by the self-relative descriptor
+std::vector<BYTE> MakeEntry(ULONG ulSecurityId, ULONG ulHash, LPCWSTR szSDDL)
+{
+    PSECURITY_DESCRIPTOR pSD = nullptr;
+    ULONG ulLength = 0L;
+    Assert::IsTrue(
+        ConvertStringSecurityDescriptorToSecurityDescriptor(szSDDL, SDDL_REVISION_1, &pSD, &ulLength) != FALSE);
+
+    constexpr DWORD dwHeaderSize = sizeof(SECURITY_DESCRIPTOR_ENTRY) - sizeof(SECURITY_DESCRIPTOR_RELATIVE);
+
+    std::vector<BYTE> entry(std::max<size_t>(dwHeaderSize + ulLength, sizeof(SECURITY_DESCRIPTOR_ENTRY)), 0);
+    auto pEntry = reinterpret_cast<SECURITY_DESCRIPTOR_ENTRY*>(entry.data());
+    pEntry->Hash = ulHash;
+    pEntry->SecID = ulSecurityId;
+    pEntry->SizeEntry = dwHeaderSize + ulLength;
+    CopyMemory(&pEntry->SecurityDescriptor, pSD, ulLength);
+
+    LocalFree(pSD);
+    return entry;
+}
+
+const SECURITY_DESCRIPTOR_ENTRY& AsEntry(const std::vector<BYTE>& entry)
+{
+    return *reinterpret_cast<const SECURITY_DESCRIPTOR_ENTRY*>(entry.data());
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(SecurityDescriptorCacheTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(FindBySecurityId)
+    {
+        SecurityDescriptorCache cache;
+
+        const auto system = MakeEntry(0x100, 0x1234, L"O:SYG:SYD:(A;;FA;;;SY)");
+        const auto admins = MakeEntry(0x101, 0x5678, L"O:BAG:SYD:(A;;FA;;;BA)");
+        // same descriptor as 0x100, with another security id
+        const auto systemAgain = MakeEntry(0x102, 0x1234, L"O:SYG:SYD:(A;;FA;;;SY)");
+        // same hash as 0x100, with another descriptor
+        const auto collision = MakeEntry(0x103, 0x1234, L"O:BAG:BAD:(A;;FR;;;WD)");
+
+        Assert::AreEqual(S_OK, cache.Add(AsEntry(system)));
+        Assert::AreEqual(S_OK, cache.Add(AsEntry(admins)));
+        Assert::AreEqual(S_OK, cache.Add(AsEntry(systemAgain)));
+        Assert::AreEqual(S_OK, cache.Add(AsEntry(collision)));
+
+        // $SDS mirror
+        Assert::AreEqual(S_FALSE, cache.Add(AsEntry(system)));
+
+        Assert::AreEqual(size_t(4), cache.Count());
+        Assert::AreEqual(size_t(3), cache.DescriptorCount());
+
+        const auto pSystem = cache.Find(0x100);
+        Assert::IsNotNull(pSystem);
+        Assert::AreEqual(L"S-1-5-18", pSystem->OwnerSid.c_str());
+        Assert::IsTrue(pSystem->SDDL.find(L"O:SY") == 0);
+        Assert::IsFalse(pSystem->Owner.empty());
+
+        Assert::IsTrue(pSystem == cache.Find(0x102));
+        Assert::IsTrue(pSystem != cache.Find(0x103));
+
+        const auto pAdmins = cache.Find(0x101);
+        Assert::IsNotNull(pAdmins);
+        Assert::AreEqual(L"S-1-5-32-544", pAdmins->OwnerSid.c_str());
+        Assert::AreEqual(pAdmins->Owner, cache.Find(0x103)->Owner);
+
+        Assert::IsNull(cache.Find(0x200));
+    }
+
+    TEST_METHOD(InvalidEntry)
+    {
+        SecurityDescriptorCache cache;
+
+        auto entry = MakeEntry(0x100, 0x1234, L"O:SYG:SYD:(A;;FA;;;SY)");
+        reinterpret_cast<SECURITY_DESCRIPTOR_ENTRY*>(entry.data())->SizeEntry = 0x18;
+
+        Assert::IsTrue(FAILED(cache.Add(AsEntry(entry))));
+        Assert::IsNull(cache.Find(0x100));
+    }
+};
+}  // namespace Orc::Test
@@ -735,5 +735,43 @@ public:
         stream;
 
     }
+
+    TEST_METHOD(JSONLinesStructuredOutput)
+    {
+        auto stream = std::make_shared<MemoryStream>();
+        Assert::IsTrue(SUCCEEDED(stream->OpenForReadWrite()));
+
+        auto options = std::make_unique<StructuredOutput::JSON::Options>();
+        options->Encoding = OutputSpec::Encoding::UTF8;
+        options->bJsonLines = true;
+        options->bPrettyPrint = true;
+
+        auto writer = StructuredOutput::JSON::GetWriter(stream, std::move(options));
+
+        Assert::IsTrue(SUCCEEDED(writer->BeginCollection(L"items")));
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            Assert::IsTrue(SUCCEEDED(writer->BeginElement(L"item")));
+            Assert::IsTrue(SUCCEEDED(writer->WriteNamed(L"index", i)));
+            Assert::IsTrue(SUCCEEDED(writer->WriteNamed(L"path", L"c:\\windows\\system32")));
+            Assert::IsTrue(SUCCEEDED(writer->WriteNamed(L"name", L"say \"hi\"")));
+            Assert::IsTrue(SUCCEEDED(writer->EndElement(L"item")));
+        }
+        Assert::IsTrue(SUCCEEDED(writer->EndCollection(L"items")));
+        Assert::IsTrue(SUCCEEDED(writer->WriteNamed(L"count", 3U)));
+        Assert::IsTrue(SUCCEEDED(writer->Close()));
+
+        const auto expected =
+            "{\"index\":0,\"path\":\"c:\\\\windows\\\\system32\",\"name\":\"say \\\"hi\\\"\"}\n"
+            "{\"index\":1,\"path\":\"c:\\\\windows\\\\system32\",\"name\":\"say \\\"hi\\\"\"}\n"
+            "{\"index\":2,\"path\":\"c:\\\\windows\\\\system32\",\"name\":\"say \\\"hi\\\"\"}\n"
+            "{\"count\":3}\n"sv;
+
+        const auto result = stream->GetConstBuffer();
+        Assert::AreEqual(
+            std::string(expected),
+            std::string(reinterpret_cast<const char*>(result.GetData()), result.GetCount()),
+            L"JSON Lines output differ from expected result");
+    }
 };
 }  // namespace Orc::Test
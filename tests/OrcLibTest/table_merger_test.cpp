@@ -0,0 +1,162 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "OutputSpec.h"
+#include "TableMerger.h"
+
+#include <filesystem>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+std::filesystem::path GetTempDirectory(const std::wstring& name)
+{
+    std::error_code ec;
+    auto path = std::filesystem::temp_directory_path(ec) / name;
+    std::filesystem::remove_all(path, ec);
+    std::filesystem::create_directories(path, ec);
+    Assert::IsFalse((bool)ec);
+    return path;
+}
+
+std::vector<std::wstring> ReadColumn(const std::filesystem::path& path, const std::wstring& strColumn)
+{
+    TableOutput::CSV::MappedFileReader reader;
+    Assert::IsTrue(SUCCEEDED(reader.OpenFile(path.c_str())));
+
+    const auto& headers = reader.GetHeaders();
+    const auto it = std::find(std::cbegin(headers), std::cend(headers), strColumn);
+    Assert::IsTrue(it != std::cend(headers));
+    const auto index = std::distance(std::cbegin(headers), it);
+
+    std::vector<std::wstring> values;
+    Assert::IsTrue(SUCCEEDED(reader.Parse([&](const auto& record) {
+        std::wstring value;
+        Assert::IsTrue(SUCCEEDED(record.GetString(index, value)));
+        values.push_back(value);
+        return S_OK;
+    })));
+    return values;
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(TableMergerTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(MergeAndSort)
+    {
+        const auto directory = GetTempDirectory(L"table_merger");
+
+        helper.WriteFile(
+            directory / L"NTFSInfo_C.csv",
+            "FRN,Name,LastModificationDate\r\n"
+            "0x0010,\"b, quoted\",2021-01-02 00:00:00.000\r\n"
+            "0x0002,a,2021-01-01 00:00:00.000\r\n"sv);
+        helper.WriteFile(
+            directory / L"NTFSInfo_D.csv",
+            "Name,FRN,Volume\r\n"
+            "c,0x0005,D\r\n"
+            "d,0x0002,D\r\n"sv);
+
+        TableOutput::Merger::Options options;
+        options.SortColumn = L"FRN";
+        options.PartitionColumn = L"Volume";
+        options.DirectoryFormat = OutputSpec::Kind::CSV;
+
+        TableOutput::Merger merger(options);
+        Assert::IsTrue(SUCCEEDED(merger.AddInput(directory / L"NTFSInfo_C.csv")));
+        Assert::IsTrue(SUCCEEDED(merger.AddInput(directory / L"NTFSInfo_D.csv")));
+        Assert::IsTrue(SUCCEEDED(merger.Load()));
+
+        const auto& schema = merger.GetSchema();
+        Assert::AreEqual((size_t)4, schema.size());
+        Assert::AreEqual(L"FRN", schema[0].ColumnName.c_str());
+        Assert::IsTrue(schema[0].Type == TableOutput::UInt64Type);
+        Assert::IsTrue(schema[1].Type == TableOutput::UTF8Type);
+        Assert::IsTrue(schema[2].Type == TableOutput::TimeStampType);
+        Assert::AreEqual(L"Volume", schema[3].ColumnName.c_str());
+        Assert::AreEqual(4ULL, merger.GetRowCount());
+
+        OutputSpec file;
+        Assert::IsTrue(SUCCEEDED(file.Configure(OutputSpec::Kind::TableFile, directory / L"merged.csv")));
+        Assert::IsTrue(SUCCEEDED(merger.Write(file)));
+
+        // Equal FRNs keep the input order
+        const auto names = ReadColumn(directory / L"merged.csv", L"Name");
+        Assert::AreEqual((size_t)4, names.size());
+        Assert::AreEqual(L"a", names[0].c_str());
+        Assert::AreEqual(L"d", names[1].c_str());
+        Assert::AreEqual(L"c", names[2].c_str());
+        Assert::AreEqual(L"b, quoted", names[3].c_str());
+
+        const auto partitions = GetTempDirectory(L"table_merger_partitions");
+        OutputSpec dataset;
+        Assert::IsTrue(SUCCEEDED(dataset.Configure(OutputSpec::Kind::Directory, partitions)));
+        Assert::IsTrue(SUCCEEDED(merger.Write(dataset)));
+
+        Assert::AreEqual((size_t)2, ReadColumn(partitions / L"D.csv", L"Name").size());
+        Assert::AreEqual((size_t)2, ReadColumn(partitions / L"null.csv", L"Name").size());
+
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+        std::filesystem::remove_all(partitions, ec);
+    }
+
+    TEST_METHOD(PartitionValuesDifferingInCase)
+    {
+        const auto directory = GetTempDirectory(L"table_merger_case");
+        helper.WriteFile(
+            directory / L"Users.csv",
+            "Name,User\r\n"
+            "a,Admin\r\n"
+            "b,admin\r\n"
+            "c,Admin\r\n"sv);
+
+        TableOutput::Merger::Options options;
+        options.PartitionColumn = L"User";
+        options.DirectoryFormat = OutputSpec::Kind::CSV;
+
+        TableOutput::Merger merger(options);
+        Assert::IsTrue(SUCCEEDED(merger.AddInput(directory / L"Users.csv")));
+        Assert::IsTrue(SUCCEEDED(merger.Load()));
+
+        const auto partitions = GetTempDirectory(L"table_merger_case_partitions");
+        OutputSpec dataset;
+        Assert::IsTrue(SUCCEEDED(dataset.Configure(OutputSpec::Kind::Directory, partitions)));
+        Assert::IsTrue(SUCCEEDED(merger.Write(dataset)));
+
+        // File names are not case sensitive: each value gets its own file
+        const auto admins = ReadColumn(partitions / L"Admin.csv", L"Name");
+        Assert::AreEqual((size_t)2, admins.size());
+        Assert::AreEqual(L"a", admins[0].c_str());
+        Assert::AreEqual(L"c", admins[1].c_str());
+
+        const auto others = ReadColumn(partitions / L"admin_1.csv", L"Name");
+        Assert::AreEqual((size_t)1, others.size());
+        Assert::AreEqual(L"b", others[0].c_str());
+
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+        std::filesystem::remove_all(partitions, ec);
+    }
+};
+}  // namespace Orc::Test
@@ -0,0 +1,171 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "MemoryStream.h"
+#include "NTFSCompression.h"
+#include "UncompressNTFSStream.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+constexpr DWORD kCompressionUnit = 0x10000;
+
+using RtlGetCompressionWorkSpaceSizeFn = NTSTATUS(WINAPI*)(USHORT, PULONG, PULONG);
+using RtlCompressBufferFn = NTSTATUS(WINAPI*)(USHORT, PUCHAR, ULONG, PUCHAR, ULONG, ULONG, PULONG, PVOID);
+
+std::vector<BYTE> MakeLogLikeData(size_t size)
+{
+    std::vector<BYTE> data;
+    data.reserve(size);
+
+    DWORD dwSeed = 0x2021;
+    while (data.size() < size)
+    {
+        dwSeed = dwSeed * 1103515245 + 12345;
+        const auto line = fmt::format(
+            "2021-06-{:02} 12:{:02}:{:02} [INFO] Process {} opened C:\\Windows\\System32\\{:08x}.dll\r\n",
+            dwSeed % 28 + 1,
+            (dwSeed >> 8) % 60,
+            (dwSeed >> 16) % 60,
+            dwSeed % 4096,
+            dwSeed);
+        data.insert(std::end(data), std::cbegin(line), std::cend(line));
+    }
+
+    data.resize(size);
+    return data;
+}
+
+// Compresses each compression unit as NTFS does: LZNT1 data followed by (sparse) zeroes up to the unit size
+std::vector<BYTE> CompressUnits(const std::vector<BYTE>& data)
+{
+    const auto hNtdll = GetModuleHandleW(L"ntdll.dll");
+    Assert::IsNotNull(hNtdll);
+
+    const auto pGetWorkSpaceSize = reinterpret_cast<RtlGetCompressionWorkSpaceSizeFn>(
+        GetProcAddress(hNtdll, "RtlGetCompressionWorkSpaceSize"));
+    const auto pCompressBuffer = reinterpret_cast<RtlCompressBufferFn>(GetProcAddress(hNtdll, "RtlCompressBuffer"));
+    Assert::IsTrue(pGetWorkSpaceSize != nullptr && pCompressBuffer != nullptr);
+
+    ULONG ulWorkSpaceSize = 0, ulFragmentWorkSpaceSize = 0;
+    Assert::IsTrue(pGetWorkSpaceSize(COMPRESSION_FORMAT_LZNT1, &ulWorkSpaceSize, &ulFragmentWorkSpaceSize) >= 0);
+    std::vector<BYTE> workSpace(ulWorkSpaceSize);
+
+    std::vector<BYTE> compressed(data.size(), 0);
+    for (size_t offset = 0; offset < data.size(); offset += kCompressionUnit)
+    {
+        const auto cbUnit = static_cast<ULONG>(std::min<size_t>(kCompressionUnit, data.size() - offset));
+        ULONG ulCompressed = 0;
+        Assert::IsTrue(
+            pCompressBuffer(
+                COMPRESSION_FORMAT_LZNT1,
+                const_cast<PUCHAR>(data.data() + offset),
+                cbUnit,
+                compressed.data() + offset,
+                cbUnit,
+                4096,
+                &ulCompressed,
+                workSpace.data())
+            >= 0);
+    }
+
+    return compressed;
+}
+
+std::shared_ptr<UncompressNTFSStream> OpenStream(std::vector<BYTE>& compressed)
+{
+    auto memStream = std::make_shared<MemoryStream>();
+    Assert::IsTrue(SUCCEEDED(memStream->OpenForReadOnly(compressed.data(), compressed.size())));
+
+    const std::shared_ptr<ByteStream> chained = memStream;
+    auto stream = std::make_shared<UncompressNTFSStream>();
+    Assert::IsTrue(SUCCEEDED(stream->Open(chained, kCompressionUnit)));
+    return stream;
+}
+
+std::vector<BYTE> ReadAll(UncompressNTFSStream& stream, size_t cbChunk)
+{
+    std::vector<BYTE> result(static_cast<size_t>(stream.GetSize()));
+
+    size_t offset = 0;
+    while (offset < result.size())
+    {
+        ULONGLONG ullRead = 0LL;
+        const auto cbToRead = std::min(cbChunk, result.size() - offset);
+        Assert::IsTrue(SUCCEEDED(stream.Read(result.data() + offset, cbToRead, &ullRead)));
+        Assert::IsTrue(ullRead > 0);
+        offset += static_cast<size_t>(ullRead);
+    }
+
+    return result;
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(UncompressNTFSStreamTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(ReadCompressedUnits)
+    {
+        // the last compression unit is truncated
+        const auto data = MakeLogLikeData(40 * kCompressionUnit + 1234);
+        auto compressed = CompressUnits(data);
+
+        {
+            auto stream = OpenStream(compressed);
+            Assert::IsTrue(data == ReadAll(*stream, data.size()));
+        }
+
+        {
+            auto stream = OpenStream(compressed);
+            Assert::IsTrue(data == ReadAll(*stream, 3000));
+        }
+
+        {
+            auto stream = OpenStream(compressed);
+            const ULONGLONG ullOffset = 7 * kCompressionUnit + 100;
+            Assert::IsTrue(SUCCEEDED(stream->SetFilePointer(ullOffset, FILE_BEGIN, nullptr)));
+
+            std::vector<BYTE> buffer(2 * kCompressionUnit);
+            ULONGLONG ullRead = 0LL;
+            Assert::IsTrue(SUCCEEDED(stream->Read(buffer.data(), buffer.size(), &ullRead)));
+            Assert::AreEqual(static_cast<ULONGLONG>(buffer.size()), ullRead);
+            Assert::IsTrue(std::equal(std::cbegin(buffer), std::cend(buffer), std::cbegin(data) + ullOffset));
+        }
+    }
+
+    TEST_METHOD(DecompressUnit)
+    {
+        const auto data = MakeLogLikeData(kCompressionUnit);
+        auto compressed = CompressUnits(data);
+
+        std::vector<BYTE> uncompressed(kCompressionUnit, 0xFF);
+        Assert::IsTrue(SUCCEEDED(
+            lznt1_decompress_unit(uncompressed.data(), uncompressed.size(), compressed.data(), compressed.size())));
+        Assert::IsTrue(data == uncompressed);
+
+        // The first token cannot be a back reference
+        compressed[2] |= 0x01;
+        Assert::IsTrue(FAILED(
+            lznt1_decompress_unit(uncompressed.data(), uncompressed.size(), compressed.data(), compressed.size())));
+    }
+};
+}  // namespace Orc::Test
@@ -0,0 +1,103 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#include "stdafx.h"
+
+#include "Unicode.h"
+
+using namespace std;
+
+using namespace std::string_literals;
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+bool IsXmlChar(WCHAR x)
+{
+    return x == 0x09 || x == 0x0A || x == 0x0D || (x >= 0x20 && x <= 0xD7FF) || (x >= 0xE000 && x <= 0xFFFD);
+}
+
+// Unit by unit reference of IsUnicodeValidTable::FindFirstInvalid
+size_t FindFirstInvalidReference(const IsUnicodeValidTable& table, const std::wstring& str)
+{
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+        if (!table.IsValid(str[i]))
+            return i;
+    }
+    return str.size();
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(Unicode)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(XmlCharTables)
+    {
+        for (ULONG x = 0; x <= 0xFFFF; ++x)
+        {
+            const auto wCode = static_cast<WCHAR>(x);
+            Assert::AreEqual(IsXmlChar(wCode), IsUnicodeValid(xml_string_table, wCode));
+            Assert::AreEqual(IsXmlChar(wCode), IsUnicodeValid(xml_attr_value_table, wCode));
+            Assert::AreEqual(IsXmlChar(wCode), IsUnicodeValid(xml_comment_table, wCode));
+        }
+
+        Assert::IsTrue(IsUnicodeStringValid(xml_element_table, L"Element_Name-1.0"s));
+        Assert::IsFalse(IsUnicodeStringValid(xml_element_table, L"ns:element"s));
+        Assert::IsFalse(IsUnicodeStringValid(xml_element_table, L"element name"s));
+    }
+
+    TEST_METHOD(FindFirstInvalid)
+    {
+        // Move each kind of invalid unit across the 16 units blocks and the scalar tail
+        const std::wstring valid = L"C:\\Windows\\System32\\drivers\\etc\\hosts.\u00E9t\u00E9";
+
+        for (const auto invalid : {L'\x0001', L'\xD800', L'\xDFFF', L'\xFFFE', L'\xFFFF'})
+        {
+            for (size_t pos = 0; pos <= valid.size(); ++pos)
+            {
+                auto str = valid;
+                str.insert(pos, 1, invalid);
+
+                for (const auto table : {&xml_string_table, &xml_attr_value_table, &xml_element_table})
+                {
+                    Assert::AreEqual(
+                        FindFirstInvalidReference(*table, str), table->FindFirstInvalid(str.c_str(), str.size()));
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(Sanitize)
+    {
+        std::wstring result;
+
+        Assert::IsTrue(SUCCEEDED(SanitizeString(xml_string_table, L"plain string value"s, result)));
+        Assert::AreEqual(L"plain string value", result.c_str());
+
+        Assert::IsTrue(
+            SUCCEEDED(SanitizeString(xml_string_table, L"a\x0001long enough string to\xFFFEuse blocks"s, result)));
+        Assert::AreEqual(L"a#x0001;long enough string to#xFFFE;use blocks", result.c_str());
+
+        Assert::IsTrue(SUCCEEDED(ReplaceInvalidChars(xml_element_table, L"ns:element name"s, result)));
+        Assert::AreEqual(L"ns_element_name", result.c_str());
+    }
+};
+}  // namespace Orc::Test
@@ -31,11 +31,10 @@ private:
     UnitTestHelper helper;
 
 public:
-    TEST_METHOD_INITIALIZE(Initialize)
-    {
-    }
+    TEST_METHOD_INITIALIZE(Initialize) { m_dwBufferSize = USNJournalWalkerOffline::GetBufferSize(); }
 
-    TEST_METHOD_CLEANUP(Finalize) {}
+    // Tests change the (static) buffer size, the next ones run with the default
+    TEST_METHOD_CLEANUP(Finalize) { USNJournalWalkerOffline::SetBufferSize(m_dwBufferSize); }
 
     TEST_METHOD(USNJournalWalkerOfflineBasicTest)
     {
@@ -188,13 +187,34 @@ public:
         }
     }
 
+    TEST_METHOD(USNJournalWalkerOfflineParallelTest)
+    {
+        // Names and order of the records do not depend on the mode
+        const auto archive = helper.GetDirectoryName(__WFILE__) + L"\\usn_journal\\win7.7z";
+        USNJournalWalkerOffline::SetBufferSize(0x10000);
+
+        m_NbRecords = 0;
+        m_Names.clear();
+        ProcessArchive(archive, false);
+        const auto names = std::move(m_Names);
+
+        m_NbRecords = 0;
+        m_Names.clear();
+        ProcessArchive(archive, true);
+
+        Assert::IsTrue(m_NbRecords == 0x947E);
+        Assert::IsTrue(names == m_Names);
+    }
+
 private:
+    DWORD m_dwBufferSize = 0L;
     DWORD64 m_NbRecords;
+    std::vector<std::wstring> m_Names;
     typedef std::map<int, OrcArchive::ArchiveItem> ITEMS;
     typedef std::map<int, std::wstring> ITEM_PATHS;
     ITEMS m_Items;
 
-    void ProcessArchive(const std::wstring& archive)
+    void ProcessArchive(const std::wstring& archive, bool bParallel = false)
     {
         // first extract archive
         LPCWSTR archiveStr = archive.c_str();
@@ -228,6 +248,7 @@ private:
 
             // initialize walker that will parse MFT
             USNJournalWalkerOffline walker;
+            walker.SetParallel(bParallel);
 
             Assert::AreEqual(walker.Initialize(loc), S_OK);
             loc.reset();
@@ -249,6 +270,7 @@ private:
             callbacks.RecordCallback =
                 [this](const std::shared_ptr<VolumeReader>& volreader, WCHAR* szFullName, USN_RECORD* pElt) {
                     ++m_NbRecords;
+                    m_Names.emplace_back(szFullName);
                 };
 
             Assert::AreEqual(walker.ReadJournal(callbacks), S_OK);
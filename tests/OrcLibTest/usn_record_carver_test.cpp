@@ -0,0 +1,172 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "USNRecordCarver.h"
+#include "USNJournalWalkerBase.h"
+#include "MemoryStream.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+// 2021-01-01
+constexpr LONGLONG kTimeStamp = 132539328000000000LL;
+
+void FillJunk(std::vector<BYTE>& data)
+{
+    DWORD dwSeed = 0x12345678;
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        dwSeed = dwSeed * 1103515245 + 12345;
+        // Zeroed areas as in unallocated clusters
+        data[i] = (i / 0x800) % 3 == 0 ? 0 : static_cast<BYTE>(dwSeed >> 16);
+    }
+}
+
+DWORD WriteRecordV2(std::vector<BYTE>& data, size_t offset, std::wstring_view name, LONGLONG timeStamp = kTimeStamp)
+{
+    using Record = USNJournalWalkerBase::USN_RECORD_V2;
+
+    const auto cbName = static_cast<WORD>(name.size() * sizeof(WCHAR));
+    const auto dwLength = (FIELD_OFFSET(Record, FileName) + cbName + 7) & ~7UL;
+    ZeroMemory(data.data() + offset, dwLength);
+
+    auto pRecord = reinterpret_cast<Record*>(data.data() + offset);
+    pRecord->RecordLength = dwLength;
+    pRecord->MajorVersion = 2;
+    pRecord->FileReferenceNumber = 0x0001000000000100;
+    pRecord->ParentFileReferenceNumber = 0x0005000000000005;
+    pRecord->Usn = 0x1000;
+    pRecord->TimeStamp.QuadPart = timeStamp;
+    pRecord->Reason = USN_REASON_FILE_CREATE | USN_REASON_CLOSE;
+    pRecord->FileNameLength = cbName;
+    pRecord->FileNameOffset = FIELD_OFFSET(Record, FileName);
+    CopyMemory(pRecord->FileName, name.data(), cbName);
+    return dwLength;
+}
+
+DWORD WriteRecordV3(std::vector<BYTE>& data, size_t offset, std::wstring_view name)
+{
+    using Record = USNJournalWalkerBase::USN_RECORD_V3;
+
+    const auto cbName = static_cast<WORD>(name.size() * sizeof(WCHAR));
+    const auto dwLength = (FIELD_OFFSET(Record, FileName) + cbName + 7) & ~7UL;
+    ZeroMemory(data.data() + offset, dwLength);
+
+    auto pRecord = reinterpret_cast<Record*>(data.data() + offset);
+    pRecord->RecordLength = dwLength;
+    pRecord->MajorVersion = 3;
+    pRecord->FileReferenceNumber[0] = 0x42;
+    pRecord->ParentFileReferenceNumber[0] = 0x05;
+    pRecord->Usn = 0x2000;
+    pRecord->TimeStamp.QuadPart = kTimeStamp;
+    pRecord->Reason = USN_REASON_DATA_EXTEND;
+    pRecord->FileNameLength = cbName;
+    pRecord->FileNameOffset = FIELD_OFFSET(Record, FileName);
+    CopyMemory(pRecord->FileName, name.data(), cbName);
+    return dwLength;
+}
+
+DWORD WriteRecordV4(std::vector<BYTE>& data, size_t offset)
+{
+    using Record = USNRecordCarver::USN_RECORD_V4;
+
+    const auto dwLength = static_cast<DWORD>(FIELD_OFFSET(Record, Extents) + 2 * sizeof(Record::Extents[0]));
+    ZeroMemory(data.data() + offset, dwLength);
+
+    auto pRecord = reinterpret_cast<Record*>(data.data() + offset);
+    pRecord->RecordLength = dwLength;
+    pRecord->MajorVersion = 4;
+    pRecord->Usn = 0x3000;
+    pRecord->Reason = USN_REASON_DATA_OVERWRITE;
+    pRecord->NumberOfExtents = 2;
+    pRecord->ExtentSize = sizeof(Record::Extents[0]);
+    pRecord->Extents[0] = {0, 0x1000};
+    pRecord->Extents[1] = {0x4000, 0x2000};
+    return dwLength;
+}
+
+std::vector<std::pair<ULONG64, WORD>>
+Carve(std::vector<BYTE>& data, const std::vector<std::pair<ULONG64, ULONG64>>& ranges = {})
+{
+    MemoryStream stream;
+    Assert::IsTrue(SUCCEEDED(stream.OpenForReadOnly(data.data(), data.size())));
+
+    std::vector<std::pair<ULONG64, WORD>> found;
+    Assert::IsTrue(SUCCEEDED(USNRecordCarver::Carve(stream, ranges, [&found](ULONG64 ullOffset, const BYTE* pRecord) {
+        found.emplace_back(ullOffset, reinterpret_cast<const USN_RECORD*>(pRecord)->MajorVersion);
+    })));
+    return found;
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(USNRecordCarverTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(CarveRecords)
+    {
+        std::vector<BYTE> data(0x180000);
+        FillJunk(data);
+
+        const size_t first = 0x1000;
+        const size_t second = first + WriteRecordV2(data, first, L"file.txt"sv);
+        WriteRecordV3(data, second, L"other.dat"sv);
+
+        // Not plausible: time stamp before 2000
+        WriteRecordV2(data, 0x2000, L"old.txt"sv, 100000000000000000LL);
+
+        // Cut by the end of the first scan slice
+        const size_t third = 0x100000 - 0x10;
+        WriteRecordV2(data, third, L"across.bin"sv);
+
+        const size_t fourth = 0x150000;
+        WriteRecordV4(data, fourth);
+
+        // Records are 8 bytes aligned
+        WriteRecordV2(data, 0x160004, L"unaligned.txt"sv);
+
+        const std::vector<std::pair<ULONG64, WORD>> expected = {
+            {first, 2}, {second, 3}, {third, 2}, {fourth, 4}};
+        Assert::IsTrue(Carve(data) == expected);
+
+        // Only the records starting in the ranges
+        const std::vector<std::pair<ULONG64, WORD>> expectedInRange = {{second, 3}, {fourth, 4}};
+        Assert::IsTrue(Carve(data, {{second, 0x100}, {0x140000, 0x20000}}) == expectedInRange);
+    }
+
+    TEST_METHOD(RecordLength)
+    {
+        std::vector<BYTE> data(0x200);
+        const auto dwLength = WriteRecordV2(data, 0, L"name"sv);
+
+        Assert::AreEqual(dwLength, USNRecordCarver::GetRecordLength(data.data(), data.size()));
+        Assert::AreEqual(0UL, USNRecordCarver::GetRecordLength(data.data(), dwLength - 8));
+
+        auto pRecord = reinterpret_cast<USN_RECORD*>(data.data());
+        pRecord->FileName[1] = L'\\';
+        Assert::AreEqual(0UL, USNRecordCarver::GetRecordLength(data.data(), data.size()));
+
+        pRecord->FileName[1] = L'a';
+        pRecord->Reason = 0;
+        Assert::AreEqual(0UL, USNRecordCarver::GetRecordLength(data.data(), data.size()));
+    }
+};
+}  // namespace Orc::Test
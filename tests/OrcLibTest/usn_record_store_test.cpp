@@ -0,0 +1,105 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "USNRecordStore.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+std::vector<BYTE> MakeRecord(DWORDLONG dwlFrn, DWORDLONG dwlParentFrn, std::wstring_view name)
+{
+    const auto cbName = static_cast<DWORD>(name.size() * sizeof(WCHAR));
+
+    std::vector<BYTE> buffer(FIELD_OFFSET(USN_RECORD, FileName) + cbName);
+    auto pRecord = reinterpret_cast<USN_RECORD*>(buffer.data());
+    pRecord->RecordLength = static_cast<DWORD>(buffer.size());
+    pRecord->MajorVersion = 2;
+    pRecord->FileReferenceNumber = dwlFrn;
+    pRecord->ParentFileReferenceNumber = dwlParentFrn;
+    pRecord->FileNameLength = static_cast<WORD>(cbName);
+    pRecord->FileNameOffset = FIELD_OFFSET(USN_RECORD, FileName);
+    CopyMemory(pRecord->FileName, name.data(), cbName);
+    return buffer;
+}
+
+HRESULT Insert(USNRecordStore& store, DWORDLONG dwlFrn, DWORDLONG dwlParentFrn, std::wstring_view name)
+{
+    const auto buffer = MakeRecord(dwlFrn, dwlParentFrn, name);
+    return store.Insert(reinterpret_cast<const USN_RECORD*>(buffer.data()));
+}
+
+std::wstring_view Name(const USN_RECORD* pRecord)
+{
+    return std::wstring_view(pRecord->FileName, pRecord->FileNameLength / sizeof(WCHAR));
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(USNRecordStoreTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(FindAndErase)
+    {
+        USNRecordStore store;
+
+        Assert::IsTrue(S_OK == Insert(store, 0x0002000000000030ULL, 0x0005000000000005ULL, L"Windows"sv));
+        Assert::IsTrue(S_OK == Insert(store, 0x0001000000000010ULL, 0x0002000000000030ULL, L"System32"sv));
+        Assert::IsTrue(S_OK == Insert(store, 0x0003000000000010ULL, 0x0002000000000030ULL, L"Temp"sv));
+        Assert::IsTrue(S_OK == Insert(store, 0x0002000000000030ULL, 0x0005000000000005ULL, L"Duplicate"sv));
+        store.Sort();
+
+        Assert::AreEqual((size_t)3, store.Size());
+        Assert::IsTrue(Name(store.Find(0x0002000000000030ULL)) == L"Windows"sv);
+        Assert::IsTrue(Name(store.Find(0x0001000000000010ULL)) == L"System32"sv);
+        Assert::IsNull(store.Find(0x0002000000000010ULL));
+
+        // Lookup by segment returns the highest sequence
+        Assert::IsTrue(Name(store.FindSegment(0x10)) == L"Temp"sv);
+        Assert::IsNull(store.FindSegment(0x20));
+
+        std::vector<std::wstring> names;
+        store.ForEach([&store, &names](USN_RECORD* pRecord) {
+            names.emplace_back(Name(pRecord));
+            store.Erase(pRecord->FileReferenceNumber);
+        });
+
+        const std::vector<std::wstring> expected = {L"System32", L"Temp", L"Windows"};
+        Assert::IsTrue(names == expected);
+        Assert::AreEqual((size_t)0, store.Size());
+        Assert::IsNull(store.Find(0x0002000000000030ULL));
+    }
+
+    TEST_METHOD(ManyRecords)
+    {
+        USNRecordStore store;
+
+        // Spans several blocks
+        constexpr DWORDLONG count = 0x10000;
+        for (DWORDLONG i = count; i > 0; i--)
+            Assert::IsTrue(S_OK == Insert(store, i, 5, std::to_wstring(i)));
+        store.Sort();
+
+        Assert::AreEqual((size_t)count, store.Size());
+        for (DWORDLONG i = 1; i <= count; i++)
+            Assert::IsTrue(Name(store.Find(i)) == std::to_wstring(i));
+    }
+};
+}  // namespace Orc::Test
@@ -58,6 +58,15 @@ public:
             Assert::IsTrue(SUCCEEDED(hr));
             Assert::AreEqual(result.get(), L"Testing string");
         }
+        {
+            // a single character is not dropped
+            std::wstring result;
+            Assert::IsTrue(SUCCEEDED(Orc::AnsiToWide(std::string_view("D"), result)));
+            Assert::AreEqual(result.c_str(), L"D");
+
+            Assert::IsTrue(SUCCEEDED(Orc::AnsiToWide("a"s, result)));
+            Assert::AreEqual(result.c_str(), L"a");
+        }
     }
 };
 }  // namespace Orc::Test
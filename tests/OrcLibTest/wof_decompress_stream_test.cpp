@@ -0,0 +1,546 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2021 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "MemoryStream.h"
+#include "CompressAPIExtension.h"
+#include "WofDecompressStream.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std::string_view_literals;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace {
+
+std::vector<BYTE> MakeData(size_t size)
+{
+    std::vector<BYTE> data;
+    data.reserve(size);
+
+    DWORD dwSeed = 0x2021;
+    while (data.size() < size)
+    {
+        dwSeed = dwSeed * 1103515245 + 12345;
+
+        // Some chunks do not compress and are stored
+        if ((data.size() / 0x3000) % 5 == 4)
+        {
+            data.push_back(static_cast<BYTE>(dwSeed >> 16));
+            continue;
+        }
+
+        const auto line = fmt::format("{:08x} MZ.PE.text.rdata.data.reloc {}\r\n", dwSeed, dwSeed % 4096);
+        data.insert(std::end(data), std::cbegin(line), std::cend(line));
+    }
+
+    data.resize(size);
+    return data;
+}
+
+// Compresses as compact.exe does: the chunk end offsets, followed by the XPRESS Huffman chunks
+std::vector<BYTE> CompressChunks(const std::vector<BYTE>& data, DWORD dwChunkSize)
+{
+    const auto pCompressAPI = ExtensionLibrary::GetLibrary<CompressAPIExtension>();
+    Assert::IsTrue(pCompressAPI != nullptr);
+
+    COMPRESSOR_HANDLE hCompressor = nullptr;
+    Assert::IsTrue(SUCCEEDED(
+        pCompressAPI->CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW, nullptr, &hCompressor)));
+
+    const size_t cChunks = (data.size() + dwChunkSize - 1) / dwChunkSize;
+    std::vector<DWORD> table;
+    std::vector<BYTE> chunks;
+    std::vector<BYTE> buffer(dwChunkSize);
+
+    for (size_t i = 0; i < cChunks; i++)
+    {
+        const auto pChunk = data.data() + i * dwChunkSize;
+        const auto cbChunk = std::min<size_t>(dwChunkSize, data.size() - i * dwChunkSize);
+
+        SIZE_T cbCompressed = 0;
+        if (SUCCEEDED(pCompressAPI->Compress(hCompressor, pChunk, cbChunk, buffer.data(), cbChunk - 1, &cbCompressed)))
+            chunks.insert(std::end(chunks), std::cbegin(buffer), std::cbegin(buffer) + cbCompressed);
+        else
+            chunks.insert(std::end(chunks), pChunk, pChunk + cbChunk);
+
+        if (i + 1 < cChunks)
+            table.push_back(static_cast<DWORD>(chunks.size()));
+    }
+
+    pCompressAPI->CloseCompressor(hCompressor);
+
+    std::vector<BYTE> compressed(table.size() * sizeof(DWORD));
+    CopyMemory(compressed.data(), table.data(), compressed.size());
+    compressed.insert(std::end(compressed), std::cbegin(chunks), std::cend(chunks));
+    return compressed;
+}
+
+constexpr DWORD kLzxChunkSize = 0x8000;
+
+constexpr unsigned kLzxBlockVerbatim = 1;
+constexpr unsigned kLzxBlockAligned = 2;
+constexpr unsigned kLzxBlockUncompressed = 3;
+
+class LzxBitWriter
+{
+public:
+    // 16 bits little endian words, filled from their most significant bit
+    void Write(DWORD dwValue, unsigned bits)
+    {
+        for (unsigned i = bits; i > 0; i--)
+        {
+            m_word = static_cast<WORD>((m_word << 1) | ((dwValue >> (i - 1)) & 1));
+            if (++m_bits == 16)
+                Flush();
+        }
+    }
+
+    // Uncompressed blocks start on the next word, a whole one is skipped when already aligned
+    void Align() { Write(0, 16 - m_bits); }
+
+    void WriteBytes(const BYTE* pData, size_t cbData) { m_data.insert(std::end(m_data), pData, pData + cbData); }
+
+    std::vector<BYTE> Finish()
+    {
+        Write(0, (16 - m_bits) % 16);
+        return std::move(m_data);
+    }
+
+private:
+    std::vector<BYTE> m_data;
+    WORD m_word = 0;
+    unsigned m_bits = 0;
+
+    void Flush()
+    {
+        m_data.push_back(LOBYTE(m_word));
+        m_data.push_back(HIBYTE(m_word));
+        m_word = 0;
+        m_bits = 0;
+    }
+};
+
+struct LzxCode
+{
+    std::vector<BYTE> Lens;
+    std::vector<WORD> Codes;
+
+    explicit LzxCode(std::vector<BYTE> lens)
+        : Lens(std::move(lens))
+        , Codes(Lens.size())
+    {
+        WORD code = 0;
+        for (BYTE len = 1; len <= 16; len++)
+        {
+            for (size_t i = 0; i < Lens.size(); i++)
+            {
+                if (Lens[i] == len)
+                    Codes[i] = code++;
+            }
+            code <<= 1;
+        }
+    }
+
+    void Write(LzxBitWriter& writer, size_t symbol) const
+    {
+        Assert::IsTrue(Lens[symbol] != 0);
+        writer.Write(Codes[symbol], Lens[symbol]);
+    }
+};
+
+// Code lengths are deltas from the previous block's, with runs of zeroes and of identical lengths
+void WriteLzxCodeLens(
+    LzxBitWriter& writer,
+    const std::vector<BYTE>& previous,
+    const std::vector<BYTE>& lens,
+    size_t begin,
+    size_t end)
+{
+    const LzxCode precode(std::vector<BYTE>(20, 5));
+    for (size_t i = 0; i < precode.Lens.size(); i++)
+        writer.Write(precode.Lens[i], 4);
+
+    size_t i = begin;
+    while (i < end)
+    {
+        size_t run = 1;
+        while (i + run < end && lens[i + run] == lens[i])
+            run++;
+
+        const auto delta = (previous[i] + 17 - lens[i]) % 17;
+        if (lens[i] == 0 && run >= 20)
+        {
+            run = std::min<size_t>(run, 51);
+            precode.Write(writer, 18);
+            writer.Write(static_cast<DWORD>(run - 20), 5);
+        }
+        else if (lens[i] == 0 && run >= 4)
+        {
+            run = std::min<size_t>(run, 19);
+            precode.Write(writer, 17);
+            writer.Write(static_cast<DWORD>(run - 4), 4);
+        }
+        else if (run >= 4)
+        {
+            run = std::min<size_t>(run, 5);
+            precode.Write(writer, 19);
+            writer.Write(static_cast<DWORD>(run - 4), 1);
+            precode.Write(writer, delta);
+        }
+        else
+        {
+            run = 1;
+            precode.Write(writer, delta);
+        }
+        i += run;
+    }
+}
+
+unsigned GetLzxExtraOffsetBits(unsigned slot)
+{
+    return slot < 4 ? 0 : (slot >> 1) - 1;
+}
+
+DWORD GetLzxOffsetSlotBase(unsigned slot)
+{
+    return slot < 4 ? slot : (2 | (slot & 1)) << GetLzxExtraOffsetBits(slot);
+}
+
+// The compressor translates the relative targets of x86 calls to absolute ones
+void TranslateE8(std::vector<BYTE>& chunk)
+{
+    constexpr LONG kE8FileSize = 12000000;
+
+    for (size_t i = 0; i + 10 < chunk.size();)
+    {
+        if (chunk[i] != 0xE8)
+        {
+            i++;
+            continue;
+        }
+
+        const auto pos = static_cast<LONG>(i);
+        LONG target = 0;
+        CopyMemory(&target, chunk.data() + i + 1, sizeof(target));
+        if (target >= -pos && target < kE8FileSize)
+        {
+            target = target < kE8FileSize - pos ? target + pos : target - kE8FileSize;
+            CopyMemory(chunk.data() + i + 1, &target, sizeof(target));
+        }
+        i += 5;
+    }
+}
+
+// A minimal LZX compressor with fixed code lengths, matches are looked up naively in the last 256 bytes.
+// 'blocks' are the type and size of the blocks of the chunk, uncompressed blocks can only be first.
+std::vector<BYTE> LzxCompressChunk(std::vector<BYTE> chunk, const std::vector<std::pair<unsigned, size_t>>& blocks)
+{
+    constexpr size_t kMaxMatchLength = 128;
+    constexpr size_t kWindow = 256;
+
+    std::vector<BYTE> mainLens(496, 9);
+    std::vector<BYTE> lenLens(249, 0);
+    std::fill(std::begin(lenLens), std::begin(lenLens) + (kMaxMatchLength - 8), static_cast<BYTE>(7));
+
+    const LzxCode mainCode(mainLens);
+    const LzxCode lenCode(lenLens);
+    const LzxCode alignedCode(std::vector<BYTE>(8, 3));
+
+    std::vector<BYTE> previousMainLens(mainLens.size(), 0);
+    std::vector<BYTE> previousLenLens(lenLens.size(), 0);
+    DWORD recentOffsets[3] = {1, 1, 1};
+
+    TranslateE8(chunk);
+
+    LzxBitWriter writer;
+    size_t pos = 0;
+    for (const auto& [type, size] : blocks)
+    {
+        writer.Write(type, 3);
+        if (size == kLzxChunkSize)
+        {
+            writer.Write(1, 1);
+        }
+        else
+        {
+            writer.Write(0, 1);
+            writer.Write(static_cast<DWORD>(size), 16);
+        }
+
+        if (type == kLzxBlockUncompressed)
+        {
+            Assert::AreEqual(static_cast<size_t>(0), pos);
+
+            const BYTE padding = 0;
+            writer.Align();
+            writer.WriteBytes(reinterpret_cast<const BYTE*>(recentOffsets), sizeof(recentOffsets));
+            writer.WriteBytes(chunk.data() + pos, size);
+            if (size & 1)
+                writer.WriteBytes(&padding, 1);
+            pos += size;
+            continue;
+        }
+
+        if (type == kLzxBlockAligned)
+        {
+            for (const auto len : alignedCode.Lens)
+                writer.Write(len, 3);
+        }
+
+        WriteLzxCodeLens(writer, previousMainLens, mainLens, 0, 256);
+        WriteLzxCodeLens(writer, previousMainLens, mainLens, 256, mainLens.size());
+        WriteLzxCodeLens(writer, previousLenLens, lenLens, 0, lenLens.size());
+        previousMainLens = mainLens;
+        previousLenLens = lenLens;
+
+        const size_t blockEnd = pos + size;
+        while (pos < blockEnd)
+        {
+            size_t matchOffset = 0;
+            size_t matchLength = 0;
+            for (size_t offset = 1; offset <= std::min(pos, kWindow); offset++)
+            {
+                size_t length = 0;
+                while (length < std::min(kMaxMatchLength, blockEnd - pos)
+                       && chunk[pos + length] == chunk[pos + length - offset])
+                    length++;
+
+                if (length > matchLength)
+                {
+                    matchOffset = offset;
+                    matchLength = length;
+                }
+            }
+
+            if (matchLength < 3)
+            {
+                mainCode.Write(writer, chunk[pos++]);
+                continue;
+            }
+
+            const auto offset = static_cast<DWORD>(matchOffset);
+            unsigned slot = 0;
+            if (offset == recentOffsets[0])
+            {
+                slot = 0;
+            }
+            else if (offset == recentOffsets[1] || offset == recentOffsets[2])
+            {
+                slot = offset == recentOffsets[1] ? 1 : 2;
+                std::swap(recentOffsets[0], recentOffsets[slot]);
+            }
+            else
+            {
+                slot = 3;
+                while (slot + 1 < 30 && GetLzxOffsetSlotBase(slot + 1) <= offset + 2)
+                    slot++;
+
+                recentOffsets[2] = recentOffsets[1];
+                recentOffsets[1] = recentOffsets[0];
+                recentOffsets[0] = offset;
+            }
+
+            const auto lengthHeader = std::min<size_t>(matchLength - 2, 7);
+            mainCode.Write(writer, 256 + slot * 8 + lengthHeader);
+            if (lengthHeader == 7)
+                lenCode.Write(writer, matchLength - 2 - 7);
+
+            if (slot >= 3)
+            {
+                const auto extraBits = GetLzxExtraOffsetBits(slot);
+                const auto extra = offset + 2 - GetLzxOffsetSlotBase(slot);
+                if (type == kLzxBlockAligned && extraBits >= 3)
+                {
+                    writer.Write(extra >> 3, extraBits - 3);
+                    alignedCode.Write(writer, extra & 7);
+                }
+                else
+                {
+                    writer.Write(extra, extraBits);
+                }
+            }
+
+            pos += matchLength;
+        }
+    }
+
+    Assert::AreEqual(chunk.size(), pos);
+    return writer.Finish();
+}
+
+// Each chunk has a different layout of blocks
+std::vector<BYTE> CompressLzxChunks(const std::vector<BYTE>& data)
+{
+    const std::vector<std::vector<std::pair<unsigned, size_t>>> layouts = {
+        {{kLzxBlockVerbatim, kLzxChunkSize}},
+        {{kLzxBlockAligned, 0x3000}, {kLzxBlockVerbatim, kLzxChunkSize}},
+        {{kLzxBlockUncompressed, 0x1001}, {kLzxBlockAligned, kLzxChunkSize}},
+        {{kLzxBlockVerbatim, 0x100}, {kLzxBlockAligned, 0x100}, {kLzxBlockVerbatim, kLzxChunkSize}}};
+
+    const size_t cChunks = (data.size() + kLzxChunkSize - 1) / kLzxChunkSize;
+    std::vector<DWORD> table;
+    std::vector<BYTE> chunks;
+
+    for (size_t i = 0; i < cChunks; i++)
+    {
+        const auto pChunk = data.data() + i * kLzxChunkSize;
+        const auto cbChunk = std::min<size_t>(kLzxChunkSize, data.size() - i * kLzxChunkSize);
+
+        // the last block ends the chunk
+        std::vector<std::pair<unsigned, size_t>> blocks;
+        size_t cbBlocks = 0;
+        for (auto [type, size] : layouts[i % layouts.size()])
+        {
+            size = std::min(size, cbChunk - cbBlocks);
+            if (size == 0)
+                break;
+            blocks.emplace_back(type, size);
+            cbBlocks += size;
+        }
+        blocks.back().second += cbChunk - cbBlocks;
+
+        const auto compressed = LzxCompressChunk(std::vector<BYTE>(pChunk, pChunk + cbChunk), blocks);
+        if (compressed.size() < cbChunk)
+            chunks.insert(std::end(chunks), std::cbegin(compressed), std::cend(compressed));
+        else
+            chunks.insert(std::end(chunks), pChunk, pChunk + cbChunk);
+
+        if (i + 1 < cChunks)
+            table.push_back(static_cast<DWORD>(chunks.size()));
+    }
+
+    std::vector<BYTE> compressed(table.size() * sizeof(DWORD));
+    CopyMemory(compressed.data(), table.data(), compressed.size());
+    compressed.insert(std::end(compressed), std::cbegin(chunks), std::cend(chunks));
+    return compressed;
+}
+
+std::shared_ptr<WofDecompressStream>
+OpenStream(std::vector<BYTE>& compressed, WofDecompressStream::Algorithm algorithm, size_t cbData)
+{
+    auto memStream = std::make_shared<MemoryStream>();
+    Assert::IsTrue(SUCCEEDED(memStream->OpenForReadOnly(compressed.data(), compressed.size())));
+
+    const std::shared_ptr<ByteStream> chained = memStream;
+    auto stream = std::make_shared<WofDecompressStream>();
+    Assert::IsTrue(SUCCEEDED(stream->Open(chained, algorithm, cbData)));
+    return stream;
+}
+
+std::vector<BYTE> ReadAll(WofDecompressStream& stream, size_t cbChunk)
+{
+    std::vector<BYTE> result(static_cast<size_t>(stream.GetSize()));
+
+    size_t offset = 0;
+    while (offset < result.size())
+    {
+        ULONGLONG ullRead = 0LL;
+        const auto cbToRead = std::min(cbChunk, result.size() - offset);
+        Assert::IsTrue(SUCCEEDED(stream.Read(result.data() + offset, cbToRead, &ullRead)));
+        Assert::IsTrue(ullRead > 0);
+        offset += static_cast<size_t>(ullRead);
+    }
+
+    return result;
+}
+
+void CheckReads(std::vector<BYTE>& compressed, WofDecompressStream::Algorithm algorithm, const std::vector<BYTE>& data)
+{
+    const auto dwChunkSize = WofDecompressStream::GetChunkSize(algorithm);
+
+    {
+        auto stream = OpenStream(compressed, algorithm, data.size());
+        Assert::IsTrue(data == ReadAll(*stream, data.size()));
+    }
+
+    {
+        auto stream = OpenStream(compressed, algorithm, data.size());
+        Assert::IsTrue(data == ReadAll(*stream, 3000));
+    }
+
+    {
+        auto stream = OpenStream(compressed, algorithm, data.size());
+        for (const ULONGLONG ullOffset : {ULONGLONG(data.size() * 7 / 10 + 10), ULONGLONG(3 * dwChunkSize)})
+        {
+            Assert::IsTrue(SUCCEEDED(stream->SetFilePointer(ullOffset, FILE_BEGIN, nullptr)));
+
+            std::vector<BYTE> buffer(2 * dwChunkSize + 100);
+            ULONGLONG ullRead = 0LL;
+            Assert::IsTrue(SUCCEEDED(stream->Read(buffer.data(), buffer.size(), &ullRead)));
+            Assert::AreEqual(static_cast<ULONGLONG>(buffer.size()), ullRead);
+            Assert::IsTrue(std::equal(std::cbegin(buffer), std::cend(buffer), std::cbegin(data) + ullOffset));
+        }
+    }
+}
+
+}  // namespace
+
+namespace Orc::Test {
+TEST_CLASS(WofDecompressStreamTest)
+{
+private:
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize) {}
+
+    TEST_METHOD_CLEANUP(Finalize) {}
+
+    TEST_METHOD(ReadChunks)
+    {
+        for (const auto algorithm :
+             {WofDecompressStream::Algorithm::Xpress4K,
+              WofDecompressStream::Algorithm::Xpress8K,
+              WofDecompressStream::Algorithm::Xpress16K})
+        {
+            const auto dwChunkSize = WofDecompressStream::GetChunkSize(algorithm);
+
+            // the last chunk is truncated
+            const auto data = MakeData(100 * dwChunkSize + 1234);
+            auto compressed = CompressChunks(data, dwChunkSize);
+            CheckReads(compressed, algorithm, data);
+        }
+    }
+
+    TEST_METHOD(ReadLzxChunks)
+    {
+        const auto algorithm = WofDecompressStream::Algorithm::Lzx;
+        auto data = MakeData(10 * kLzxChunkSize + 1234);
+
+        // x86 calls, both relative and absolute targets are translated
+        for (size_t i = 0x100; i + 5 < data.size(); i += 0x777)
+        {
+            const auto pos = static_cast<LONG>(i % kLzxChunkSize);
+            const LONG target = i % 3 == 0 ? -pos / 2 : (i % 7 == 0 ? 11999990 : static_cast<LONG>(i % 5000));
+            data[i] = 0xE8;
+            CopyMemory(data.data() + i + 1, &target, sizeof(target));
+        }
+
+        auto compressed = CompressLzxChunks(data);
+        CheckReads(compressed, algorithm, data);
+    }
+
+    TEST_METHOD(InvalidChunkTable)
+    {
+        const auto algorithm = WofDecompressStream::Algorithm::Xpress4K;
+        const auto data = MakeData(8 * WofDecompressStream::GetChunkSize(algorithm));
+        auto compressed = CompressChunks(data, WofDecompressStream::GetChunkSize(algorithm));
+
+        // chunk end offsets must increase
+        reinterpret_cast<DWORD*>(compressed.data())[2] = reinterpret_cast<DWORD*>(compressed.data())[1];
+
+        auto memStream = std::make_shared<MemoryStream>();
+        Assert::IsTrue(SUCCEEDED(memStream->OpenForReadOnly(compressed.data(), compressed.size())));
+
+        WofDecompressStream stream;
+        Assert::IsTrue(FAILED(stream.Open(memStream, algorithm, data.size())));
+        Assert::IsTrue(FAILED(stream.Open(memStream, static_cast<WofDecompressStream::Algorithm>(4), data.size())));
+    }
+};
+}  // namespace Orc::Test